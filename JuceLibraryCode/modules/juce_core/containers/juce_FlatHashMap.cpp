@@ -0,0 +1,390 @@
+/*
+  ==============================================================================
+
+   This file is part of the juce_core module of the JUCE library.
+   Copyright (c) 2013 - Raw Material Software Ltd.
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose with
+   or without fee is hereby granted, provided that the above copyright notice and this
+   permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+   ------------------------------------------------------------------------------
+
+   NOTE! This permissive ISC license applies ONLY to files within the juce_core module!
+   All other JUCE modules are covered by a dual GPL/commercial license, so if you are
+   using any other modules, be sure to check that you also comply with their license.
+
+   For more details, visit www.juce.com
+
+  ==============================================================================
+*/
+
+namespace FlatHashHelpers
+{
+    static const uint64 prime1 = 0x9e3779b185ebca87ULL;
+    static const uint64 prime2 = 0xc2b2ae3d27d4eb4fULL;
+    static const uint64 prime3 = 0x165667b19e3779f9ULL;
+    static const uint64 prime4 = 0x85ebca77c2b2ae63ULL;
+    static const uint64 prime5 = 0x27d4eb2f165667c5ULL;
+
+    static inline uint64 rotateLeft (uint64 x, int bits) noexcept   { return (x << bits) | (x >> (64 - bits)); }
+
+    static inline uint64 round (uint64 accumulator, uint64 input) noexcept
+    {
+        return rotateLeft (accumulator + input * prime2, 31) * prime1;
+    }
+
+    static inline uint64 mergeRound (uint64 accumulator, uint64 value) noexcept
+    {
+        return (accumulator ^ round (0, value)) * prime1 + prime4;
+    }
+}
+
+uint64 FlatHashFunctions::hashBytes (const void* const data, const size_t numBytes, const uint64 seed) noexcept
+{
+    using namespace FlatHashHelpers;
+
+    const uint8* p = static_cast<const uint8*> (data);
+    const uint8* const end = p + numBytes;
+    uint64 h;
+
+    if (numBytes >= 32)
+    {
+        uint64 v1 = seed + prime1 + prime2, v2 = seed + prime2, v3 = seed, v4 = seed - prime1;
+
+        for (const uint8* const limit = end - 32; p <= limit; p += 32)
+        {
+            v1 = round (v1, ByteOrder::littleEndianInt64 (p));
+            v2 = round (v2, ByteOrder::littleEndianInt64 (p + 8));
+            v3 = round (v3, ByteOrder::littleEndianInt64 (p + 16));
+            v4 = round (v4, ByteOrder::littleEndianInt64 (p + 24));
+        }
+
+        h = rotateLeft (v1, 1) + rotateLeft (v2, 7) + rotateLeft (v3, 12) + rotateLeft (v4, 18);
+        h = mergeRound (mergeRound (mergeRound (mergeRound (h, v1), v2), v3), v4);
+    }
+    else
+    {
+        h = seed + prime5;
+    }
+
+    h += (uint64) numBytes;
+
+    for (; p + 8 <= end; p += 8)
+        h = rotateLeft (h ^ round (0, ByteOrder::littleEndianInt64 (p)), 27) * prime1 + prime4;
+
+    if (p + 4 <= end)
+    {
+        h = rotateLeft (h ^ (ByteOrder::littleEndianInt (p) * prime1), 23) * prime2 + prime3;
+        p += 4;
+    }
+
+    for (; p < end; ++p)
+        h = rotateLeft (h ^ (*p * prime5), 11) * prime1;
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class FlatHashMapTests  : public UnitTest
+{
+public:
+    FlatHashMapTests() : UnitTest ("FlatHashMap") {}
+
+    template <class MapType>
+    static int64 sumContents (const MapType& map)
+    {
+        int64 total = 0;
+
+        for (typename MapType::Iterator i (map); i.next();)
+            total += i.getKey() * 3 + i.getValue();
+
+        return total;
+    }
+
+    template <class MapType>
+    static double timeInserts (MapType& map, const Array<int>& keys)
+    {
+        const double start = Time::getMillisecondCounterHiRes();
+
+        for (int i = 0; i < keys.size(); ++i)
+            map.set (keys.getUnchecked (i), i);
+
+        return Time::getMillisecondCounterHiRes() - start;
+    }
+
+    template <class MapType>
+    static double timeLookups (const MapType& map, const Array<int>& keys, int& numFound)
+    {
+        const double start = Time::getMillisecondCounterHiRes();
+
+        for (int repeat = 0; repeat < 4; ++repeat)
+            for (int i = 0; i < keys.size(); ++i)
+                numFound += map.contains (keys.getUnchecked (i)) ? 1 : 0;
+
+        return Time::getMillisecondCounterHiRes() - start;
+    }
+
+    template <class MapType>
+    static double timeRemoves (MapType& map, const Array<int>& keys)
+    {
+        const double start = Time::getMillisecondCounterHiRes();
+
+        for (int i = 0; i < keys.size(); ++i)
+            map.remove (keys.getUnchecked (i));
+
+        return Time::getMillisecondCounterHiRes() - start;
+    }
+
+    template <class MapType>
+    static double timeStringLookups (const MapType& map, const StringArray& keys, int& numFound)
+    {
+        const double start = Time::getMillisecondCounterHiRes();
+
+        for (int repeat = 0; repeat < 4; ++repeat)
+            for (int i = 0; i < keys.size(); ++i)
+                numFound += map [keys[i]];
+
+        return Time::getMillisecondCounterHiRes() - start;
+    }
+
+    void runTest() override
+    {
+        beginTest ("Hash functions");
+        {
+            expect (FlatHashFunctions::hashBytes ("", 0) == 0xef46db3751d8e999ULL);
+            expect (FlatHashFunctions::hashBytes ("abc", 3) == 0x44bc2cf5ad770999ULL);
+            expect (FlatHashFunctions::hashBytes ("The quick brown fox jumps over the lazy dog", 43) == 0x0b242d361fda71bcULL);
+
+            const FlatHashFunctions hasher;
+            expect (hasher.generateHash (String ("abc")) == (uint32) 0x44bc2cf5ad770999ULL);
+            expect (hasher.generateHash (Identifier ("abc")) == hasher.generateHash (String ("abc")));
+
+            // consecutive keys, and keys that are all multiples of 16, should both spread
+            // evenly over the low bits
+            for (int step = 1; step <= 16; step *= 16)
+            {
+                int counts [256] = { 0 };
+
+                for (int i = 0; i < 256 * 64; ++i)
+                    ++counts [hasher.generateHash (i * step) & 255];
+
+                int busiest = 0;
+
+                for (int i = 0; i < 256; ++i)
+                    busiest = jmax (busiest, counts[i]);
+
+                expect (busiest < 64 * 2);
+            }
+        }
+
+        beginTest ("Matches HashMap");
+        {
+            Random r (getRandom());
+            FlatHashMap<int, int> map;
+            HashMap<int, int> reference;
+
+            for (int i = 0; i < 50000; ++i)
+            {
+                const int key = r.nextInt (3000) - 1000;
+
+                switch (r.nextInt (4))
+                {
+                    case 0:
+                    case 1:     map.set (key, i); reference.set (key, i); break;
+                    case 2:     map.remove (key); reference.remove (key); break;
+                    default:    expectEquals (map [key], reference [key]);
+                                expect (map.contains (key) == reference.contains (key)); break;
+                }
+            }
+
+            expectEquals (map.size(), reference.size());
+            expect (sumContents (map) == sumContents (reference));
+
+            for (HashMap<int, int>::Iterator i (reference); i.next();)
+                expectEquals (map [i.getKey()], i.getValue());
+        }
+
+        beginTest ("Removing and remapping");
+        {
+            FlatHashMap<int, int> map (100);
+            expectEquals (map.getNumSlots(), 128);
+
+            for (int i = 0; i < 1000; ++i)
+                map.set (i, i % 10);
+
+            expect (map.getNumSlots() >= 2048);
+            expect (map.containsValue (3));
+
+            map.removeValue (3);
+            expectEquals (map.size(), 900);
+            expect (! map.containsValue (3));
+
+            for (int i = 0; i < 1000; i += 2)
+                map.remove (i);
+
+            expectEquals (map.size(), 400);
+
+            map.remapTable (0);
+            expectEquals (map.getNumSlots(), 1024);
+            map.remapTable (8192);
+            expectEquals (map.getNumSlots(), 8192);
+
+            int numWrong = 0;
+
+            for (int i = 0; i < 1000; ++i)
+                if (map.contains (i) != ((i & 1) != 0 && i % 10 != 3))
+                    ++numWrong;
+
+            expectEquals (numWrong, 0);
+
+            ++map.getReference (1);
+            ++map.getReference (-1);
+            expectEquals (map [1], 2);
+            expectEquals (map [-1], 1);
+
+            FlatHashMap<int, int> other;
+            other.set (5, 5);
+            map.swapWith (other);
+            expectEquals (map.size(), 1);
+            expectEquals (other.size(), 401);
+
+            other.clear();
+            expectEquals (other.size(), 0);
+            expect (! other.contains (1));
+        }
+
+        beginTest ("String and Identifier keys");
+        {
+            FlatHashMap<String, int> strings;
+            FlatHashMap<Identifier, String> identifiers;
+
+            for (int i = 0; i < 2000; ++i)
+            {
+                strings.set ("key" + String (i), i);
+                identifiers.set (Identifier ("id" + String (i)), String (i));
+            }
+
+            for (int i = 0; i < 2000; i += 3)
+                strings.remove ("key" + String (i));
+
+            int numWrong = 0;
+
+            for (int i = 0; i < 2000; ++i)
+            {
+                if (strings ["key" + String (i)] != (i % 3 == 0 ? 0 : i))
+                    ++numWrong;
+
+                if (identifiers [Identifier ("id" + String (i))] != String (i))
+                    ++numWrong;
+            }
+
+            expectEquals (numWrong, 0);
+            expect (! strings.contains (String()));
+        }
+
+        beginTest ("FlatHashSet");
+        {
+            FlatHashSet<String> set;
+            expect (set.add ("one"));
+            expect (set.add ("two"));
+            expect (! set.add ("one"));
+            expectEquals (set.size(), 2);
+            expect (set.contains ("two"));
+            expect (set.remove ("two"));
+            expect (! set.remove ("two"));
+            expect (! set.contains ("two"));
+
+            FlatHashSet<void*> pointers;
+
+            for (int i = 0; i < 1000; ++i)
+                pointers.add (reinterpret_cast<void*> ((pointer_sized_int) (i * 16)));
+
+            int numIterated = 0;
+
+            for (FlatHashSet<void*>::Iterator i (pointers); i.next();)
+                numIterated += (((pointer_sized_int) i.getKey()) % 16 == 0) ? 1 : 0;
+
+            expectEquals (numIterated, 1000);
+        }
+
+        beginTest ("Benchmarks");
+        {
+            Random r (getRandom());
+            Array<int> keys;
+
+            for (int i = 0; i < 200000; ++i)
+                keys.add ((int) r.nextInt());
+
+            // look things up in a different order from the one they were added in, as
+            // HashMap's nodes would otherwise be visited in the order they were allocated
+            Array<int> shuffledKeys (keys);
+
+            for (int i = shuffledKeys.size(); --i > 0;)
+                shuffledKeys.swap (i, r.nextInt (i + 1));
+
+            {
+                FlatHashMap<int, int> flat;
+                HashMap<int, int> chained;
+                int numFound = 0;
+
+                const double flatInsert = timeInserts (flat, keys);
+                const double chainedInsert = timeInserts (chained, keys);
+                const double flatLookup = timeLookups (flat, shuffledKeys, numFound);
+                const double chainedLookup = timeLookups (chained, shuffledKeys, numFound);
+                const double flatRemove = timeRemoves (flat, shuffledKeys);
+                const double chainedRemove = timeRemoves (chained, shuffledKeys);
+
+                expectEquals (flat.size(), 0);
+                expectEquals (numFound, keys.size() * 8);
+
+                logMessage (String (keys.size()) + " int keys, FlatHashMap vs HashMap (ms): insert "
+                              + String (flatInsert, 1) + " / " + String (chainedInsert, 1)
+                              + ", lookup x4 " + String (flatLookup, 1) + " / " + String (chainedLookup, 1)
+                              + ", remove " + String (flatRemove, 1) + " / " + String (chainedRemove, 1));
+            }
+
+            {
+                StringArray stringKeys;
+
+                for (int i = 0; i < 50000; ++i)
+                    stringKeys.add ("item_" + String::toHexString (shuffledKeys.getUnchecked (i)));
+
+                FlatHashMap<String, int> flat;
+                HashMap<String, int> chained;
+
+                for (int i = 0; i < stringKeys.size(); ++i)
+                {
+                    flat.set (stringKeys[i], 1);
+                    chained.set (stringKeys[i], 1);
+                }
+
+                int numFound = 0;
+                const double flatLookup = timeStringLookups (flat, stringKeys, numFound);
+                const double chainedLookup = timeStringLookups (chained, stringKeys, numFound);
+                expectEquals (numFound, stringKeys.size() * 8);
+
+                logMessage (String (stringKeys.size()) + " String keys, FlatHashMap vs HashMap (ms): lookup x4 "
+                              + String (flatLookup, 1) + " / " + String (chainedLookup, 1));
+            }
+        }
+    }
+};
+
+static FlatHashMapTests flatHashMapTests;
+
+#endif
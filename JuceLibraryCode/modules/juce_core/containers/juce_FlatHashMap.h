@@ -0,0 +1,751 @@
+/*
+  ==============================================================================
+
+   This file is part of the juce_core module of the JUCE library.
+   Copyright (c) 2013 - Raw Material Software Ltd.
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose with
+   or without fee is hereby granted, provided that the above copyright notice and this
+   permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+   ------------------------------------------------------------------------------
+
+   NOTE! This permissive ISC license applies ONLY to files within the juce_core module!
+   All other JUCE modules are covered by a dual GPL/commercial license, so if you are
+   using any other modules, be sure to check that you also comply with their license.
+
+   For more details, visit www.juce.com
+
+  ==============================================================================
+*/
+
+#ifndef JUCE_FLATHASHMAP_H_INCLUDED
+#define JUCE_FLATHASHMAP_H_INCLUDED
+
+
+//==============================================================================
+/**
+    Hash functions for FlatHashMap and FlatHashSet.
+
+    Unlike DefaultHashFunctions, these return a full 32-bit hash rather than a slot
+    number, and every input bit affects every output bit. That matters because the
+    flat tables pick a slot from the low bits of the hash, so sequential integers or
+    pointers that are all multiples of 16 would otherwise pile up together.
+
+    To hash your own key types, write a class with the same form, i.e.
+    @code
+    struct MyHashGenerator
+    {
+        uint32 generateHash (const MyKeyType& key) const noexcept
+        {
+            return FlatHashFunctions::mix (someFunctionOfMyKeyType (key));
+        }
+    };
+    @endcode
+
+    @see FlatHashMap, FlatHashSet
+*/
+struct JUCE_API  FlatHashFunctions
+{
+    /** Scrambles a 64-bit value, so that inputs differing in any bit give unrelated results. */
+    static uint32 mix (uint64 x) noexcept
+    {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return (uint32) x;
+    }
+
+    /** Returns the XXH64 hash of a block of memory. */
+    static uint64 hashBytes (const void* data, size_t numBytes, uint64 seed = 0) noexcept;
+
+    uint32 generateHash (const int key) const noexcept             { return mix ((uint64) (int64) key); }
+    uint32 generateHash (const uint32 key) const noexcept          { return mix ((uint64) key); }
+    uint32 generateHash (const int64 key) const noexcept           { return mix ((uint64) key); }
+    uint32 generateHash (const uint64 key) const noexcept          { return mix (key); }
+
+    /** Strings are hashed by content. */
+    uint32 generateHash (const String& key) const noexcept
+    {
+        const String::CharPointerType text (key.getCharPointer());
+        return (uint32) hashBytes (text.getAddress(), text.sizeInBytes() - sizeof (*text.getAddress()));
+    }
+
+    /** Identifiers carry a hash of their text, so this doesn't need to read it. */
+    uint32 generateHash (const Identifier& key) const noexcept     { return key.getHash(); }
+
+    uint32 generateHash (const var& key) const noexcept            { return generateHash (key.toString()); }
+
+    template <typename ObjectType>
+    uint32 generateHash (ObjectType* const key) const noexcept     { return mix ((uint64) (pointer_sized_uint) key); }
+};
+
+
+#ifndef DOXYGEN
+namespace FlatHashHelpers
+{
+    /** The open-addressing table that FlatHashMap and FlatHashSet are built on.
+
+        It uses linear probing with Robin-Hood ordering: within each run of occupied
+        slots, the entries are kept sorted by the slot they'd ideally be in. That keeps
+        probe lengths short and even at high load, lets a search for a missing key stop
+        as soon as it reaches an entry that's closer to home than the key would be, and
+        lets removal shuffle the following entries back rather than leaving tombstones.
+
+        Each slot records how far its entry is from home (plus one, so that 0 means
+        "empty"), which makes both of those stopping conditions a single comparison, and
+        the entry's full hash, so most non-matching keys are rejected without comparing
+        them.
+
+        Like Array, this moves its entries around with memcpy, so the key and value types
+        must be ones that don't mind being relocated in memory.
+    */
+    template <class EntryType, class HashFunctionType>
+    class Table
+    {
+    public:
+        Table (int initialCapacity, const HashFunctionType& hashFunction_)
+            : hashFunction (hashFunction_), mask (0), numUsed (0)
+        {
+            if (initialCapacity > 0)
+                reallocate (getCapacityNeededFor (0, initialCapacity));
+        }
+
+        ~Table()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            for (uint32 i = 0; numUsed > 0; ++i)
+            {
+                if (slots[i].probeLength != 0)
+                {
+                    slots[i].entry.~EntryType();
+                    slots[i].probeLength = 0;
+                    --numUsed;
+                }
+            }
+        }
+
+        inline int size() const noexcept            { return numUsed; }
+        inline int getCapacity() const noexcept     { return slots != nullptr ? (int) mask + 1 : 0; }
+
+        template <typename KeyType>
+        inline uint32 getHash (const KeyType& key) const noexcept
+        {
+            return hashFunction.generateHash (key);
+        }
+
+        /** Returns the slot that holds the key, or -1. */
+        template <typename KeyType>
+        int find (const KeyType& key, const uint32 hash) const
+        {
+            if (numUsed > 0)
+            {
+                for (uint32 pos = hash & mask, probeLength = 1;; pos = (pos + 1) & mask, ++probeLength)
+                {
+                    const Slot& slot = slots[pos];
+
+                    if (slot.probeLength < probeLength)
+                        break;
+
+                    if (slot.hash == hash && slot.entry.key == key)
+                        return (int) pos;
+                }
+            }
+
+            return -1;
+        }
+
+        /** Makes room for a new entry with the given hash, which mustn't already be in
+            the table, and returns the raw memory in which the caller must construct it.
+        */
+        void* insert (const uint32 hash)
+        {
+            if (numUsed >= getMaxLoad())
+                reallocate (jmax ((uint32) minimumCapacity, (mask + 1) * 2));
+
+            uint32 pos = hash & mask, probeLength = 1;
+
+            while (slots[pos].probeLength >= probeLength)
+            {
+                pos = (pos + 1) & mask;
+                ++probeLength;
+            }
+
+            if (slots[pos].probeLength != 0)
+            {
+                // shuffle the rest of this run along by one to make room
+                uint32 gap = pos;
+
+                while (slots[gap].probeLength != 0)
+                    gap = (gap + 1) & mask;
+
+                for (uint32 i = gap; i != pos;)
+                {
+                    const uint32 previous = (i - 1) & mask;
+                    memcpy (static_cast<void*> (slots + i), slots + previous, sizeof (Slot));
+                    ++(slots[i].probeLength);
+                    i = previous;
+                }
+            }
+
+            Slot& slot = slots[pos];
+            slot.probeLength = probeLength;
+            slot.hash = hash;
+            ++numUsed;
+            return &(slot.entry);
+        }
+
+        void removeAt (uint32 pos)
+        {
+            jassert (pos <= mask && slots[pos].probeLength != 0);
+
+            slots[pos].entry.~EntryType();
+            --numUsed;
+
+            // pull back any entries that were displaced past this one
+            for (uint32 next = (pos + 1) & mask; slots[next].probeLength > 1; next = (next + 1) & mask)
+            {
+                memcpy (static_cast<void*> (slots + pos), slots + next, sizeof (Slot));
+                --(slots[pos].probeLength);
+                pos = next;
+            }
+
+            slots[pos].probeLength = 0;
+        }
+
+        /** Changes the number of slots. This will be at least enough for the current contents. */
+        void rehash (int minimumSlots)
+        {
+            const uint32 newCapacity = getCapacityNeededFor (jmax (numUsed, 1), minimumSlots);
+
+            if (newCapacity != (uint32) getCapacity())
+                reallocate (newCapacity);
+        }
+
+        /** Returns the index of the first occupied slot at or after the given one, or -1. */
+        int getNextUsedSlot (int index) const noexcept
+        {
+            for (const int capacity = getCapacity(); index < capacity; ++index)
+                if (slots[index].probeLength != 0)
+                    return index;
+
+            return -1;
+        }
+
+        inline EntryType& getEntry (int index) const noexcept      { return slots[index].entry; }
+
+        void swapWith (Table& other) noexcept
+        {
+            slots.swapWith (other.slots);
+            std::swap (mask, other.mask);
+            std::swap (numUsed, other.numUsed);
+            std::swap (hashFunction, other.hashFunction);
+        }
+
+        HashFunctionType hashFunction;
+
+    private:
+        enum { minimumCapacity = 8 };
+
+        // these are never constructed as a whole: the first two fields are just written
+        // to, and the entry is placement-constructed when the slot gets used
+        struct Slot
+        {
+            uint32 probeLength, hash;
+            EntryType entry;
+        };
+
+        HeapBlock<Slot> slots;
+        uint32 mask;
+        int numUsed;
+
+        // The table grows when it's half full. Linear probing gets noticeably slower
+        // above that, because a lookup that has to look past the first slot usually
+        // costs a mispredicted branch while it waits for memory.
+        inline int getMaxLoad() const noexcept              { return slots != nullptr ? (int) ((mask + 1) >> 1) : 0; }
+
+        static uint32 getCapacityNeededFor (int numItems, int minimumSlots = 0) noexcept
+        {
+            uint32 capacity = minimumCapacity;
+
+            while ((int) (capacity >> 1) < numItems || (int) capacity < minimumSlots)
+                capacity <<= 1;
+
+            return capacity;
+        }
+
+        void reallocate (const uint32 newCapacity)
+        {
+            const uint32 oldCapacity = (uint32) getCapacity();
+            HeapBlock<Slot> oldSlots;
+            oldSlots.swapWith (slots);
+            slots.calloc (newCapacity);
+
+            const int numToMove = numUsed;
+            mask = newCapacity - 1;
+            numUsed = 0;
+
+            for (uint32 i = 0; i < oldCapacity && numUsed < numToMove; ++i)
+                if (oldSlots[i].probeLength != 0)
+                    memcpy (insert (oldSlots[i].hash), &(oldSlots[i].entry), sizeof (EntryType));
+        }
+    };
+}
+#endif
+
+//==============================================================================
+/**
+    Holds a set of mappings between some key/value pairs, in a single flat table.
+
+    This has the same interface as HashMap, so it can be used in place of one, but
+    it's usually several times faster. HashMap allocates a node for every item and
+    chains them together; this keeps the items themselves in one power-of-two sized
+    array using Robin-Hood open addressing, so adding an item doesn't allocate (except
+    when the table grows, which it does by itself when it gets half full) and a lookup
+    normally touches just one or two neighbouring slots.
+
+    The differences from HashMap are:
+    - The HashFunctionType's generateHash() method takes just a key and returns a
+      32-bit hash, rather than being given the number of slots. The default
+      FlatHashFunctions handles integers, strings, Identifiers, vars and pointers.
+    - Like Array, it moves the keys and values around with memcpy, so these must be
+      types that can be relocated in memory, which is true of all the JUCE classes.
+
+    @code
+    FlatHashMap<String, int> map;
+    map.set ("one", 1);
+    map.set ("two", 2);
+
+    DBG (map ["two"]); // prints "2"
+
+    for (FlatHashMap<String, int>::Iterator i (map); i.next();)
+        DBG (i.getKey() << " -> " << i.getValue());
+    @endcode
+
+    @see HashMap, FlatHashSet, FlatHashFunctions
+*/
+template <typename KeyType,
+          typename ValueType,
+          class HashFunctionType = FlatHashFunctions,
+          class TypeOfCriticalSectionToUse = DummyCriticalSection>
+class FlatHashMap
+{
+private:
+    typedef PARAMETER_TYPE (KeyType)   KeyTypeParameter;
+    typedef PARAMETER_TYPE (ValueType) ValueTypeParameter;
+
+public:
+    //==============================================================================
+    /** Creates an empty map.
+
+        @param numberOfSlots  if this is more than zero, the map starts off with at least
+                              this many slots, so that it won't need to grow until it holds
+                              half that many items.
+        @param hashFunction   an instance of HashFunctionType, which will be copied and
+                              stored to use with the map.
+    */
+    explicit FlatHashMap (int numberOfSlots = 0,
+                          HashFunctionType hashFunction = HashFunctionType())
+       : table (numberOfSlots, hashFunction)
+    {
+    }
+
+    /** Destructor. */
+    ~FlatHashMap()
+    {
+    }
+
+    //==============================================================================
+    /** Removes all values from the map. The number of slots is left unchanged. */
+    void clear()
+    {
+        const ScopedLockType sl (getLock());
+        table.clear();
+    }
+
+    //==============================================================================
+    /** Returns the current number of items in the map. */
+    inline int size() const noexcept
+    {
+        return table.size();
+    }
+
+    /** Returns the value corresponding to a given key.
+        If the map doesn't contain the key, a default instance of the value type is returned.
+    */
+    inline ValueType operator[] (KeyTypeParameter keyToLookFor) const
+    {
+        const ScopedLockType sl (getLock());
+        const int index = table.find (keyToLookFor, table.getHash (keyToLookFor));
+        return index >= 0 ? table.getEntry (index).value : ValueType();
+    }
+
+    /** Returns a reference to the value corresponding to a given key, adding a default
+        value first if the map doesn't contain the key yet.
+        The reference is only valid until the map is next modified.
+    */
+    ValueType& getReference (KeyTypeParameter key)
+    {
+        const ScopedLockType sl (getLock());
+        const uint32 hash = table.getHash (key);
+        const int index = table.find (key, hash);
+
+        if (index >= 0)
+            return table.getEntry (index).value;
+
+        return (new (table.insert (hash)) Entry (key, ValueType()))->value;
+    }
+
+    //==============================================================================
+    /** Returns true if the map contains an item with the specied key. */
+    bool contains (KeyTypeParameter keyToLookFor) const
+    {
+        const ScopedLockType sl (getLock());
+        return table.find (keyToLookFor, table.getHash (keyToLookFor)) >= 0;
+    }
+
+    /** Returns true if the map contains at least one occurrence of a given value. */
+    bool containsValue (ValueTypeParameter valueToLookFor) const
+    {
+        const ScopedLockType sl (getLock());
+
+        for (int i = table.getNextUsedSlot (0); i >= 0; i = table.getNextUsedSlot (i + 1))
+            if (table.getEntry (i).value == valueToLookFor)
+                return true;
+
+        return false;
+    }
+
+    //==============================================================================
+    /** Adds or replaces an element in the map.
+        If there's already an item with the given key, this will replace its value. Otherwise, a new item
+        will be added to the map.
+    */
+    void set (KeyTypeParameter newKey, ValueTypeParameter newValue)
+    {
+        const ScopedLockType sl (getLock());
+        const uint32 hash = table.getHash (newKey);
+        const int index = table.find (newKey, hash);
+
+        if (index >= 0)
+            table.getEntry (index).value = newValue;
+        else
+            new (table.insert (hash)) Entry (newKey, newValue);
+    }
+
+    /** Removes an item with the given key. */
+    void remove (KeyTypeParameter keyToRemove)
+    {
+        const ScopedLockType sl (getLock());
+        const int index = table.find (keyToRemove, table.getHash (keyToRemove));
+
+        if (index >= 0)
+            table.removeAt ((uint32) index);
+    }
+
+    /** Removes all items with the given value. */
+    void removeValue (ValueTypeParameter valueToRemove)
+    {
+        const ScopedLockType sl (getLock());
+
+        for (int i = table.getNextUsedSlot (0); i >= 0;)
+        {
+            if (table.getEntry (i).value == valueToRemove)
+                table.removeAt ((uint32) i);  // this may have pulled another item into slot i
+            else
+                ++i;
+
+            i = table.getNextUsedSlot (i);
+        }
+    }
+
+    /** Changes the number of slots. The table always has a power-of-two number of them, and
+        this won't shrink it to the point where the current contents would make it grow again.
+    */
+    void remapTable (int newNumberOfSlots)
+    {
+        const ScopedLockType sl (getLock());
+        table.rehash (newNumberOfSlots);
+    }
+
+    /** Returns the number of slots in the table. */
+    inline int getNumSlots() const noexcept
+    {
+        return table.getCapacity();
+    }
+
+    //==============================================================================
+    /** Efficiently swaps the contents of two maps. */
+    template <class OtherHashMapType>
+    void swapWith (OtherHashMapType& otherHashMap) noexcept
+    {
+        const ScopedLockType lock1 (getLock());
+        const typename OtherHashMapType::ScopedLockType lock2 (otherHashMap.getLock());
+
+        table.swapWith (otherHashMap.table);
+    }
+
+    //==============================================================================
+    /** Returns the CriticalSection that locks this structure.
+        To lock, you can call getLock().enter() and getLock().exit(), or preferably use
+        an object of ScopedLockType as an RAII lock for it.
+    */
+    inline const TypeOfCriticalSectionToUse& getLock() const noexcept      { return lock; }
+
+    /** Returns the type of scoped lock to use for locking this map */
+    typedef typename TypeOfCriticalSectionToUse::ScopedLockType ScopedLockType;
+
+private:
+    //==============================================================================
+    struct Entry
+    {
+        Entry (KeyTypeParameter k, ValueTypeParameter v)  : key (k), value (v) {}
+
+        KeyType key;
+        ValueType value;
+    };
+
+public:
+    //==============================================================================
+    /** Iterates over the items in a FlatHashMap.
+
+        This works in the same way as HashMap::Iterator. The items come out in no
+        particular order, and the iterator must not be used after the map is modified.
+    */
+    class Iterator
+    {
+    public:
+        //==============================================================================
+        Iterator (const FlatHashMap& hashMapToIterate)
+            : hashMap (hashMapToIterate), index (-1)
+        {}
+
+        /** Moves to the next item, if one is available.
+            When this returns true, you can get the item's key and value using getKey() and
+            getValue(). If it returns false, the iteration has finished and you should stop.
+        */
+        bool next()
+        {
+            index = hashMap.table.getNextUsedSlot (index + 1);
+            return index >= 0;
+        }
+
+        /** Returns the current item's key.
+            This should only be called when a call to next() has just returned true.
+        */
+        KeyType getKey() const
+        {
+            return index >= 0 ? hashMap.table.getEntry (index).key : KeyType();
+        }
+
+        /** Returns the current item's value.
+            This should only be called when a call to next() has just returned true.
+        */
+        ValueType getValue() const
+        {
+            return index >= 0 ? hashMap.table.getEntry (index).value : ValueType();
+        }
+
+    private:
+        //==============================================================================
+        const FlatHashMap& hashMap;
+        int index;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Iterator)
+    };
+
+private:
+    //==============================================================================
+    friend class Iterator;
+    template <typename, typename, class, class> friend class FlatHashMap;
+
+    FlatHashHelpers::Table<Entry, HashFunctionType> table;
+    TypeOfCriticalSectionToUse lock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FlatHashMap)
+};
+
+
+//==============================================================================
+/**
+    Holds a set of unique keys in a single flat table.
+
+    This is the FlatHashMap equivalent of a set: it uses the same Robin-Hood table and
+    the same hash functions, but only stores keys. Use it instead of a SortedSet when
+    you just need to know whether something's in the set, and don't need it sorted.
+
+    @see FlatHashMap, FlatHashFunctions, SortedSet
+*/
+template <typename KeyType,
+          class HashFunctionType = FlatHashFunctions,
+          class TypeOfCriticalSectionToUse = DummyCriticalSection>
+class FlatHashSet
+{
+private:
+    typedef PARAMETER_TYPE (KeyType) KeyTypeParameter;
+
+public:
+    //==============================================================================
+    /** Creates an empty set. See the FlatHashMap constructor for details of the parameters. */
+    explicit FlatHashSet (int numberOfSlots = 0,
+                          HashFunctionType hashFunction = HashFunctionType())
+       : table (numberOfSlots, hashFunction)
+    {
+    }
+
+    /** Destructor. */
+    ~FlatHashSet()
+    {
+    }
+
+    //==============================================================================
+    /** Removes all keys from the set. The number of slots is left unchanged. */
+    void clear()
+    {
+        const ScopedLockType sl (getLock());
+        table.clear();
+    }
+
+    /** Returns the number of keys in the set. */
+    inline int size() const noexcept
+    {
+        return table.size();
+    }
+
+    /** Returns true if the set contains the given key. */
+    bool contains (KeyTypeParameter keyToLookFor) const
+    {
+        const ScopedLockType sl (getLock());
+        return table.find (keyToLookFor, table.getHash (keyToLookFor)) >= 0;
+    }
+
+    //==============================================================================
+    /** Adds a key to the set.
+        @returns true if the key was added, or false if it was already there
+    */
+    bool add (KeyTypeParameter newKey)
+    {
+        const ScopedLockType sl (getLock());
+        const uint32 hash = table.getHash (newKey);
+
+        if (table.find (newKey, hash) >= 0)
+            return false;
+
+        new (table.insert (hash)) Entry (newKey);
+        return true;
+    }
+
+    /** Removes a key from the set.
+        @returns true if the key was removed, or false if it wasn't there
+    */
+    bool remove (KeyTypeParameter keyToRemove)
+    {
+        const ScopedLockType sl (getLock());
+        const int index = table.find (keyToRemove, table.getHash (keyToRemove));
+
+        if (index < 0)
+            return false;
+
+        table.removeAt ((uint32) index);
+        return true;
+    }
+
+    /** Changes the number of slots. See FlatHashMap::remapTable(). */
+    void remapTable (int newNumberOfSlots)
+    {
+        const ScopedLockType sl (getLock());
+        table.rehash (newNumberOfSlots);
+    }
+
+    /** Returns the number of slots in the table. */
+    inline int getNumSlots() const noexcept
+    {
+        return table.getCapacity();
+    }
+
+    /** Efficiently swaps the contents of two sets. */
+    template <class OtherSetType>
+    void swapWith (OtherSetType& otherSet) noexcept
+    {
+        const ScopedLockType lock1 (getLock());
+        const typename OtherSetType::ScopedLockType lock2 (otherSet.getLock());
+
+        table.swapWith (otherSet.table);
+    }
+
+    //==============================================================================
+    /** Returns the CriticalSection that locks this structure. */
+    inline const TypeOfCriticalSectionToUse& getLock() const noexcept      { return lock; }
+
+    /** Returns the type of scoped lock to use for locking this set */
+    typedef typename TypeOfCriticalSectionToUse::ScopedLockType ScopedLockType;
+
+private:
+    //==============================================================================
+    struct Entry
+    {
+        Entry (KeyTypeParameter k)  : key (k) {}
+
+        KeyType key;
+    };
+
+public:
+    //==============================================================================
+    /** Iterates over the keys in a FlatHashSet, in no particular order.
+        The iterator must not be used after the set is modified.
+    */
+    class Iterator
+    {
+    public:
+        Iterator (const FlatHashSet& setToIterate)
+            : set (setToIterate), index (-1)
+        {}
+
+        /** Moves to the next key, returning false when there are no more. */
+        bool next()
+        {
+            index = set.table.getNextUsedSlot (index + 1);
+            return index >= 0;
+        }
+
+        /** Returns the current key.
+            This should only be called when a call to next() has just returned true.
+        */
+        KeyType getKey() const
+        {
+            return index >= 0 ? set.table.getEntry (index).key : KeyType();
+        }
+
+    private:
+        const FlatHashSet& set;
+        int index;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Iterator)
+    };
+
+private:
+    //==============================================================================
+    friend class Iterator;
+    template <typename, class, class> friend class FlatHashSet;
+
+    FlatHashHelpers::Table<Entry, HashFunctionType> table;
+    TypeOfCriticalSectionToUse lock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FlatHashSet)
+};
+
+
+#endif   // JUCE_FLATHASHMAP_H_INCLUDED
@@ -39,9 +39,11 @@
 struct DefaultHashFunctions
 {
     /** Generates a simple hash from an integer. */
-    int generateHash (const int key, const int upperLimit) const noexcept        { return std::abs (key) % upperLimit; }
+    int generateHash (const int key, const int upperLimit) const noexcept        { return (int) (((uint32) key) % (uint32) upperLimit); }
     /** Generates a simple hash from an int64. */
-    int generateHash (const int64 key, const int upperLimit) const noexcept      { return std::abs ((int) key) % upperLimit; }
+    int generateHash (const int64 key, const int upperLimit) const noexcept      { return (int) (((uint64) key) % (uint64) upperLimit); }
+    /** Generates a simple hash from an Identifier. */
+    int generateHash (const Identifier& key, const int upperLimit) const noexcept { return (int) (key.getHash() % (uint32) upperLimit); }
     /** Generates a simple hash from a string. */
     int generateHash (const String& key, const int upperLimit) const noexcept    { return (int) (((uint32) key.hashCode()) % (uint32) upperLimit); }
     /** Generates a simple hash from a variant. */
@@ -89,7 +91,7 @@ struct DefaultHashFunctions
     @endcode
 
     @tparam HashFunctionType The class of hash function, which must be copy-constructible.
-    @see CriticalSection, DefaultHashFunctions, NamedValueSet, SortedSet
+    @see CriticalSection, DefaultHashFunctions, FlatHashMap, NamedValueSet, SortedSet
 */
 template <typename KeyType,
           typename ValueType,
@@ -0,0 +1,547 @@
+/*
+  ==============================================================================
+
+   This file is part of the juce_core module of the JUCE library.
+   Copyright (c) 2013 - Raw Material Software Ltd.
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose with
+   or without fee is hereby granted, provided that the above copyright notice and this
+   permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+   ------------------------------------------------------------------------------
+
+   NOTE! This permissive ISC license applies ONLY to files within the juce_core module!
+   All other JUCE modules are covered by a dual GPL/commercial license, so if you are
+   using any other modules, be sure to check that you also comply with their license.
+
+   For more details, visit www.juce.com
+
+  ==============================================================================
+*/
+
+#if JUCE_UNIT_TESTS
+
+class LockFreeQueueTests  : public UnitTest
+{
+public:
+    LockFreeQueueTests() : UnitTest ("Lock-free queues") {}
+
+    enum { numProducers = 4, numConsumers = 4 };
+
+    static uint32 makeValue (int producer, int index) noexcept   { return ((uint32) producer << 24) | (uint32) index; }
+    static int getProducer (uint32 value) noexcept               { return (int) (value >> 24); }
+    static int getIndex (uint32 value) noexcept                  { return (int) (value & 0xffffff); }
+
+    // Spins for a while, then starts sleeping, so that a waiting thread can't starve
+    // the one it's waiting for when they're sharing a CPU
+    static void waitABit (int& numFailures)
+    {
+        if (++numFailures < 64)
+            Thread::yield();
+        else
+            Thread::sleep (numFailures < 128 ? 0 : 1);
+    }
+
+    //==============================================================================
+    // The queue that the lock-free ones are being compared with
+    template <typename ElementType>
+    class LockedQueue
+    {
+    public:
+        LockedQueue (int)  : readIndex (0) {}
+
+        bool push (const ElementType& item)
+        {
+            const ScopedLock sl (lock);
+            items.add (item);
+            return true;
+        }
+
+        bool pop (ElementType& item)
+        {
+            const ScopedLock sl (lock);
+
+            if (readIndex >= items.size())
+                return false;
+
+            item = items.getUnchecked (readIndex++);
+
+            if (readIndex == items.size())
+            {
+                items.clearQuick();
+                readIndex = 0;
+            }
+
+            return true;
+        }
+
+    private:
+        CriticalSection lock;
+        Array<ElementType> items;
+        int readIndex;
+    };
+
+    // AbstractFifo with a buffer, used the way its documentation suggests
+    template <typename ElementType>
+    class AbstractFifoQueue
+    {
+    public:
+        AbstractFifoQueue (int capacity)  : fifo (capacity), buffer ((size_t) capacity) {}
+
+        int push (const ElementType* source, int numItems)
+        {
+            int start1, size1, start2, size2;
+            fifo.prepareToWrite (numItems, start1, size1, start2, size2);
+
+            for (int i = 0; i < size1; ++i)  buffer [start1 + i] = source[i];
+            for (int i = 0; i < size2; ++i)  buffer [start2 + i] = source[size1 + i];
+
+            fifo.finishedWrite (size1 + size2);
+            return size1 + size2;
+        }
+
+        int pop (ElementType* dest, int maxItems)
+        {
+            int start1, size1, start2, size2;
+            fifo.prepareToRead (maxItems, start1, size1, start2, size2);
+
+            for (int i = 0; i < size1; ++i)  dest[i] = buffer [start1 + i];
+            for (int i = 0; i < size2; ++i)  dest[size1 + i] = buffer [start2 + i];
+
+            fifo.finishedRead (size1 + size2);
+            return size1 + size2;
+        }
+
+    private:
+        AbstractFifo fifo;
+        HeapBlock<ElementType> buffer;
+    };
+
+    //==============================================================================
+    template <typename QueueType>
+    class Producer  : public Thread
+    {
+    public:
+        Producer (QueueType& q, int index_, int numItems_)
+            : Thread ("queue producer"), queue (q), index (index_), numItems (numItems_) {}
+
+        void run() override
+        {
+            int numFailures = 0;
+
+            for (int i = 0; i < numItems; ++i)
+            {
+                while (! queue.push (makeValue (index, i)))
+                    waitABit (numFailures);
+
+                numFailures = 0;
+            }
+        }
+
+    private:
+        QueueType& queue;
+        const int index, numItems;
+    };
+
+    template <typename QueueType>
+    class Consumer  : public Thread
+    {
+    public:
+        Consumer (QueueType& q, Atomic<int>& remaining_)
+            : Thread ("queue consumer"), queue (q), remaining (remaining_) {}
+
+        void run() override
+        {
+            uint32 value;
+            int numFailures = 0;
+
+            while (remaining.get() > 0)
+            {
+                if (queue.pop (value))
+                {
+                    --remaining;
+                    received.add (value);
+                    numFailures = 0;
+                }
+                else
+                {
+                    waitABit (numFailures);
+                }
+            }
+        }
+
+        Array<uint32> received;
+
+    private:
+        QueueType& queue;
+        Atomic<int>& remaining;
+    };
+
+    // Pushes numPerProducer items from each producer, and returns what each consumer got
+    template <typename QueueType>
+    double runManyToMany (QueueType& queue, int numPerProducer, OwnedArray<Consumer<QueueType> >& consumers)
+    {
+        Atomic<int> remaining (numProducers * numPerProducer);
+        OwnedArray<Producer<QueueType> > producers;
+
+        for (int i = 0; i < numConsumers; ++i)
+            consumers.add (new Consumer<QueueType> (queue, remaining));
+
+        for (int i = 0; i < numProducers; ++i)
+            producers.add (new Producer<QueueType> (queue, i, numPerProducer));
+
+        const double start = Time::getMillisecondCounterHiRes();
+
+        for (int i = 0; i < consumers.size(); ++i)  consumers.getUnchecked(i)->startThread();
+        for (int i = 0; i < producers.size(); ++i)  producers.getUnchecked(i)->startThread();
+
+        for (int i = 0; i < producers.size(); ++i)  producers.getUnchecked(i)->waitForThreadToExit (-1);
+        for (int i = 0; i < consumers.size(); ++i)  consumers.getUnchecked(i)->waitForThreadToExit (-1);
+
+        return Time::getMillisecondCounterHiRes() - start;
+    }
+
+    //==============================================================================
+    struct TestNode  : public MPSCQueueNode
+    {
+        int producer, index;
+    };
+
+    class NodeProducer  : public Thread
+    {
+    public:
+        NodeProducer (MPSCQueue<TestNode>& q, OwnedArray<TestNode>& nodes_)
+            : Thread ("node producer"), queue (q), nodes (nodes_) {}
+
+        void run() override
+        {
+            for (int i = 0; i < nodes.size(); ++i)
+                queue.push (nodes.getUnchecked (i));
+        }
+
+    private:
+        MPSCQueue<TestNode>& queue;
+        OwnedArray<TestNode>& nodes;
+    };
+
+    //==============================================================================
+    template <typename QueueType>
+    class BatchProducer  : public Thread
+    {
+    public:
+        BatchProducer (QueueType& q, int numItems_, int maxBatch_, int64 seed)
+            : Thread ("batch producer"), queue (q), numItems (numItems_), maxBatch (maxBatch_), random (seed) {}
+
+        void run() override
+        {
+            HeapBlock<uint32> batch ((size_t) maxBatch);
+            int numFailures = 0;
+
+            for (int next = 0; next < numItems;)
+            {
+                const int num = jmin (numItems - next, random.nextInt (maxBatch) + 1);
+
+                for (int i = 0; i < num; ++i)
+                    batch[i] = (uint32) (next + i);
+
+                for (int done = 0; done < num;)
+                {
+                    const int pushed = queue.push (batch + done, num - done);
+                    done += pushed;
+
+                    if (pushed == 0)
+                        waitABit (numFailures);
+                    else
+                        numFailures = 0;
+                }
+
+                next += num;
+            }
+        }
+
+    private:
+        QueueType& queue;
+        const int numItems, maxBatch;
+        Random random;
+    };
+
+    // Returns the time taken, and checks that everything arrives in order
+    template <typename QueueType>
+    double runOneToOne (QueueType& queue, int numItems, int maxBatch, int64 seed)
+    {
+        BatchProducer<QueueType> producer (queue, numItems, maxBatch, seed);
+        Random random (seed + 1);
+        HeapBlock<uint32> batch ((size_t) maxBatch);
+        int next = 0, numFailures = 0;
+        bool inOrder = true;
+
+        const double start = Time::getMillisecondCounterHiRes();
+        producer.startThread();
+
+        while (next < numItems)
+        {
+            const int num = queue.pop (batch, random.nextInt (maxBatch) + 1);
+
+            if (num == 0)
+                waitABit (numFailures);
+            else
+                numFailures = 0;
+
+            for (int i = 0; i < num; ++i)
+                inOrder = inOrder && batch[i] == (uint32) next++;
+        }
+
+        const double elapsed = Time::getMillisecondCounterHiRes() - start;
+        producer.waitForThreadToExit (-1);
+
+        expect (inOrder, "items arrived out of order");
+        return elapsed;
+    }
+
+    //==============================================================================
+    struct CountedObject  : public ReferenceCountedObject
+    {
+        typedef ReferenceCountedObjectPtr<CountedObject> Ptr;
+    };
+
+    //==============================================================================
+    static String getRate (int numItems, double milliseconds)
+    {
+        return String (numItems / jmax (0.001, milliseconds * 0.001) / 1000000.0, 2) + "M items/s";
+    }
+
+    void runTest() override
+    {
+        beginTest ("MPMCQueue basics");
+        {
+            MPMCQueue<int> queue (5);
+            expectEquals (queue.getCapacity(), 8);
+            expect (queue.isEmpty());
+
+            for (int i = 0; i < 8; ++i)
+                expect (queue.push (i));
+
+            expect (! queue.push (8));
+            expectEquals (queue.size(), 8);
+
+            int value = -1;
+
+            for (int i = 0; i < 8; ++i)
+            {
+                expect (queue.pop (value));
+                expectEquals (value, i);
+            }
+
+            expect (! queue.pop (value));
+            expect (queue.isEmpty());
+        }
+
+        beginTest ("MPMCQueue stress");
+        {
+            const int numPerProducer = 20000;
+            MPMCQueue<uint32> queue (64);
+            OwnedArray<Consumer<MPMCQueue<uint32> > > consumers;
+            runManyToMany (queue, numPerProducer, consumers);
+
+            HeapBlock<int> timesReceived ((size_t) (numProducers * numPerProducer), true);
+            bool inOrder = true;
+
+            for (int c = 0; c < consumers.size(); ++c)
+            {
+                const Array<uint32>& received = consumers.getUnchecked(c)->received;
+                int lastIndex [numProducers] = { -1, -1, -1, -1 };
+
+                for (int i = 0; i < received.size(); ++i)
+                {
+                    const int producer = getProducer (received.getUnchecked (i));
+                    const int index = getIndex (received.getUnchecked (i));
+
+                    inOrder = inOrder && index > lastIndex [producer];
+                    lastIndex [producer] = index;
+                    ++timesReceived [producer * numPerProducer + index];
+                }
+            }
+
+            int numWrong = 0;
+
+            for (int i = 0; i < numProducers * numPerProducer; ++i)
+                if (timesReceived[i] != 1)
+                    ++numWrong;
+
+            expectEquals (numWrong, 0);
+            expect (inOrder, "a consumer saw one producer's items out of order");
+            expect (queue.isEmpty());
+        }
+
+        beginTest ("MPSCQueue stress");
+        {
+            const int numPerProducer = 20000;
+            MPSCQueue<TestNode> queue;
+            expect (queue.isEmpty());
+            expect (queue.pop() == nullptr);
+
+            OwnedArray<TestNode> nodes [numProducers];
+            OwnedArray<NodeProducer> producers;
+
+            for (int p = 0; p < numProducers; ++p)
+            {
+                for (int i = 0; i < numPerProducer; ++i)
+                {
+                    TestNode* n = nodes[p].add (new TestNode());
+                    n->producer = p;
+                    n->index = i;
+                }
+
+                producers.add (new NodeProducer (queue, nodes[p]));
+            }
+
+            for (int i = 0; i < producers.size(); ++i)
+                producers.getUnchecked(i)->startThread();
+
+            int nextIndex [numProducers] = { 0, 0, 0, 0 };
+            bool inOrder = true;
+
+            for (int numReceived = 0, numFailures = 0; numReceived < numProducers * numPerProducer;)
+            {
+                if (TestNode* n = queue.pop())
+                {
+                    inOrder = inOrder && n->index == nextIndex [n->producer]++;
+                    ++numReceived;
+                    numFailures = 0;
+                }
+                else
+                {
+                    waitABit (numFailures);
+                }
+            }
+
+            for (int i = 0; i < producers.size(); ++i)
+                producers.getUnchecked(i)->waitForThreadToExit (-1);
+
+            expect (inOrder, "one producer's nodes came out of order");
+            expect (queue.pop() == nullptr);
+            expect (queue.isEmpty());
+
+            // nodes can go round again once they've been popped
+            queue.push (nodes[0].getUnchecked (0));
+            queue.push (nodes[1].getUnchecked (0));
+            expect (queue.pop() == nodes[0].getUnchecked (0));
+            expect (queue.pop() == nodes[1].getUnchecked (0));
+            expect (queue.pop() == nullptr);
+        }
+
+        beginTest ("SPSCQueue batches");
+        {
+            SPSCQueue<uint32> queue (100);
+            expectEquals (queue.getCapacity(), 128);
+
+            HeapBlock<uint32> items (200);
+
+            for (uint32 i = 0; i < 200; ++i)
+                items[i] = i;
+
+            expectEquals (queue.push (items, 200), 128);
+            expectEquals (queue.getNumReady(), 128);
+            expectEquals (queue.getFreeSpace(), 0);
+            expect (! queue.push (items[0]));
+
+            uint32 value = 0;
+            expect (queue.pop (value));
+            expectEquals ((int) value, 0);
+            expectEquals (queue.pop (items, 200), 127);
+            expectEquals ((int) items[126], 127);
+            expect (! queue.pop (value));
+
+            for (int i = 0; i < 10; ++i)
+                runOneToOne (queue, 20000, 1 + getRandom().nextInt (150), getRandom().nextInt64());
+        }
+
+        beginTest ("SPSCQueue of Strings");
+        {
+            {
+                SPSCQueue<String> queue (8);
+                String batch[5];
+
+                for (int round = 0; round < 20; ++round)
+                {
+                    for (int i = 0; i < 5; ++i)
+                        batch[i] = "item " + String (round * 5 + i);
+
+                    expectEquals (queue.push (batch, 5), 5);
+                    expect (queue.push (String ("single ") + String (round)));
+
+                    String result;
+                    expectEquals (queue.pop (&result, 1), 1);
+                    expectEquals (result, "item " + String (round * 5));
+
+                    String rest[5];
+                    expectEquals (queue.pop (rest, 5), 5);
+                    expectEquals (rest[3], "item " + String (round * 5 + 4));
+                    expectEquals (rest[4], "single " + String (round));
+                }
+
+                // leave some in the queue, for the destructor to clean up
+                expectEquals (queue.push (batch, 5), 5);
+            }
+
+            CountedObject::Ptr object (new CountedObject());
+
+            {
+                SPSCQueue<CountedObject::Ptr> queue (4);
+                expect (queue.push (object));
+                expect (queue.push (object));
+                expectEquals (object->getReferenceCount(), 3);
+
+                CountedObject::Ptr popped;
+                expect (queue.pop (popped));
+                expectEquals (object->getReferenceCount(), 3);
+                popped = nullptr;
+                expectEquals (object->getReferenceCount(), 2);
+            }
+
+            expectEquals (object->getReferenceCount(), 1);
+        }
+
+        beginTest ("Benchmarks");
+        {
+            const int numPerProducer = 25000;
+            const int totalItems = numProducers * numPerProducer;
+
+            {
+                MPMCQueue<uint32> queue (1024);
+                OwnedArray<Consumer<MPMCQueue<uint32> > > consumers;
+                const double lockFree = runManyToMany (queue, numPerProducer, consumers);
+
+                LockedQueue<uint32> lockedQueue (1024);
+                OwnedArray<Consumer<LockedQueue<uint32> > > lockedConsumers;
+                const double locked = runManyToMany (lockedQueue, numPerProducer, lockedConsumers);
+
+                logMessage (String (numProducers) + " producers, " + String (numConsumers) + " consumers: MPMCQueue "
+                              + getRate (totalItems, lockFree) + ", locked Array " + getRate (totalItems, locked));
+            }
+
+            for (int batch = 1; batch <= 64; batch *= 8)
+            {
+                SPSCQueue<uint32> queue (1024);
+                AbstractFifoQueue<uint32> fifo (1024);
+
+                const double lockFree = runOneToOne (queue, totalItems, batch, 1234);
+                const double abstractFifo = runOneToOne (fifo, totalItems, batch, 1234);
+
+                logMessage ("1 producer, 1 consumer, batches of up to " + String (batch) + ": SPSCQueue "
+                              + getRate (totalItems, lockFree) + ", AbstractFifo " + getRate (totalItems, abstractFifo));
+            }
+        }
+    }
+};
+
+static LockFreeQueueTests lockFreeQueueTests;
+
+#endif
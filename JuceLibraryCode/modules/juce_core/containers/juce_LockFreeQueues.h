@@ -0,0 +1,418 @@
+/*
+  ==============================================================================
+
+   This file is part of the juce_core module of the JUCE library.
+   Copyright (c) 2013 - Raw Material Software Ltd.
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose with
+   or without fee is hereby granted, provided that the above copyright notice and this
+   permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+   ------------------------------------------------------------------------------
+
+   NOTE! This permissive ISC license applies ONLY to files within the juce_core module!
+   All other JUCE modules are covered by a dual GPL/commercial license, so if you are
+   using any other modules, be sure to check that you also comply with their license.
+
+   For more details, visit www.juce.com
+
+  ==============================================================================
+*/
+
+#ifndef JUCE_LOCKFREEQUEUES_H_INCLUDED
+#define JUCE_LOCKFREEQUEUES_H_INCLUDED
+
+#ifndef DOXYGEN
+namespace LockFreeQueueHelpers
+{
+    /** Enough to keep the things either side of some padding in different cache lines. */
+    enum { cacheLineSize = 64 };
+
+    /** An atomic counter that has a cache line to itself, so that threads updating it
+        don't slow down threads that are using its neighbours.
+    */
+    template <typename Type>
+    struct PaddedAtomic
+    {
+        Atomic<Type> value;
+        char padding [cacheLineSize - sizeof (Atomic<Type>)];
+    };
+
+    inline uint32 roundUpToPowerOfTwo (int n) noexcept
+    {
+        uint32 size = 2;
+
+        while (size < (uint32) n)
+            size <<= 1;
+
+        return size;
+    }
+}
+#endif
+
+//==============================================================================
+/**
+    A fixed-size lock-free queue which any number of threads can push into and pop
+    from at the same time.
+
+    This is Dmitry Vyukov's bounded queue: each slot has a sequence number that says
+    whether it's ready to be written or read, so a push or pop is normally just one
+    compare-and-swap on the shared position plus a write to its own slot. Items come
+    out in the order that their pushes claimed slots.
+
+    Note that a thread which gets suspended between claiming a slot and filling (or
+    emptying) it will hold up whoever needs that slot next, so threads that spin on a
+    failed push or pop should back off to sleeping if there could be more of them
+    than there are CPUs.
+
+    ElementType must be default-constructible and copyable. A popped slot is reset to a
+    default-constructed value so that it doesn't keep anything alive.
+
+    @see MPSCQueue, SPSCQueue, AbstractFifo
+*/
+template <typename ElementType>
+class MPMCQueue
+{
+public:
+    /** Creates a queue that can hold at least the given number of items. The actual
+        capacity is rounded up to a power of two.
+    */
+    explicit MPMCQueue (int minimumCapacity)
+        : mask (LockFreeQueueHelpers::roundUpToPowerOfTwo (minimumCapacity) - 1),
+          cells ((size_t) mask + 1)
+    {
+        for (uint32 i = 0; i <= mask; ++i)
+        {
+            new (cells + i) Cell();
+            cells[i].sequence = i;
+        }
+    }
+
+    /** Destructor. */
+    ~MPMCQueue()
+    {
+        for (uint32 i = 0; i <= mask; ++i)
+            cells[i].~Cell();
+    }
+
+    /** Adds an item to the back of the queue. Returns false if the queue is full. */
+    bool push (const ElementType& item)
+    {
+        for (uint32 pos = enqueuePosition.value.get();;)
+        {
+            Cell& cell = cells [pos & mask];
+            const int32 diff = (int32) (cell.sequence.get() - pos);
+
+            if (diff == 0)
+            {
+                if (enqueuePosition.value.compareAndSetBool (pos + 1, pos))
+                {
+                    cell.item = item;
+                    cell.sequence = pos + 1;
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+
+            pos = enqueuePosition.value.get();
+        }
+    }
+
+    /** Takes the item from the front of the queue. Returns false if the queue is empty. */
+    bool pop (ElementType& result)
+    {
+        for (uint32 pos = dequeuePosition.value.get();;)
+        {
+            Cell& cell = cells [pos & mask];
+            const int32 diff = (int32) (cell.sequence.get() - (pos + 1));
+
+            if (diff == 0)
+            {
+                if (dequeuePosition.value.compareAndSetBool (pos + 1, pos))
+                {
+                    result = cell.item;
+                    cell.item = ElementType();
+                    cell.sequence = pos + mask + 1;
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+
+            pos = dequeuePosition.value.get();
+        }
+    }
+
+    /** Returns the number of items in the queue. If other threads are using it, this
+        could be out of date by the time it returns.
+    */
+    int size() const noexcept
+    {
+        const uint32 dequeued = dequeuePosition.value.get();
+        return (int) jmin (enqueuePosition.value.get() - dequeued, mask + 1);
+    }
+
+    /** Returns true if the queue seems to be empty. The same caveat as size() applies. */
+    bool isEmpty() const noexcept                   { return enqueuePosition.value.get() == dequeuePosition.value.get(); }
+
+    /** Returns the number of items the queue can hold. */
+    int getCapacity() const noexcept                { return (int) mask + 1; }
+
+private:
+    struct Cell
+    {
+        Atomic<uint32> sequence;
+        ElementType item;
+    };
+
+    const uint32 mask;
+    HeapBlock<Cell> cells;
+    char padding [LockFreeQueueHelpers::cacheLineSize];
+    LockFreeQueueHelpers::PaddedAtomic<uint32> enqueuePosition, dequeuePosition;
+
+    JUCE_DECLARE_NON_COPYABLE (MPMCQueue)
+};
+
+//==============================================================================
+/**
+    The base class for objects that can be put into an MPSCQueue.
+
+    An object can only be in one queue at a time, and mustn't be deleted while it's
+    in one.
+*/
+class MPSCQueueNode
+{
+public:
+    MPSCQueueNode() noexcept {}
+
+private:
+    template <typename NodeType> friend class MPSCQueue;
+    Atomic<MPSCQueueNode*> nextInQueue;
+
+    JUCE_DECLARE_NON_COPYABLE (MPSCQueueNode)
+};
+
+/**
+    An unbounded queue of objects that any number of threads can push into, but only
+    one thread can pop from.
+
+    It's intrusive: the objects must inherit from MPSCQueueNode, which holds the link
+    to the next object, so pushing never allocates. A push is a single atomic exchange,
+    so producers never wait for each other or for the consumer.
+
+    This is Dmitry Vyukov's intrusive queue. A pop can return nullptr while another
+    thread is halfway through a push, even though that push has started, so consumers
+    should treat nullptr as "nothing yet" rather than "definitely empty".
+
+    @see MPMCQueue, SPSCQueue
+*/
+template <typename NodeType>
+class MPSCQueue
+{
+public:
+    MPSCQueue() noexcept
+    {
+        head.value = &stub;
+        tail = &stub;
+    }
+
+    /** Adds an object to the back of the queue. Any thread can call this. */
+    void push (NodeType* node) noexcept
+    {
+        jassert (node != nullptr);
+        pushNode (static_cast<MPSCQueueNode*> (node));
+    }
+
+    /** Takes the object at the front of the queue, or returns nullptr if there isn't one.
+        Only one thread may call this at a time.
+    */
+    NodeType* pop() noexcept
+    {
+        MPSCQueueNode* first = tail;
+        MPSCQueueNode* next = first->nextInQueue.get();
+
+        if (first == &stub)
+        {
+            if (next == nullptr)
+                return nullptr;
+
+            tail = first = next;
+            next = next->nextInQueue.get();
+        }
+
+        if (next == nullptr)
+        {
+            // first is the last node, so the stub goes behind it before it can be handed out
+            if (first != head.value.get())
+                return nullptr;     // another thread is in the middle of pushing
+
+            pushNode (&stub);
+            next = first->nextInQueue.get();
+
+            if (next == nullptr)
+                return nullptr;
+        }
+
+        tail = next;
+        return static_cast<NodeType*> (first);
+    }
+
+    /** Returns true if the queue seems to be empty. Only the consumer thread may call this. */
+    bool isEmpty() const noexcept
+    {
+        return tail == &stub && stub.nextInQueue.get() == nullptr;
+    }
+
+private:
+    LockFreeQueueHelpers::PaddedAtomic<MPSCQueueNode*> head;
+    MPSCQueueNode* tail;
+    MPSCQueueNode stub;
+
+    void pushNode (MPSCQueueNode* node) noexcept
+    {
+        node->nextInQueue = nullptr;
+        MPSCQueueNode* const previous = head.value.exchange (node);
+        previous->nextInQueue = node;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (MPSCQueue)
+};
+
+//==============================================================================
+/**
+    A fixed-size lock-free queue of items for passing between exactly one producer
+    thread and one consumer thread.
+
+    Unlike AbstractFifo, this holds the items itself, and it can push and pop whole
+    blocks of them at once. Each side keeps a private copy of the other side's
+    position and only re-reads the shared one when that copy says the queue is full
+    (or empty), so a push or pop usually involves just one atomic write. The two
+    positions are on separate cache lines.
+
+    ElementType must be copy-constructible and copy-assignable. The queue only holds
+    constructed objects for the items that are in it, so it can hold any type, and
+    anything left in it is deleted along with the queue.
+
+    @see MPMCQueue, MPSCQueue, AbstractFifo
+*/
+template <typename ElementType>
+class SPSCQueue
+{
+public:
+    /** Creates a queue that can hold at least the given number of items. The actual
+        capacity is rounded up to a power of two.
+    */
+    explicit SPSCQueue (int minimumCapacity)
+        : mask (LockFreeQueueHelpers::roundUpToPowerOfTwo (minimumCapacity) - 1),
+          items ((size_t) mask + 1),
+          cachedReadPosition (0),
+          cachedWritePosition (0)
+    {
+    }
+
+    /** Destructor. Any items still in the queue are deleted. */
+    ~SPSCQueue()
+    {
+        for (uint32 pos = readPosition.value.get(), end = writePosition.value.get(); pos != end; ++pos)
+            items[pos & mask].~ElementType();
+    }
+
+    /** Adds an item. Returns false if the queue is full. Only the producer may call this. */
+    bool push (const ElementType& item)
+    {
+        return push (&item, 1) == 1;
+    }
+
+    /** Adds as many of the given items as will fit, and returns the number that were added.
+        Only the producer may call this.
+    */
+    int push (const ElementType* source, int numItems)
+    {
+        const uint32 pos = writePosition.value.get();
+
+        if (pos + (uint32) numItems - cachedReadPosition > mask + 1)
+            cachedReadPosition = readPosition.value.get();
+
+        const int num = jmin (numItems, (int) (mask + 1 - (pos - cachedReadPosition)));
+
+        for (int i = 0; i < num; ++i)
+            new (items + ((pos + (uint32) i) & mask)) ElementType (source[i]);
+
+        if (num > 0)
+            writePosition.value = pos + (uint32) num;
+
+        return num;
+    }
+
+    /** Takes the next item. Returns false if the queue is empty. Only the consumer may call this. */
+    bool pop (ElementType& result)
+    {
+        return pop (&result, 1) == 1;
+    }
+
+    /** Takes up to maxItems items, and returns the number taken. Only the consumer may call this. */
+    int pop (ElementType* dest, int maxItems)
+    {
+        const uint32 pos = readPosition.value.get();
+
+        if (cachedWritePosition - pos < (uint32) maxItems)
+            cachedWritePosition = writePosition.value.get();
+
+        const int num = jmin (maxItems, (int) (cachedWritePosition - pos));
+
+        for (int i = 0; i < num; ++i)
+        {
+            ElementType& item = items[(pos + (uint32) i) & mask];
+            dest[i] = item;
+            item.~ElementType();
+        }
+
+        if (num > 0)
+            readPosition.value = pos + (uint32) num;
+
+        return num;
+    }
+
+    /** Returns the number of items waiting to be popped. */
+    int getNumReady() const noexcept        { return (int) (writePosition.value.get() - readPosition.value.get()); }
+
+    /** Returns the number of items that could be pushed. */
+    int getFreeSpace() const noexcept       { return getCapacity() - getNumReady(); }
+
+    /** Returns the number of items the queue can hold. */
+    int getCapacity() const noexcept        { return (int) mask + 1; }
+
+private:
+    const uint32 mask;
+
+    // the slots are raw memory: an item is copy-constructed into one when it's pushed,
+    // and destroyed when it's popped
+    HeapBlock<ElementType> items;
+    char padding [LockFreeQueueHelpers::cacheLineSize];
+
+    // each side's own position and its copy of the other's are kept together, away from the other side's
+    LockFreeQueueHelpers::PaddedAtomic<uint32> writePosition;
+    uint32 cachedReadPosition;
+    char producerPadding [LockFreeQueueHelpers::cacheLineSize];
+
+    LockFreeQueueHelpers::PaddedAtomic<uint32> readPosition;
+    uint32 cachedWritePosition;
+    char consumerPadding [LockFreeQueueHelpers::cacheLineSize];
+
+    JUCE_DECLARE_NON_COPYABLE (SPSCQueue)
+};
+
+
+#endif   // JUCE_LOCKFREEQUEUES_H_INCLUDED
@@ -110,6 +110,8 @@ namespace juce
 {
 
 #include "containers/juce_AbstractFifo.cpp"
+#include "containers/juce_FlatHashMap.cpp"
+#include "containers/juce_LockFreeQueues.cpp"
 #include "containers/juce_NamedValueSet.cpp"
 #include "containers/juce_PropertySet.cpp"
 #include "containers/juce_Variant.cpp"
@@ -155,6 +157,8 @@ namespace juce
 #include "threads/juce_ReadWriteLock.cpp"
 #include "threads/juce_Thread.cpp"
 #include "threads/juce_ThreadPool.cpp"
+#include "threads/juce_ParallelFor.cpp"
+#include "threads/juce_TaskGraph.cpp"
 #include "threads/juce_TimeSliceThread.cpp"
 #include "time/juce_PerformanceCounter.cpp"
 #include "time/juce_RelativeTime.cpp"
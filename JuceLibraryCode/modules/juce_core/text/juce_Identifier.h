@@ -97,6 +97,12 @@ public:
     /** Returns true if this Identifier is null */
     bool isNull() const noexcept                                        { return name.getAddress() == nullptr; }
 
+    /** Returns a hash of the name, which is the same as FlatHashFunctions would give for
+        a String containing it. This was worked out when the name was first used, so it's
+        very quick. A null identifier's hash is 0.
+    */
+    uint32 getHash() const noexcept                                     { return isValid() ? StringPool::getPooledStringHash (name) : 0; }
+
     /** A null identifier. */
     static Identifier null;
 
@@ -26,88 +26,402 @@
   ==============================================================================
 */
 
-StringPool::StringPool() noexcept   {}
-StringPool::~StringPool()           {}
+struct StringPool::Entry
+{
+    uint32 numBytes, hash;      // the hash must come just before the text (see getPooledStringHash)
+    String::CharPointerType::CharType text[1];
+};
 
-namespace StringPoolHelpers
+//==============================================================================
+struct StringPool::Table
 {
-    template <class StringType>
-    String::CharPointerType getPooledStringFromArray (Array<String>& strings,
-                                                      StringType newString,
-                                                      const CriticalSection& lock)
+    explicit Table (uint32 capacity)  : mask (capacity - 1), slots (capacity, true)
     {
-        const ScopedLock sl (lock);
-        int start = 0;
-        int end = strings.size();
+        jassert (isPowerOfTwo ((int) capacity));
+    }
 
-        for (;;)
+    Entry* find (const String::CharPointerType::CharType* const text, const uint32 numBytes, const uint32 hash) const noexcept
+    {
+        for (uint32 i = hash & mask;; i = (i + 1) & mask)
         {
-            if (start >= end)
-            {
-                jassert (start <= end);
-                strings.insert (start, newString);
-                return strings.getReference (start).getCharPointer();
-            }
+            // A plain read is enough here, because an entry is completely written before
+            // its pointer is stored, and the store is a full barrier.
+            Entry* const e = slots[i].value;
+
+            if (e == nullptr)
+                return nullptr;
 
-            const String& startString = strings.getReference (start);
+            if (e->hash == hash && e->numBytes == numBytes && memcmp (e->text, text, numBytes) == 0)
+                return e;
+        }
+    }
 
-            if (startString == newString)
-                return startString.getCharPointer();
+    void add (Entry* const e) noexcept
+    {
+        uint32 i = e->hash & mask;
 
-            const int halfway = (start + end) >> 1;
+        while (slots[i].value != nullptr)
+            i = (i + 1) & mask;
 
-            if (halfway == start)
-            {
-                if (startString.compare (newString) < 0)
-                    ++start;
+        slots[i] = e;
+    }
 
-                strings.insert (start, newString);
-                return strings.getReference (start).getCharPointer();
-            }
+    const uint32 mask;
+    HeapBlock<Atomic<Entry*> > slots;
 
-            const int comp = strings.getReference (halfway).compare (newString);
+    JUCE_DECLARE_NON_COPYABLE (Table)
+};
 
-            if (comp == 0)
-                return strings.getReference (halfway).getCharPointer();
+//==============================================================================
+struct StringPool::Shard
+{
+    Shard()
+    {
+        table = tables.add (new Table (initialTableSize));
+    }
 
-            if (comp < 0)
-                start = halfway;
-            else
-                end = halfway;
-        }
+    ~Shard()
+    {
+        for (int i = entries.size(); --i >= 0;)
+            delete[] reinterpret_cast<char*> (entries.getUnchecked (i));
+    }
+
+    enum { initialTableSize = 64 };
+
+    Atomic<Table*> table;
+    OwnedArray<Table> tables;   // includes the ones that have been replaced, which readers may still be using
+    Array<Entry*> entries;
+    CriticalSection lock;
+
+    JUCE_DECLARE_NON_COPYABLE (Shard)
+};
+
+//==============================================================================
+namespace StringPoolHelpers
+{
+    enum { numShardBits = 4 };
+
+    static bool isAscii (const char* text, size_t& numBytes) noexcept
+    {
+        const char* t = text;
+
+        for (; *t != 0; ++t)
+            if ((uint8) *t >= 0x80)
+                return false;
+
+        numBytes = (size_t) (t - text);
+        return true;
     }
 }
 
-String::CharPointerType StringPool::getPooledString (const String& s)
+StringPool::StringPool()
+{
+    static_jassert (offsetof (Entry, text) == offsetof (Entry, hash) + sizeof (uint32));
+
+    for (int i = 0; i < (1 << StringPoolHelpers::numShardBits); ++i)
+        shards.add (new Shard());
+}
+
+StringPool::~StringPool() {}
+
+String::CharPointerType StringPool::getPooledText (const String::CharPointerType::CharType* const text, const size_t numBytes)
 {
-    if (s.isEmpty())
-        return String().getCharPointer();
+    typedef String::CharPointerType::CharType CharType;
 
-    return StringPoolHelpers::getPooledStringFromArray (strings, s, lock);
+    const uint32 hash = (uint32) FlatHashFunctions::hashBytes (text, numBytes);
+    Shard& shard = *shards.getUnchecked ((int) (hash >> (32 - StringPoolHelpers::numShardBits)));
+
+    if (const Entry* const e = shard.table.value->find (text, (uint32) numBytes, hash))
+        return String::CharPointerType (e->text);
+
+    const ScopedLock sl (shard.lock);
+    Table* table = shard.table.value;
+
+    // someone else may have added it since we looked
+    if (const Entry* const e = table->find (text, (uint32) numBytes, hash))
+        return String::CharPointerType (e->text);
+
+    if ((shard.entries.size() + 1) * 2 > (int) table->mask + 1)
+    {
+        table = shard.tables.add (new Table ((table->mask + 1) * 2));
+
+        for (int i = 0; i < shard.entries.size(); ++i)
+            table->add (shard.entries.getUnchecked (i));
+
+        shard.table = table;
+    }
+
+    Entry* const e = reinterpret_cast<Entry*> (new char [sizeof (Entry) + numBytes]);
+    e->numBytes = (uint32) numBytes;
+    e->hash = hash;
+    memcpy (e->text, text, numBytes);
+    e->text [numBytes / sizeof (CharType)] = 0;
+
+    shard.entries.add (e);
+    table->add (e);
+    ++numStrings;
+
+    return String::CharPointerType (e->text);
+}
+
+String::CharPointerType StringPool::getPooledString (const String& s)
+{
+    const String::CharPointerType text (s.getCharPointer());
+    return getPooledText (text.getAddress(), text.sizeInBytes() - sizeof (*text.getAddress()));
 }
 
 String::CharPointerType StringPool::getPooledString (const char* const s)
 {
-    if (s == nullptr || *s == 0)
-        return String().getCharPointer();
+    if (s == nullptr)
+        return getPooledString (String());
+
+   #if JUCE_STRING_UTF_TYPE == 8
+    // ascii is already valid UTF-8, so there's no need to make a String first
+    size_t numBytes;
 
-    return StringPoolHelpers::getPooledStringFromArray (strings, s, lock);
+    if (StringPoolHelpers::isAscii (s, numBytes))
+        return getPooledText (s, numBytes);
+   #endif
+
+    return getPooledString (String (s));
 }
 
 String::CharPointerType StringPool::getPooledString (const wchar_t* const s)
 {
-    if (s == nullptr || *s == 0)
-        return String().getCharPointer();
-
-    return StringPoolHelpers::getPooledStringFromArray (strings, s, lock);
+    return getPooledString (String (s));
 }
 
 int StringPool::size() const noexcept
 {
-    return strings.size();
+    return numStrings.get();
 }
 
-String::CharPointerType StringPool::operator[] (const int index) const noexcept
+String::CharPointerType StringPool::operator[] (int index) const noexcept
 {
-    return strings [index].getCharPointer();
+    for (int i = 0; i < shards.size(); ++i)
+    {
+        const Shard& shard = *shards.getUnchecked (i);
+        const ScopedLock sl (shard.lock);
+
+        if (isPositiveAndBelow (index, shard.entries.size()))
+            return String::CharPointerType (shard.entries.getUnchecked (index)->text);
+
+        index -= shard.entries.size();
+    }
+
+    return String().getCharPointer();
 }
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class StringPoolTests  : public UnitTest
+{
+public:
+    StringPoolTests() : UnitTest ("StringPool") {}
+
+    // What the pool used to be: a sorted array of strings, searched and added to under a lock
+    class SortedArrayPool
+    {
+    public:
+        String::CharPointerType getPooledString (const String& s)
+        {
+            const ScopedLock sl (lock);
+            const int index = strings.indexOf (s);
+
+            if (index >= 0)
+                return strings.getReference (index).getCharPointer();
+
+            strings.add (s);
+            return strings.getReference (strings.indexOf (s)).getCharPointer();
+        }
+
+    private:
+        SortedSet<String> strings;
+        CriticalSection lock;
+    };
+
+    template <class PoolType>
+    class InterningThread  : public Thread
+    {
+    public:
+        InterningThread (PoolType& p, const StringArray& names_, int numRepeats_)
+            : Thread ("interning thread"), pool (p), names (names_), numRepeats (numRepeats_)
+        {
+        }
+
+        void run() override
+        {
+            for (int repeat = 0; repeat < numRepeats; ++repeat)
+            {
+                results.clearQuick();
+
+                for (int i = 0; i < names.size(); ++i)
+                    results.add (pool.getPooledString (names[i]).getAddress());
+            }
+        }
+
+        Array<const void*> results;
+
+    private:
+        PoolType& pool;
+        const StringArray& names;
+        const int numRepeats;
+    };
+
+    // Returns the time taken, and sets allConsistent to whether every pointer that the threads
+    // were given is the one the pool hands back for the same string afterwards.
+    template <class PoolType>
+    static double timeLookups (PoolType& pool, const StringArray& names, int numThreads, int numRepeats, bool& allConsistent)
+    {
+        OwnedArray<InterningThread<PoolType> > threads;
+
+        for (int i = 0; i < numThreads; ++i)
+            threads.add (new InterningThread<PoolType> (pool, names, numRepeats));
+
+        const double start = Time::getMillisecondCounterHiRes();
+
+        for (int i = 0; i < threads.size(); ++i)    threads.getUnchecked(i)->startThread();
+        for (int i = 0; i < threads.size(); ++i)    threads.getUnchecked(i)->waitForThreadToExit (-1);
+
+        const double elapsed = Time::getMillisecondCounterHiRes() - start;
+        allConsistent = true;
+
+        for (int i = 0; i < names.size(); ++i)
+        {
+            const void* const address = pool.getPooledString (names[i]).getAddress();
+
+            for (int j = 0; j < threads.size(); ++j)
+                allConsistent = allConsistent && threads.getUnchecked(j)->results.getUnchecked (i) == address;
+        }
+
+        return elapsed;
+    }
+
+    static StringArray makeNames (int num, Random& r)
+    {
+        StringArray names;
+
+        for (int i = 0; i < num; ++i)
+            names.add ("name_" + String (r.nextInt (num * 4)) + "_" + String (i % 7));
+
+        return names;
+    }
+
+    void runTest() override
+    {
+        beginTest ("Matching strings share a pointer");
+        {
+            StringPool pool;
+            const String::CharPointerType a (pool.getPooledString ("abc"));
+
+            expect (pool.getPooledString (String ("ab") + "c") == a);
+            expect (pool.getPooledString (L"abc") == a);
+            expect (pool.getPooledString ("abd") != a);
+            expect (String (a) == "abc");
+            expectEquals (pool.size(), 2);
+
+            expect (pool.getPooledString (String()) == pool.getPooledString (""));
+            expect (pool.getPooledString (String()).isEmpty());
+            expect (pool.getPooledString (String (CharPointer_UTF8 ("caf\xc3\xa9"))) == pool.getPooledString ("caf" + String::charToString ((juce_wchar) 0xe9)));
+            expectEquals (pool.size(), 4);
+
+            const FlatHashFunctions hasher;
+            expect (StringPool::getPooledStringHash (a) == hasher.generateHash (String ("abc")));
+            expect (Identifier ("abc").getHash() == hasher.generateHash (String ("abc")));
+            expect (Identifier().getHash() == 0);
+        }
+
+        beginTest ("Growing");
+        {
+            StringPool pool;
+            Random r (getRandom());
+            const StringArray names (makeNames (20000, r));
+            Array<const void*> first;
+
+            for (int i = 0; i < names.size(); ++i)
+                first.add (pool.getPooledString (names[i]).getAddress());
+
+            int numWrong = 0;
+
+            for (int i = 0; i < names.size(); ++i)
+                if (pool.getPooledString (names[i]).getAddress() != first.getUnchecked (i)
+                     || String (pool.getPooledString (names[i])) != names[i])
+                    ++numWrong;
+
+            expectEquals (numWrong, 0);
+
+            SortedSet<String> distinct;
+
+            for (int i = 0; i < names.size(); ++i)
+                distinct.add (names[i]);
+
+            expectEquals (pool.size(), distinct.size());
+
+            int numFound = 0;
+
+            for (int i = 0; i < pool.size(); ++i)
+                if (distinct.contains (String (pool[i])))
+                    ++numFound;
+
+            expectEquals (numFound, distinct.size());
+        }
+
+        beginTest ("Threads");
+        {
+            StringPool pool;
+            Random r (getRandom());
+            const StringArray names (makeNames (5000, r));
+            OwnedArray<InterningThread<StringPool> > threads;
+
+            for (int i = 0; i < 4; ++i)
+                threads.add (new InterningThread<StringPool> (pool, names, 1));
+
+            for (int i = 0; i < threads.size(); ++i)    threads.getUnchecked(i)->startThread();
+            for (int i = 0; i < threads.size(); ++i)    threads.getUnchecked(i)->waitForThreadToExit (-1);
+
+            bool allMatch = true;
+
+            for (int i = 1; i < threads.size(); ++i)
+                allMatch = allMatch && threads.getUnchecked(i)->results == threads.getUnchecked(0)->results;
+
+            expect (allMatch, "two threads got different pointers for the same string");
+
+            for (int i = 0; i < names.size(); ++i)
+                allMatch = allMatch && pool.getPooledString (names[i]).getAddress() == threads.getUnchecked(0)->results.getUnchecked (i);
+
+            expect (allMatch);
+        }
+
+        beginTest ("Benchmarks");
+        {
+            Random r (getRandom());
+            const StringArray names (makeNames (20000, r));
+
+            for (int numThreads = 1; numThreads <= 4; numThreads *= 4)
+            {
+                StringPool pool;
+                SortedArrayPool oldPool;
+                bool newAddsMatch, oldAddsMatch, newLookupsMatch, oldLookupsMatch;
+
+                const double newAdding = timeLookups (pool, names, 1, 1, newAddsMatch);
+                const double oldAdding = timeLookups (oldPool, names, 1, 1, oldAddsMatch);
+                const double newLookups = timeLookups (pool, names, numThreads, 4, newLookupsMatch);
+                const double oldLookups = timeLookups (oldPool, names, numThreads, 4, oldLookupsMatch);
+
+                expect (newAddsMatch && newLookupsMatch, "the pool gave out different pointers for the same string");
+                expect (oldAddsMatch && oldLookupsMatch);
+                expect (String (pool.getPooledString (names[0])) == names[0]);
+
+                logMessage (String (names.size()) + " strings (ms), hashed vs sorted: adding "
+                              + String (newAdding, 1) + " / " + String (oldAdding, 1)
+                              + ", looking up x4 on " + String (numThreads) + " threads "
+                              + String (newLookups, 1) + " / " + String (oldLookups, 1));
+            }
+        }
+    }
+};
+
+static StringPoolTests stringPoolTests;
+
+#endif
@@ -40,13 +40,18 @@
     is returned every time a matching string is asked for. This means that it's trivial to
     compare two pooled strings for equality, as you can simply compare their pointers. It
     also cuts down on storage if you're using many copies of the same string.
+
+    The strings are kept in a number of separately-locked hash tables, chosen by each
+    string's hash. Looking up a string that's already in the pool doesn't take any lock,
+    and adding one only locks the table that it goes into, so many threads can use the
+    same pool at once.
 */
 class JUCE_API  StringPool
 {
 public:
     //==============================================================================
     /** Creates an empty pool. */
-    StringPool() noexcept;
+    StringPool();
 
     /** Destructor */
     ~StringPool();
@@ -76,16 +81,42 @@ public:
     */
     String::CharPointerType getPooledString (const wchar_t* original);
 
+    //==============================================================================
+    /** Returns the hash of a string that was returned by getPooledString().
+
+        This is worked out when the string is added to the pool and stored alongside it,
+        so it's very quick. It's the same value that FlatHashFunctions would give for a
+        String containing the same text.
+    */
+    static uint32 getPooledStringHash (String::CharPointerType pooledString) noexcept
+    {
+        jassert (pooledString.getAddress() != nullptr);
+        return reinterpret_cast<const uint32*> (pooledString.getAddress()) [-1];
+    }
+
     //==============================================================================
     /** Returns the number of strings in the pool. */
     int size() const noexcept;
 
-    /** Returns one of the strings in the pool, by index. */
+    /** Returns one of the strings in the pool, by index.
+        The strings aren't kept in any particular order, and this has to search for the
+        right table, so it's only really useful for iterating the contents.
+    */
     String::CharPointerType operator[] (int index) const noexcept;
 
 private:
-    Array <String> strings;
-    CriticalSection lock;
+    //==============================================================================
+    struct Entry;
+    struct Table;
+    struct Shard;
+    friend struct ContainerDeletePolicy<Shard>;
+
+    OwnedArray<Shard> shards;
+    Atomic<int> numStrings;
+
+    String::CharPointerType getPooledText (const String::CharPointerType::CharType*, size_t numBytes);
+
+    JUCE_DECLARE_NON_COPYABLE (StringPool)
 };
 
 
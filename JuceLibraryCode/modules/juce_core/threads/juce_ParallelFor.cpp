@@ -0,0 +1,257 @@
+/*
+  ==============================================================================
+
+   This file is part of the juce_core module of the JUCE library.
+   Copyright (c) 2013 - Raw Material Software Ltd.
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose with
+   or without fee is hereby granted, provided that the above copyright notice and this
+   permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+   ------------------------------------------------------------------------------
+
+   NOTE! This permissive ISC license applies ONLY to files within the juce_core module!
+   All other JUCE modules are covered by a dual GPL/commercial license, so if you are
+   using any other modules, be sure to check that you also comply with their license.
+
+   For more details, visit www.juce.com
+
+  ==============================================================================
+*/
+
+class ParallelLoop::HelperJob  : public ThreadPoolJob
+{
+public:
+    HelperJob (ParallelLoop& l)  : ThreadPoolJob ("Parallel loop"), loop (l) {}
+
+    JobStatus runJob() override
+    {
+        while (! shouldExit() && loop.processNextChunk())
+        {}
+
+        return jobHasFinished;
+    }
+
+private:
+    ParallelLoop& loop;
+
+    JUCE_DECLARE_NON_COPYABLE (HelperJob)
+};
+
+//==============================================================================
+static int getParallelLoopChunkSize (int numItems, int grainSize, int numThreads) noexcept
+{
+    if (grainSize > 0)
+        return grainSize;
+
+    // a few chunks per thread, so that the load balances if some are slower than others
+    return jmax (1, numItems / (jmax (1, numThreads) * 4));
+}
+
+ParallelLoop::ParallelLoop (const int startIndex, const int endIndex, const int grainSize, const int numThreads) noexcept
+    : start (startIndex),
+      end (jmax (startIndex, endIndex)),
+      chunkSize (getParallelLoopChunkSize (end - start, grainSize, numThreads)),
+      numChunks ((end - start + chunkSize - 1) / chunkSize)
+{
+}
+
+ParallelLoop::~ParallelLoop()
+{
+}
+
+bool ParallelLoop::processNextChunk()
+{
+    const int chunk = ++nextChunk - 1;
+
+    if (chunk >= numChunks)
+        return false;
+
+    const int chunkStart = start + chunk * chunkSize;
+    processChunk (chunk, chunkStart, jmin (end, chunkStart + chunkSize));
+    return true;
+}
+
+void ParallelLoop::run (ThreadPool& pool)
+{
+    nextChunk = 0;
+
+    OwnedArray<HelperJob> helpers;
+
+    for (int i = jmin (pool.getNumThreads(), numChunks - 1); --i >= 0;)
+    {
+        helpers.add (new HelperJob (*this));
+        pool.addJob (helpers.getLast(), false);
+    }
+
+    while (processNextChunk())
+    {}
+
+    // every chunk has been taken, so the helpers that haven't started yet are cancelled,
+    // and the others will be finishing their last chunk
+    for (int i = helpers.size(); --i >= 0;)
+        pool.removeJob (helpers.getUnchecked (i), false, -1);
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class ParallelForTests  : public UnitTest
+{
+public:
+    ParallelForTests() : UnitTest ("ParallelFor") {}
+
+    struct CountVisits
+    {
+        CountVisits (Atomic<int>* v) : visits (v) {}
+
+        void operator() (int rangeStart, int rangeEnd) const
+        {
+            for (int i = rangeStart; i < rangeEnd; ++i)
+                ++visits[i];
+        }
+
+        Atomic<int>* visits;
+    };
+
+    struct SumRange
+    {
+        SumRange (const float* d) : data (d) {}
+
+        double operator() (int rangeStart, int rangeEnd) const
+        {
+            double sum = 0;
+
+            for (int i = rangeStart; i < rangeEnd; ++i)
+                sum += data[i];
+
+            return sum;
+        }
+
+        const float* data;
+    };
+
+    struct Add
+    {
+        double operator() (double a, double b) const    { return a + b; }
+    };
+
+    /** Runs a parallelFor for each row, from inside the outer parallelFor's ranges. */
+    struct NestedRows
+    {
+        NestedRows (ThreadPool& p, Atomic<int>* v, int w) : pool (p), visits (v), width (w) {}
+
+        void operator() (int rowStart, int rowEnd) const
+        {
+            for (int row = rowStart; row < rowEnd; ++row)
+                parallelFor (pool, 0, width, CountVisits (visits + row * width), 16);
+        }
+
+        ThreadPool& pool;
+        Atomic<int>* visits;
+        const int width;
+    };
+
+    void checkAllVisitedOnce (const Atomic<int>* visits, int num)
+    {
+        int numWrong = 0;
+
+        for (int i = 0; i < num; ++i)
+            if (visits[i].get() != 1)
+                ++numWrong;
+
+        expectEquals (numWrong, 0);
+    }
+
+    void runTest() override
+    {
+        ThreadPool pool (4);
+
+        beginTest ("Every index is visited once");
+        {
+            const int sizes[] = { 0, 1, 2, 7, 100, 1000, 65537 };
+
+            for (int i = 0; i < numElementsInArray (sizes); ++i)
+            {
+                for (int grain = 0; grain <= 3; grain += 3)
+                {
+                    HeapBlock<Atomic<int> > visits ((size_t) sizes[i] + 1, true);
+                    parallelFor (pool, 0, sizes[i], CountVisits (visits), grain);
+                    checkAllVisitedOnce (visits, sizes[i]);
+                    expectEquals (visits[sizes[i]].get(), 0);
+                }
+            }
+
+            HeapBlock<Atomic<int> > visits (100, true);
+            parallelFor (pool, 50, 40, CountVisits (visits));
+            checkAllVisitedOnce (visits, 0);
+        }
+
+        beginTest ("Nested loops");
+        {
+            const int width = 100, height = 50;
+            HeapBlock<Atomic<int> > visits ((size_t) (width * height), true);
+            parallelFor (pool, 0, height, NestedRows (pool, visits, width), 1);
+            checkAllVisitedOnce (visits, width * height);
+        }
+
+        beginTest ("Reduction");
+        {
+            const int num = 100003;
+            HeapBlock<float> data ((size_t) num);
+            Random r (0x5a5a);
+            double expected = 0;
+
+            for (int i = 0; i < num; ++i)
+                expected += (data[i] = r.nextFloat());
+
+            const double sum = parallelReduce (pool, 0, num, 0.0, SumRange (data), Add(), 1000);
+            expect (std::abs (sum - expected) < 1.0e-6 * num);
+
+            // the same chunks are always combined in the same order
+            ThreadPool otherPool (3);
+            expectEquals (parallelReduce (otherPool, 0, num, 0.0, SumRange (data), Add(), 1000), sum);
+            expectEquals (parallelReduce (pool, 0, 0, 1.5, SumRange (data), Add()), 1.5);
+        }
+
+        beginTest ("Speed");
+        {
+            const int num = 1 << 22;
+            HeapBlock<float> data ((size_t) num);
+
+            for (int i = 0; i < num; ++i)
+                data[i] = (float) (i & 7);
+
+            const SumRange sumRange (data);
+            double serialSum = 0, parallelSum = 0, serialTime = 1.0e9, parallelTime = 1.0e9;
+
+            // best of a few runs, so that neither timing includes warming up
+            for (int run = 0; run < 3; ++run)
+            {
+                double start = Time::getMillisecondCounterHiRes();
+                serialSum = parallelReduce (pool, 0, num, 0.0, sumRange, Add(), num); // one chunk, on this thread
+                serialTime = jmin (serialTime, Time::getMillisecondCounterHiRes() - start);
+
+                start = Time::getMillisecondCounterHiRes();
+                parallelSum = parallelReduce (pool, 0, num, 0.0, sumRange, Add());
+                parallelTime = jmin (parallelTime, Time::getMillisecondCounterHiRes() - start);
+            }
+
+            expectEquals (parallelSum, serialSum);
+            logMessage ("Summing " + String (num) + " floats: " + String (serialTime, 2) + "ms on one thread, "
+                         + String (parallelTime, 2) + "ms with parallelReduce on " + String (pool.getNumThreads())
+                         + " threads and " + String (SystemStats::getNumCpus()) + " CPUs");
+        }
+    }
+};
+
+static ParallelForTests parallelForTests;
+
+#endif
@@ -0,0 +1,189 @@
+/*
+  ==============================================================================
+
+   This file is part of the juce_core module of the JUCE library.
+   Copyright (c) 2013 - Raw Material Software Ltd.
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose with
+   or without fee is hereby granted, provided that the above copyright notice and this
+   permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+   ------------------------------------------------------------------------------
+
+   NOTE! This permissive ISC license applies ONLY to files within the juce_core module!
+   All other JUCE modules are covered by a dual GPL/commercial license, so if you are
+   using any other modules, be sure to check that you also comply with their license.
+
+   For more details, visit www.juce.com
+
+  ==============================================================================
+*/
+
+#ifndef JUCE_PARALLELFOR_H_INCLUDED
+#define JUCE_PARALLELFOR_H_INCLUDED
+
+
+//==============================================================================
+/**
+    Splits a range of indices into chunks and processes them on a ThreadPool.
+
+    This is the engine behind parallelFor() and parallelReduce(), which are usually
+    more convenient, but you can also subclass it directly.
+
+    Threads take chunks one at a time from a shared counter, so a thread that gets
+    quick chunks simply takes more of them. The thread that calls run() processes
+    chunks too, and when they've all been taken it cancels any of the pool's jobs
+    that haven't started yet. This means that run() can safely be called from inside
+    a job that's running on the same pool: in the worst case the calling thread
+    ends up doing all the work itself.
+
+    @see parallelFor, parallelReduce, TaskGraph
+*/
+class JUCE_API  ParallelLoop
+{
+public:
+    /** Creates a loop over the indices startIndex to endIndex - 1.
+
+        If grainSize is 0 or less, a chunk size is chosen which gives each of the
+        given number of threads several chunks to work on.
+    */
+    ParallelLoop (int startIndex, int endIndex, int grainSize, int numThreads) noexcept;
+
+    /** Destructor. */
+    virtual ~ParallelLoop();
+
+    /** Processes all the chunks, and returns when they're finished. */
+    void run (ThreadPool& pool);
+
+    /** Returns the number of chunks that the range has been split into. */
+    int getNumChunks() const noexcept           { return numChunks; }
+
+protected:
+    /** Called once for each chunk, on any of the threads.
+        chunkIndex goes from 0 to getNumChunks() - 1, and the chunk covers the indices
+        chunkStart to chunkEnd - 1.
+    */
+    virtual void processChunk (int chunkIndex, int chunkStart, int chunkEnd) = 0;
+
+private:
+    class HelperJob;
+    friend class HelperJob;
+
+    const int start, end, chunkSize, numChunks;
+    Atomic<int> nextChunk;
+
+    bool processNextChunk();
+
+    JUCE_DECLARE_NON_COPYABLE (ParallelLoop)
+};
+
+//==============================================================================
+#ifndef DOXYGEN
+namespace ParallelLoopHelpers
+{
+    template <typename FunctionType>
+    class ForLoop  : public ParallelLoop
+    {
+    public:
+        ForLoop (int startIndex, int endIndex, int grainSize, int numThreads, FunctionType& f)
+            : ParallelLoop (startIndex, endIndex, grainSize, numThreads), function (f) {}
+
+        void processChunk (int, int chunkStart, int chunkEnd) override     { function (chunkStart, chunkEnd); }
+
+    private:
+        FunctionType& function;
+
+        JUCE_DECLARE_NON_COPYABLE (ForLoop)
+    };
+
+    template <typename ValueType, typename FunctionType>
+    class ReduceLoop  : public ParallelLoop
+    {
+    public:
+        ReduceLoop (int startIndex, int endIndex, int grainSize, int numThreads,
+                    FunctionType& f, const ValueType& initialValue)
+            : ParallelLoop (startIndex, endIndex, grainSize, numThreads), function (f)
+        {
+            results.insertMultiple (0, initialValue, getNumChunks());
+        }
+
+        void processChunk (int chunkIndex, int chunkStart, int chunkEnd) override
+        {
+            results.getReference (chunkIndex) = function (chunkStart, chunkEnd);
+        }
+
+        Array<ValueType> results;
+
+    private:
+        FunctionType& function;
+
+        JUCE_DECLARE_NON_COPYABLE (ReduceLoop)
+    };
+}
+#endif
+
+//==============================================================================
+/**
+    Calls a function for consecutive ranges of indices from startIndex to endIndex - 1,
+    using all the pool's threads as well as the calling one.
+
+    The function is called as function (int rangeStart, int rangeEnd), and must process
+    the indices from rangeStart to rangeEnd - 1. It will be called on several threads at
+    once, so the ranges must be independent of each other. Working on a range rather
+    than a single index lets the function keep things like row pointers in registers
+    and lets the compiler vectorise its inner loop.
+
+    grainSize is the number of indices per call. If it's 0, a size is chosen that gives
+    each thread several ranges. Use a bigger grain if each index is very cheap.
+
+    This returns when every index has been processed. It can be called from inside a
+    ThreadPoolJob, including one running on the same pool.
+
+    @see parallelReduce, ParallelLoop, TaskGraph
+*/
+template <typename FunctionType>
+void parallelFor (ThreadPool& pool, int startIndex, int endIndex, FunctionType function, int grainSize = 0)
+{
+    ParallelLoopHelpers::ForLoop<FunctionType> loop (startIndex, endIndex, grainSize, pool.getNumThreads() + 1, function);
+    loop.run (pool);
+}
+
+/**
+    Combines values calculated for consecutive ranges of indices, using all the pool's
+    threads as well as the calling one.
+
+    The function is called as function (int rangeStart, int rangeEnd), like with
+    parallelFor(), and must return a ValueType for its range. The results are then
+    combined on the calling thread, starting with initialValue, as
+    combiner (combiner (combiner (initialValue, result0), result1), ...)
+    in the order of the ranges. So the answer only depends on how the range was split,
+    which can be fixed by giving a grainSize. That makes floating-point sums
+    repeatable from run to run.
+
+    @see parallelFor, ParallelLoop
+*/
+template <typename ValueType, typename FunctionType, typename CombinerType>
+ValueType parallelReduce (ThreadPool& pool, int startIndex, int endIndex, const ValueType& initialValue,
+                          FunctionType function, CombinerType combiner, int grainSize = 0)
+{
+    ParallelLoopHelpers::ReduceLoop<ValueType, FunctionType> loop (startIndex, endIndex, grainSize,
+                                                                   pool.getNumThreads() + 1, function, initialValue);
+    loop.run (pool);
+
+    ValueType total (initialValue);
+
+    for (int i = 0; i < loop.results.size(); ++i)
+        total = combiner (total, loop.results.getReference (i));
+
+    return total;
+}
+
+
+#endif   // JUCE_PARALLELFOR_H_INCLUDED
@@ -0,0 +1,361 @@
+/*
+  ==============================================================================
+
+   This file is part of the juce_core module of the JUCE library.
+   Copyright (c) 2013 - Raw Material Software Ltd.
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose with
+   or without fee is hereby granted, provided that the above copyright notice and this
+   permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+   ------------------------------------------------------------------------------
+
+   NOTE! This permissive ISC license applies ONLY to files within the juce_core module!
+   All other JUCE modules are covered by a dual GPL/commercial license, so if you are
+   using any other modules, be sure to check that you also comply with their license.
+
+   For more details, visit www.juce.com
+
+  ==============================================================================
+*/
+
+class TaskGraph::TaskJob  : public ThreadPoolJob
+{
+public:
+    TaskJob (TaskGraph& g, int index)  : ThreadPoolJob ("Task graph"), graph (g), taskIndex (index) {}
+
+    JobStatus runJob() override
+    {
+        graph.runTaskAndContinuations (taskIndex);
+        return jobHasFinished;
+    }
+
+private:
+    TaskGraph& graph;
+    const int taskIndex;
+
+    JUCE_DECLARE_NON_COPYABLE (TaskJob)
+};
+
+struct TaskGraph::Node
+{
+    Node (Task* t, TaskJob* j)  : task (t), job (j), numPrerequisites (0) {}
+
+    ScopedPointer<Task> task;
+    ScopedPointer<TaskJob> job;
+    Array<int> dependents;
+    int numPrerequisites;
+    Atomic<int> numPending;
+};
+
+//==============================================================================
+TaskGraph::TaskGraph()  : currentPool (nullptr)
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+    // don't delete a graph while it's running!
+    jassert (currentPool == nullptr);
+}
+
+int TaskGraph::addTask (Task* const newTask)
+{
+    jassert (newTask != nullptr);
+    jassert (currentPool == nullptr); // can't add tasks while the graph is running
+
+    const int index = nodes.size();
+    nodes.add (new Node (newTask, new TaskJob (*this, index)));
+    return index;
+}
+
+void TaskGraph::addDependency (const int taskIndex, const int mustRunAfterTaskIndex)
+{
+    jassert (currentPool == nullptr); // can't add dependencies while the graph is running
+    jassert (taskIndex != mustRunAfterTaskIndex);
+
+    if (Node* const prerequisite = nodes [mustRunAfterTaskIndex])
+    {
+        if (Node* const node = nodes [taskIndex])
+        {
+            if (! prerequisite->dependents.contains (taskIndex))
+            {
+                prerequisite->dependents.add (taskIndex);
+                ++(node->numPrerequisites);
+            }
+        }
+    }
+}
+
+int TaskGraph::getNumTasks() const noexcept
+{
+    return nodes.size();
+}
+
+void TaskGraph::clear()
+{
+    jassert (currentPool == nullptr);
+    nodes.clear();
+}
+
+bool TaskGraph::hasCycle() const
+{
+    // repeatedly remove the tasks that aren't waiting for anything; whatever's left is in a cycle
+    Array<int> waitingFor, ready;
+    int numRemoved = 0;
+
+    for (int i = 0; i < nodes.size(); ++i)
+    {
+        waitingFor.add (nodes.getUnchecked(i)->numPrerequisites);
+
+        if (waitingFor.getLast() == 0)
+            ready.add (i);
+    }
+
+    while (ready.size() > 0)
+    {
+        const Node& node = *nodes.getUnchecked (ready.remove (ready.size() - 1));
+        ++numRemoved;
+
+        for (int i = 0; i < node.dependents.size(); ++i)
+        {
+            const int dependent = node.dependents.getUnchecked (i);
+
+            if (--(waitingFor.getReference (dependent)) == 0)
+                ready.add (dependent);
+        }
+    }
+
+    return numRemoved < nodes.size();
+}
+
+void TaskGraph::runTaskAndContinuations (int taskIndex)
+{
+    while (taskIndex >= 0)
+    {
+        const Node& node = *nodes.getUnchecked (taskIndex);
+        node.task->run();
+        taskIndex = -1;
+
+        for (int i = 0; i < node.dependents.size(); ++i)
+        {
+            const int dependent = node.dependents.getUnchecked (i);
+            Node& dependentNode = *nodes.getUnchecked (dependent);
+
+            if (--(dependentNode.numPending) == 0)
+            {
+                // carry on with the first task that this one has made ready, and let other threads have the rest
+                if (taskIndex < 0)
+                    taskIndex = dependent;
+                else
+                    currentPool->addJob (dependentNode.job, false);
+            }
+        }
+
+        --numTasksRemaining;
+        progress.signal();
+    }
+}
+
+bool TaskGraph::run (ThreadPool& pool)
+{
+    jassert (currentPool == nullptr); // a graph can only be run on one thread at a time
+
+    if (hasCycle())
+    {
+        jassertfalse;
+        return false;
+    }
+
+    if (nodes.size() == 0)
+        return true;
+
+    currentPool = &pool;
+    numTasksRemaining = nodes.size();
+    progress.reset();
+
+    int firstRoot = -1;
+
+    for (int i = 0; i < nodes.size(); ++i)
+    {
+        Node& node = *nodes.getUnchecked(i);
+        node.numPending = node.numPrerequisites;
+    }
+
+    for (int i = 0; i < nodes.size(); ++i)
+    {
+        if (nodes.getUnchecked(i)->numPrerequisites == 0)
+        {
+            if (firstRoot < 0)
+                firstRoot = i;
+            else
+                pool.addJob (nodes.getUnchecked(i)->job, false);
+        }
+    }
+
+    runTaskAndContinuations (firstRoot);
+
+    // help with the queued jobs until the graph's finished, and sleep when there's nothing to do
+    // (every task that finishes signals, so a newly-ready task can't be missed)
+    while (numTasksRemaining.get() > 0)
+        if (! pool.runNextQueuedJob())
+            progress.wait (-1);
+
+    // the jobs have all run their tasks, but the pool may still be tidying up after the last ones
+    for (int i = 0; i < nodes.size(); ++i)
+        pool.waitForJobToFinish (nodes.getUnchecked(i)->job, -1);
+
+    currentPool = nullptr;
+    return true;
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class TaskGraphTests  : public UnitTest
+{
+public:
+    TaskGraphTests() : UnitTest ("TaskGraph") {}
+
+    /** Records the order in which it ran, after a short amount of work. */
+    struct OrderedTask  : public TaskGraph::Task
+    {
+        OrderedTask (Atomic<int>& c, int* slot) : counter (c), order (slot) {}
+
+        void run() override
+        {
+            uint32 x = (uint32) (pointer_sized_int) this;
+
+            for (int i = 0; i < 2000; ++i)
+                x = x * 1664525 + 1013904223;
+
+            junk = x;
+            *order = ++counter;
+        }
+
+        Atomic<int>& counter;
+        int* order;
+        uint32 junk;
+    };
+
+    /** Runs a parallelFor from inside a task. */
+    struct ParallelFill
+    {
+        ParallelFill (ThreadPool& p, int* d, int n) : pool (p), data (d), num (n) {}
+
+        void operator() (int rangeStart, int rangeEnd) const
+        {
+            for (int i = rangeStart; i < rangeEnd; ++i)
+                data[i] = i;
+        }
+
+        void operator()() const     { parallelFor (pool, 0, num, *this, 64); }
+
+        ThreadPool& pool;
+        int* data;
+        const int num;
+    };
+
+    void runTest() override
+    {
+        ThreadPool pool (4);
+
+        beginTest ("Dependencies are respected");
+        {
+            // layers of tasks, each depending on a few in the layer before
+            const int numLayers = 8, width = 20;
+            TaskGraph graph;
+            Atomic<int> counter;
+            HeapBlock<int> order ((size_t) (numLayers * width), true);
+            Random r (0x7a5c);
+            Array<int> tasks, prerequisites;
+
+            for (int i = 0; i < numLayers * width; ++i)
+                graph.addTask (new OrderedTask (counter, order + i));
+
+            for (int layer = 1; layer < numLayers; ++layer)
+            {
+                for (int i = 0; i < width; ++i)
+                {
+                    for (int j = r.nextInt (4); --j >= 0;)
+                    {
+                        tasks.add (layer * width + i);
+                        prerequisites.add ((layer - 1) * width + r.nextInt (width));
+                        graph.addDependency (tasks.getLast(), prerequisites.getLast());
+                    }
+                }
+            }
+
+            for (int run = 0; run < 3; ++run)
+            {
+                counter = 0;
+                expect (graph.run (pool));
+                expectEquals (counter.get(), numLayers * width);
+
+                int numOutOfOrder = 0;
+
+                for (int i = 0; i < tasks.size(); ++i)
+                    if (order[tasks[i]] <= order[prerequisites[i]])
+                        ++numOutOfOrder;
+
+                expectEquals (numOutOfOrder, 0);
+            }
+        }
+
+        beginTest ("Chains and diamonds");
+        {
+            TaskGraph graph;
+            Atomic<int> counter;
+            int order[5] = { 0 };
+
+            // 0 -> (1, 2) -> 3 -> 4
+            for (int i = 0; i < 5; ++i)
+                graph.addTask (new OrderedTask (counter, order + i));
+
+            graph.addDependency (1, 0);
+            graph.addDependency (2, 0);
+            graph.addDependency (3, 1);
+            graph.addDependency (3, 2);
+            graph.addDependency (4, 3);
+            graph.addDependency (4, 3);
+
+            expect (graph.run (pool));
+            expectEquals (order[0], 1);
+            expect (order[1] > 1 && order[1] < 4 && order[2] > 1 && order[2] < 4);
+            expectEquals (order[3], 4);
+            expectEquals (order[4], 5);
+        }
+
+        beginTest ("Nested parallelism");
+        {
+            TaskGraph graph;
+            const int num = 5000;
+            HeapBlock<int> data ((size_t) num * 4, true);
+
+            for (int i = 0; i < 4; ++i)
+                graph.addFunction (ParallelFill (pool, data + i * num, num));
+
+            graph.addDependency (3, 0);
+            expect (graph.run (pool));
+
+            int numWrong = 0;
+
+            for (int i = 0; i < num * 4; ++i)
+                if (data[i] != i % num)
+                    ++numWrong;
+
+            expectEquals (numWrong, 0);
+        }
+    }
+};
+
+static TaskGraphTests taskGraphTests;
+
+#endif
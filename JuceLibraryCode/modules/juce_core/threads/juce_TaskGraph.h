@@ -0,0 +1,130 @@
+/*
+  ==============================================================================
+
+   This file is part of the juce_core module of the JUCE library.
+   Copyright (c) 2013 - Raw Material Software Ltd.
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose with
+   or without fee is hereby granted, provided that the above copyright notice and this
+   permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+   ------------------------------------------------------------------------------
+
+   NOTE! This permissive ISC license applies ONLY to files within the juce_core module!
+   All other JUCE modules are covered by a dual GPL/commercial license, so if you are
+   using any other modules, be sure to check that you also comply with their license.
+
+   For more details, visit www.juce.com
+
+  ==============================================================================
+*/
+
+#ifndef JUCE_TASKGRAPH_H_INCLUDED
+#define JUCE_TASKGRAPH_H_INCLUDED
+
+
+//==============================================================================
+/**
+    A set of tasks with dependencies between them, which are run on a ThreadPool
+    as soon as the tasks they depend on have finished.
+
+    Add the tasks with addTask() or addFunction(), say which ones have to wait for
+    which with addDependency(), and then call run(). Tasks that are ready go into
+    the pool, and when a task finishes, the thread that ran it carries straight on
+    with one of the tasks that were waiting for it, so chains of tasks don't have
+    to go back through a queue. The thread that calls run() runs queued jobs too
+    until the whole graph is finished, so it can be called from inside a job on
+    the same pool.
+
+    A graph can be run as many times as you like, but tasks and dependencies can't
+    be added while it's running.
+
+    @see parallelFor, ThreadPool
+*/
+class JUCE_API  TaskGraph
+{
+public:
+    //==============================================================================
+    /** A piece of work in a TaskGraph. */
+    class JUCE_API  Task
+    {
+    public:
+        virtual ~Task() {}
+
+        /** Does the work. This may be called on any thread. */
+        virtual void run() = 0;
+    };
+
+    //==============================================================================
+    /** Creates an empty graph. */
+    TaskGraph();
+
+    /** Destructor. */
+    ~TaskGraph();
+
+    //==============================================================================
+    /** Adds a task, which the graph will own and delete.
+        Returns the task's index, which is used to refer to it in addDependency().
+    */
+    int addTask (Task* newTask);
+
+    /** Adds a task that calls a copy of the given function object (or lambda), with no arguments. */
+    template <typename FunctionType>
+    int addFunction (FunctionType function)
+    {
+        return addTask (new FunctionTask<FunctionType> (function));
+    }
+
+    /** Makes one task wait until another has finished. */
+    void addDependency (int taskIndex, int mustRunAfterTaskIndex);
+
+    /** Returns the number of tasks that have been added. */
+    int getNumTasks() const noexcept;
+
+    /** Deletes all the tasks. */
+    void clear();
+
+    //==============================================================================
+    /** Runs every task once, and returns when they've all finished.
+
+        Returns false without running anything if the dependencies go round in a
+        circle, because then there's no order they could be run in.
+    */
+    bool run (ThreadPool& pool);
+
+private:
+    //==============================================================================
+    template <typename FunctionType>
+    struct FunctionTask  : public Task
+    {
+        FunctionTask (const FunctionType& f) : function (f) {}
+        void run() override     { function(); }
+
+        FunctionType function;
+    };
+
+    struct Node;
+    class TaskJob;
+    friend class TaskJob;
+    friend struct ContainerDeletePolicy<Node>;
+
+    OwnedArray<Node> nodes;
+    Atomic<int> numTasksRemaining;
+    WaitableEvent progress;
+    ThreadPool* currentPool;
+
+    bool hasCycle() const;
+    void runTaskAndContinuations (int taskIndex);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TaskGraph)
+};
+
+
+#endif   // JUCE_TASKGRAPH_H_INCLUDED
@@ -31,7 +31,8 @@ ThreadPoolJob::ThreadPoolJob (const String& name)
       pool (nullptr),
       shouldStop (false),
       isActive (false),
-      shouldBeDeleted (false)
+      shouldBeDeleted (false),
+      queueTicket (0)
 {
 }
 
@@ -57,13 +58,186 @@ void ThreadPoolJob::signalJobShouldExit()
     shouldStop = true;
 }
 
+//==============================================================================
+/*  An entry in one of the queues. Each time a job is queued it gets a new ticket, so
+    that an entry left behind by a job that has since been removed (or deleted, and
+    its address reused by a new job) can be recognised and skipped.
+*/
+struct ThreadPool::QueuedJob
+{
+    ThreadPoolJob* job;
+    uint32 ticket;
+};
+
+struct ThreadPool::JobShard
+{
+    CriticalSection lock;
+    SortedSet<ThreadPoolJob*> jobs;
+};
+
+//==============================================================================
+/*  A Chase-Lev work-stealing deque. Only the thread that owns it may push() and
+    pop(), which work at the bottom end, while any other thread may steal() from the
+    top. The buffer doubles when it fills up, and old buffers are kept until the
+    deque is deleted because a thief may still be reading from one.
+*/
+class ThreadPool::JobDeque
+{
+public:
+    JobDeque()  : top (0), bottom (0), buffer (new Buffer (64, nullptr)) {}
+
+    ~JobDeque()
+    {
+        for (Buffer* b = buffer.get(); b != nullptr;)
+        {
+            Buffer* const previous = b->previous;
+            delete b;
+            b = previous;
+        }
+    }
+
+    void push (const QueuedJob& item)
+    {
+        const int64 b = bottom.get();
+        const int64 t = top.get();
+        Buffer* buf = buffer.get();
+
+        if (b - t >= buf->size)
+        {
+            Buffer* const bigger = new Buffer (buf->size * 2, buf);
+
+            for (int64 i = t; i < b; ++i)
+                bigger->at (i) = buf->at (i);
+
+            buffer = buf = bigger;
+        }
+
+        buf->at (b) = item;
+        bottom = b + 1;
+    }
+
+    bool pop (QueuedJob& item)
+    {
+        const int64 b = bottom.get() - 1;
+        bottom = b;
+        const int64 t = top.get();
+
+        if (t > b)
+        {
+            bottom = t;
+            return false;
+        }
+
+        item = buffer.get()->at (b);
+
+        if (t < b)
+            return true;
+
+        // taking the last item, which a thief may be after too
+        const bool won = top.compareAndSetBool (t + 1, t);
+        bottom = t + 1;
+        return won;
+    }
+
+    bool steal (QueuedJob& item)
+    {
+        const int64 t = top.get();
+        const int64 b = bottom.get();
+
+        if (t >= b)
+            return false;
+
+        item = buffer.get()->at (t);
+        return top.compareAndSetBool (t + 1, t);
+    }
+
+    bool isEmpty() const noexcept   { return bottom.get() <= top.get(); }
+
+private:
+    struct Buffer
+    {
+        Buffer (int64 numItems, Buffer* previousBuffer)
+            : size (numItems), items ((size_t) numItems), previous (previousBuffer) {}
+
+        QueuedJob& at (int64 index) noexcept     { return items [(size_t) (index & (size - 1))]; }
+
+        const int64 size;
+        HeapBlock<QueuedJob> items;
+        Buffer* const previous;
+    };
+
+    Atomic<int64> top, bottom;
+    Atomic<Buffer*> buffer;
+
+    JUCE_DECLARE_NON_COPYABLE (JobDeque)
+};
+
+//==============================================================================
+/*  The queue for jobs added from outside the pool's threads, and for jobs that
+    need running again. This is a bounded lock-free queue for any number of
+    producers and consumers (Dmitry Vyukov's design), which spills over into a
+    locked list in the unlikely event that it fills up.
+*/
+class ThreadPool::InjectionQueue
+{
+public:
+    InjectionQueue()  : ring (4096)
+    {
+    }
+
+    void push (const QueuedJob& item)
+    {
+        if (! ring.push (item))
+        {
+            const ScopedLock sl (overflowLock);
+            overflow.add (item);
+            ++numOverflowing;
+        }
+    }
+
+    bool pop (QueuedJob& item)
+    {
+        if (ring.pop (item))
+            return true;
+
+        if (numOverflowing.get() > 0)
+        {
+            const ScopedLock sl (overflowLock);
+
+            if (overflow.size() > 0)
+            {
+                item = overflow.getFirst();
+                overflow.remove (0);
+                --numOverflowing;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool isEmpty() const noexcept
+    {
+        return ring.isEmpty() && numOverflowing.get() == 0;
+    }
+
+private:
+    MPMCQueue<QueuedJob> ring;
+    CriticalSection overflowLock;
+    Array<QueuedJob> overflow;
+    Atomic<int> numOverflowing;
+
+    JUCE_DECLARE_NON_COPYABLE (InjectionQueue)
+};
+
 //==============================================================================
 class ThreadPool::ThreadPoolThread  : public Thread
 {
 public:
-    ThreadPoolThread (ThreadPool& pool_)
+    ThreadPoolThread (ThreadPool& pool_, int index_)
         : Thread ("Pool"),
-          pool (pool_)
+          pool (pool_),
+          index (index_)
     {
     }
 
@@ -71,14 +245,29 @@ public:
     {
         while (! threadShouldExit())
         {
-            if (! pool.runNextJob())
-                wait (500);
+            if (pool.runNextJob (this))
+                continue;
+
+            // announce that we're going to sleep before looking for work one last time, so
+            // that a job added meanwhile either gets seen here or wakes us up
+            isSleeping = 1;
+            ++pool.numSleepingThreads;
+
+            if (! (pool.hasQueuedJobs() || threadShouldExit()))
+                wait (-1);
+
+            // unless whoever woke us has already done so
+            if (isSleeping.compareAndSetBool (0, 1))
+                --pool.numSleepingThreads;
         }
     }
 
-private:
     ThreadPool& pool;
+    const int index;
+    JobDeque deque;
+    Atomic<int> isSleeping;
 
+private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ThreadPoolThread)
 };
 
@@ -103,8 +292,13 @@ ThreadPool::~ThreadPool()
 
 void ThreadPool::createThreads (int numThreads)
 {
-    for (int i = jmax (1, numThreads); --i >= 0;)
-        threads.add (new ThreadPoolThread (*this));
+    for (int i = 0; i < 32; ++i)
+        shards.add (new JobShard());
+
+    injectionQueue = new InjectionQueue();
+
+    for (int i = 0; i < jmax (1, numThreads); ++i)
+        threads.add (new ThreadPoolThread (*this, i));
 
     for (int i = threads.size(); --i >= 0;)
         threads.getUnchecked(i)->startThread();
@@ -113,12 +307,21 @@ void ThreadPool::createThreads (int numThreads)
 void ThreadPool::stopThreads()
 {
     for (int i = threads.size(); --i >= 0;)
+    {
         threads.getUnchecked(i)->signalThreadShouldExit();
+        threads.getUnchecked(i)->notify();
+    }
 
     for (int i = threads.size(); --i >= 0;)
         threads.getUnchecked(i)->stopThread (500);
 }
 
+ThreadPool::JobShard& ThreadPool::getShard (const ThreadPoolJob* const job) const noexcept
+{
+    const uint64 address = (uint64) (pointer_sized_uint) job;
+    return *shards.getUnchecked ((int) (((address >> 4) * 0x9e3779b97f4a7c15ULL) >> 59));
+}
+
 void ThreadPool::addJob (ThreadPoolJob* const job, const bool deleteJobWhenFinished)
 {
     jassert (job != nullptr);
@@ -131,37 +334,151 @@ void ThreadPool::addJob (ThreadPoolJob* const job, const bool deleteJobWhenFinis
         job->isActive = false;
         job->shouldBeDeleted = deleteJobWhenFinished;
 
+        uint32 ticket;
+
         {
-            const ScopedLock sl (lock);
-            jobs.add (job);
+            JobShard& shard = getShard (job);
+            const ScopedLock sl (shard.lock);
+            shard.jobs.add (job);
+            ticket = job->queueTicket = ++nextQueueTicket;
         }
 
-        for (int i = threads.size(); --i >= 0;)
-            threads.getUnchecked(i)->notify();
+        ++numJobs;
+        enqueue (job, ticket, true);
     }
 }
 
+void ThreadPool::enqueue (ThreadPoolJob* const job, const uint32 ticket, const bool fromRunningJob)
+{
+    const QueuedJob item = { job, ticket };
+
+    ThreadPoolThread* const currentThread = fromRunningJob ? dynamic_cast<ThreadPoolThread*> (Thread::getCurrentThread())
+                                                           : nullptr;
+
+    if (currentThread != nullptr && &(currentThread->pool) == this)
+        currentThread->deque.push (item);
+    else
+        injectionQueue->push (item);
+
+    wakeSleepingThread();
+}
+
+void ThreadPool::wakeSleepingThread()
+{
+    if (numSleepingThreads.get() > 0)
+    {
+        for (int i = 0; i < threads.size(); ++i)
+        {
+            ThreadPoolThread* const t = threads.getUnchecked(i);
+
+            if (t->isSleeping.compareAndSetBool (0, 1))
+            {
+                --numSleepingThreads;
+                t->notify();
+                break;
+            }
+        }
+    }
+}
+
+bool ThreadPool::hasQueuedJobs() const noexcept
+{
+    if (! injectionQueue->isEmpty())
+        return true;
+
+    for (int i = threads.size(); --i >= 0;)
+        if (! threads.getUnchecked(i)->deque.isEmpty())
+            return true;
+
+    return false;
+}
+
 int ThreadPool::getNumJobs() const
 {
-    return jobs.size();
+    return numJobs.get();
 }
 
-ThreadPoolJob* ThreadPool::getJob (const int index) const
+ThreadPoolJob* ThreadPool::getJob (int index) const
 {
-    const ScopedLock sl (lock);
-    return jobs [index];
+    for (int i = 0; i < shards.size(); ++i)
+    {
+        const JobShard& shard = *shards.getUnchecked(i);
+        const ScopedLock sl (shard.lock);
+
+        if (isPositiveAndBelow (index, shard.jobs.size()))
+            return shard.jobs.getUnchecked (index);
+
+        index -= shard.jobs.size();
+    }
+
+    return nullptr;
 }
 
 bool ThreadPool::contains (const ThreadPoolJob* const job) const
 {
-    const ScopedLock sl (lock);
-    return jobs.contains (const_cast <ThreadPoolJob*> (job));
+    const JobShard& shard = getShard (job);
+    const ScopedLock sl (shard.lock);
+    return shard.jobs.contains (const_cast <ThreadPoolJob*> (job));
 }
 
 bool ThreadPool::isJobRunning (const ThreadPoolJob* const job) const
 {
-    const ScopedLock sl (lock);
-    return jobs.contains (const_cast <ThreadPoolJob*> (job)) && job->isActive;
+    const JobShard& shard = getShard (job);
+    const ScopedLock sl (shard.lock);
+    return shard.jobs.contains (const_cast <ThreadPoolJob*> (job)) && job->isActive;
+}
+
+//==============================================================================
+/*  While one of these exists, its event is signalled whenever a job leaves the pool. */
+struct ThreadPoolFinishWaiter
+{
+    ThreadPoolFinishWaiter (CriticalSection& l, Array<WaitableEvent*>& w, Atomic<int>& n)
+        : lock (l), waiters (w), numWaiters (n)
+    {
+        const ScopedLock sl (lock);
+        waiters.add (&event);
+        ++numWaiters;
+    }
+
+    ~ThreadPoolFinishWaiter()
+    {
+        const ScopedLock sl (lock);
+        waiters.removeFirstMatchingValue (&event);
+        --numWaiters;
+    }
+
+    /** Returns false if the time is up. */
+    bool wait (const uint32 startTime, const int timeOutMs) const
+    {
+        if (timeOutMs < 0)
+            return event.wait (-1);
+
+        const int remaining = (int) (startTime + (uint32) timeOutMs - Time::getMillisecondCounter());
+
+        if (remaining <= 0 || remaining > timeOutMs)
+            return false;
+
+        event.wait (remaining);
+        return true;
+    }
+
+    CriticalSection& lock;
+    Array<WaitableEvent*>& waiters;
+    Atomic<int>& numWaiters;
+    WaitableEvent event;
+
+    JUCE_DECLARE_NON_COPYABLE (ThreadPoolFinishWaiter)
+};
+
+void ThreadPool::signalJobStopped()
+{
+    if (numFinishWaiters.get() > 0)
+    {
+        const ScopedLock sl (finishWaitersLock);
+
+        for (int i = finishWaiters.size(); --i >= 0;)
+            finishWaiters.getUnchecked(i)->signal();
+    }
 }
 
 bool ThreadPool::waitForJobToFinish (const ThreadPoolJob* const job,
@@ -170,14 +487,11 @@ bool ThreadPool::waitForJobToFinish (const ThreadPoolJob* const job,
     if (job != nullptr)
     {
         const uint32 start = Time::getMillisecondCounter();
+        ThreadPoolFinishWaiter waiter (finishWaitersLock, finishWaiters, numFinishWaiters);
 
         while (contains (job))
-        {
-            if (timeOutMs >= 0 && Time::getMillisecondCounter() >= start + (uint32) timeOutMs)
-                return false;
-
-            jobFinishedSignal.wait (2);
-        }
+            if (! waiter.wait (start, timeOutMs))
+                return ! contains (job);
     }
 
     return true;
@@ -187,14 +501,15 @@ bool ThreadPool::removeJob (ThreadPoolJob* const job,
                             const bool interruptIfRunning,
                             const int timeOutMs)
 {
-    bool dontWait = true;
+    bool dontWait = true, removed = false;
     OwnedArray<ThreadPoolJob> deletionList;
 
     if (job != nullptr)
     {
-        const ScopedLock sl (lock);
+        JobShard& shard = getShard (job);
+        const ScopedLock sl (shard.lock);
 
-        if (jobs.contains (job))
+        if (shard.jobs.contains (job))
         {
             if (job->isActive)
             {
@@ -205,12 +520,18 @@ bool ThreadPool::removeJob (ThreadPoolJob* const job,
             }
             else
             {
-                jobs.removeFirstMatchingValue (job);
+                // its queue entry is left behind, and will be skipped when it's reached
+                shard.jobs.removeValue (job);
+                --numJobs;
                 addToDeleteList (deletionList, job);
+                removed = true;
             }
         }
     }
 
+    if (removed)
+        signalJobStopped();
+
     return dontWait || waitForJobToFinish (job, timeOutMs);
 }
 
@@ -219,15 +540,20 @@ bool ThreadPool::removeAllJobs (const bool interruptRunningJobs, const int timeO
 {
     Array <ThreadPoolJob*> jobsToWaitFor;
 
+    // register before looking, so that no job can finish unnoticed in between
+    ThreadPoolFinishWaiter waiter (finishWaitersLock, finishWaiters, numFinishWaiters);
+
     {
         OwnedArray<ThreadPoolJob> deletionList;
 
+        for (int s = 0; s < shards.size(); ++s)
         {
-            const ScopedLock sl (lock);
+            JobShard& shard = *shards.getUnchecked(s);
+            const ScopedLock sl (shard.lock);
 
-            for (int i = jobs.size(); --i >= 0;)
+            for (int i = shard.jobs.size(); --i >= 0;)
             {
-                ThreadPoolJob* const job = jobs.getUnchecked(i);
+                ThreadPoolJob* const job = shard.jobs.getUnchecked(i);
 
                 if (selectedJobsToRemove == nullptr || selectedJobsToRemove->isJobSuitable (job))
                 {
@@ -240,12 +566,16 @@ bool ThreadPool::removeAllJobs (const bool interruptRunningJobs, const int timeO
                     }
                     else
                     {
-                        jobs.remove (i);
+                        shard.jobs.remove (i);
+                        --numJobs;
                         addToDeleteList (deletionList, job);
                     }
                 }
             }
         }
+
+        if (deletionList.size() > 0)
+            signalJobStopped();
     }
 
     const uint32 start = Time::getMillisecondCounter();
@@ -263,10 +593,8 @@ bool ThreadPool::removeAllJobs (const bool interruptRunningJobs, const int timeO
         if (jobsToWaitFor.size() == 0)
             break;
 
-        if (timeOutMs >= 0 && Time::getMillisecondCounter() >= start + (uint32) timeOutMs)
+        if (! waiter.wait (start, timeOutMs))
             return false;
-
-        jobFinishedSignal.wait (20);
     }
 
     return true;
@@ -275,13 +603,18 @@ bool ThreadPool::removeAllJobs (const bool interruptRunningJobs, const int timeO
 StringArray ThreadPool::getNamesOfAllJobs (const bool onlyReturnActiveJobs) const
 {
     StringArray s;
-    const ScopedLock sl (lock);
 
-    for (int i = 0; i < jobs.size(); ++i)
+    for (int i = 0; i < shards.size(); ++i)
     {
-        const ThreadPoolJob* const job = jobs.getUnchecked(i);
-        if (job->isActive || ! onlyReturnActiveJobs)
-            s.add (job->getJobName());
+        const JobShard& shard = *shards.getUnchecked(i);
+        const ScopedLock sl (shard.lock);
+
+        for (int j = 0; j < shard.jobs.size(); ++j)
+        {
+            const ThreadPoolJob* const job = shard.jobs.getUnchecked(j);
+            if (job->isActive || ! onlyReturnActiveJobs)
+                s.add (job->getJobName());
+        }
     }
 
     return s;
@@ -298,43 +631,80 @@ bool ThreadPool::setThreadPriorities (const int newPriority)
     return ok;
 }
 
-ThreadPoolJob* ThreadPool::pickNextJobToRun()
+bool ThreadPool::findQueuedJob (ThreadPoolThread* const thread, QueuedJob& item)
 {
-    OwnedArray<ThreadPoolJob> deletionList;
+    if ((thread != nullptr && thread->deque.pop (item)) || injectionQueue->pop (item))
+        return true;
 
+    // nothing of our own to do, so try the other threads, starting with our neighbour
+    const int numThreads = threads.size();
+    const int first = thread != nullptr ? thread->index + 1 : 0;
+
+    for (int i = 0; i < numThreads; ++i)
     {
-        const ScopedLock sl (lock);
+        ThreadPoolThread* const victim = threads.getUnchecked ((first + i) % numThreads);
 
-        for (int i = 0; i < jobs.size(); ++i)
-        {
-            ThreadPoolJob* job = jobs[i];
+        if (victim != thread && victim->deque.steal (item))
+            return true;
+    }
 
-            if (job != nullptr && ! job->isActive)
-            {
-                if (job->shouldStop)
-                {
-                    jobs.remove (i);
-                    addToDeleteList (deletionList, job);
-                    --i;
-                    continue;
-                }
+    return false;
+}
 
-                job->isActive = true;
-                return job;
-            }
+bool ThreadPool::claimJob (const QueuedJob& item)
+{
+    OwnedArray<ThreadPoolJob> deletionList;
+
+    {
+        JobShard& shard = getShard (item.job);
+        const ScopedLock sl (shard.lock);
+
+        // only look inside the job once we know it's still in the pool
+        if (! shard.jobs.contains (item.job) || item.job->queueTicket != item.ticket || item.job->isActive)
+            return false;
+
+        if (! item.job->shouldStop)
+        {
+            item.job->isActive = true;
+            return true;
         }
+
+        shard.jobs.removeValue (item.job);
+        --numJobs;
+        addToDeleteList (deletionList, item.job);
     }
 
-    return nullptr;
+    signalJobStopped();
+    return false;
 }
 
-bool ThreadPool::runNextJob()
+int ThreadPool::getNumThreads() const noexcept
 {
-    ThreadPoolJob* const job = pickNextJobToRun();
+    return threads.size();
+}
 
-    if (job == nullptr)
-        return false;
+bool ThreadPool::runNextQueuedJob()
+{
+    ThreadPoolThread* currentThread = dynamic_cast<ThreadPoolThread*> (Thread::getCurrentThread());
+
+    if (currentThread != nullptr && &(currentThread->pool) != this)
+        currentThread = nullptr;
 
+    return runNextJob (currentThread);
+}
+
+bool ThreadPool::runNextJob (ThreadPoolThread* const thread)
+{
+    QueuedJob item;
+
+    do
+    {
+        if (! findQueuedJob (thread, item))
+            return false;
+    }
+    while (! claimJob (item));
+
+    ThreadPoolJob* const job = item.job;
     ThreadPoolJob::JobStatus result = ThreadPoolJob::jobHasFinished;
 
     JUCE_TRY
@@ -344,29 +714,36 @@ bool ThreadPool::runNextJob()
     JUCE_CATCH_ALL_ASSERT
 
     OwnedArray<ThreadPoolJob> deletionList;
+    bool runAgain = false;
+    uint32 ticket = 0;
 
     {
-        const ScopedLock sl (lock);
+        JobShard& shard = getShard (job);
+        const ScopedLock sl (shard.lock);
 
-        if (jobs.contains (job))
+        if (shard.jobs.contains (job))
         {
             job->isActive = false;
 
             if (result != ThreadPoolJob::jobNeedsRunningAgain || job->shouldStop)
             {
-                jobs.removeFirstMatchingValue (job);
+                shard.jobs.removeValue (job);
+                --numJobs;
                 addToDeleteList (deletionList, job);
-
-                jobFinishedSignal.signal();
             }
             else
             {
-                // move the job to the end of the queue if it wants another go
-                jobs.move (jobs.indexOf (job), -1);
+                ticket = job->queueTicket = ++nextQueueTicket;
+                runAgain = true;
             }
         }
     }
 
+    if (runAgain)
+        enqueue (job, ticket, false);   // to the back of the shared queue, so other jobs get a turn
+
+    // anyone waiting for this job to stop running needs to look again, whether or not it's finished
+    signalJobStopped();
     return true;
 }
 
@@ -378,3 +755,235 @@ void ThreadPool::addToDeleteList (OwnedArray<ThreadPoolJob>& deletionList, Threa
     if (job->shouldBeDeleted)
         deletionList.add (job);
 }
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class ThreadPoolTests  : public UnitTest
+{
+public:
+    ThreadPoolTests() : UnitTest ("ThreadPool") {}
+
+    /** Does a little work, and optionally adds more jobs like itself from inside runJob(). */
+    struct CountingJob  : public ThreadPoolJob
+    {
+        CountingJob (ThreadPool& p, Atomic<int>& counter, int numRuns, int numChildren, int workSize)
+            : ThreadPoolJob ("counting"), owner (p), count (counter), runsLeft (numRuns),
+              children (numChildren), work (workSize), result (0)
+        {
+        }
+
+        JobStatus runJob() override
+        {
+            for (int i = 0; i < work; ++i)
+                result = result * 1664525 + 1013904223;
+
+            for (int i = 0; i < children; ++i)
+                owner.addJob (new CountingJob (owner, count, 1, children - 1, work), true);
+
+            ++count;
+            return --runsLeft > 0 ? jobNeedsRunningAgain : jobHasFinished;
+        }
+
+        ThreadPool& owner;
+        Atomic<int>& count;
+        int runsLeft;
+        const int children, work;
+        uint32 result;
+    };
+
+    /** Blocks its thread until told to finish. */
+    struct BlockingJob  : public ThreadPoolJob
+    {
+        BlockingJob() : ThreadPoolJob ("blocking"), started (true) {}
+
+        JobStatus runJob() override
+        {
+            started.signal();
+
+            while (! (shouldExit() || release.wait (1)))
+            {}
+
+            return jobHasFinished;
+        }
+
+        WaitableEvent started, release;
+    };
+
+    /** Sleeps for a while each time it runs, and keeps asking to be run again until it's stopped. */
+    struct RepeatingJob  : public ThreadPoolJob
+    {
+        RepeatingJob() : ThreadPoolJob ("repeating"), started (true) {}
+
+        JobStatus runJob() override
+        {
+            started.signal();
+            Thread::sleep (50);
+            return jobNeedsRunningAgain;
+        }
+
+        WaitableEvent started;
+    };
+
+    struct SingleJobSelector  : public ThreadPool::JobSelector
+    {
+        SingleJobSelector (ThreadPoolJob* j) : job (j) {}
+        bool isJobSuitable (ThreadPoolJob* j) override    { return j == job; }
+
+        ThreadPoolJob* const job;
+    };
+
+    static bool waitForCount (ThreadPool& pool, Atomic<int>& count, int target)
+    {
+        const uint32 start = Time::getMillisecondCounter();
+
+        while (count.get() < target || pool.getNumJobs() > 0)
+        {
+            if (Time::getMillisecondCounter() > start + 20000)
+                return false;
+
+            Thread::sleep (1);
+        }
+
+        return true;
+    }
+
+    void runTest() override
+    {
+        beginTest ("Every job runs");
+        {
+            ThreadPool pool (4);
+            OwnedArray<ThreadPoolJob> jobs;
+            Atomic<int> count;
+            int expectedCount = 0;
+
+            for (int i = 0; i < 5000; ++i)
+            {
+                jobs.add (new CountingJob (pool, count, 1 + (i % 3), 0, 10));
+                pool.addJob (jobs.getLast(), false);
+                expectedCount += 1 + (i % 3);
+            }
+
+            for (int i = 0; i < jobs.size(); ++i)
+                expect (pool.waitForJobToFinish (jobs.getUnchecked (i), 20000));
+
+            expectEquals (count.get(), expectedCount);
+            expectEquals (pool.getNumJobs(), 0);
+        }
+
+        beginTest ("Jobs added by jobs");
+        {
+            ThreadPool pool (4);
+            Atomic<int> count;
+
+            // a tree of 1 + 6 + 6*5 + 6*5*4 + ... jobs
+            pool.addJob (new CountingJob (pool, count, 1, 6, 100), true);
+            expect (waitForCount (pool, count, 1957));
+            expectEquals (count.get(), 1957);
+        }
+
+        beginTest ("Removing jobs");
+        {
+            ThreadPool pool (1);
+            BlockingJob blocker;
+            pool.addJob (&blocker, false);
+            blocker.started.wait (5000);
+            expect (pool.isJobRunning (&blocker));
+
+            Atomic<int> count;
+            CountingJob queued (pool, count, 1, 0, 0);
+            pool.addJob (&queued, false);
+            pool.addJob (new CountingJob (pool, count, 1, 0, 0), true);
+            expectEquals (pool.getNumJobs(), 3);
+            expectEquals (pool.getNamesOfAllJobs (true).size(), 1);
+
+            expect (pool.removeJob (&queued, false, 0));
+            expect (! pool.contains (&queued));
+            expect (! pool.removeJob (&blocker, false, 10));
+
+            // and add it back, so that the first queue entry is stale
+            pool.addJob (&queued, false);
+            blocker.release.signal();
+            expect (pool.waitForJobToFinish (&blocker, 5000));
+            expect (pool.waitForJobToFinish (&queued, 5000));
+            expect (waitForCount (pool, count, 2));
+            expectEquals (count.get(), 2);
+
+            BlockingJob blocker2;
+            pool.addJob (&blocker2, false);
+            blocker2.started.wait (5000);
+
+            for (int i = 0; i < 10; ++i)
+                pool.addJob (new CountingJob (pool, count, 1, 0, 0), true);
+
+            expect (pool.removeAllJobs (true, 5000));
+            expectEquals (pool.getNumJobs(), 0);
+            expectEquals (count.get(), 2);
+        }
+
+        beginTest ("Waiting for a job that runs again");
+        {
+            ThreadPool pool (1);
+            RepeatingJob repeater;
+            BlockingJob blocker;
+            pool.addJob (&repeater, false);
+            repeater.started.wait (5000);
+            pool.addJob (&blocker, false);
+
+            // the repeater goes back in the queue behind the blocker, which then holds the only
+            // thread, but the repeater has stopped running, so this shouldn't have to wait for it
+            SingleJobSelector selector (&repeater);
+            const uint32 start = Time::getMillisecondCounter();
+            expect (pool.removeAllJobs (false, 5000, &selector));
+            expect (Time::getMillisecondCounter() - start < 2000);
+            expect (! pool.isJobRunning (&repeater));
+
+            blocker.release.signal();
+            expect (pool.removeAllJobs (true, 5000));
+            expectEquals (pool.getNumJobs(), 0);
+        }
+
+        beginTest ("Scaling");
+        {
+            const int numCpus = SystemStats::getNumCpus();
+            const int numJobs = 20000;
+
+            for (int numThreads = 1; numThreads <= 64; numThreads *= 2)
+            {
+                double flatTime, nestedTime;
+
+                {
+                    ThreadPool pool (numThreads);
+                    Atomic<int> count;
+                    const double start = Time::getMillisecondCounterHiRes();
+
+                    for (int i = 0; i < numJobs; ++i)
+                        pool.addJob (new CountingJob (pool, count, 1, 0, 200), true);
+
+                    expect (waitForCount (pool, count, numJobs));
+                    flatTime = Time::getMillisecondCounterHiRes() - start;
+                }
+
+                {
+                    ThreadPool pool (numThreads);
+                    Atomic<int> count;
+                    const double start = Time::getMillisecondCounterHiRes();
+
+                    // 1 + 7 + 7*6 + ... + 7! = 13700 jobs, nearly all added from inside other jobs
+                    pool.addJob (new CountingJob (pool, count, 1, 7, 200), true);
+
+                    expect (waitForCount (pool, count, 13700));
+                    nestedTime = Time::getMillisecondCounterHiRes() - start;
+                }
+
+                logMessage (String (numThreads) + " threads (" + String (numCpus) + " CPUs): "
+                             + String (roundToInt (numJobs / flatTime)) + "k jobs/s added from outside, "
+                             + String (roundToInt (13700 / nestedTime)) + "k jobs/s added by jobs");
+            }
+        }
+    }
+};
+
+static ThreadPoolTests threadPoolTests;
+
+#endif
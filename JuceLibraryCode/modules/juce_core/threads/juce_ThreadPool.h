@@ -126,6 +126,7 @@ private:
     String jobName;
     ThreadPool* pool;
     bool shouldStop, isActive, shouldBeDeleted;
+    uint32 queueTicket;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ThreadPoolJob)
 };
@@ -138,6 +139,12 @@ private:
     When a ThreadPoolJob object is added to the ThreadPool's list, its runJob() method
     will be called by the next pooled thread that becomes free.
 
+    Each thread has its own queue of jobs, and a thread that runs out of work takes
+    jobs from the others, so jobs aren't necessarily started in the order they were
+    added. Jobs added from inside another job's runJob() go onto the current thread's
+    own queue, and jobs added from anywhere else go onto a shared queue that all the
+    threads take from. Threads with nothing to do sleep until a job is added.
+
     @see ThreadPoolJob, Thread
 */
 class JUCE_API  ThreadPool
@@ -284,21 +291,53 @@ public:
     */
     bool setThreadPriorities (int newPriority);
 
+    /** Returns the number of threads in the pool. */
+    int getNumThreads() const noexcept;
 
-private:
     //==============================================================================
-    Array <ThreadPoolJob*> jobs;
+    /** Runs one of the queued jobs on the calling thread, if there are any.
+
+        This lets a thread that's waiting for some jobs to finish help with them rather
+        than sitting idle. Any queued job may be picked, not just the ones it's waiting for.
+        Returns false if there was nothing to run.
+
+        @see parallelFor, TaskGraph
+    */
+    bool runNextQueuedJob();
 
+
+private:
+    //==============================================================================
+    struct QueuedJob;
+    struct JobShard;
+    class JobDeque;
+    class InjectionQueue;
     class ThreadPoolThread;
     friend class ThreadPoolThread;
     friend struct ContainerDeletePolicy<ThreadPoolThread>;
+    friend struct ContainerDeletePolicy<JobShard>;
+    friend struct ContainerDeletePolicy<InjectionQueue>;
     OwnedArray<ThreadPoolThread> threads;
 
-    CriticalSection lock;
-    WaitableEvent jobFinishedSignal;
-
-    bool runNextJob();
-    ThreadPoolJob* pickNextJobToRun();
+    // the jobs in the pool are kept in several sets, each with its own lock, so that
+    // threads starting and finishing different jobs rarely wait for each other
+    OwnedArray<JobShard> shards;
+    ScopedPointer<InjectionQueue> injectionQueue;
+    Atomic<int> numJobs, numSleepingThreads;
+    Atomic<uint32> nextQueueTicket;
+
+    mutable CriticalSection finishWaitersLock;
+    mutable Array<WaitableEvent*> finishWaiters;
+    mutable Atomic<int> numFinishWaiters;
+
+    JobShard& getShard (const ThreadPoolJob*) const noexcept;
+    void enqueue (ThreadPoolJob*, uint32 ticket, bool fromRunningJob);
+    void wakeSleepingThread();
+    bool hasQueuedJobs() const noexcept;
+    bool findQueuedJob (ThreadPoolThread*, QueuedJob&);
+    bool claimJob (const QueuedJob&);
+    bool runNextJob (ThreadPoolThread*);
+    void signalJobStopped();
     void addToDeleteList (OwnedArray<ThreadPoolJob>&, ThreadPoolJob*) const;
     void createThreads (int numThreads);
     void stopThreads();
@@ -0,0 +1,872 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2013 - Raw Material Software Ltd.
+
+   Permission is granted to use this software under the terms of either:
+   a) the GPL v2 (or any later version)
+   b) the Affero GPL v3
+
+   Details of these licenses can be found at: www.gnu.org/licenses
+
+   JUCE is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+   A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   ------------------------------------------------------------------------------
+
+   To release a closed-source product which uses JUCE, commercial licenses are
+   available: visit www.juce.com for more information.
+
+  ==============================================================================
+*/
+
+// GCC needs each function that uses an instruction set's intrinsics to be marked
+// as targeting it, unless the whole file is compiled for it.
+#if JUCE_GCC
+ #define JUCE_YUV_TARGET(instructionSet)   __attribute__ ((target (instructionSet)))
+#else
+ #define JUCE_YUV_TARGET(instructionSet)
+#endif
+
+namespace YUVConverterHelpers
+{
+    typedef void (*RowFunction) (const uint8* y, const uint8* u, const uint8* v, uint8* dest, int width);
+
+    //==============================================================================
+    /*  BT.601 limited range, in 6-bit fixed point:
+
+            R = (Y' + 102 V) >> 6
+            G = (Y' -  25 U - 52 V) >> 6
+            B = (Y' + 129 U) >> 6
+
+        where Y' = 74.5 (Y - 16) + 32, and U and V are centred on zero. Every
+        intermediate value fits into a signed 16-bit lane, except where the
+        result would be clamped to 255 anyway, so the SIMD versions can use
+        saturating 16-bit arithmetic and still match this one exactly.
+    */
+    static forcedinline int scaleLuma (int y) noexcept
+    {
+        const int d = y - 16;
+        return d * 74 + (d >> 1) + 32;
+    }
+
+    static forcedinline uint8 clampToByte (int v) noexcept
+    {
+        return (uint8) (v < 0 ? 0 : (v > 255 ? 255 : v));
+    }
+
+    template <int format>
+    static forcedinline void fetch (const uint8* y, const uint8* u, const uint8* v, int x, int& Y, int& U, int& V) noexcept
+    {
+        const int pair = x & ~1;
+
+        switch (format)
+        {
+            case YUVConverter::yuyv:   Y = y[2 * x];      U = y[2 * pair + 1];  V = y[2 * pair + 3];  break;
+            case YUVConverter::uyvy:   Y = y[2 * x + 1];  U = y[2 * pair];      V = y[2 * pair + 2];  break;
+            case YUVConverter::nv12:   Y = y[x];          U = u[pair];          V = u[pair + 1];      break;
+            default:                   Y = y[x];          U = u[x >> 1];        V = v[x >> 1];        break;
+        }
+    }
+
+    template <int format, class PixelType>
+    static void convertRowScalarFrom (const uint8* y, const uint8* u, const uint8* v, uint8* dest, int startX, int width) noexcept
+    {
+        PixelType* const d = reinterpret_cast<PixelType*> (dest);
+
+        for (int x = startX; x < width; ++x)
+        {
+            int Y, U, V;
+            fetch<format> (y, u, v, x, Y, U, V);
+
+            const int c = scaleLuma (Y);
+            U -= 128;
+            V -= 128;
+
+            d[x].setARGB (255, clampToByte ((c + 102 * V) >> 6),
+                               clampToByte ((c - 25 * U - 52 * V) >> 6),
+                               clampToByte ((c + 129 * U) >> 6));
+        }
+    }
+
+    template <int format, class PixelType>
+    static void convertRowScalar (const uint8* y, const uint8* u, const uint8* v, uint8* dest, int width)
+    {
+        convertRowScalarFrom<format, PixelType> (y, u, v, dest, 0, width);
+    }
+
+   #if JUCE_YUV_USE_SSE2
+    //==============================================================================
+    JUCE_YUV_TARGET ("sse2")
+    static forcedinline __m128i scaleLumaSSE2 (__m128i y) noexcept
+    {
+        const __m128i d = _mm_sub_epi16 (y, _mm_set1_epi16 (16));
+        return _mm_add_epi16 (_mm_add_epi16 (_mm_mullo_epi16 (d, _mm_set1_epi16 (74)), _mm_srai_epi16 (d, 1)),
+                              _mm_set1_epi16 (32));
+    }
+
+    /*  Takes 16 luma values as two sets of 8 shorts, and the 8 chroma pairs that go
+        with them, and returns 16 bytes each of R, G and B.
+    */
+    JUCE_YUV_TARGET ("sse2")
+    static forcedinline void yuvToRGBSSE2 (__m128i y0, __m128i y1, __m128i u, __m128i v,
+                                           __m128i& r, __m128i& g, __m128i& b) noexcept
+    {
+        u = _mm_sub_epi16 (u, _mm_set1_epi16 (128));
+        v = _mm_sub_epi16 (v, _mm_set1_epi16 (128));
+
+        const __m128i rv  = _mm_mullo_epi16 (v, _mm_set1_epi16 (102));
+        const __m128i guv = _mm_add_epi16 (_mm_mullo_epi16 (u, _mm_set1_epi16 (25)),
+                                           _mm_mullo_epi16 (v, _mm_set1_epi16 (52)));
+        const __m128i bu  = _mm_mullo_epi16 (u, _mm_set1_epi16 (129));
+
+        const __m128i c0 = scaleLumaSSE2 (y0);
+        const __m128i c1 = scaleLumaSSE2 (y1);
+
+        // each chroma value is shared by two neighbouring pixels
+        r = _mm_packus_epi16 (_mm_srai_epi16 (_mm_adds_epi16 (c0, _mm_unpacklo_epi16 (rv, rv)), 6),
+                              _mm_srai_epi16 (_mm_adds_epi16 (c1, _mm_unpackhi_epi16 (rv, rv)), 6));
+        g = _mm_packus_epi16 (_mm_srai_epi16 (_mm_subs_epi16 (c0, _mm_unpacklo_epi16 (guv, guv)), 6),
+                              _mm_srai_epi16 (_mm_subs_epi16 (c1, _mm_unpackhi_epi16 (guv, guv)), 6));
+        b = _mm_packus_epi16 (_mm_srai_epi16 (_mm_adds_epi16 (c0, _mm_unpacklo_epi16 (bu, bu)), 6),
+                              _mm_srai_epi16 (_mm_adds_epi16 (c1, _mm_unpackhi_epi16 (bu, bu)), 6));
+    }
+
+    /** Loads 16 pixels starting at x, as 16-bit values. */
+    template <int format>
+    JUCE_YUV_TARGET ("sse2")
+    static forcedinline void load16SSE2 (const uint8* y, const uint8* u, const uint8* v, int x,
+                                         __m128i& y0, __m128i& y1, __m128i& cu, __m128i& cv) noexcept
+    {
+        const __m128i lowBytes = _mm_set1_epi16 (0xff);
+
+        if (format == YUVConverter::yuyv || format == YUVConverter::uyvy)
+        {
+            const __m128i a = _mm_loadu_si128 ((const __m128i*) (y + 2 * x));
+            const __m128i b = _mm_loadu_si128 ((const __m128i*) (y + 2 * x + 16));
+            __m128i ca, cb;
+
+            if (format == YUVConverter::yuyv)
+            {
+                y0 = _mm_and_si128 (a, lowBytes);   ca = _mm_srli_epi16 (a, 8);
+                y1 = _mm_and_si128 (b, lowBytes);   cb = _mm_srli_epi16 (b, 8);
+            }
+            else
+            {
+                y0 = _mm_srli_epi16 (a, 8);         ca = _mm_and_si128 (a, lowBytes);
+                y1 = _mm_srli_epi16 (b, 8);         cb = _mm_and_si128 (b, lowBytes);
+            }
+
+            const __m128i uv = _mm_packus_epi16 (ca, cb);
+            cu = _mm_and_si128 (uv, lowBytes);
+            cv = _mm_srli_epi16 (uv, 8);
+        }
+        else
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i luma = _mm_loadu_si128 ((const __m128i*) (y + x));
+            y0 = _mm_unpacklo_epi8 (luma, zero);
+            y1 = _mm_unpackhi_epi8 (luma, zero);
+
+            if (format == YUVConverter::nv12)
+            {
+                const __m128i uv = _mm_loadu_si128 ((const __m128i*) (u + x));
+                cu = _mm_and_si128 (uv, lowBytes);
+                cv = _mm_srli_epi16 (uv, 8);
+            }
+            else
+            {
+                cu = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i*) (u + x / 2)), zero);
+                cv = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i*) (v + x / 2)), zero);
+            }
+        }
+    }
+
+    /** Interleaves 16 pixels into four registers of PixelARGB, which is BGRA in memory on Intel. */
+    JUCE_YUV_TARGET ("sse2")
+    static forcedinline void interleaveSSE2 (__m128i r, __m128i g, __m128i b, __m128i* out) noexcept
+    {
+        const __m128i alpha = _mm_set1_epi8 ((char) 0xff);
+
+        const __m128i lo0 = _mm_unpacklo_epi8 (b, g),     hi0 = _mm_unpackhi_epi8 (b, g);
+        const __m128i lo1 = _mm_unpacklo_epi8 (r, alpha), hi1 = _mm_unpackhi_epi8 (r, alpha);
+
+        out[0] = _mm_unpacklo_epi16 (lo0, lo1);
+        out[1] = _mm_unpackhi_epi16 (lo0, lo1);
+        out[2] = _mm_unpacklo_epi16 (hi0, hi1);
+        out[3] = _mm_unpackhi_epi16 (hi0, hi1);
+    }
+
+    JUCE_YUV_TARGET ("sse2")
+    static forcedinline void store16SSE2 (PixelARGB* dest, __m128i r, __m128i g, __m128i b) noexcept
+    {
+        __m128i out[4];
+        interleaveSSE2 (r, g, b, out);
+
+        for (int i = 0; i < 4; ++i)
+            _mm_storeu_si128 (reinterpret_cast<__m128i*> (dest) + i, out[i]);
+    }
+
+    JUCE_YUV_TARGET ("sse2")
+    static forcedinline void store16SSE2 (PixelRGB* dest, __m128i r, __m128i g, __m128i b) noexcept
+    {
+        // without SSSE3 there's no cheap way to drop the alpha bytes
+        __m128i out[4];
+        interleaveSSE2 (r, g, b, out);
+        const PixelARGB* const argb = reinterpret_cast<const PixelARGB*> (out);
+
+        for (int i = 0; i < 16; ++i)
+            dest[i].set (argb[i]);
+    }
+
+    template <int format, class PixelType>
+    JUCE_YUV_TARGET ("sse2")
+    static void convertRowSSE2 (const uint8* y, const uint8* u, const uint8* v, uint8* dest, int width)
+    {
+        PixelType* const d = reinterpret_cast<PixelType*> (dest);
+        int x = 0;
+
+        for (; x <= width - 16; x += 16)
+        {
+            __m128i y0, y1, cu, cv, r, g, b;
+            load16SSE2<format> (y, u, v, x, y0, y1, cu, cv);
+            yuvToRGBSSE2 (y0, y1, cu, cv, r, g, b);
+            store16SSE2 (d + x, r, g, b);
+        }
+
+        convertRowScalarFrom<format, PixelType> (y, u, v, dest, x, width);
+    }
+   #endif
+
+   #if JUCE_YUV_USE_SSSE3
+    //==============================================================================
+    /** Packs four registers of PixelARGB into 48 bytes of PixelRGB. */
+    JUCE_YUV_TARGET ("ssse3")
+    static forcedinline void storeRGBSSSE3 (uint8* dest, __m128i p0, __m128i p1, __m128i p2, __m128i p3) noexcept
+    {
+        // the byte that each PixelRGB component comes from, within a PixelARGB
+        int source[3];
+        source[PixelRGB::indexR] = PixelARGB::indexR;
+        source[PixelRGB::indexG] = PixelARGB::indexG;
+        source[PixelRGB::indexB] = PixelARGB::indexB;
+
+        const __m128i mask = _mm_setr_epi8 ((char) (source[0]),      (char) (source[1]),      (char) (source[2]),
+                                            (char) (source[0] + 4),  (char) (source[1] + 4),  (char) (source[2] + 4),
+                                            (char) (source[0] + 8),  (char) (source[1] + 8),  (char) (source[2] + 8),
+                                            (char) (source[0] + 12), (char) (source[1] + 12), (char) (source[2] + 12),
+                                            -1, -1, -1, -1);
+
+        p0 = _mm_shuffle_epi8 (p0, mask);
+        p1 = _mm_shuffle_epi8 (p1, mask);
+        p2 = _mm_shuffle_epi8 (p2, mask);
+        p3 = _mm_shuffle_epi8 (p3, mask);
+
+        _mm_storeu_si128 ((__m128i*) dest,        _mm_or_si128 (p0, _mm_slli_si128 (p1, 12)));
+        _mm_storeu_si128 ((__m128i*) (dest + 16), _mm_or_si128 (_mm_srli_si128 (p1, 4), _mm_slli_si128 (p2, 8)));
+        _mm_storeu_si128 ((__m128i*) (dest + 32), _mm_or_si128 (_mm_srli_si128 (p2, 8), _mm_slli_si128 (p3, 4)));
+    }
+
+    template <int format>
+    JUCE_YUV_TARGET ("ssse3")
+    static void convertRowSSSE3 (const uint8* y, const uint8* u, const uint8* v, uint8* dest, int width)
+    {
+        int x = 0;
+
+        for (; x <= width - 16; x += 16)
+        {
+            __m128i y0, y1, cu, cv, r, g, b, out[4];
+            load16SSE2<format> (y, u, v, x, y0, y1, cu, cv);
+            yuvToRGBSSE2 (y0, y1, cu, cv, r, g, b);
+            interleaveSSE2 (r, g, b, out);
+            storeRGBSSSE3 (dest + 3 * x, out[0], out[1], out[2], out[3]);
+        }
+
+        convertRowScalarFrom<format, PixelRGB> (y, u, v, dest, x, width);
+    }
+   #endif
+
+   #if JUCE_YUV_USE_AVX2
+    //==============================================================================
+    JUCE_YUV_TARGET ("avx2")
+    static forcedinline __m256i scaleLumaAVX2 (__m256i y) noexcept
+    {
+        const __m256i d = _mm256_sub_epi16 (y, _mm256_set1_epi16 (16));
+        return _mm256_add_epi16 (_mm256_add_epi16 (_mm256_mullo_epi16 (d, _mm256_set1_epi16 (74)), _mm256_srai_epi16 (d, 1)),
+                                 _mm256_set1_epi16 (32));
+    }
+
+    /*  The same as yuvToRGBSSE2(), but for 32 pixels. AVX2 unpacks and packs work within
+        each 128-bit lane, so the chroma has to arrive with pairs 0-3 and 8-11 in the low
+        lane and 4-7 and 12-15 in the high one, and the results are put back into order
+        at the end.
+    */
+    JUCE_YUV_TARGET ("avx2")
+    static forcedinline void yuvToRGBAVX2 (__m256i y0, __m256i y1, __m256i u, __m256i v,
+                                           __m256i& r, __m256i& g, __m256i& b) noexcept
+    {
+        u = _mm256_sub_epi16 (u, _mm256_set1_epi16 (128));
+        v = _mm256_sub_epi16 (v, _mm256_set1_epi16 (128));
+
+        const __m256i rv  = _mm256_mullo_epi16 (v, _mm256_set1_epi16 (102));
+        const __m256i guv = _mm256_add_epi16 (_mm256_mullo_epi16 (u, _mm256_set1_epi16 (25)),
+                                              _mm256_mullo_epi16 (v, _mm256_set1_epi16 (52)));
+        const __m256i bu  = _mm256_mullo_epi16 (u, _mm256_set1_epi16 (129));
+
+        const __m256i c0 = scaleLumaAVX2 (y0);
+        const __m256i c1 = scaleLumaAVX2 (y1);
+
+        r = _mm256_packus_epi16 (_mm256_srai_epi16 (_mm256_adds_epi16 (c0, _mm256_unpacklo_epi16 (rv, rv)), 6),
+                                 _mm256_srai_epi16 (_mm256_adds_epi16 (c1, _mm256_unpackhi_epi16 (rv, rv)), 6));
+        g = _mm256_packus_epi16 (_mm256_srai_epi16 (_mm256_subs_epi16 (c0, _mm256_unpacklo_epi16 (guv, guv)), 6),
+                                 _mm256_srai_epi16 (_mm256_subs_epi16 (c1, _mm256_unpackhi_epi16 (guv, guv)), 6));
+        b = _mm256_packus_epi16 (_mm256_srai_epi16 (_mm256_adds_epi16 (c0, _mm256_unpacklo_epi16 (bu, bu)), 6),
+                                 _mm256_srai_epi16 (_mm256_adds_epi16 (c1, _mm256_unpackhi_epi16 (bu, bu)), 6));
+
+        r = _mm256_permute4x64_epi64 (r, 0xd8);
+        g = _mm256_permute4x64_epi64 (g, 0xd8);
+        b = _mm256_permute4x64_epi64 (b, 0xd8);
+    }
+
+    template <int format>
+    JUCE_YUV_TARGET ("avx2")
+    static forcedinline void load32AVX2 (const uint8* y, const uint8* u, const uint8* v, int x,
+                                         __m256i& y0, __m256i& y1, __m256i& cu, __m256i& cv) noexcept
+    {
+        const __m256i lowBytes = _mm256_set1_epi16 (0xff);
+
+        if (format == YUVConverter::yuyv || format == YUVConverter::uyvy)
+        {
+            const __m256i a = _mm256_loadu_si256 ((const __m256i*) (y + 2 * x));
+            const __m256i b = _mm256_loadu_si256 ((const __m256i*) (y + 2 * x + 32));
+            __m256i ca, cb;
+
+            if (format == YUVConverter::yuyv)
+            {
+                y0 = _mm256_and_si256 (a, lowBytes);    ca = _mm256_srli_epi16 (a, 8);
+                y1 = _mm256_and_si256 (b, lowBytes);    cb = _mm256_srli_epi16 (b, 8);
+            }
+            else
+            {
+                y0 = _mm256_srli_epi16 (a, 8);          ca = _mm256_and_si256 (a, lowBytes);
+                y1 = _mm256_srli_epi16 (b, 8);          cb = _mm256_and_si256 (b, lowBytes);
+            }
+
+            // packing within lanes leaves the chroma in the order yuvToRGBAVX2() wants
+            const __m256i uv = _mm256_packus_epi16 (ca, cb);
+            cu = _mm256_and_si256 (uv, lowBytes);
+            cv = _mm256_srli_epi16 (uv, 8);
+        }
+        else
+        {
+            y0 = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i*) (y + x)));
+            y1 = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i*) (y + x + 16)));
+
+            if (format == YUVConverter::nv12)
+            {
+                const __m256i uv = _mm256_loadu_si256 ((const __m256i*) (u + x));
+                cu = _mm256_and_si256 (uv, lowBytes);
+                cv = _mm256_srli_epi16 (uv, 8);
+            }
+            else
+            {
+                cu = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i*) (u + x / 2)));
+                cv = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i*) (v + x / 2)));
+            }
+
+            cu = _mm256_permute4x64_epi64 (cu, 0xd8);
+            cv = _mm256_permute4x64_epi64 (cv, 0xd8);
+        }
+    }
+
+    /** Interleaves 32 pixels into four registers of PixelARGB, in memory order. */
+    JUCE_YUV_TARGET ("avx2")
+    static forcedinline void interleaveAVX2 (__m256i r, __m256i g, __m256i b, __m256i* out) noexcept
+    {
+        const __m256i alpha = _mm256_set1_epi8 ((char) 0xff);
+
+        const __m256i lo0 = _mm256_unpacklo_epi8 (b, g),     hi0 = _mm256_unpackhi_epi8 (b, g);
+        const __m256i lo1 = _mm256_unpacklo_epi8 (r, alpha), hi1 = _mm256_unpackhi_epi8 (r, alpha);
+
+        // pixels 0-3 and 16-19, 4-7 and 20-23, 8-11 and 24-27, 12-15 and 28-31
+        const __m256i p0 = _mm256_unpacklo_epi16 (lo0, lo1);
+        const __m256i p1 = _mm256_unpackhi_epi16 (lo0, lo1);
+        const __m256i p2 = _mm256_unpacklo_epi16 (hi0, hi1);
+        const __m256i p3 = _mm256_unpackhi_epi16 (hi0, hi1);
+
+        out[0] = _mm256_permute2x128_si256 (p0, p1, 0x20);
+        out[1] = _mm256_permute2x128_si256 (p2, p3, 0x20);
+        out[2] = _mm256_permute2x128_si256 (p0, p1, 0x31);
+        out[3] = _mm256_permute2x128_si256 (p2, p3, 0x31);
+    }
+
+    template <int format>
+    JUCE_YUV_TARGET ("avx2")
+    static void convertRowAVX2ARGB (const uint8* y, const uint8* u, const uint8* v, uint8* dest, int width)
+    {
+        int x = 0;
+
+        for (; x <= width - 32; x += 32)
+        {
+            __m256i y0, y1, cu, cv, r, g, b, out[4];
+            load32AVX2<format> (y, u, v, x, y0, y1, cu, cv);
+            yuvToRGBAVX2 (y0, y1, cu, cv, r, g, b);
+            interleaveAVX2 (r, g, b, out);
+
+            __m256i* const d = reinterpret_cast<__m256i*> (dest + 4 * x);
+
+            for (int i = 0; i < 4; ++i)
+                _mm256_storeu_si256 (d + i, out[i]);
+        }
+
+        convertRowScalarFrom<format, PixelARGB> (y, u, v, dest, x, width);
+    }
+
+    template <int format>
+    JUCE_YUV_TARGET ("avx2")
+    static void convertRowAVX2RGB (const uint8* y, const uint8* u, const uint8* v, uint8* dest, int width)
+    {
+        int x = 0;
+
+        for (; x <= width - 32; x += 32)
+        {
+            __m256i y0, y1, cu, cv, r, g, b, out[4];
+            load32AVX2<format> (y, u, v, x, y0, y1, cu, cv);
+            yuvToRGBAVX2 (y0, y1, cu, cv, r, g, b);
+            interleaveAVX2 (r, g, b, out);
+
+            storeRGBSSSE3 (dest + 3 * x,
+                           _mm256_castsi256_si128 (out[0]), _mm256_extracti128_si256 (out[0], 1),
+                           _mm256_castsi256_si128 (out[1]), _mm256_extracti128_si256 (out[1], 1));
+            storeRGBSSSE3 (dest + 3 * x + 48,
+                           _mm256_castsi256_si128 (out[2]), _mm256_extracti128_si256 (out[2], 1),
+                           _mm256_castsi256_si128 (out[3]), _mm256_extracti128_si256 (out[3], 1));
+        }
+
+        convertRowScalarFrom<format, PixelRGB> (y, u, v, dest, x, width);
+    }
+   #endif
+
+    //==============================================================================
+    template <int format>
+    static RowFunction getRowFunction (YUVConverter::InstructionSet instructionSet, bool hasAlpha) noexcept
+    {
+        switch (instructionSet)
+        {
+           #if JUCE_YUV_USE_AVX2
+            case YUVConverter::avx2:    return hasAlpha ? convertRowAVX2ARGB<format> : convertRowAVX2RGB<format>;
+           #endif
+           #if JUCE_YUV_USE_SSSE3
+            // SSSE3 only helps with dropping the alpha bytes
+            case YUVConverter::ssse3:   return hasAlpha ? convertRowSSE2<format, PixelARGB> : convertRowSSSE3<format>;
+           #endif
+           #if JUCE_YUV_USE_SSE2
+            case YUVConverter::sse2:    return hasAlpha ? convertRowSSE2<format, PixelARGB> : convertRowSSE2<format, PixelRGB>;
+           #endif
+            default:                    return hasAlpha ? convertRowScalar<format, PixelARGB> : convertRowScalar<format, PixelRGB>;
+        }
+    }
+
+    static RowFunction getRowFunction (YUVConverter::Format format, YUVConverter::InstructionSet instructionSet, bool hasAlpha) noexcept
+    {
+        switch (format)
+        {
+            case YUVConverter::yuyv:    return getRowFunction<YUVConverter::yuyv> (instructionSet, hasAlpha);
+            case YUVConverter::uyvy:    return getRowFunction<YUVConverter::uyvy> (instructionSet, hasAlpha);
+            case YUVConverter::nv12:    return getRowFunction<YUVConverter::nv12> (instructionSet, hasAlpha);
+            default:                    return getRowFunction<YUVConverter::i420> (instructionSet, hasAlpha);
+        }
+    }
+
+    //==============================================================================
+    struct CPUFeatures
+    {
+        CPUFeatures() noexcept  : hasSSE2 (false), hasSSSE3 (false), hasAVX2 (false)
+        {
+           #if JUCE_YUV_USE_SSE2
+            int info[4] = { 0 };
+            callCPUID (info, 0);
+            const int maxLeaf = info[0];
+
+            callCPUID (info, 1);
+            hasSSE2  = (info[3] & (1 << 26)) != 0;
+            hasSSSE3 = (info[2] & (1 << 9)) != 0;
+
+            #if JUCE_YUV_USE_AVX2
+             // AVX needs the OS to save the upper halves of the registers on a context switch
+             const bool osSavesAVXState = (info[2] & (1 << 27)) != 0     // OSXSAVE
+                                           && (info[2] & (1 << 28)) != 0  // AVX
+                                           && (getXCR0() & 6) == 6;
+
+             if (maxLeaf >= 7 && osSavesAVXState)
+             {
+                 callCPUID (info, 7);
+                 hasAVX2 = (info[1] & (1 << 5)) != 0;
+             }
+            #else
+             (void) maxLeaf;
+            #endif
+           #endif
+        }
+
+        bool hasSSE2, hasSSSE3, hasAVX2;
+
+    private:
+       #if JUCE_YUV_USE_SSE2
+        static void callCPUID (int* info, int leaf) noexcept
+        {
+           #if JUCE_MSVC
+            __cpuidex (info, leaf, 0);
+           #else
+            unsigned int a, b, c, d;
+            __cpuid_count (leaf, 0, a, b, c, d);
+            info[0] = (int) a; info[1] = (int) b; info[2] = (int) c; info[3] = (int) d;
+           #endif
+        }
+       #endif
+
+       #if JUCE_YUV_USE_AVX2
+        static uint64 getXCR0() noexcept
+        {
+           #if JUCE_MSVC
+            return (uint64) _xgetbv (0);
+           #else
+            uint32 lo, hi;
+            __asm__ (".byte 0x0f, 0x01, 0xd0" : "=a" (lo), "=d" (hi) : "c" (0));  // xgetbv
+            return lo | ((uint64) hi << 32);
+           #endif
+        }
+       #endif
+    };
+
+    static const CPUFeatures& getCPUFeatures() noexcept
+    {
+        static CPUFeatures features;
+        return features;
+    }
+
+    //==============================================================================
+    struct BandConverter
+    {
+        BandConverter (const YUVConverter::Frame& f, const Image::BitmapData& d, YUVConverter::InstructionSet i)
+            : frame (f), dest (d), instructionSet (i)
+        {
+        }
+
+        void operator() (int startRow, int endRow) const
+        {
+            YUVConverter::convertRows (frame, dest, startRow, endRow - startRow, instructionSet);
+        }
+
+        const YUVConverter::Frame& frame;
+        const Image::BitmapData& dest;
+        const YUVConverter::InstructionSet instructionSet;
+    };
+}
+
+//==============================================================================
+YUVConverter::Frame::Frame (Format f, int w, int h, const void* data, int lineStride) noexcept
+    : format (f), width (w), height (h)
+{
+    jassert (f == yuyv || f == uyvy);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        planes[i] = static_cast<const uint8*> (data);
+        lineStrides[i] = lineStride;
+    }
+}
+
+YUVConverter::Frame::Frame (Format f, int w, int h,
+                            const void* yPlane, int yLineStride,
+                            const void* uPlane, int uLineStride,
+                            const void* vPlane, int vLineStride) noexcept
+    : format (f), width (w), height (h)
+{
+    jassert (f == nv12 || f == i420);
+
+    planes[0] = static_cast<const uint8*> (yPlane);
+    planes[1] = static_cast<const uint8*> (uPlane);
+    planes[2] = static_cast<const uint8*> (vPlane);
+    lineStrides[0] = yLineStride;
+    lineStrides[1] = uLineStride;
+    lineStrides[2] = vLineStride;
+}
+
+//==============================================================================
+bool YUVConverter::isAvailable (InstructionSet instructionSet) noexcept
+{
+    using namespace YUVConverterHelpers;
+
+    switch (instructionSet)
+    {
+        case scalar:        return true;
+        case sse2:          return getCPUFeatures().hasSSE2;
+        case ssse3:         return getCPUFeatures().hasSSE2 && getCPUFeatures().hasSSSE3;
+        case avx2:          return getCPUFeatures().hasAVX2;
+        case bestAvailable: return true;
+        default:            return false;
+    }
+}
+
+YUVConverter::InstructionSet YUVConverter::getBestInstructionSet() noexcept
+{
+    if (isAvailable (avx2))   return avx2;
+    if (isAvailable (ssse3))  return ssse3;
+    if (isAvailable (sse2))   return sse2;
+
+    return scalar;
+}
+
+const char* YUVConverter::getName (InstructionSet instructionSet) noexcept
+{
+    switch (instructionSet)
+    {
+        case scalar:        return "Scalar";
+        case sse2:          return "SSE2";
+        case ssse3:         return "SSSE3";
+        case avx2:          return "AVX2";
+        default:            return getName (getBestInstructionSet());
+    }
+}
+
+//==============================================================================
+void YUVConverter::convertRows (const Frame& source, const Image::BitmapData& dest,
+                                int startRow, int numRows, InstructionSet instructionSet)
+{
+    // An RGB image with a four byte stride is laid out the same as an ARGB one
+    jassert (dest.pixelFormat == Image::ARGB || dest.pixelFormat == Image::RGB);
+    jassert (dest.pixelStride == 3 || dest.pixelStride == 4);
+    jassert (dest.width >= source.width && dest.height >= source.height);
+
+    if (instructionSet == bestAvailable || ! isAvailable (instructionSet))
+    {
+        jassert (instructionSet == bestAvailable);  // you've asked for one that this CPU can't run
+        instructionSet = getBestInstructionSet();
+    }
+
+    const YUVConverterHelpers::RowFunction convertRow
+        = YUVConverterHelpers::getRowFunction (source.format, instructionSet, dest.pixelStride == 4);
+
+    const int endRow = jmin (startRow + numRows, source.height);
+
+    for (int row = jmax (0, startRow); row < endRow; ++row)
+    {
+        const uint8* const y = source.planes[0] + row * source.lineStrides[0];
+        const uint8* u = y;
+        const uint8* v = y;
+
+        if (source.format == nv12 || source.format == i420)
+        {
+            u = source.planes[1] + (row / 2) * source.lineStrides[1];
+            v = source.planes[2] + (row / 2) * source.lineStrides[2];
+        }
+
+        convertRow (y, u, v, dest.getLinePointer (row), source.width);
+    }
+}
+
+void YUVConverter::convert (const Frame& source, const Image::BitmapData& dest,
+                            ThreadPool* pool, InstructionSet instructionSet)
+{
+    // Bands of fewer rows than this aren't worth handing to another thread
+    const int minRowsPerBand = 32;
+    const int numBands = jmin (jmax (2, SystemStats::getNumCpus()), source.height / minRowsPerBand);
+
+    if (pool == nullptr || numBands <= 1)
+    {
+        convertRows (source, dest, 0, source.height, instructionSet);
+        return;
+    }
+
+    // an even number of rows per band keeps each pair of 4:2:0 rows together
+    const int rowsPerBand = ((source.height + numBands - 1) / numBands + 1) & ~1;
+
+    parallelFor (*pool, 0, source.height, YUVConverterHelpers::BandConverter (source, dest, instructionSet), rowsPerBand);
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class YUVConverterTests  : public UnitTest
+{
+public:
+    YUVConverterTests() : UnitTest ("YUVConverter") {}
+
+    /** Holds a frame of random data, with padding at the end of each line. */
+    struct TestFrame
+    {
+        TestFrame (YUVConverter::Format format, int w, int h, Random& random)
+        {
+            const int chromaWidth = (w + 1) / 2, chromaHeight = (h + 1) / 2;
+
+            switch (format)
+            {
+                case YUVConverter::yuyv:
+                case YUVConverter::uyvy:
+                    fill (planes[0], strides[0] = 4 * chromaWidth + 12, h, random);
+                    frame = new YUVConverter::Frame (format, w, h, planes[0], strides[0]);
+                    break;
+
+                case YUVConverter::nv12:
+                    fill (planes[0], strides[0] = w + 5, h, random);
+                    fill (planes[1], strides[1] = 2 * chromaWidth + 7, chromaHeight, random);
+                    frame = new YUVConverter::Frame (format, w, h, planes[0], strides[0], planes[1], strides[1], planes[1], strides[1]);
+                    break;
+
+                default:
+                    fill (planes[0], strides[0] = w + 3, h, random);
+                    fill (planes[1], strides[1] = chromaWidth + 9, chromaHeight, random);
+                    fill (planes[2], strides[2] = chromaWidth + 1, chromaHeight, random);
+                    frame = new YUVConverter::Frame (format, w, h, planes[0], strides[0], planes[1], strides[1], planes[2], strides[2]);
+                    break;
+            }
+        }
+
+        static void fill (HeapBlock<uint8>& plane, int stride, int numRows, Random& random)
+        {
+            plane.malloc ((size_t) (stride * numRows));
+
+            for (int i = 0; i < stride * numRows; ++i)
+                plane[i] = (uint8) random.nextInt (256);
+        }
+
+        HeapBlock<uint8> planes[3];
+        int strides[3];
+        ScopedPointer<YUVConverter::Frame> frame;
+    };
+
+    static Image convert (const YUVConverter::Frame& frame, Image::PixelFormat pixelFormat,
+                          ThreadPool* pool, YUVConverter::InstructionSet instructionSet)
+    {
+        Image image (pixelFormat, frame.width, frame.height, true, SoftwareImageType());
+
+        {
+            const Image::BitmapData data (image, Image::BitmapData::writeOnly);
+            YUVConverter::convert (frame, data, pool, instructionSet);
+        }
+
+        return image;
+    }
+
+    static bool imagesAreIdentical (const Image& a, const Image& b)
+    {
+        const Image::BitmapData da (a, Image::BitmapData::readOnly);
+        const Image::BitmapData db (b, Image::BitmapData::readOnly);
+
+        for (int y = 0; y < da.height; ++y)
+            if (memcmp (da.getLinePointer (y), db.getLinePointer (y), (size_t) (da.width * da.pixelStride)) != 0)
+                return false;
+
+        return true;
+    }
+
+    void expectColour (uint8 y, uint8 u, uint8 v, uint8 r, uint8 g, uint8 b)
+    {
+        const uint8 yuyv[] = { y, u, y, v };
+        const Image image (convert (YUVConverter::Frame (YUVConverter::yuyv, 2, 1, yuyv, 4),
+                                    Image::RGB, nullptr, YUVConverter::scalar));
+
+        const Colour c (image.getPixelAt (1, 0));
+        expect (c.getRed() == r && c.getGreen() == g && c.getBlue() == b, c.toDisplayString (false));
+    }
+
+    void runTest()
+    {
+        const YUVConverter::Format formats[] = { YUVConverter::yuyv, YUVConverter::uyvy, YUVConverter::nv12, YUVConverter::i420 };
+        const char* const formatNames[] = { "YUYV", "UYVY", "NV12", "I420" };
+
+        beginTest ("Reference colours");
+        {
+            expectColour (16, 128, 128, 0, 0, 0);
+            expectColour (235, 128, 128, 255, 255, 255);
+            expectColour (126, 128, 128, 128, 128, 128);
+            expectColour (81, 90, 240, 254, 0, 0);
+            expectColour (145, 54, 34, 0, 255, 1);
+            expectColour (41, 240, 110, 0, 0, 255);
+        }
+
+        beginTest ("SIMD output matches the scalar output");
+        {
+            Random random (0x5eed);
+            const int sizes[][2] = { { 70, 35 }, { 69, 12 }, { 33, 3 }, { 1, 1 }, { 257, 20 } };
+
+            for (int f = 0; f < numElementsInArray (formats); ++f)
+            {
+                for (int s = 0; s < numElementsInArray (sizes); ++s)
+                {
+                    const TestFrame test (formats[f], sizes[s][0], sizes[s][1], random);
+
+                    for (int p = 0; p < 2; ++p)
+                    {
+                        const Image::PixelFormat pixelFormat = p == 0 ? Image::ARGB : Image::RGB;
+                        const Image reference (convert (*test.frame, pixelFormat, nullptr, YUVConverter::scalar));
+
+                        for (int i = YUVConverter::sse2; i <= YUVConverter::avx2; ++i)
+                        {
+                            const YUVConverter::InstructionSet instructionSet = (YUVConverter::InstructionSet) i;
+
+                            if (YUVConverter::isAvailable (instructionSet))
+                                expect (imagesAreIdentical (reference, convert (*test.frame, pixelFormat, nullptr, instructionSet)),
+                                        String (formatNames[f]) + " " + String (sizes[s][0]) + "x" + String (sizes[s][1])
+                                          + (p == 0 ? " ARGB " : " RGB ") + YUVConverter::getName (instructionSet));
+                        }
+                    }
+                }
+            }
+        }
+
+        beginTest ("Threaded conversion");
+        {
+            Random random (0xba5e);
+            ThreadPool pool (3);
+
+            for (int f = 0; f < numElementsInArray (formats); ++f)
+            {
+                const TestFrame test (formats[f], 321, 243, random);
+                const Image reference (convert (*test.frame, Image::RGB, nullptr, YUVConverter::bestAvailable));
+
+                expect (imagesAreIdentical (reference, convert (*test.frame, Image::RGB, &pool, YUVConverter::bestAvailable)),
+                        formatNames[f]);
+            }
+        }
+
+        beginTest ("Benchmark");
+        {
+            Random random (0xfa57);
+            const int w = 1920, h = 1080, numRuns = 10;
+
+            for (int f = 0; f < numElementsInArray (formats); ++f)
+            {
+                const TestFrame test (formats[f], w, h, random);
+                Image image (Image::RGB, w, h, false, SoftwareImageType());
+                const Image::BitmapData data (image, Image::BitmapData::writeOnly);
+                String results;
+
+                for (int i = YUVConverter::scalar; i <= YUVConverter::avx2; ++i)
+                {
+                    const YUVConverter::InstructionSet instructionSet = (YUVConverter::InstructionSet) i;
+
+                    if (! YUVConverter::isAvailable (instructionSet))
+                        continue;
+
+                    const double start = Time::getMillisecondCounterHiRes();
+
+                    for (int run = 0; run < numRuns; ++run)
+                        YUVConverter::convert (*test.frame, data, nullptr, instructionSet);
+
+                    const double elapsed = (Time::getMillisecondCounterHiRes() - start) / 1000.0;
+                    results << "  " << YUVConverter::getName (instructionSet) << ": "
+                            << String (w * h * numRuns / (elapsed * 1000000.0), 1) << " MP/s";
+                }
+
+                logMessage (String (formatNames[f]) + " 1920x1080 to RGB:" + results);
+            }
+        }
+    }
+};
+
+static YUVConverterTests yuvConverterTests;
+
+#endif
@@ -0,0 +1,110 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2013 - Raw Material Software Ltd.
+
+   Permission is granted to use this software under the terms of either:
+   a) the GPL v2 (or any later version)
+   b) the Affero GPL v3
+
+   Details of these licenses can be found at: www.gnu.org/licenses
+
+   JUCE is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+   A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   ------------------------------------------------------------------------------
+
+   To release a closed-source product which uses JUCE, commercial licenses are
+   available: visit www.juce.com for more information.
+
+  ==============================================================================
+*/
+
+#ifndef JUCE_YUVCONVERTER_H_INCLUDED
+#define JUCE_YUVCONVERTER_H_INCLUDED
+
+
+//==============================================================================
+/**
+    Converts the YUV frames that cameras produce into RGB images.
+
+    The conversion uses BT.601 limited-range coefficients in 6-bit fixed point,
+    which is precise enough that every input comes out within one step of the
+    exact result, while leaving all the intermediate values small enough for
+    16-bit SIMD lanes. The SSE2, SSSE3 and AVX2 versions therefore produce
+    exactly the same bytes as the plain C++ one, and convert() just picks the
+    best one that the CPU supports.
+
+    Rows can also be split into bands and converted on a ThreadPool, which is
+    worth doing for HD frames.
+*/
+class JUCE_API  YUVConverter
+{
+public:
+    //==============================================================================
+    enum Format
+    {
+        yuyv,   /**< Packed 4:2:2, ordered Y0 U Y1 V. */
+        uyvy,   /**< Packed 4:2:2, ordered U Y0 V Y1. */
+        nv12,   /**< A plane of Y followed by a half-height plane of interleaved U and V. */
+        i420    /**< Separate planes of Y, U and V, with the chroma planes at half size. */
+    };
+
+    enum InstructionSet
+    {
+        scalar = 0,
+        sse2,
+        ssse3,
+        avx2,
+        bestAvailable
+    };
+
+    //==============================================================================
+    /** Describes where a frame's data lives. None of the data is copied. */
+    struct JUCE_API  Frame
+    {
+        /** A packed format, i.e. yuyv or uyvy. */
+        Frame (Format, int width, int height, const void* data, int lineStride) noexcept;
+
+        /** A planar format. For nv12, the U and V pointers and strides are both used for the interleaved plane. */
+        Frame (Format, int width, int height,
+               const void* yPlane, int yLineStride,
+               const void* uPlane, int uLineStride,
+               const void* vPlane, int vLineStride) noexcept;
+
+        Format format;
+        int width, height;
+        const uint8* planes[3];
+        int lineStrides[3];
+    };
+
+    //==============================================================================
+    /** Converts a frame into an RGB or ARGB image of at least the same size.
+
+        If a pool is supplied, the frame is split into bands of rows which are
+        converted by the pool's threads, and this waits for them all to finish.
+    */
+    static void convert (const Frame& source, const Image::BitmapData& dest,
+                         ThreadPool* pool = nullptr, InstructionSet = bestAvailable);
+
+    /** Converts a range of rows on the calling thread. */
+    static void convertRows (const Frame& source, const Image::BitmapData& dest,
+                             int startRow, int numRows, InstructionSet = bestAvailable);
+
+    //==============================================================================
+    /** True if this CPU can run the given instruction set's converters. */
+    static bool isAvailable (InstructionSet) noexcept;
+
+    /** Returns the fastest instruction set that's available. */
+    static InstructionSet getBestInstructionSet() noexcept;
+
+    static const char* getName (InstructionSet) noexcept;
+
+private:
+    YUVConverter() JUCE_DELETED_FUNCTION;
+};
+
+
+#endif   // JUCE_YUVCONVERTER_H_INCLUDED
@@ -97,6 +97,47 @@
  #if JUCE_DIRECTSHOW && JUCE_MSVC && ! JUCE_DONT_AUTOLINK_TO_WIN32_LIBRARIES
   #pragma comment (lib, "strmiids.lib")
  #endif
+
+//==============================================================================
+#elif JUCE_LINUX
+ #if JUCE_USE_CAMERA
+  #include <linux/videodev2.h>
+  #include <poll.h>
+ #endif
+#endif
+
+//==============================================================================
+#if JUCE_INTEL
+ // Older versions of GCC won't compile intrinsics for instruction sets that
+ // aren't enabled for the whole file.
+ #if JUCE_MSVC || JUCE_CLANG || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+  #define JUCE_YUV_USE_SSE2 1
+  #define JUCE_YUV_USE_SSSE3 1
+
+  #if ! (JUCE_MSVC && _MSC_VER < 1700)
+   #define JUCE_YUV_USE_AVX2 1
+  #endif
+ #elif defined (__SSE2__)
+  #define JUCE_YUV_USE_SSE2 1
+ #endif
+
+ #if JUCE_YUV_USE_SSE2
+  #include <emmintrin.h>
+
+  #if JUCE_MSVC
+   #include <intrin.h>
+  #else
+   #include <cpuid.h>
+  #endif
+ #endif
+
+ #if JUCE_YUV_USE_SSSE3
+  #include <tmmintrin.h>
+ #endif
+
+ #if JUCE_YUV_USE_AVX2
+  #include <immintrin.h>
+ #endif
 #endif
 
 //==============================================================================
@@ -105,6 +146,8 @@ using namespace juce;
 namespace juce
 {
 
+#include "capture/juce_YUVConverter.cpp"
+
 #if JUCE_MAC || JUCE_IOS
  #include "../juce_core/native/juce_osx_ObjCHelpers.h"
 
@@ -132,6 +175,9 @@ namespace juce
  #endif
 
 #elif JUCE_LINUX
+ #if JUCE_USE_CAMERA
+  #include "native/juce_linux_CameraDevice.cpp"
+ #endif
 
 #elif JUCE_ANDROID
  #if JUCE_USE_CAMERA
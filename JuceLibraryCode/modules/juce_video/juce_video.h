@@ -58,7 +58,7 @@
 #endif
 
 /** Config: JUCE_USE_CAMERA
-    Enables web-cam support using the CameraDevice class (Mac and Windows).
+    Enables web-cam support using the CameraDevice class (Mac, Windows and Linux).
 */
 #if (JUCE_QUICKTIME || JUCE_WINDOWS) && ! defined (JUCE_USE_CAMERA)
  #define JUCE_USE_CAMERA 0
@@ -66,6 +66,9 @@
 
 #if ! (JUCE_MAC || JUCE_WINDOWS)
  #undef JUCE_QUICKTIME
+#endif
+
+#if ! (JUCE_MAC || JUCE_WINDOWS || JUCE_LINUX)
  #undef JUCE_USE_CAMERA
 #endif
 
@@ -75,6 +78,7 @@ namespace juce
 
 #include "playback/juce_DirectShowComponent.h"
 #include "playback/juce_QuickTimeMovieComponent.h"
+#include "capture/juce_YUVConverter.h"
 #include "capture/juce_CameraDevice.h"
 
 }
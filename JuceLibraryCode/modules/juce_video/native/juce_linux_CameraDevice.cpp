@@ -0,0 +1,1245 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2013 - Raw Material Software Ltd.
+
+   Permission is granted to use this software under the terms of either:
+   a) the GPL v2 (or any later version)
+   b) the Affero GPL v3
+
+   Details of these licenses can be found at: www.gnu.org/licenses
+
+   JUCE is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+   A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   ------------------------------------------------------------------------------
+
+   To release a closed-source product which uses JUCE, commercial licenses are
+   available: visit www.juce.com for more information.
+
+  ==============================================================================
+*/
+
+/*  Setting this environment variable to the path of a file adds a fake camera to
+    the device list, which plays the file's frames at 30fps. The file can either
+    hold raw YUYV frames, in which case the size goes after the path, e.g.
+    "/tmp/frames.yuv:640x480", or be a .mjpeg file of concatenated JPEGs.
+*/
+#define JUCE_V4L2_FAKE_CAMERA_VARIABLE "JUCE_V4L2_FAKE_CAMERA"
+
+namespace V4L2Helpers
+{
+    static int xioctl (int fd, unsigned long request, void* arg) noexcept
+    {
+        int result;
+
+        do
+        {
+            result = ioctl (fd, request, arg);
+        }
+        while (result == -1 && errno == EINTR);
+
+        return result;
+    }
+
+    static int64 getMonotonicMilliseconds() noexcept
+    {
+        timespec t;
+        clock_gettime (CLOCK_MONOTONIC, &t);
+        return (int64) t.tv_sec * 1000 + t.tv_nsec / 1000000;
+    }
+
+    //==============================================================================
+    /*  Most webcams leave the Huffman tables out of their MJPEG frames, and expect
+        the decoder to use the standard ones from the JPEG spec, which our libjpeg
+        won't do. These are the same tables as jcparam.c's std_huff_tables().
+    */
+    static const uint8 bitsDCLuminance[16]   = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+    static const uint8 bitsDCChrominance[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+    static const uint8 valuesDC[12]          = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+    static const uint8 bitsACLuminance[16]   = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+    static const uint8 valuesACLuminance[162] =
+    {
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+        0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+        0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+        0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa
+    };
+
+    static const uint8 bitsACChrominance[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+    static const uint8 valuesACChrominance[162] =
+    {
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+        0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+        0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+        0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+        0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+        0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+        0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+        0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+        0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa
+    };
+
+    static void writeHuffmanTable (MemoryOutputStream& out, int tableClassAndIndex,
+                                   const uint8* bits, const uint8* values, size_t numValues)
+    {
+        out.writeByte ((char) tableClassAndIndex);
+        out.write (bits, 16);
+        out.write (values, numValues);
+    }
+
+    /** Returns a complete DHT segment holding the four standard tables. */
+    static MemoryBlock createStandardHuffmanTables()
+    {
+        MemoryOutputStream tables;
+        writeHuffmanTable (tables, 0x00, bitsDCLuminance,   valuesDC,            sizeof (valuesDC));
+        writeHuffmanTable (tables, 0x10, bitsACLuminance,   valuesACLuminance,   sizeof (valuesACLuminance));
+        writeHuffmanTable (tables, 0x01, bitsDCChrominance, valuesDC,            sizeof (valuesDC));
+        writeHuffmanTable (tables, 0x11, bitsACChrominance, valuesACChrominance, sizeof (valuesACChrominance));
+
+        MemoryOutputStream segment;
+        segment.writeByte ((char) 0xff);
+        segment.writeByte ((char) 0xc4);
+        segment.writeShortBigEndian ((short) (tables.getDataSize() + 2));
+        segment << tables;
+        return segment.getMemoryBlock();
+    }
+
+    /** Walks the JPEG's markers up to the start of the scan. If there's no DHT
+        segment before it, this returns the offset at which one should be inserted.
+    */
+    static size_t findMissingHuffmanTablePosition (const uint8* data, size_t numBytes) noexcept
+    {
+        size_t i = 2;   // skip the SOI marker
+
+        while (i + 4 <= numBytes && data[i] == 0xff)
+        {
+            const uint8 marker = data[i + 1];
+
+            if (marker == 0xc4)     return 0;   // DHT
+            if (marker == 0xda)     return i;   // SOS
+
+            if (marker == 0xff || marker == 0x01 || (marker >= 0xd0 && marker <= 0xd8))
+            {
+                i += (marker == 0xff) ? 1 : 2;
+                continue;
+            }
+
+            i += 2 + (size_t) ((data[i + 2] << 8) | data[i + 3]);
+        }
+
+        return 0;
+    }
+
+    /** Decodes an MJPEG frame. The data is only copied if Huffman tables need
+        adding to it, and then into the scratch block, which is kept between frames.
+    */
+    static Image decodeMJPEG (const uint8* data, size_t numBytes, MemoryBlock& scratch)
+    {
+        JPEGImageFormat jpeg;
+
+        if (const size_t insertPosition = findMissingHuffmanTablePosition (data, numBytes))
+        {
+            static const MemoryBlock standardTables (createStandardHuffmanTables());
+
+            const size_t totalSize = numBytes + standardTables.getSize();
+            scratch.ensureSize (totalSize);
+
+            uint8* const d = static_cast<uint8*> (scratch.getData());
+            memcpy (d, data, insertPosition);
+            memcpy (d + insertPosition, standardTables.getData(), standardTables.getSize());
+            memcpy (d + insertPosition + standardTables.getSize(), data + insertPosition, numBytes - insertPosition);
+
+            MemoryInputStream in (d, totalSize, false);
+            return jpeg.decodeImage (in);
+        }
+
+        MemoryInputStream in (data, numBytes, false);
+        return jpeg.decodeImage (in);
+    }
+}
+
+//==============================================================================
+/** Somewhere that frames come from: either a V4L2 device or a fake one backed by a file. */
+class V4L2FrameSource
+{
+public:
+    V4L2FrameSource() : width (0), height (0), bytesPerLine (0), pixelFormat (0) {}
+    virtual ~V4L2FrameSource() {}
+
+    virtual bool start() = 0;
+    virtual void stop() = 0;
+
+    /** Waits for the next frame. Its data stays valid until releaseFrame() is called. */
+    virtual bool waitForFrame (int timeoutMs, const uint8*& data, size_t& numBytes, Time& captureTime) = 0;
+    virtual void releaseFrame() = 0;
+
+    int width, height, bytesPerLine;
+    uint32 pixelFormat;     // V4L2_PIX_FMT_YUYV or V4L2_PIX_FMT_MJPEG
+
+private:
+    JUCE_DECLARE_NON_COPYABLE (V4L2FrameSource)
+};
+
+//==============================================================================
+/** Streams from a V4L2 device through a ring of memory-mapped driver buffers. */
+class V4L2DeviceSource  : public V4L2FrameSource
+{
+public:
+    V4L2DeviceSource (const String& devicePath)
+        : fd (::open (devicePath.toUTF8(), O_RDWR | O_NONBLOCK)), dequeuedIndex (-1), isStreaming (false)
+    {
+    }
+
+    ~V4L2DeviceSource()
+    {
+        stop();
+
+        for (int i = 0; i < buffers.size(); ++i)
+            munmap (buffers.getReference (i).start, buffers.getReference (i).length);
+
+        if (fd >= 0)
+        {
+            if (buffers.size() > 0)
+            {
+                v4l2_requestbuffers request;
+                zerostruct (request);
+                request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+                request.memory = V4L2_MEMORY_MMAP;
+                V4L2Helpers::xioctl (fd, VIDIOC_REQBUFS, &request);
+            }
+
+            ::close (fd);
+        }
+    }
+
+    bool open (int minWidth, int minHeight, int maxWidth, int maxHeight)
+    {
+        return fd >= 0
+                && selectFormat (minWidth, minHeight, maxWidth, maxHeight)
+                && mapBuffers();
+    }
+
+    bool start() override
+    {
+        if (isStreaming)
+            return true;
+
+        for (int i = 0; i < buffers.size(); ++i)
+            if (! queueBuffer (i))
+                return false;
+
+        int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        isStreaming = V4L2Helpers::xioctl (fd, VIDIOC_STREAMON, &type) == 0;
+        return isStreaming;
+    }
+
+    void stop() override
+    {
+        if (isStreaming)
+        {
+            // this also takes back all the buffers that the driver had queued
+            int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            V4L2Helpers::xioctl (fd, VIDIOC_STREAMOFF, &type);
+            isStreaming = false;
+            dequeuedIndex = -1;
+        }
+    }
+
+    bool waitForFrame (int timeoutMs, const uint8*& data, size_t& numBytes, Time& captureTime) override
+    {
+        jassert (dequeuedIndex < 0);
+
+        pollfd p;
+        p.fd = fd;
+        p.events = POLLIN;
+        p.revents = 0;
+
+        if (poll (&p, 1, timeoutMs) <= 0)
+            return false;
+
+        v4l2_buffer buffer;
+        zerostruct (buffer);
+        buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buffer.memory = V4L2_MEMORY_MMAP;
+
+        if (V4L2Helpers::xioctl (fd, VIDIOC_DQBUF, &buffer) != 0)
+            return false;
+
+        if ((buffer.flags & V4L2_BUF_FLAG_ERROR) != 0 || (int) buffer.index >= buffers.size())
+        {
+            queueBuffer ((int) buffer.index);
+            return false;
+        }
+
+        const int64 timestampMs = (int64) buffer.timestamp.tv_sec * 1000 + buffer.timestamp.tv_usec / 1000;
+
+        if ((buffer.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+            captureTime = Time::getCurrentTime() - RelativeTime::milliseconds (V4L2Helpers::getMonotonicMilliseconds() - timestampMs);
+        else
+            captureTime = Time (timestampMs);
+
+        dequeuedIndex = (int) buffer.index;
+        data = static_cast<const uint8*> (buffers.getReference (dequeuedIndex).start);
+        numBytes = buffer.bytesused;
+        return true;
+    }
+
+    void releaseFrame() override
+    {
+        if (dequeuedIndex >= 0)
+        {
+            queueBuffer (dequeuedIndex);
+            dequeuedIndex = -1;
+        }
+    }
+
+private:
+    struct MappedBuffer
+    {
+        void* start;
+        size_t length;
+    };
+
+    enum { numBuffersToRequest = 4 };
+
+    const int fd;
+    Array<MappedBuffer> buffers;
+    int dequeuedIndex;
+    bool isStreaming;
+
+    static bool isSupportedFormat (uint32 format) noexcept
+    {
+        return format == V4L2_PIX_FMT_YUYV || format == V4L2_PIX_FMT_MJPEG;
+    }
+
+    // Finds the biggest size within the limits. If the driver can't list its sizes,
+    // this asks for the maximum and lets VIDIOC_S_FMT pick the nearest.
+    void findLargestSize (uint32 format, int minWidth, int minHeight, int maxWidth, int maxHeight, int& w, int& h) const
+    {
+        w = h = 0;
+
+        for (uint32 i = 0;; ++i)
+        {
+            v4l2_frmsizeenum size;
+            zerostruct (size);
+            size.index = i;
+            size.pixel_format = format;
+
+            if (V4L2Helpers::xioctl (fd, VIDIOC_ENUM_FRAMESIZES, &size) != 0)
+            {
+                if (i == 0)
+                {
+                    w = maxWidth;
+                    h = maxHeight;
+                }
+
+                return;
+            }
+
+            if (size.type == V4L2_FRMSIZE_TYPE_DISCRETE)
+            {
+                const int sw = (int) size.discrete.width, sh = (int) size.discrete.height;
+
+                if (sw >= minWidth && sh >= minHeight && sw <= maxWidth && sh <= maxHeight && sw * sh > w * h)
+                {
+                    w = sw;
+                    h = sh;
+                }
+            }
+            else
+            {
+                w = jmin (maxWidth,  (int) size.stepwise.max_width);
+                h = jmin (maxHeight, (int) size.stepwise.max_height);
+
+                if (w < (int) size.stepwise.min_width || h < (int) size.stepwise.min_height)
+                    w = h = 0;
+
+                return;
+            }
+        }
+    }
+
+    bool selectFormat (int minWidth, int minHeight, int maxWidth, int maxHeight)
+    {
+        v4l2_capability caps;
+        zerostruct (caps);
+
+        if (V4L2Helpers::xioctl (fd, VIDIOC_QUERYCAP, &caps) != 0)
+            return false;
+
+        // Prefer YUYV, which needs no decoding, unless MJPEG allows a bigger picture
+        uint32 bestFormat = 0;
+        int bestWidth = 0, bestHeight = 0;
+
+        for (uint32 i = 0;; ++i)
+        {
+            v4l2_fmtdesc desc;
+            zerostruct (desc);
+            desc.index = i;
+            desc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+            if (V4L2Helpers::xioctl (fd, VIDIOC_ENUM_FMT, &desc) != 0)
+                break;
+
+            if (! isSupportedFormat (desc.pixelformat))
+                continue;
+
+            int w, h;
+            findLargestSize (desc.pixelformat, minWidth, minHeight, maxWidth, maxHeight, w, h);
+
+            if (w * h > bestWidth * bestHeight
+                 || (w * h == bestWidth * bestHeight && w > 0 && desc.pixelformat == V4L2_PIX_FMT_YUYV))
+            {
+                bestFormat = desc.pixelformat;
+                bestWidth = w;
+                bestHeight = h;
+            }
+        }
+
+        if (bestFormat == 0)
+            return false;
+
+        v4l2_format format;
+        zerostruct (format);
+        format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        format.fmt.pix.width = (uint32) bestWidth;
+        format.fmt.pix.height = (uint32) bestHeight;
+        format.fmt.pix.pixelformat = bestFormat;
+        format.fmt.pix.field = V4L2_FIELD_ANY;
+
+        if (V4L2Helpers::xioctl (fd, VIDIOC_S_FMT, &format) != 0 || ! isSupportedFormat (format.fmt.pix.pixelformat))
+            return false;
+
+        width = (int) format.fmt.pix.width;
+        height = (int) format.fmt.pix.height;
+        pixelFormat = format.fmt.pix.pixelformat;
+        bytesPerLine = jmax ((int) format.fmt.pix.bytesperline, width * 2);
+
+        DBG ("V4L2 camera: " + String (width) + "x" + String (height)
+               + (pixelFormat == V4L2_PIX_FMT_MJPEG ? " MJPEG" : " YUYV"));
+
+        return width > 0 && height > 0;
+    }
+
+    bool mapBuffers()
+    {
+        v4l2_requestbuffers request;
+        zerostruct (request);
+        request.count = numBuffersToRequest;
+        request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        request.memory = V4L2_MEMORY_MMAP;
+
+        if (V4L2Helpers::xioctl (fd, VIDIOC_REQBUFS, &request) != 0 || request.count < 2)
+            return false;
+
+        for (uint32 i = 0; i < request.count; ++i)
+        {
+            v4l2_buffer buffer;
+            zerostruct (buffer);
+            buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buffer.memory = V4L2_MEMORY_MMAP;
+            buffer.index = i;
+
+            if (V4L2Helpers::xioctl (fd, VIDIOC_QUERYBUF, &buffer) != 0)
+                return false;
+
+            MappedBuffer mapped;
+            mapped.length = buffer.length;
+            mapped.start = mmap (nullptr, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buffer.m.offset);
+
+            if (mapped.start == MAP_FAILED)
+                return false;
+
+            buffers.add (mapped);
+        }
+
+        return true;
+    }
+
+    bool queueBuffer (int index)
+    {
+        v4l2_buffer buffer;
+        zerostruct (buffer);
+        buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buffer.memory = V4L2_MEMORY_MMAP;
+        buffer.index = (uint32) index;
+
+        return V4L2Helpers::xioctl (fd, VIDIOC_QBUF, &buffer) == 0;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (V4L2DeviceSource)
+};
+
+//==============================================================================
+/** Plays frames from a memory-mapped file at 30fps, for testing without a camera. */
+class V4L2FileSource  : public V4L2FrameSource
+{
+public:
+    V4L2FileSource (const File& file, int frameWidth, int frameHeight)
+        : mappedFile (file, MemoryMappedFile::readOnly), nextFrame (0), nextFrameTime (0)
+    {
+        const uint8* const data = static_cast<const uint8*> (mappedFile.getData());
+        const size_t size = mappedFile.getSize();
+
+        if (data == nullptr)
+            return;
+
+        if (file.hasFileExtension ("mjpeg;mjpg"))
+        {
+            pixelFormat = V4L2_PIX_FMT_MJPEG;
+
+            // each frame runs from one SOI marker to the next
+            for (size_t i = 0; i + 1 < size; ++i)
+                if (data[i] == 0xff && data[i + 1] == 0xd8)
+                    frameOffsets.add (i);
+
+            if (frameOffsets.size() > 0)
+            {
+                MemoryBlock scratch;
+                const Image first (V4L2Helpers::decodeMJPEG (data, getFrameSize (0), scratch));
+                width = first.getWidth();
+                height = first.getHeight();
+            }
+        }
+        else if (frameWidth > 0 && frameHeight > 0)
+        {
+            pixelFormat = V4L2_PIX_FMT_YUYV;
+            width = frameWidth;
+            height = frameHeight;
+            bytesPerLine = width * 2;
+
+            const size_t frameSize = (size_t) (bytesPerLine * height);
+
+            for (size_t offset = 0; offset + frameSize <= size; offset += frameSize)
+                frameOffsets.add (offset);
+        }
+    }
+
+    bool isValid() const noexcept   { return frameOffsets.size() > 0 && width > 0 && height > 0; }
+
+    bool start() override
+    {
+        nextFrameTime = Time::getMillisecondCounter();
+        return true;
+    }
+
+    void stop() override {}
+
+    bool waitForFrame (int timeoutMs, const uint8*& data, size_t& numBytes, Time& captureTime) override
+    {
+        const int wait = (int) (nextFrameTime - Time::getMillisecondCounter());
+
+        if (wait > timeoutMs)
+        {
+            Thread::sleep (timeoutMs);
+            return false;
+        }
+
+        if (wait > 0)
+            Thread::sleep (wait);
+
+        nextFrameTime += 1000 / framesPerSecond;
+
+        const int index = nextFrame;
+        nextFrame = (nextFrame + 1) % frameOffsets.size();
+
+        data = static_cast<const uint8*> (mappedFile.getData()) + frameOffsets.getUnchecked (index);
+        numBytes = getFrameSize (index);
+        captureTime = Time::getCurrentTime();
+        return true;
+    }
+
+    void releaseFrame() override {}
+
+private:
+    enum { framesPerSecond = 30 };
+
+    MemoryMappedFile mappedFile;
+    Array<size_t> frameOffsets;
+    int nextFrame;
+    uint32 nextFrameTime;
+
+    size_t getFrameSize (int index) const noexcept
+    {
+        const size_t end = index + 1 < frameOffsets.size() ? frameOffsets.getUnchecked (index + 1)
+                                                           : (pixelFormat == V4L2_PIX_FMT_MJPEG ? mappedFile.getSize()
+                                                                                                : frameOffsets.getUnchecked (index) + (size_t) (bytesPerLine * height));
+        return end - frameOffsets.getUnchecked (index);
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (V4L2FileSource)
+};
+
+//==============================================================================
+struct V4L2DeviceInfo
+{
+    String name, path;
+    bool isFake;
+};
+
+struct V4L2DeviceNodeSorter
+{
+    static int compareElements (const File& a, const File& b) noexcept
+    {
+        return a.getFileName().getTrailingIntValue() - b.getFileName().getTrailingIntValue();
+    }
+};
+
+static Array<V4L2DeviceInfo> findV4L2Devices()
+{
+    Array<V4L2DeviceInfo> devices;
+
+    Array<File> nodes;
+    File ("/dev").findChildFiles (nodes, File::findFiles, false, "video*");
+
+    V4L2DeviceNodeSorter sorter;
+    nodes.sort (sorter);
+
+    for (int i = 0; i < nodes.size(); ++i)
+    {
+        const String path (nodes.getReference (i).getFullPathName());
+        const int fd = ::open (path.toUTF8(), O_RDWR | O_NONBLOCK);
+
+        if (fd < 0)
+            continue;
+
+        v4l2_capability caps;
+        zerostruct (caps);
+
+        if (V4L2Helpers::xioctl (fd, VIDIOC_QUERYCAP, &caps) == 0)
+        {
+            // newer drivers also create nodes for metadata, which only show up in device_caps
+            const uint32 deviceCaps = (caps.capabilities & V4L2_CAP_DEVICE_CAPS) != 0 ? caps.device_caps
+                                                                                     : caps.capabilities;
+
+            if ((deviceCaps & V4L2_CAP_VIDEO_CAPTURE) != 0 && (deviceCaps & V4L2_CAP_STREAMING) != 0)
+            {
+                V4L2DeviceInfo info;
+                info.name = String (CharPointer_UTF8 ((const char*) caps.card));
+                info.path = path;
+                info.isFake = false;
+                devices.add (info);
+            }
+        }
+
+        ::close (fd);
+    }
+
+    const String fakeCamera (SystemStats::getEnvironmentVariable (JUCE_V4L2_FAKE_CAMERA_VARIABLE, String::empty));
+
+    if (fakeCamera.isNotEmpty())
+    {
+        V4L2DeviceInfo info;
+        info.name = "File camera (" + File (fakeCamera.upToFirstOccurrenceOf (":", false, false)).getFileName() + ")";
+        info.path = fakeCamera;
+        info.isFake = true;
+        devices.add (info);
+    }
+
+    return devices;
+}
+
+//==============================================================================
+class V4L2CameraDeviceInternal  : public ChangeBroadcaster,
+                                  private Thread
+{
+public:
+    V4L2CameraDeviceInternal (const V4L2DeviceInfo& info,
+                              int minWidth, int minHeight,
+                              int maxWidth, int maxHeight)
+        : Thread ("V4L2 camera"),
+          ok (false), width (0), height (0),
+          activeUsers (0), imageNeedsFlipping (false),
+          recordNextFrameTime (false), recordingQuality (2)
+    {
+        if (info.isFake)
+        {
+            const String path (info.path.upToFirstOccurrenceOf (":", false, false));
+            const String size (info.path.fromFirstOccurrenceOf (":", false, false));
+
+            ScopedPointer<V4L2FileSource> fileSource (new V4L2FileSource (File (path),
+                                                                          size.upToFirstOccurrenceOf ("x", false, true).getIntValue(),
+                                                                          size.fromFirstOccurrenceOf ("x", false, true).getIntValue()));
+            if (fileSource->isValid())
+                source = fileSource.release();
+        }
+        else
+        {
+            ScopedPointer<V4L2DeviceSource> deviceSource (new V4L2DeviceSource (info.path));
+
+            if (deviceSource->open (minWidth, minHeight, maxWidth, maxHeight))
+                source = deviceSource.release();
+        }
+
+        if (source != nullptr)
+        {
+            width = source->width;
+            height = source->height;
+            activeImage = Image (Image::RGB, width, height, true);
+            loadingImage = Image (Image::RGB, width, height, true);
+
+            // HD frames are converted in bands, so that they keep up with the camera
+            if (source->pixelFormat == V4L2_PIX_FMT_YUYV && width * height >= 1280 * 720
+                 && SystemStats::getNumCpus() > 1)
+                conversionPool = new ThreadPool (jmin (4, SystemStats::getNumCpus() - 1));
+
+            ok = true;
+        }
+    }
+
+    ~V4L2CameraDeviceInternal()
+    {
+        stopThread (2000);
+
+        for (int i = viewerComps.size(); --i >= 0;)
+            viewerComps.getUnchecked(i)->ownerDeleted();
+    }
+
+    void addUser()
+    {
+        const ScopedLock sl (userLock);
+
+        if (ok && activeUsers++ == 0)
+            startThread (8);
+    }
+
+    void removeUser()
+    {
+        const ScopedLock sl (userLock);
+
+        if (ok && --activeUsers == 0)
+            stopThread (2000);
+    }
+
+    void drawCurrentImage (Graphics& g, int x, int y, int w, int h)
+    {
+        if (imageNeedsFlipping)
+        {
+            const ScopedLock sl (imageSwapLock);
+            std::swap (loadingImage, activeImage);
+            imageNeedsFlipping = false;
+        }
+
+        RectanglePlacement rp (RectanglePlacement::centred);
+        double dx = 0, dy = 0, dw = width, dh = height;
+        rp.applyTo (dx, dy, dw, dh, x, y, w, h);
+        const int rx = roundToInt (dx), ry = roundToInt (dy);
+        const int rw = roundToInt (dw), rh = roundToInt (dh);
+
+        {
+            Graphics::ScopedSaveState ss (g);
+
+            g.excludeClipRegion (Rectangle<int> (rx, ry, rw, rh));
+            g.fillAll (Colours::black);
+        }
+
+        g.drawImage (activeImage, rx, ry, rw, rh, 0, 0, width, height);
+    }
+
+    //==============================================================================
+    // Recordings are Motion JPEG streams: MJPEG frames are written as they are,
+    // and YUYV ones are compressed first.
+    bool startRecording (const File& file, int quality)
+    {
+        const ScopedLock sl (recordingLock);
+
+        file.deleteFile();
+        recordingStream = file.createOutputStream();
+        recordingQuality = quality;
+        firstRecordedTime = Time();
+        recordNextFrameTime = true;
+
+        return recordingStream != nullptr;
+    }
+
+    void stopRecording()
+    {
+        const ScopedLock sl (recordingLock);
+        recordingStream = nullptr;
+    }
+
+    //==============================================================================
+    void addListener (CameraDevice::Listener* listenerToAdd)
+    {
+        bool isFirst;
+
+        {
+            const ScopedLock sl (listenerLock);
+            isFirst = listeners.size() == 0;
+            listeners.addIfNotAlreadyThere (listenerToAdd);
+        }
+
+        if (isFirst)
+            addUser();
+    }
+
+    void removeListener (CameraDevice::Listener* listenerToRemove)
+    {
+        bool wasLast;
+
+        {
+            const ScopedLock sl (listenerLock);
+            const int oldSize = listeners.size();
+            listeners.removeFirstMatchingValue (listenerToRemove);
+            wasLast = oldSize > 0 && listeners.size() == 0;
+        }
+
+        // stop the thread outside the lock, as it might be waiting for it to call the listeners
+        if (wasLast)
+            removeUser();
+    }
+
+    //==============================================================================
+    class V4L2CaptureViewerComp   : public Component,
+                                    public ChangeListener
+    {
+    public:
+        V4L2CaptureViewerComp (V4L2CameraDeviceInternal* const owner_)
+            : owner (owner_), maxFPS (30), lastRepaintTime (0)
+        {
+            setOpaque (true);
+            owner->addChangeListener (this);
+            owner->addUser();
+            owner->viewerComps.add (this);
+            setSize (owner->width, owner->height);
+        }
+
+        ~V4L2CaptureViewerComp()
+        {
+            if (owner != nullptr)
+            {
+                owner->viewerComps.removeFirstMatchingValue (this);
+                owner->removeUser();
+                owner->removeChangeListener (this);
+            }
+        }
+
+        void ownerDeleted()
+        {
+            owner = nullptr;
+        }
+
+        void paint (Graphics& g) override
+        {
+            g.setColour (Colours::black);
+            g.setImageResamplingQuality (Graphics::lowResamplingQuality);
+
+            if (owner != nullptr)
+                owner->drawCurrentImage (g, 0, 0, getWidth(), getHeight());
+            else
+                g.fillAll (Colours::black);
+        }
+
+        void changeListenerCallback (ChangeBroadcaster*) override
+        {
+            const int64 now = Time::currentTimeMillis();
+
+            if (now >= lastRepaintTime + (1000 / maxFPS))
+            {
+                lastRepaintTime = now;
+                repaint();
+            }
+        }
+
+    private:
+        V4L2CameraDeviceInternal* owner;
+        int maxFPS;
+        int64 lastRepaintTime;
+    };
+
+    //==============================================================================
+    bool ok;
+    int width, height;
+    Time firstRecordedTime;
+
+    Array<V4L2CaptureViewerComp*> viewerComps;
+
+private:
+    ScopedPointer<V4L2FrameSource> source;
+    CriticalSection userLock;
+    int activeUsers;
+
+    CriticalSection imageSwapLock;
+    bool imageNeedsFlipping;
+    Image loadingImage;
+    Image activeImage;
+    MemoryBlock jpegScratch;
+    ScopedPointer<ThreadPool> conversionPool;
+
+    CriticalSection recordingLock;
+    ScopedPointer<FileOutputStream> recordingStream;
+    bool recordNextFrameTime;
+    int recordingQuality;
+
+    Array<CameraDevice::Listener*> listeners;
+    CriticalSection listenerLock;
+
+    void run() override
+    {
+        if (! source->start())
+        {
+            DBG ("Couldn't start the V4L2 capture stream");
+            return;
+        }
+
+        while (! threadShouldExit())
+        {
+            const uint8* data;
+            size_t numBytes;
+            Time captureTime;
+
+            if (source->waitForFrame (100, data, numBytes, captureTime))
+            {
+                handleFrame (data, numBytes, captureTime);
+                source->releaseFrame();
+            }
+        }
+
+        source->stop();
+    }
+
+    void handleFrame (const uint8* data, size_t numBytes, Time captureTime)
+    {
+        {
+            const ScopedLock sl (imageSwapLock);
+
+            if (source->pixelFormat == V4L2_PIX_FMT_MJPEG)
+            {
+                const Image decoded (V4L2Helpers::decodeMJPEG (data, numBytes, jpegScratch));
+
+                if (! decoded.isValid())
+                    return;
+
+                loadingImage = decoded;
+            }
+            else
+            {
+                if (numBytes < (size_t) (source->bytesPerLine * height))
+                    return;
+
+                const Image::BitmapData destData (loadingImage, 0, 0, width, height, Image::BitmapData::writeOnly);
+                YUVConverter::convert (YUVConverter::Frame (YUVConverter::yuyv, width, height, data, source->bytesPerLine),
+                                       destData, conversionPool);
+            }
+
+            imageNeedsFlipping = true;
+        }
+
+        recordFrame (data, numBytes, captureTime);
+        callListeners (loadingImage);
+
+        if (viewerComps.size() > 0)
+            sendChangeMessage();
+    }
+
+    void recordFrame (const uint8* data, size_t numBytes, Time captureTime)
+    {
+        const ScopedLock sl (recordingLock);
+
+        if (recordingStream == nullptr)
+            return;
+
+        if (recordNextFrameTime)
+        {
+            firstRecordedTime = captureTime;
+            recordNextFrameTime = false;
+        }
+
+        if (source->pixelFormat == V4L2_PIX_FMT_MJPEG)
+        {
+            recordingStream->write (data, numBytes);
+        }
+        else
+        {
+            const float qualities[] = { 0.5f, 0.7f, 0.9f };
+
+            JPEGImageFormat jpeg;
+            jpeg.setQuality (qualities [jlimit (0, numElementsInArray (qualities) - 1, recordingQuality)]);
+            jpeg.writeImageToStream (loadingImage, *recordingStream);
+        }
+    }
+
+    void callListeners (const Image& image)
+    {
+        const ScopedLock sl (listenerLock);
+
+        for (int i = listeners.size(); --i >= 0;)
+            if (CameraDevice::Listener* const l = listeners[i])
+                l->imageReceived (image);
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (V4L2CameraDeviceInternal)
+};
+
+
+//==============================================================================
+CameraDevice::CameraDevice (const String& nm, int /*index*/)
+    : internal (nullptr), isRecording (false), name (nm)
+{
+}
+
+CameraDevice::~CameraDevice()
+{
+    stopRecording();
+    delete static_cast <V4L2CameraDeviceInternal*> (internal);
+    internal = nullptr;
+}
+
+Component* CameraDevice::createViewerComponent()
+{
+    return new V4L2CameraDeviceInternal::V4L2CaptureViewerComp (static_cast <V4L2CameraDeviceInternal*> (internal));
+}
+
+String CameraDevice::getFileExtension()
+{
+    return ".mjpeg";
+}
+
+void CameraDevice::startRecordingToFile (const File& file, int quality)
+{
+    stopRecording();
+
+    V4L2CameraDeviceInternal* const d = static_cast <V4L2CameraDeviceInternal*> (internal);
+    d->addUser();
+    isRecording = d->startRecording (file, quality);
+
+    if (! isRecording)
+        d->removeUser();
+}
+
+Time CameraDevice::getTimeOfFirstRecordedFrame() const
+{
+    V4L2CameraDeviceInternal* const d = static_cast <V4L2CameraDeviceInternal*> (internal);
+    return d->firstRecordedTime;
+}
+
+void CameraDevice::stopRecording()
+{
+    if (isRecording)
+    {
+        V4L2CameraDeviceInternal* const d = static_cast <V4L2CameraDeviceInternal*> (internal);
+        d->stopRecording();
+        d->removeUser();
+        isRecording = false;
+    }
+}
+
+void CameraDevice::addListener (Listener* listenerToAdd)
+{
+    V4L2CameraDeviceInternal* const d = static_cast <V4L2CameraDeviceInternal*> (internal);
+
+    if (listenerToAdd != nullptr)
+        d->addListener (listenerToAdd);
+}
+
+void CameraDevice::removeListener (Listener* listenerToRemove)
+{
+    V4L2CameraDeviceInternal* const d = static_cast <V4L2CameraDeviceInternal*> (internal);
+
+    if (listenerToRemove != nullptr)
+        d->removeListener (listenerToRemove);
+}
+
+//==============================================================================
+StringArray CameraDevice::getAvailableDevices()
+{
+    const Array<V4L2DeviceInfo> devices (findV4L2Devices());
+
+    StringArray names;
+
+    for (int i = 0; i < devices.size(); ++i)
+        names.add (devices.getReference (i).name);
+
+    return names;
+}
+
+CameraDevice* CameraDevice::openDevice (int index,
+                                        int minWidth, int minHeight,
+                                        int maxWidth, int maxHeight)
+{
+    const Array<V4L2DeviceInfo> devices (findV4L2Devices());
+
+    if (! isPositiveAndBelow (index, devices.size()))
+        return nullptr;
+
+    const V4L2DeviceInfo& info = devices.getReference (index);
+    ScopedPointer <CameraDevice> cam (new CameraDevice (info.name, index));
+
+    V4L2CameraDeviceInternal* const intern
+        = new V4L2CameraDeviceInternal (info, minWidth, minHeight, maxWidth, maxHeight);
+    cam->internal = intern;
+
+    if (intern->ok)
+        return cam.release();
+
+    return nullptr;
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class V4L2CameraDeviceTests  : public UnitTest
+{
+public:
+    V4L2CameraDeviceTests() : UnitTest ("V4L2 CameraDevice") {}
+
+    struct FrameCounter  : public CameraDevice::Listener
+    {
+        FrameCounter() : numFrames (0) {}
+
+        void imageReceived (const Image& image) override
+        {
+            lastColour = image.getPixelAt (image.getWidth() / 2, image.getHeight() / 2);
+            ++numFrames;
+        }
+
+        Atomic<int> numFrames;
+        Colour lastColour;
+    };
+
+    void expectPixel (const uint8* yuyv, uint8 r, uint8 g, uint8 b)
+    {
+        Image image (Image::RGB, 2, 1, true);
+
+        {
+            const Image::BitmapData data (image, Image::BitmapData::writeOnly);
+            YUVConverter::convert (YUVConverter::Frame (YUVConverter::yuyv, 2, 1, yuyv, 4), data);
+        }
+
+        const Colour c (image.getPixelAt (1, 0));
+        expect (std::abs (c.getRed() - r) <= 1 && std::abs (c.getGreen() - g) <= 1 && std::abs (c.getBlue() - b) <= 1,
+                c.toDisplayString (false));
+    }
+
+    void runTest()
+    {
+        beginTest ("YUYV conversion");
+        {
+            const uint8 black[] = { 16, 128, 16, 128 };
+            const uint8 white[] = { 235, 128, 235, 128 };
+            const uint8 red[]   = { 81, 90, 81, 240 };
+            const uint8 blue[]  = { 41, 240, 41, 110 };
+
+            expectPixel (black, 0, 0, 0);
+            expectPixel (white, 255, 255, 255);
+            expectPixel (red, 255, 0, 0);
+            expectPixel (blue, 0, 0, 255);
+        }
+
+        beginTest ("Huffman tables are added to MJPEG frames without them");
+        {
+            const MemoryBlock tables (V4L2Helpers::createStandardHuffmanTables());
+            expectEquals ((int) tables.getSize(), 2 + 0x1a2);
+
+            Image image (Image::RGB, 32, 16, true);
+            image.clear (image.getBounds(), Colours::orange);
+
+            MemoryOutputStream jpegData;
+            JPEGImageFormat().writeImageToStream (image, jpegData);
+
+            // frames that have their own tables are left alone
+            const uint8* const data = static_cast<const uint8*> (jpegData.getData());
+            expectEquals ((int) V4L2Helpers::findMissingHuffmanTablePosition (data, jpegData.getDataSize()), 0);
+
+            MemoryBlock scratch;
+            const Image decoded (V4L2Helpers::decodeMJPEG (data, jpegData.getDataSize(), scratch));
+            expect (decoded.getWidth() == 32 && decoded.getHeight() == 16);
+            expectEquals ((int) scratch.getSize(), 0);
+
+            // a 32x16 orange frame encoded with the standard tables and then stripped of
+            // its DHT segments, as a webcam sends them
+            static const uint8 mjpegFrame[] =
+            {
+                0xff, 0xd8, 0xff, 0xdb, 0x00, 0x43, 0x00, 0x10, 0x0b, 0x0c, 0x0e, 0x0c, 0x0a, 0x10, 0x0e, 0x0d,
+                0x0e, 0x12, 0x11, 0x10, 0x13, 0x18, 0x28, 0x1a, 0x18, 0x16, 0x16, 0x18, 0x31, 0x23, 0x25, 0x1d,
+                0x28, 0x3a, 0x33, 0x3d, 0x3c, 0x39, 0x33, 0x38, 0x37, 0x40, 0x48, 0x5c, 0x4e, 0x40, 0x44, 0x57,
+                0x45, 0x37, 0x38, 0x50, 0x6d, 0x51, 0x57, 0x5f, 0x62, 0x67, 0x68, 0x67, 0x3e, 0x4d, 0x71, 0x79,
+                0x70, 0x64, 0x78, 0x5c, 0x65, 0x67, 0x63, 0xff, 0xdb, 0x00, 0x43, 0x01, 0x11, 0x12, 0x12, 0x18,
+                0x15, 0x18, 0x2f, 0x1a, 0x1a, 0x2f, 0x63, 0x42, 0x38, 0x42, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+                0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+                0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+                0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0xff, 0xc0, 0x00, 0x11,
+                0x08, 0x00, 0x10, 0x00, 0x20, 0x03, 0x01, 0x22, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01, 0xff,
+                0xda, 0x00, 0x0c, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3f, 0x00, 0xd7, 0xa2, 0x8a,
+                0x2b, 0xe4, 0x4f, 0x6c, 0x28, 0xa2, 0x8a, 0x00, 0xff, 0xd9
+            };
+
+            const size_t insertPosition = V4L2Helpers::findMissingHuffmanTablePosition (mjpegFrame, sizeof (mjpegFrame));
+            expect (insertPosition > 2 && mjpegFrame[insertPosition] == 0xff && mjpegFrame[insertPosition + 1] == 0xda);
+
+            const Image repaired (V4L2Helpers::decodeMJPEG (mjpegFrame, sizeof (mjpegFrame), scratch));
+            expect (scratch.getSize() >= sizeof (mjpegFrame) + tables.getSize());
+            expect (memcmp (static_cast<const uint8*> (scratch.getData()) + insertPosition, tables.getData(), tables.getSize()) == 0);
+            expect (repaired.getWidth() == 32 && repaired.getHeight() == 16);
+
+            const Colour pixel (repaired.getPixelAt (16, 8));
+            expect (std::abs (pixel.getRed()   - Colours::orange.getRed())   < 8
+                     && std::abs (pixel.getGreen() - Colours::orange.getGreen()) < 8
+                     && std::abs (pixel.getBlue()  - Colours::orange.getBlue())  < 8);
+        }
+
+        beginTest ("File camera");
+        {
+            const int w = 64, h = 48;
+            TemporaryFile temp (".yuv");
+
+            {
+                // three frames of mid-grey
+                HeapBlock<uint8> frame ((size_t) (w * h * 2));
+
+                for (int i = 0; i < w * h * 2; i += 2)
+                {
+                    frame[i] = 126;
+                    frame[i + 1] = 128;
+                }
+
+                FileOutputStream out (temp.getFile());
+
+                for (int i = 0; i < 3; ++i)
+                    out.write (frame, (size_t) (w * h * 2));
+            }
+
+            setenv (JUCE_V4L2_FAKE_CAMERA_VARIABLE, (temp.getFile().getFullPathName() + ":64x48").toRawUTF8(), 1);
+
+            const StringArray devices (CameraDevice::getAvailableDevices());
+            const int index = devices.indexOf ("File camera (" + temp.getFile().getFileName() + ")");
+            expect (index >= 0);
+
+            ScopedPointer<CameraDevice> camera (CameraDevice::openDevice (index));
+            expect (camera != nullptr);
+
+            if (camera != nullptr)
+            {
+                FrameCounter counter;
+                camera->addListener (&counter);
+
+                for (int i = 0; i < 100 && counter.numFrames.get() < 5; ++i)
+                    Thread::sleep (20);
+
+                camera->removeListener (&counter);
+
+                expect (counter.numFrames.get() >= 5);
+                expect (std::abs (counter.lastColour.getRed() - 128) <= 1 && counter.lastColour.getRed() == counter.lastColour.getBlue());
+            }
+
+            unsetenv (JUCE_V4L2_FAKE_CAMERA_VARIABLE);
+        }
+    }
+};
+
+static V4L2CameraDeviceTests v4l2CameraDeviceTests;
+
+#endif
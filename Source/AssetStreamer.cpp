@@ -0,0 +1,445 @@
+/*
+  ==============================================================================
+
+    AssetStreamer.cpp
+
+  ==============================================================================
+*/
+
+#include "AssetStreamer.h"
+
+//==============================================================================
+StreamedAsset::StreamedAsset()
+    : streamer (nullptr), state ((int) waiting), loadResult (Result::ok())
+{
+}
+
+StreamedAsset::~StreamedAsset()
+{
+}
+
+void StreamedAsset::requestUpload()
+{
+    if (streamer != nullptr)
+        streamer->queueForUpload (this);
+}
+
+//==============================================================================
+StreamedTexture::StreamedTexture (const File& imageFile)
+    : file (imageFile), sourceData (nullptr), sourceSize (0),
+      width (0), height (0), textureID (0), textureWidth (0), textureHeight (0), nextRowToUpload (0)
+{
+}
+
+StreamedTexture::StreamedTexture (const void* imageData, size_t numBytes)
+    : sourceData (imageData), sourceSize (numBytes),
+      width (0), height (0), textureID (0), textureWidth (0), textureHeight (0), nextRowToUpload (0)
+{
+}
+
+StreamedTexture::StreamedTexture()
+    : sourceData (nullptr), sourceSize (0),
+      width (0), height (0), textureID (0), textureWidth (0), textureHeight (0), nextRowToUpload (0)
+{
+}
+
+StreamedTexture::~StreamedTexture()
+{
+    // the texture must be deleted on the GL thread, by AssetStreamer::releaseGLResources()
+    // or by the streamer letting go of it
+    jassert (textureID == 0);
+}
+
+Result StreamedTexture::load()
+{
+    Image image;
+
+    if (sourceData != nullptr)
+        image = ImageFileFormat::loadFrom (sourceData, sourceSize);
+    else if (file != File::nonexistent)
+        image = ImageFileFormat::loadFrom (file);
+    else
+        return Result::ok();    // the image will come from setImage()
+
+    if (! image.isValid())
+        return Result::fail ("Couldn't load the image " + file.getFileName());
+
+    setPixels (image);
+    return Result::ok();
+}
+
+void StreamedTexture::setImage (const Image& image)
+{
+    setPixels (image);
+    requestUpload();
+}
+
+void StreamedTexture::setPixels (const Image& source)
+{
+    Image image (source.convertedToFormat (Image::ARGB));
+
+    if (! (isPowerOfTwo (image.getWidth()) && isPowerOfTwo (image.getHeight())
+            && image.getWidth() <= (int) maxSize && image.getHeight() <= (int) maxSize))
+        image = image.rescaled (jmin ((int) maxSize, nextPowerOfTwo (image.getWidth())),
+                                jmin ((int) maxSize, nextPowerOfTwo (image.getHeight())));
+
+    const int w = image.getWidth(), h = image.getHeight();
+    HeapBlock<PixelARGB> newPixels ((size_t) (w * h));
+
+    {
+        const Image::BitmapData srcData (image, Image::BitmapData::readOnly);
+
+        jassert (srcData.pixelFormat == Image::ARGB);
+
+        for (int y = 0; y < h; ++y)
+        {
+            const uint8* src = srcData.getLinePointer (y);
+            PixelARGB* const dest = newPixels + w * (h - 1 - y);
+
+            for (int x = 0; x < w; ++x)
+            {
+                dest[x].set (*reinterpret_cast<const PixelARGB*> (src));
+                src += srcData.pixelStride;
+            }
+        }
+    }
+
+    const ScopedLock sl (pixelLock);
+    pixels.swapWith (newPixels);
+    width = w;
+    height = h;
+    nextRowToUpload = 0;
+}
+
+size_t StreamedTexture::upload (OpenGLContext&, size_t maxBytes, bool& finished)
+{
+    const ScopedLock sl (pixelLock);
+
+    if (width == 0 || height == 0)
+    {
+        finished = true;
+        return 0;
+    }
+
+    if (textureID == 0)
+    {
+        glGenTextures (1, &textureID);
+        glBindTexture (GL_TEXTURE_2D, textureID);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        textureWidth = textureHeight = 0;
+    }
+    else
+    {
+        glBindTexture (GL_TEXTURE_2D, textureID);
+    }
+
+    // the storage only needs reallocating if the size has changed
+    if (textureWidth != width || textureHeight != height)
+    {
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, JUCE_RGBA_FORMAT, GL_UNSIGNED_BYTE, nullptr);
+        textureWidth = width;
+        textureHeight = height;
+    }
+
+    const size_t bytesPerRow = (size_t) width * sizeof (PixelARGB);
+    const int numRows = jmin (height - nextRowToUpload, jmax (1, (int) (maxBytes / bytesPerRow)));
+
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D (GL_TEXTURE_2D, 0, 0, nextRowToUpload, width, numRows,
+                     JUCE_RGBA_FORMAT, GL_UNSIGNED_BYTE, pixels + width * nextRowToUpload);
+
+    nextRowToUpload += numRows;
+    finished = nextRowToUpload >= height;
+
+    if (finished)
+        nextRowToUpload = 0;
+
+    return (size_t) numRows * bytesPerRow;
+}
+
+void StreamedTexture::releaseGLResources (OpenGLContext&)
+{
+    const ScopedLock sl (pixelLock);
+
+    if (textureID != 0)
+    {
+        glDeleteTextures (1, &textureID);
+        textureID = 0;
+    }
+
+    nextRowToUpload = 0;
+}
+
+void StreamedTexture::bind() const
+{
+    if (textureID != 0)
+        glBindTexture (GL_TEXTURE_2D, textureID);
+}
+
+//==============================================================================
+StreamedMesh::StreamedMesh (const File& objFile, CachedMesh::VertexBuilder* b)
+    : file (objFile), sourceData (nullptr), sourceSize (0), builder (b),
+      nextPartToUpload (0), nextByteToUpload (0)
+{
+}
+
+StreamedMesh::StreamedMesh (const void* objFileData, size_t numBytes, const String& nm, CachedMesh::VertexBuilder* b)
+    : sourceData (objFileData), sourceSize (numBytes), name (nm), builder (b),
+      nextPartToUpload (0), nextByteToUpload (0)
+{
+}
+
+StreamedMesh::~StreamedMesh()
+{
+    // the buffers must be deleted on the GL thread, by AssetStreamer::releaseGLResources()
+    // or by the streamer letting go of it
+    jassert (buffers.size() == 0);
+}
+
+Result StreamedMesh::load()
+{
+    return sourceData != nullptr ? mesh.load (sourceData, sourceSize, name, *builder)
+                                 : mesh.load (file, *builder);
+}
+
+size_t StreamedMesh::upload (OpenGLContext& context, size_t maxBytes, bool& finished)
+{
+    size_t numUploaded = 0;
+
+    while (nextPartToUpload < mesh.getNumParts())
+    {
+        const CachedMesh::Part& part = mesh.getPart (nextPartToUpload);
+        const size_t vertexBytes = (size_t) part.numVertices * (size_t) mesh.getVertexSize();
+        const size_t indexBytes = (size_t) part.numIndices * (size_t) part.bytesPerIndex;
+
+        if (nextPartToUpload == buffers.size())
+        {
+            Buffers b;
+            b.numIndices = part.numIndices;
+            b.indexType = part.bytesPerIndex == (int) sizeof (uint16) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+            context.extensions.glGenBuffers (1, &b.vertexBuffer);
+            context.extensions.glBindBuffer (GL_ARRAY_BUFFER, b.vertexBuffer);
+            context.extensions.glBufferData (GL_ARRAY_BUFFER, (GLsizeiptr) vertexBytes, nullptr, GL_STATIC_DRAW);
+
+            context.extensions.glGenBuffers (1, &b.indexBuffer);
+            context.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, b.indexBuffer);
+            context.extensions.glBufferData (GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr) indexBytes, nullptr, GL_STATIC_DRAW);
+
+            buffers.add (b);
+        }
+
+        if (numUploaded >= maxBytes)
+            break;
+
+        const Buffers& b = buffers.getReference (nextPartToUpload);
+        size_t sliceSize = jmin (maxBytes - numUploaded, vertexBytes + indexBytes - nextByteToUpload);
+
+        if (nextByteToUpload < vertexBytes)
+        {
+            sliceSize = jmin (sliceSize, vertexBytes - nextByteToUpload);
+            context.extensions.glBindBuffer (GL_ARRAY_BUFFER, b.vertexBuffer);
+            context.extensions.glBufferSubData (GL_ARRAY_BUFFER, (GLintptr) nextByteToUpload, (GLsizeiptr) sliceSize,
+                                                static_cast<const uint8*> (part.vertices) + nextByteToUpload);
+        }
+        else
+        {
+            const size_t offset = nextByteToUpload - vertexBytes;
+            context.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, b.indexBuffer);
+            context.extensions.glBufferSubData (GL_ELEMENT_ARRAY_BUFFER, (GLintptr) offset, (GLsizeiptr) sliceSize,
+                                                reinterpret_cast<const uint8*> (part.indices) + offset);
+        }
+
+        numUploaded += sliceSize;
+        nextByteToUpload += sliceSize;
+
+        if (nextByteToUpload >= vertexBytes + indexBytes)
+        {
+            ++nextPartToUpload;
+            nextByteToUpload = 0;
+        }
+    }
+
+    unbind (context);
+    finished = nextPartToUpload >= mesh.getNumParts();
+    return numUploaded;
+}
+
+void StreamedMesh::releaseGLResources (OpenGLContext& context)
+{
+    for (int i = 0; i < buffers.size(); ++i)
+    {
+        context.extensions.glDeleteBuffers (1, &buffers.getReference (i).vertexBuffer);
+        context.extensions.glDeleteBuffers (1, &buffers.getReference (i).indexBuffer);
+    }
+
+    buffers.clear();
+    nextPartToUpload = 0;
+    nextByteToUpload = 0;
+}
+
+void StreamedMesh::bind (OpenGLContext& context, int part) const
+{
+    const Buffers& b = buffers.getReference (part);
+    context.extensions.glBindBuffer (GL_ARRAY_BUFFER, b.vertexBuffer);
+    context.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, b.indexBuffer);
+}
+
+void StreamedMesh::unbind (OpenGLContext& context)
+{
+    context.extensions.glBindBuffer (GL_ARRAY_BUFFER, 0);
+    context.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+//==============================================================================
+struct AssetStreamer::LoadJob  : public ThreadPoolJob
+{
+    LoadJob (AssetStreamer& s, StreamedAsset* a)
+        : ThreadPoolJob ("Asset loader"), streamer (s), asset (a) {}
+
+    JobStatus runJob() override
+    {
+        asset->state = (int) StreamedAsset::loading;
+        asset->loadResult = asset->load();
+
+        if (asset->loadResult.wasOk())
+            streamer.queueForUpload (asset);
+        else
+            asset->state = (int) StreamedAsset::failed;
+
+        return jobHasFinished;
+    }
+
+    AssetStreamer& streamer;
+    const StreamedAsset::Ptr asset;
+};
+
+//==============================================================================
+AssetStreamer::AssetStreamer (int numLoadingThreads, size_t uploadBytesPerFrame)
+    : pool (numLoadingThreads)
+{
+    setUploadBudget (uploadBytesPerFrame);
+}
+
+AssetStreamer::~AssetStreamer()
+{
+    pool.removeAllJobs (true, 10000);
+}
+
+void AssetStreamer::setUploadBudget (size_t bytesPerFrame) noexcept
+{
+    jassert (bytesPerFrame > 0);
+    uploadBudget = (int64) jmax ((size_t) 1, bytesPerFrame);
+}
+
+void AssetStreamer::add (StreamedAsset* asset)
+{
+    jassert (asset != nullptr && asset->streamer == nullptr);  // an asset can only be added once
+
+    asset->streamer = this;
+    asset->state = (int) StreamedAsset::waiting;
+
+    {
+        const ScopedLock sl (lock);
+        assets.add (asset);
+    }
+
+    pool.addJob (new LoadJob (*this, asset), true);
+}
+
+void AssetStreamer::queueForUpload (StreamedAsset* asset)
+{
+    const ScopedLock sl (lock);
+    asset->state = (int) StreamedAsset::uploading;
+    uploadQueue.addIfNotAlreadyThere (asset);
+}
+
+int AssetStreamer::getNumPending() const
+{
+    const ScopedLock sl (lock);
+    int numPending = 0;
+
+    for (int i = 0; i < assets.size(); ++i)
+    {
+        const StreamedAsset::State state = assets.getObjectPointerUnchecked (i)->getState();
+
+        if (state != StreamedAsset::ready && state != StreamedAsset::failed)
+            ++numPending;
+    }
+
+    return numPending;
+}
+
+size_t AssetStreamer::processUploads (OpenGLContext& context)
+{
+    jassert (OpenGLHelpers::isContextActive());
+
+    const size_t budget = getUploadBudget();
+    size_t numUploaded = 0;
+
+    while (numUploaded < budget)
+    {
+        StreamedAsset::Ptr asset;
+
+        {
+            const ScopedLock sl (lock);
+            asset = uploadQueue.getFirst();
+        }
+
+        if (asset == nullptr)
+            break;
+
+        bool finished = false;
+        numUploaded += asset->upload (context, budget - numUploaded, finished);
+
+        if (! finished)
+            break;
+
+        const ScopedLock sl (lock);
+        asset->state = (int) StreamedAsset::ready;
+        uploadQueue.removeObject (asset);
+    }
+
+    // Forget any uploaded assets that nobody else is using. The array's reference and
+    // the one taken here are the only ones left in that case.
+    for (int i = assets.size(); --i >= 0;)
+    {
+        StreamedAsset::Ptr asset;
+
+        {
+            const ScopedLock sl (lock);
+            asset = assets[i];
+        }
+
+        if (asset != nullptr && asset->getReferenceCount() == 2
+             && (asset->getState() == StreamedAsset::ready || asset->getState() == StreamedAsset::failed))
+        {
+            asset->releaseGLResources (context);
+
+            const ScopedLock sl (lock);
+            assets.removeObject (asset);
+        }
+    }
+
+    return numUploaded;
+}
+
+void AssetStreamer::releaseGLResources (OpenGLContext& context)
+{
+    jassert (OpenGLHelpers::isContextActive());
+
+    const ScopedLock sl (lock);
+
+    for (int i = 0; i < assets.size(); ++i)
+    {
+        StreamedAsset* const asset = assets.getObjectPointerUnchecked (i);
+        asset->releaseGLResources (context);
+
+        // anything that's been loaded will need uploading again to the next context
+        if (asset->getState() == StreamedAsset::ready)
+            queueForUpload (asset);
+    }
+}
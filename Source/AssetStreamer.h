@@ -0,0 +1,255 @@
+/*
+  ==============================================================================
+
+    AssetStreamer.h
+
+  ==============================================================================
+*/
+
+#ifndef ASSETSTREAMER_H_INCLUDED
+#define ASSETSTREAMER_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "CachedMesh.h"
+
+class AssetStreamer;
+
+//==============================================================================
+/**
+    Something that's read and decoded in the background, then uploaded to GL a
+    piece at a time by an AssetStreamer.
+
+    Until getState() says it's ready, keep drawing whatever was there before.
+*/
+class StreamedAsset  : public ReferenceCountedObject
+{
+public:
+    enum State
+    {
+        waiting,        // added, but not yet picked up by a loading thread
+        loading,        // being read and decoded
+        uploading,      // waiting for, or part way through, its upload
+        ready,          // everything is on the GPU
+        failed
+    };
+
+    typedef ReferenceCountedObjectPtr<StreamedAsset> Ptr;
+
+    virtual ~StreamedAsset();
+
+    State getState() const noexcept                     { return (State) state.get(); }
+    bool isReady() const noexcept                       { return getState() == ready; }
+
+    /** If loading failed, this says why. */
+    const Result& getLoadResult() const noexcept        { return loadResult; }
+
+protected:
+    StreamedAsset();
+
+    /** Called on one of the streamer's threads to read and decode the asset. */
+    virtual Result load() = 0;
+
+    /** Called on the GL thread to upload up to about maxBytes more of the asset.
+        This should return the number of bytes it uploaded, and set finished once
+        everything is on the GPU. It's allowed to go over maxBytes if it can't
+        split the data any further, but it must make some progress each time.
+    */
+    virtual size_t upload (OpenGLContext&, size_t maxBytes, bool& finished) = 0;
+
+    /** Called on the GL thread to delete any GL objects. The next upload() must
+        start again from the beginning.
+    */
+    virtual void releaseGLResources (OpenGLContext&) = 0;
+
+    /** Asks for the asset to be uploaded again, e.g. because its contents have changed.
+        This can be called on any thread, and does nothing if the asset hasn't been
+        added to a streamer yet.
+    */
+    void requestUpload();
+
+private:
+    friend class AssetStreamer;
+
+    AssetStreamer* streamer;
+    Atomic<int> state;
+    Result loadResult;
+
+    JUCE_DECLARE_NON_COPYABLE (StreamedAsset)
+};
+
+//==============================================================================
+/**
+    A texture that's decoded from an image file on a background thread, and
+    uploaded a band of rows at a time.
+
+    Images are converted and resized on the loading thread so that each side is
+    a power of two of at most maxSize, as OpenGLTexture would have done.
+*/
+class StreamedTexture  : public StreamedAsset
+{
+public:
+    typedef ReferenceCountedObjectPtr<StreamedTexture> Ptr;
+
+    explicit StreamedTexture (const File& imageFile);
+
+    /** The data isn't copied, so it must outlive the texture, as BinaryData does. */
+    StreamedTexture (const void* imageData, size_t numBytes);
+
+    /** Creates a texture whose image will be given by setImage(). */
+    StreamedTexture();
+
+    ~StreamedTexture();
+
+    enum { maxSize = 1024 };
+
+    /** Replaces the image. It's converted on the calling thread and then uploaded
+        through the streamer into the same GL texture, a band of rows at a time, so
+        until it's done the texture shows the new rows over the old ones. If the
+        size has changed, the texture's storage is reallocated first, which leaves
+        the rows that haven't arrived yet undefined.
+    */
+    void setImage (const Image&);
+
+    /** Binds the texture, if any of it has been uploaded. */
+    void bind() const;
+
+    GLuint getTextureID() const noexcept        { return textureID; }
+    int getWidth() const noexcept               { return width; }
+    int getHeight() const noexcept              { return height; }
+
+protected:
+    Result load() override;
+    size_t upload (OpenGLContext&, size_t maxBytes, bool& finished) override;
+    void releaseGLResources (OpenGLContext&) override;
+
+private:
+    const File file;
+    const void* const sourceData;
+    const size_t sourceSize;
+
+    CriticalSection pixelLock;
+    HeapBlock<PixelARGB> pixels;    // bottom row first, as GL wants them
+    int width, height;
+
+    GLuint textureID;
+    int textureWidth, textureHeight, nextRowToUpload;
+
+    void setPixels (const Image&);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StreamedTexture)
+};
+
+//==============================================================================
+/**
+    An OBJ model that's loaded through a CachedMesh on a background thread, then
+    copied into vertex and index buffers with glBufferSubData a slice at a time.
+*/
+class StreamedMesh  : public StreamedAsset
+{
+public:
+    typedef ReferenceCountedObjectPtr<StreamedMesh> Ptr;
+
+    /** The mesh takes ownership of the builder, which is used on the loading thread. */
+    StreamedMesh (const File& objFile, CachedMesh::VertexBuilder* builder);
+
+    /** The data isn't copied, so it must outlive the mesh, as BinaryData does. */
+    StreamedMesh (const void* objFileData, size_t numBytes, const String& name, CachedMesh::VertexBuilder* builder);
+
+    ~StreamedMesh();
+
+    /** Once the mesh is ready, these describe the parts to draw. */
+    int getNumParts() const noexcept            { return buffers.size(); }
+    int getNumIndices (int part) const noexcept { return buffers.getReference (part).numIndices; }
+
+    /** GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, to pass to glDrawElements. */
+    GLenum getIndexType (int part) const noexcept   { return buffers.getReference (part).indexType; }
+
+    /** Binds a part's vertex and index buffers. */
+    void bind (OpenGLContext&, int part) const;
+
+    /** Unbinds the vertex and index buffers. */
+    static void unbind (OpenGLContext&);
+
+protected:
+    Result load() override;
+    size_t upload (OpenGLContext&, size_t maxBytes, bool& finished) override;
+    void releaseGLResources (OpenGLContext&) override;
+
+private:
+    struct Buffers
+    {
+        GLuint vertexBuffer, indexBuffer;
+        int numIndices;
+        GLenum indexType;
+    };
+
+    const File file;
+    const void* const sourceData;
+    const size_t sourceSize;
+    const String name;
+    ScopedPointer<CachedMesh::VertexBuilder> builder;
+
+    CachedMesh mesh;
+    Array<Buffers> buffers;
+    int nextPartToUpload;
+    size_t nextByteToUpload;    // within the part's vertices followed by its indices
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StreamedMesh)
+};
+
+//==============================================================================
+/**
+    Loads StreamedAssets on a ThreadPool and uploads them on the GL thread
+    within a fixed number of bytes per frame.
+
+    Call processUploads() once per frame from the renderer, and
+    releaseGLResources() from openGLContextClosing(). Assets are uploaded in the
+    order that they finish loading. Once an asset has been uploaded and the
+    streamer is the only thing still referring to it, processUploads() deletes
+    its GL objects and forgets it.
+*/
+class AssetStreamer
+{
+public:
+    AssetStreamer (int numLoadingThreads = 2, size_t uploadBytesPerFrame = 1 << 20);
+
+    /** Any assets that were uploaded must have been released with
+        releaseGLResources() before this is deleted.
+    */
+    ~AssetStreamer();
+
+    /** Starts loading an asset. */
+    void add (StreamedAsset*);
+
+    /** Limits how much processUploads() uploads each time it's called. */
+    void setUploadBudget (size_t bytesPerFrame) noexcept;
+    size_t getUploadBudget() const noexcept             { return (size_t) uploadBudget.get(); }
+
+    /** Called on the GL thread each frame. Returns the number of bytes uploaded. */
+    size_t processUploads (OpenGLContext&);
+
+    /** Called on the GL thread when the context is closing. Deletes all the GL
+        objects, and assets that are still in use will be uploaded again to the
+        next context.
+    */
+    void releaseGLResources (OpenGLContext&);
+
+    /** The number of assets that are still loading or uploading. */
+    int getNumPending() const;
+
+private:
+    struct LoadJob;
+    friend class StreamedAsset;
+
+    ThreadPool pool;
+    CriticalSection lock;
+    ReferenceCountedArray<StreamedAsset> assets, uploadQueue;
+    Atomic<int64> uploadBudget;
+
+    void queueForUpload (StreamedAsset*);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AssetStreamer)
+};
+
+
+#endif  // ASSETSTREAMER_H_INCLUDED
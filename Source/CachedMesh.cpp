@@ -0,0 +1,730 @@
+/*
+  ==============================================================================
+
+    CachedMesh.cpp
+
+  ==============================================================================
+*/
+
+#include "CachedMesh.h"
+#include "MeshOptimiser.h"
+
+//==============================================================================
+namespace CachedMeshFormat
+{
+    enum
+    {
+        magic = 0x434d464c,     // "LFMC"
+        version = 2,
+        headerSize = 64,
+        partEntrySize = 40,
+        blockAlignment = 16
+    };
+
+    enum
+    {
+       #if JUCE_BIG_ENDIAN
+        nativeByteOrder = 1
+       #else
+        nativeByteOrder = 0
+       #endif
+    };
+
+    static void writeUInt32 (uint8*& d, uint32 value) noexcept
+    {
+        value = ByteOrder::swapIfBigEndian (value);
+        memcpy (d, &value, 4);
+        d += 4;
+    }
+
+    static void writeUInt64 (uint8*& d, uint64 value) noexcept
+    {
+        value = ByteOrder::swapIfBigEndian (value);
+        memcpy (d, &value, 8);
+        d += 8;
+    }
+
+    static uint32 readUInt32 (const uint8*& s) noexcept
+    {
+        const uint32 value = ByteOrder::littleEndianInt (s);
+        s += 4;
+        return value;
+    }
+
+    static uint64 readUInt64 (const uint8*& s) noexcept
+    {
+        const uint64 value = ByteOrder::littleEndianInt64 (s);
+        s += 8;
+        return value;
+    }
+
+    static size_t align (size_t offset) noexcept
+    {
+        return (offset + blockAlignment - 1) & ~(size_t) (blockAlignment - 1);
+    }
+
+    static bool isInRange (uint64 offset, uint64 numBytes, size_t totalSize) noexcept
+    {
+        return offset <= totalSize && numBytes <= totalSize - offset;
+    }
+
+    template <typename IndexType>
+    static bool indicesAreBelow (const uint8* data, uint32 numIndices, uint32 numVertices) noexcept
+    {
+        const IndexType* const indices = reinterpret_cast<const IndexType*> (data);
+        IndexType highest = 0;
+
+        for (uint32 i = 0; i < numIndices; ++i)
+            highest = jmax (highest, indices[i]);
+
+        return numIndices == 0 || (uint32) highest < numVertices;
+    }
+}
+
+//==============================================================================
+CachedMesh::CachedMesh (const File& directory)
+    : cacheDirectory (directory), vertexSize (0), loadedFromCache (false)
+{
+}
+
+CachedMesh::~CachedMesh()
+{
+}
+
+File CachedMesh::getDefaultCacheDirectory()
+{
+    return File::getSpecialLocation (File::userApplicationDataDirectory)
+             .getChildFile ("JuceLeapFw").getChildFile ("MeshCache");
+}
+
+void CachedMesh::clear()
+{
+    parts.clearQuick();
+    mappedFile = nullptr;
+    builtData.setSize (0);
+    optimisationReport = String::empty;
+    vertexSize = 0;
+    loadedFromCache = false;
+}
+
+//==============================================================================
+Result CachedMesh::load (const File& objFile, VertexBuilder& builder)
+{
+    clear();
+
+    if (! objFile.existsAsFile())
+        return Result::fail ("Cannot open file: " + objFile.getFullPathName());
+
+    SourceKey key;
+    key.size = objFile.getSize();
+    key.modificationTime = objFile.getLastModificationTime().toMilliseconds();
+    key.formatId = builder.getFormatId();
+    key.vertexSize = (uint32) builder.getVertexSize();
+
+    cacheFile = cacheDirectory.getChildFile (MD5 ((objFile.getFullPathName() + ":" + String (key.formatId)).toUTF8()).toHexString() + ".mesh");
+
+    // an untouched file can be trusted without reading it, otherwise check whether its contents changed
+    if (openCacheFile (key, false))
+        return Result::ok();
+
+    key.hash = MD5 (objFile);
+
+    if (openCacheFile (key, true))
+        return Result::ok();
+
+    WavefrontObjFile obj;
+    const Result result (obj.load (objFile));
+
+    if (result.failed())
+        return result;
+
+    return build (obj, key, builder);
+}
+
+Result CachedMesh::load (const void* objFileData, size_t numBytes, const String& name, VertexBuilder& builder)
+{
+    clear();
+
+    SourceKey key;
+    key.hash = MD5 (objFileData, numBytes);
+    key.size = (int64) numBytes;
+    key.modificationTime = 0;
+    key.formatId = builder.getFormatId();
+    key.vertexSize = (uint32) builder.getVertexSize();
+
+    cacheFile = cacheDirectory.getChildFile (File::createLegalFileName (name) + "_" + String::toHexString ((int) key.formatId) + ".mesh");
+
+    if (openCacheFile (key, true))
+        return Result::ok();
+
+    WavefrontObjFile obj;
+    const Result result (obj.load (objFileData, numBytes));
+
+    if (result.failed())
+        return result;
+
+    return build (obj, key, builder);
+}
+
+//==============================================================================
+bool CachedMesh::openCacheFile (const SourceKey& key, bool checkHash)
+{
+    if (! cacheFile.existsAsFile())
+        return false;
+
+    mappedFile = new MemoryMappedFile (cacheFile, MemoryMappedFile::readOnly);
+
+    if (mappedFile->getData() != nullptr
+         && readParts (mappedFile->getData(), mappedFile->getSize(), key, checkHash))
+    {
+        loadedFromCache = true;
+        return true;
+    }
+
+    mappedFile = nullptr;
+    return false;
+}
+
+bool CachedMesh::readParts (const void* data, size_t size, const SourceKey& key, bool checkHash)
+{
+    using namespace CachedMeshFormat;
+
+    parts.clearQuick();
+
+    if (size < (size_t) headerSize)
+        return false;
+
+    const uint8* const start = static_cast<const uint8*> (data);
+    const uint8* s = start;
+
+    const uint32 fileMagic      = readUInt32 (s);
+    const uint32 fileVersion    = readUInt32 (s);
+    const uint32 byteOrder      = readUInt32 (s);
+    const uint32 formatId       = readUInt32 (s);
+    const uint32 fileVertexSize = readUInt32 (s);
+    const uint32 numParts       = readUInt32 (s);
+    const int64 sourceSize      = (int64) readUInt64 (s);
+    const int64 sourceModTime   = (int64) readUInt64 (s);
+    const uint8* const hashData = s;
+    s += 16;
+    const uint64 totalSize      = readUInt64 (s);
+
+    if (fileMagic != (uint32) magic || fileVersion != (uint32) version || byteOrder != (uint32) nativeByteOrder
+         || formatId != key.formatId || fileVertexSize != key.vertexSize || totalSize != (uint64) size
+         || sourceSize != key.size)
+        return false;
+
+    if (checkHash ? memcmp (hashData, key.hash.getChecksumDataArray(), 16) != 0
+                  : sourceModTime != key.modificationTime)
+        return false;
+
+    if (! isInRange (headerSize, (uint64) numParts * partEntrySize, size))
+        return false;
+
+    for (uint32 i = 0; i < numParts; ++i)
+    {
+        const uint32 nameOffset   = readUInt32 (s);
+        const uint32 nameLength   = readUInt32 (s);
+        const uint32 numVertices  = readUInt32 (s);
+        const uint32 numIndices   = readUInt32 (s);
+        const uint64 vertexOffset = readUInt64 (s);
+        const uint64 indexOffset  = readUInt64 (s);
+        const uint32 indexSize    = readUInt32 (s);
+        s += 4;
+
+        if (! ((indexSize == 2 || indexSize == 4)
+                && isInRange (nameOffset, nameLength, size)
+                && isInRange (vertexOffset, (uint64) numVertices * fileVertexSize, size)
+                && isInRange (indexOffset, (uint64) numIndices * indexSize, size)
+                && (vertexOffset % blockAlignment) == 0 && (indexOffset % blockAlignment) == 0
+                && numVertices < 0x7fffffff && numIndices < 0x7fffffff))
+        {
+            parts.clearQuick();
+            return false;
+        }
+
+        // a damaged index would send the GPU reading past the end of the vertex buffer
+        if (! (indexSize == 2 ? indicesAreBelow<uint16> (start + indexOffset, numIndices, numVertices)
+                              : indicesAreBelow<uint32> (start + indexOffset, numIndices, numVertices)))
+        {
+            parts.clearQuick();
+            return false;
+        }
+
+        Part part;
+        part.name = String (CharPointer_UTF8 ((const char*) start + nameOffset),
+                            CharPointer_UTF8 ((const char*) start + nameOffset + nameLength));
+        part.vertices = start + vertexOffset;
+        part.numVertices = (int) numVertices;
+        part.indices = start + indexOffset;
+        part.numIndices = (int) numIndices;
+        part.bytesPerIndex = (int) indexSize;
+        parts.add (part);
+    }
+
+    vertexSize = (int) fileVertexSize;
+    return true;
+}
+
+//==============================================================================
+namespace CachedMeshFormat
+{
+    /** A shape's vertices and indices, built and optionally optimised before being laid out. */
+    struct BuiltPart
+    {
+        HeapBlock<uint8> vertices;
+        HeapBlock<uint32> indices;
+        int numVertices, numIndices, bytesPerIndex;
+    };
+
+    static void buildPart (BuiltPart& part, const WavefrontObjFile::Mesh& mesh,
+                           CachedMesh::VertexBuilder& builder, String& report)
+    {
+        const int vertexSize = builder.getVertexSize();
+
+        part.numVertices = mesh.vertices.size();
+        part.numIndices = mesh.indices.size();
+        part.bytesPerIndex = (int) sizeof (uint32);
+
+        part.vertices.malloc ((size_t) part.numVertices * (size_t) vertexSize);
+        builder.buildVertices (mesh, part.vertices);
+
+        part.indices.malloc ((size_t) part.numIndices);
+        memcpy (part.indices, mesh.indices.begin(), (size_t) part.numIndices * sizeof (uint32));
+
+        if (builder.shouldOptimise())
+        {
+            const MeshOptimiser::Statistics before (MeshOptimiser::analyse (part.indices, part.numIndices, part.numVertices));
+
+            MeshOptimiser::optimiseVertexCache (part.indices, part.numIndices, part.numVertices);
+            part.numVertices = MeshOptimiser::optimiseVertexFetch (part.indices, part.numIndices, part.vertices,
+                                                                   part.numVertices, vertexSize);
+
+            report << MeshOptimiser::getReport (before, MeshOptimiser::analyse (part.indices, part.numIndices, part.numVertices))
+                   << newLine;
+
+            if (MeshOptimiser::canUse16BitIndices (part.numVertices))
+                part.bytesPerIndex = (int) sizeof (uint16);
+        }
+    }
+}
+
+Result CachedMesh::build (WavefrontObjFile& obj, const SourceKey& key, VertexBuilder& builder)
+{
+    using namespace CachedMeshFormat;
+
+    const int numParts = obj.shapes.size();
+    OwnedArray<BuiltPart> builtParts;
+
+    for (int i = 0; i < numParts; ++i)
+    {
+        const WavefrontObjFile::Shape& shape = *obj.shapes.getUnchecked (i);
+
+        if (builder.shouldOptimise())
+            optimisationReport << shape.name << ": ";
+
+        buildPart (*builtParts.add (new BuiltPart()), shape.mesh, builder, optimisationReport);
+    }
+
+    if (optimisationReport.isNotEmpty())
+    {
+        DBG ("Optimised " + cacheFile.getFileName() + newLine + optimisationReport);
+    }
+
+    // work out where everything goes..
+    HeapBlock<size_t> nameOffsets ((size_t) numParts), vertexOffsets ((size_t) numParts), indexOffsets ((size_t) numParts);
+    size_t size = headerSize + (size_t) numParts * partEntrySize;
+
+    for (int i = 0; i < numParts; ++i)
+    {
+        nameOffsets[i] = size;
+        size += obj.shapes.getUnchecked (i)->name.getNumBytesAsUTF8();
+    }
+
+    for (int i = 0; i < numParts; ++i)
+    {
+        const BuiltPart& part = *builtParts.getUnchecked (i);
+
+        vertexOffsets[i] = size = align (size);
+        size += (size_t) part.numVertices * key.vertexSize;
+
+        indexOffsets[i] = size = align (size);
+        size += (size_t) part.numIndices * (size_t) part.bytesPerIndex;
+    }
+
+    // ..then fill it in
+    builtData.setSize (size, true);
+    uint8* const start = static_cast<uint8*> (builtData.getData());
+    uint8* d = start;
+
+    writeUInt32 (d, (uint32) magic);
+    writeUInt32 (d, (uint32) version);
+    writeUInt32 (d, (uint32) nativeByteOrder);
+    writeUInt32 (d, key.formatId);
+    writeUInt32 (d, key.vertexSize);
+    writeUInt32 (d, (uint32) numParts);
+    writeUInt64 (d, (uint64) key.size);
+    writeUInt64 (d, (uint64) key.modificationTime);
+    memcpy (d, key.hash.getChecksumDataArray(), 16);
+    d += 16;
+    writeUInt64 (d, (uint64) size);
+
+    for (int i = 0; i < numParts; ++i)
+    {
+        const String& name = obj.shapes.getUnchecked (i)->name;
+        const size_t nameLength = name.getNumBytesAsUTF8();
+        const BuiltPart& part = *builtParts.getUnchecked (i);
+
+        writeUInt32 (d, (uint32) nameOffsets[i]);
+        writeUInt32 (d, (uint32) nameLength);
+        writeUInt32 (d, (uint32) part.numVertices);
+        writeUInt32 (d, (uint32) part.numIndices);
+        writeUInt64 (d, (uint64) vertexOffsets[i]);
+        writeUInt64 (d, (uint64) indexOffsets[i]);
+        writeUInt32 (d, (uint32) part.bytesPerIndex);
+        writeUInt32 (d, 0);
+
+        memcpy (start + nameOffsets[i], name.toRawUTF8(), nameLength);
+        memcpy (start + vertexOffsets[i], part.vertices, (size_t) part.numVertices * key.vertexSize);
+
+        if (part.bytesPerIndex == (int) sizeof (uint16))
+            MeshOptimiser::compactIndices (part.indices, reinterpret_cast<uint16*> (start + indexOffsets[i]), part.numIndices);
+        else
+            memcpy (start + indexOffsets[i], part.indices, (size_t) part.numIndices * sizeof (uint32));
+    }
+
+    if (! readParts (start, size, key, true))
+    {
+        jassertfalse;
+        return Result::fail ("Couldn't build the mesh");
+    }
+
+    // Failing to write the cache only costs a re-parse next time, so it isn't an error.
+    // Writing to a temporary file first means a half-written cache is never seen.
+    if (cacheDirectory.createDirectory())
+    {
+        TemporaryFile temp (cacheFile);
+
+        if (! (temp.getFile().replaceWithData (start, size) && temp.overwriteTargetFileWithTemporary()))
+        {
+            DBG ("Couldn't write mesh cache: " + cacheFile.getFullPathName());
+        }
+    }
+
+    return Result::ok();
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class CachedMeshTests  : public UnitTest
+{
+public:
+    CachedMeshTests() : UnitTest ("CachedMesh") {}
+
+    struct TestVertex
+    {
+        float position[3];
+        float texCoord[2];
+    };
+
+    struct TestBuilder  : public CachedMesh::VertexBuilder
+    {
+        TestBuilder (uint32 id = 1, bool optimise = false) : formatId (id), numBuilt (0), optimised (optimise) {}
+
+        uint32 getFormatId() const override     { return formatId; }
+        int getVertexSize() const override      { return (int) sizeof (TestVertex); }
+        bool shouldOptimise() const override    { return optimised; }
+
+        void buildVertices (const WavefrontObjFile::Mesh& mesh, void* dest) override
+        {
+            TestVertex* v = static_cast<TestVertex*> (dest);
+
+            for (int i = 0; i < mesh.vertices.size(); ++i)
+            {
+                const WavefrontObjFile::Vertex& p = mesh.vertices.getReference (i);
+                TestVertex tv = { { p.x, p.y, p.z }, { 0.0f, 0.0f } };
+
+                if (i < mesh.textureCoords.size())
+                {
+                    tv.texCoord[0] = mesh.textureCoords.getReference (i).x;
+                    tv.texCoord[1] = mesh.textureCoords.getReference (i).y;
+                }
+
+                v[i] = tv;
+            }
+
+            ++numBuilt;
+        }
+
+        uint32 formatId;
+        int numBuilt;
+        bool optimised;
+    };
+
+    struct PackedBuilder  : public CachedMesh::VertexBuilder
+    {
+        uint32 getFormatId() const override     { return 4; }
+        int getVertexSize() const override      { return (int) sizeof (MeshOptimiser::PackedVertex); }
+        bool shouldOptimise() const override    { return true; }
+
+        void buildVertices (const WavefrontObjFile::Mesh& mesh, void* dest) override
+        {
+            using namespace MeshOptimiser;
+            PackedVertex* v = static_cast<PackedVertex*> (dest);
+
+            for (int i = 0; i < mesh.vertices.size(); ++i)
+            {
+                const WavefrontObjFile::Vertex& p = mesh.vertices.getReference (i);
+                const WavefrontObjFile::TextureCoord& tc = mesh.textureCoords.getReference (i);
+
+                PackedVertex pv =
+                {
+                    { p.x, p.y, p.z },
+                    { 0, 0, packSigned (1.0f), 0 },
+                    { 255, 255, 255, 255 },
+                    { tc.x, tc.y }
+                };
+
+                v[i] = pv;
+            }
+        }
+    };
+
+    static String createObj (int size)
+    {
+        MemoryOutputStream s;
+
+        for (int y = 0; y <= size; ++y)
+            for (int x = 0; x <= size; ++x)
+                s << "v " << x << ' ' << y << " " << ((x * y) % 7) << "\n"
+                  << "vt " << (x / (double) size) << ' ' << (y / (double) size) << "\n";
+
+        for (int y = 0; y < size; ++y)
+        {
+            if (y % 32 == 0)
+                s << "g part" << (y / 32) << "\n";
+
+            for (int x = 0; x < size; ++x)
+            {
+                const int a = y * (size + 1) + x + 1, b = a + 1, c = a + size + 1, d = c + 1;
+                s << "f " << a << '/' << a << ' ' << b << '/' << b << ' ' << d << '/' << d << ' ' << c << '/' << c << "\n";
+            }
+        }
+
+        return s.toString();
+    }
+
+    bool partsMatch (const CachedMesh& a, const CachedMesh& b)
+    {
+        if (a.getNumParts() != b.getNumParts() || a.getVertexSize() != b.getVertexSize())
+            return false;
+
+        for (int i = 0; i < a.getNumParts(); ++i)
+        {
+            const CachedMesh::Part& p1 = a.getPart (i);
+            const CachedMesh::Part& p2 = b.getPart (i);
+
+            if (p1.name != p2.name || p1.numVertices != p2.numVertices || p1.numIndices != p2.numIndices
+                 || memcmp (p1.vertices, p2.vertices, (size_t) (p1.numVertices * a.getVertexSize())) != 0
+                 || p1.bytesPerIndex != p2.bytesPerIndex
+                 || memcmp (p1.indices, p2.indices, (size_t) (p1.numIndices * p1.bytesPerIndex)) != 0)
+                return false;
+        }
+
+        return true;
+    }
+
+    static double msSince (int64 start)
+    {
+        return Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start) * 1000.0;
+    }
+
+    void runTest()
+    {
+        const File dir (File::getSpecialLocation (File::tempDirectory).getNonexistentChildFile ("MeshCacheTest", ""));
+        const File objFile (dir.getChildFile ("grid.obj"));
+        dir.createDirectory();
+        objFile.replaceWithText (createObj (100));
+
+        beginTest ("Cache is written on a miss and used on a hit");
+        {
+            TestBuilder builder;
+            CachedMesh first (dir), second (dir);
+
+            expect (first.load (objFile, builder).wasOk());
+            expect (! first.wasLoadedFromCache());
+            expect (first.getCacheFile().existsAsFile());
+            expectEquals (first.getNumParts(), 4);
+            expectEquals (first.getPart (0).name, String ("part0"));
+            expectEquals (first.getPart (0).numIndices, 32 * 100 * 6);
+            expectEquals ((int) (reinterpret_cast<pointer_sized_int> (first.getPart (1).vertices) & 15), 0);
+
+            expect (second.load (objFile, builder).wasOk());
+            expect (second.wasLoadedFromCache());
+            expect (partsMatch (first, second));
+            expectEquals (builder.numBuilt, 4);
+
+            const TestVertex& v = static_cast<const TestVertex*> (second.getPart (3).vertices)[5];
+            expectEquals (v.texCoord[1], v.position[1] / 100.0f);
+        }
+
+        beginTest ("Changes invalidate the cache");
+        {
+            TestBuilder builder, otherFormat (2);
+            CachedMesh mesh (dir);
+
+            expect (mesh.load (objFile, otherFormat).wasOk());
+            expect (! mesh.wasLoadedFromCache());
+
+            // the same contents with a new time still match by hash
+            objFile.setLastModificationTime (Time::getCurrentTime() + RelativeTime::hours (1));
+            expect (mesh.load (objFile, builder).wasOk());
+            expect (mesh.wasLoadedFromCache());
+
+            objFile.appendText ("f 1 2 3\n");
+            expect (mesh.load (objFile, builder).wasOk());
+            expect (! mesh.wasLoadedFromCache());
+            expectEquals (mesh.getPart (3).numIndices, 4 * 100 * 6 + 3);
+        }
+
+        beginTest ("Damaged cache files are rebuilt");
+        {
+            TestBuilder builder;
+            CachedMesh mesh (dir);
+            expect (mesh.load (objFile, builder).wasOk());
+            const File cacheFile (mesh.getCacheFile());
+
+            MemoryBlock data;
+            cacheFile.loadFileAsData (data);
+
+            cacheFile.replaceWithData (data.getData(), data.getSize() / 2);
+            expect (mesh.load (objFile, builder).wasOk());
+            expect (! mesh.wasLoadedFromCache());
+
+            MemoryBlock damaged (data);
+            static_cast<uint8*> (damaged.getData())[CachedMeshFormat::headerSize + 16] = 0xff;
+            cacheFile.replaceWithData (damaged.getData(), damaged.getSize());
+            expect (mesh.load (objFile, builder).wasOk());
+            expect (! mesh.wasLoadedFromCache());
+            expectEquals (mesh.getNumParts(), 4);
+
+            // an index past the end of its part's vertices, with the header still intact
+            damaged = data;
+            const uint8* const firstPart = static_cast<const uint8*> (data.getData()) + CachedMeshFormat::headerSize;
+            const uint64 indexOffset = ByteOrder::littleEndianInt64 (firstPart + 24);
+            const uint32 indexSize = ByteOrder::littleEndianInt (firstPart + 32);
+            memset (static_cast<uint8*> (damaged.getData()) + indexOffset + indexSize * 7, 0xff, indexSize);
+            cacheFile.replaceWithData (damaged.getData(), damaged.getSize());
+            expect (mesh.load (objFile, builder).wasOk());
+            expect (! mesh.wasLoadedFromCache());
+            expect (mesh.getPart (0).numVertices < 0xffff);
+            expectEquals (mesh.getPart (0).numIndices, 32 * 100 * 6);
+        }
+
+        beginTest ("Data in memory");
+        {
+            const String text (createObj (20));
+            TestBuilder builder;
+            CachedMesh first (dir), second (dir);
+
+            expect (first.load (text.toRawUTF8(), text.getNumBytesAsUTF8(), "embedded", builder).wasOk());
+            expect (second.load (text.toRawUTF8(), text.getNumBytesAsUTF8(), "embedded", builder).wasOk());
+            expect (! first.wasLoadedFromCache());
+            expect (second.wasLoadedFromCache());
+            expect (partsMatch (first, second));
+        }
+
+        beginTest ("Optimised parts");
+        {
+            TestBuilder plain, optimising (3, true);
+            CachedMesh original (dir), first (dir), second (dir);
+
+            expect (original.load (objFile, plain).wasOk());
+            expect (first.load (objFile, optimising).wasOk());
+            expect (second.load (objFile, optimising).wasOk());
+            expect (second.wasLoadedFromCache());
+            expect (partsMatch (first, second));
+            expect (first.getOptimisationReport().contains ("ACMR"));
+
+            for (int i = 0; i < first.getNumParts(); ++i)
+            {
+                const CachedMesh::Part& before = original.getPart (i);
+                const CachedMesh::Part& after = first.getPart (i);
+
+                expectEquals (before.bytesPerIndex, 4);
+                expectEquals (after.bytesPerIndex, 2);
+                expectEquals (after.numIndices, before.numIndices);
+                expect (after.numVertices <= before.numVertices);
+
+                // the first triangle's corners should be the same positions, wherever they went
+                const uint16* const indices = static_cast<const uint16*> (after.indices);
+                const TestVertex* const vertices = static_cast<const TestVertex*> (after.vertices);
+                expect (indices[0] < after.numVertices && indices[1] < after.numVertices && indices[2] < after.numVertices);
+                expect (vertices[indices[0]].position[2] == (float) ((int) vertices[indices[0]].position[0]
+                                                                      * (int) vertices[indices[0]].position[1] % 7));
+            }
+        }
+
+        beginTest ("Texture coordinates outside 0..1");
+        {
+            const String text ("v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+                               "vt 0 0\nvt 2 0\nvt -0.5 2\n"
+                               "f 1/1 2/2 3/3\n");
+            PackedBuilder builder;
+            CachedMesh first (dir), second (dir);
+
+            expect (first.load (text.toRawUTF8(), text.getNumBytesAsUTF8(), "wrapped", builder).wasOk());
+            expect (second.load (text.toRawUTF8(), text.getNumBytesAsUTF8(), "wrapped", builder).wasOk());
+            expect (second.wasLoadedFromCache());
+            expect (partsMatch (first, second));
+
+            const CachedMesh::Part& part = second.getPart (0);
+            const MeshOptimiser::PackedVertex* const vertices = static_cast<const MeshOptimiser::PackedVertex*> (part.vertices);
+            bool foundWrapped = false;
+
+            for (int i = 0; i < part.numVertices; ++i)
+            {
+                if (vertices[i].position[0] == 1.0f)
+                {
+                    expectEquals (vertices[i].texCoord[0], 2.0f);
+                    foundWrapped = true;
+                }
+                else if (vertices[i].position[1] == 1.0f)
+                {
+                    expectEquals (vertices[i].texCoord[0], -0.5f);
+                    expectEquals (vertices[i].texCoord[1], 2.0f);
+                }
+            }
+
+            expect (foundWrapped);
+        }
+
+        beginTest ("Benchmark");
+        {
+            objFile.replaceWithText (createObj (600));
+            TestBuilder builder;
+
+            int64 start = Time::getHighResolutionTicks();
+            CachedMesh cold (dir);
+            cold.load (objFile, builder);
+            const double coldMs = msSince (start);
+
+            start = Time::getHighResolutionTicks();
+            CachedMesh warm (dir);
+            warm.load (objFile, builder);
+            const double warmMs = msSince (start);
+
+            expect (warm.wasLoadedFromCache());
+
+            logMessage (String (objFile.getSize() / (1024.0 * 1024.0), 1) + " MB OBJ: parsing "
+                          + String (coldMs, 1) + " ms, from cache " + String (warmMs, 2) + " ms");
+        }
+
+        dir.deleteRecursively();
+    }
+};
+
+static CachedMeshTests cachedMeshTests;
+
+#endif
@@ -0,0 +1,131 @@
+/*
+  ==============================================================================
+
+    CachedMesh.h
+
+  ==============================================================================
+*/
+
+#ifndef CACHEDMESH_H_INCLUDED
+#define CACHEDMESH_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "WavefrontObjParser.h"
+
+//==============================================================================
+/**
+    An OBJ model as ready-to-draw vertex and index blocks, which are kept in a
+    binary cache file so the OBJ only has to be parsed once.
+
+    load() looks for a cache file made from the same source and the same
+    VertexBuilder. If there is one, it's memory-mapped and the parts point straight
+    into it, so they can be passed to glBufferData without any parsing or copying.
+    Otherwise the OBJ is parsed with WavefrontObjFile, each shape's vertices are
+    interleaved by the VertexBuilder, and the result is written to the cache for
+    next time.
+
+    A cache file for an OBJ file is matched to it by the file's size and
+    modification time, or failing that by an MD5 of its contents, so a warm start
+    doesn't read the OBJ at all. Data in memory, like BinaryData, is always hashed.
+
+    The file starts with a 64 byte header and a table of parts, then the name of
+    each part and its vertex and index blocks, each 16-byte aligned. The header is
+    little-endian; the blocks are in the native byte order and a cache written on
+    a machine with the other byte order is ignored. Indices are 32 bits unless the
+    VertexBuilder asks for optimisation and the part has few enough vertices.
+*/
+class CachedMesh
+{
+public:
+    //==============================================================================
+    /** Turns a parsed mesh into interleaved vertices. */
+    class VertexBuilder
+    {
+    public:
+        virtual ~VertexBuilder() {}
+
+        /** Identifies what buildVertices() produces. Change it whenever the vertex
+            layout or contents change, and existing cache files will be rebuilt.
+        */
+        virtual uint32 getFormatId() const = 0;
+
+        virtual int getVertexSize() const = 0;
+
+        /** Writes mesh.vertices.size() vertices of getVertexSize() bytes each. */
+        virtual void buildVertices (const WavefrontObjFile::Mesh& mesh, void* destVertices) = 0;
+
+        /** If this returns true, each part is run through MeshOptimiser before it's
+            cached: the triangles are reordered for the vertex cache, the vertices
+            are reordered to match, and the indices are stored as 16 bits if they fit.
+        */
+        virtual bool shouldOptimise() const         { return false; }
+    };
+
+    /** One shape from the OBJ. The pointers stay valid until the mesh is reloaded or deleted. */
+    struct Part
+    {
+        String name;
+        const void* vertices;
+        int numVertices;
+        const void* indices;
+        int numIndices;
+        int bytesPerIndex;      // 2 or 4
+    };
+
+    //==============================================================================
+    /** Cache files are kept in the given directory, which is created if needed. */
+    explicit CachedMesh (const File& cacheDirectory = getDefaultCacheDirectory());
+    ~CachedMesh();
+
+    Result load (const File& objFile, VertexBuilder&);
+
+    /** Loads an OBJ that's already in memory. The name distinguishes its cache file
+        from those of other meshes.
+    */
+    Result load (const void* objFileData, size_t numBytes, const String& name, VertexBuilder&);
+
+    int getNumParts() const noexcept                    { return parts.size(); }
+    const Part& getPart (int index) const noexcept      { return parts.getReference (index); }
+    int getVertexSize() const noexcept                  { return vertexSize; }
+
+    /** True if the last load() used the cache rather than parsing the OBJ. */
+    bool wasLoadedFromCache() const noexcept            { return loadedFromCache; }
+
+    /** The cache file that the last load() used or wrote. */
+    const File& getCacheFile() const noexcept           { return cacheFile; }
+
+    /** If the last load() built an optimised mesh, this compares each part's
+        vertex cache statistics before and after.
+    */
+    const String& getOptimisationReport() const noexcept    { return optimisationReport; }
+
+    static File getDefaultCacheDirectory();
+
+private:
+    //==============================================================================
+    struct SourceKey
+    {
+        MD5 hash;
+        int64 size, modificationTime;
+        uint32 formatId, vertexSize;
+    };
+
+    const File cacheDirectory;
+    File cacheFile;
+    ScopedPointer<MemoryMappedFile> mappedFile;
+    MemoryBlock builtData;
+    Array<Part> parts;
+    String optimisationReport;
+    int vertexSize;
+    bool loadedFromCache;
+
+    void clear();
+    bool openCacheFile (const SourceKey&, bool checkHash);
+    Result build (WavefrontObjFile&, const SourceKey&, VertexBuilder&);
+    bool readParts (const void* data, size_t size, const SourceKey&, bool checkHash);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CachedMesh)
+};
+
+
+#endif  // CACHEDMESH_H_INCLUDED
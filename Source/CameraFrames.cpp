@@ -0,0 +1,346 @@
+/*
+  ==============================================================================
+
+    CameraFrames.cpp
+
+  ==============================================================================
+*/
+
+#include "CameraFrames.h"
+
+#ifndef GL_PIXEL_UNPACK_BUFFER
+ #define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+
+//==============================================================================
+namespace CameraFrameHelpers
+{
+    template <class PixelType>
+    static void copyRows (PixelARGB* dest, const Image::BitmapData& src)
+    {
+        for (int y = 0; y < src.height; ++y)
+        {
+            const uint8* s = src.getLinePointer (y);
+            PixelARGB* d = dest + src.width * (src.height - 1 - y);
+
+            for (int x = 0; x < src.width; ++x)
+            {
+                d[x].set (*reinterpret_cast<const PixelType*> (s));
+                s += src.pixelStride;
+            }
+        }
+    }
+}
+
+//==============================================================================
+CameraFramePool::CameraFramePool (int initialWidth, int initialHeight)
+    : shared (1), numDropped (0), writeIndex (0), readIndex (2), nextSequenceNumber (1)
+{
+    for (int i = 0; i < numFrames; ++i)
+    {
+        Frame& f = frames[i];
+        f.numPixelsAllocated = (size_t) (initialWidth * initialHeight);
+        f.pixels.malloc (f.numPixelsAllocated);
+        f.width = f.height = 0;
+        f.sequenceNumber = 0;
+    }
+}
+
+CameraFramePool::~CameraFramePool()
+{
+}
+
+void CameraFramePool::copyImage (Frame& frame, const Image& image)
+{
+    const Image::BitmapData src (image, Image::BitmapData::readOnly);
+    const size_t numPixels = (size_t) (src.width * src.height);
+
+    if (numPixels > frame.numPixelsAllocated)
+    {
+        frame.pixels.malloc (numPixels);
+        frame.numPixelsAllocated = numPixels;
+    }
+
+    frame.width = src.width;
+    frame.height = src.height;
+
+    switch (src.pixelFormat)
+    {
+        case Image::RGB:            CameraFrameHelpers::copyRows<PixelRGB>   (frame.pixels, src); break;
+        case Image::ARGB:           CameraFrameHelpers::copyRows<PixelARGB>  (frame.pixels, src); break;
+        case Image::SingleChannel:  CameraFrameHelpers::copyRows<PixelAlpha> (frame.pixels, src); break;
+        default:                    jassertfalse; frame.width = frame.height = 0; break;
+    }
+}
+
+void CameraFramePool::write (const Image& image)
+{
+    if (! image.isValid())
+        return;
+
+    Frame& frame = frames[writeIndex];
+    copyImage (frame, image);
+    frame.sequenceNumber = nextSequenceNumber++;
+
+    // hand the filled buffer over and take back whichever one was shared
+    const int previous = shared.exchange (writeIndex | freshFlag);
+
+    if ((previous & freshFlag) != 0)
+        ++numDropped;
+
+    writeIndex = previous & indexMask;
+}
+
+const CameraFramePool::Frame* CameraFramePool::read()
+{
+    if ((shared.get() & freshFlag) == 0)
+        return nullptr;
+
+    readIndex = shared.exchange (readIndex) & indexMask;
+    return frames + readIndex;
+}
+
+//==============================================================================
+CameraTexture::CameraTexture()
+    : textureID (0), width (0), height (0), nextPixelBuffer (0)
+{
+    zerostruct (pixelBuffers);
+}
+
+CameraTexture::~CameraTexture()
+{
+    // the texture must be deleted on the GL thread, by releaseGLResources()
+    jassert (textureID == 0);
+}
+
+void CameraTexture::upload (OpenGLContext& context, const CameraFramePool::Frame& frame)
+{
+    if (frame.width <= 0 || frame.height <= 0)
+        return;
+
+    const GLsizeiptr numBytes = (GLsizeiptr) (frame.width * frame.height * (int) sizeof (PixelARGB));
+
+    if (textureID == 0)
+    {
+        glGenTextures (1, &textureID);
+        glBindTexture (GL_TEXTURE_2D, textureID);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        context.extensions.glGenBuffers (numPixelBuffers, pixelBuffers);
+        width = height = 0;
+    }
+    else
+    {
+        glBindTexture (GL_TEXTURE_2D, textureID);
+    }
+
+    // the texture storage only needs reallocating if the camera's resolution changes
+    if (width != frame.width || height != frame.height)
+    {
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, frame.width, frame.height, 0, JUCE_RGBA_FORMAT, GL_UNSIGNED_BYTE, nullptr);
+        width = frame.width;
+        height = frame.height;
+    }
+
+    // Orphaning the buffer gives it fresh storage if the GPU is still reading
+    // the old contents, rather than making glBufferSubData wait.
+    context.extensions.glBindBuffer (GL_PIXEL_UNPACK_BUFFER, pixelBuffers[nextPixelBuffer]);
+    context.extensions.glBufferData (GL_PIXEL_UNPACK_BUFFER, numBytes, nullptr, GL_STREAM_DRAW);
+    context.extensions.glBufferSubData (GL_PIXEL_UNPACK_BUFFER, 0, numBytes, frame.pixels);
+
+    // with a pixel buffer bound, the last argument is an offset into it
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, width, height, JUCE_RGBA_FORMAT, GL_UNSIGNED_BYTE, nullptr);
+
+    context.extensions.glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+    nextPixelBuffer = (nextPixelBuffer + 1) % numPixelBuffers;
+}
+
+void CameraTexture::bind() const
+{
+    if (textureID != 0)
+        glBindTexture (GL_TEXTURE_2D, textureID);
+}
+
+void CameraTexture::drawFullScreen() const
+{
+    if (textureID == 0)
+        return;
+
+    glMatrixMode (GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode (GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glPushAttrib (GL_ENABLE_BIT | GL_CURRENT_BIT);
+    glDisable (GL_DEPTH_TEST);
+    glDisable (GL_LIGHTING);
+    glDisable (GL_BLEND);
+    glEnable (GL_TEXTURE_2D);
+    bind();
+
+    // the rows were stored bottom first, so the texture is already the right way up
+    glColor4f (1.0f, 1.0f, 1.0f, 1.0f);
+    glBegin (GL_QUADS);
+    glTexCoord2f (0.0f, 0.0f);  glVertex2f (-1.0f, -1.0f);
+    glTexCoord2f (1.0f, 0.0f);  glVertex2f ( 1.0f, -1.0f);
+    glTexCoord2f (1.0f, 1.0f);  glVertex2f ( 1.0f,  1.0f);
+    glTexCoord2f (0.0f, 1.0f);  glVertex2f (-1.0f,  1.0f);
+    glEnd();
+
+    glPopAttrib();
+    glMatrixMode (GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode (GL_MODELVIEW);
+    glPopMatrix();
+}
+
+void CameraTexture::releaseGLResources (OpenGLContext& context)
+{
+    if (textureID != 0)
+    {
+        glDeleteTextures (1, &textureID);
+        context.extensions.glDeleteBuffers (numPixelBuffers, pixelBuffers);
+        textureID = 0;
+        zerostruct (pixelBuffers);
+    }
+
+    width = height = 0;
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class CameraFramePoolTests  : public UnitTest
+{
+public:
+    CameraFramePoolTests() : UnitTest ("CameraFramePool") {}
+
+    static Image createFrame (int w, int h, uint8 value)
+    {
+        Image image (Image::RGB, w, h, false);
+        image.clear (image.getBounds(), Colour (value, value, value));
+        return image;
+    }
+
+    void runTest()
+    {
+        beginTest ("Latest frame wins");
+        {
+            CameraFramePool pool (8, 6);
+            expect (pool.read() == nullptr);
+
+            pool.write (createFrame (8, 6, 10));
+            pool.write (createFrame (8, 6, 20));
+
+            const CameraFramePool::Frame* frame = pool.read();
+            expect (frame != nullptr);
+            expectEquals ((int) frame->pixels[0].getRed(), 20);
+            expectEquals ((int) frame->sequenceNumber, 2);
+            expectEquals (pool.getNumDroppedFrames(), 1);
+            expect (pool.read() == nullptr);
+
+            pool.write (createFrame (8, 6, 30));
+            frame = pool.read();
+            expect (frame != nullptr);
+            expectEquals ((int) frame->pixels[0].getRed(), 30);
+            expectEquals ((int) frame->pixels[0].getAlpha(), 255);
+        }
+
+        beginTest ("Rows are stored bottom first");
+        {
+            CameraFramePool pool (4, 4);
+            Image image (createFrame (4, 4, 0));
+            image.setPixelAt (0, 0, Colours::white);
+
+            pool.write (image);
+            const CameraFramePool::Frame* frame = pool.read();
+            expectEquals ((int) frame->pixels[4 * 3].getRed(), 255);
+            expectEquals ((int) frame->pixels[0].getRed(), 0);
+        }
+
+        beginTest ("Buffers are reused at a steady size");
+        {
+            CameraFramePool pool (16, 16);
+            Array<const PixelARGB*> buffersSeen;
+
+            for (int i = 0; i < 30; ++i)
+            {
+                pool.write (createFrame (16, 16, (uint8) i));
+
+                if (i % 3 == 0)
+                {
+                    const CameraFramePool::Frame* frame = pool.read();
+                    expect (frame != nullptr && frame->width == 16 && frame->numPixelsAllocated == 256);
+                    buffersSeen.addIfNotAlreadyThere (frame->pixels);
+                }
+            }
+
+            expect (buffersSeen.size() <= 3);
+
+            // a bigger frame grows whichever buffer it lands in
+            pool.write (createFrame (32, 8, 1));
+            const CameraFramePool::Frame* frame = pool.read();
+            expect (frame->width == 32 && frame->numPixelsAllocated == 256);
+
+            pool.write (createFrame (32, 16, 1));
+            frame = pool.read();
+            expect (frame->width == 32 && frame->numPixelsAllocated == 512);
+        }
+
+        beginTest ("Frames cross threads");
+        {
+            CameraFramePool pool (64, 48);
+
+            struct Writer  : public Thread
+            {
+                Writer (CameraFramePool& p) : Thread ("camera"), pool (p) {}
+
+                void run() override
+                {
+                    for (int i = 1; i <= 2000 && ! threadShouldExit(); ++i)
+                        pool.write (createFrame (64, 48, (uint8) i));
+                }
+
+                CameraFramePool& pool;
+            };
+
+            Writer writer (pool);
+            writer.startThread();
+
+            uint32 lastSequence = 0;
+            int numRead = 0;
+
+            while (writer.isThreadRunning() || lastSequence < 2000)
+            {
+                if (const CameraFramePool::Frame* frame = pool.read())
+                {
+                    expect (frame->sequenceNumber > lastSequence);
+
+                    // every pixel of a frame should come from the same image
+                    const uint8 value = frame->pixels[0].getRed();
+                    expectEquals ((int) frame->pixels[64 * 48 - 1].getRed(), (int) value);
+                    expectEquals ((int) value, (int) (uint8) frame->sequenceNumber);
+
+                    lastSequence = frame->sequenceNumber;
+                    ++numRead;
+                }
+                else if (! writer.isThreadRunning())
+                {
+                    break;
+                }
+            }
+
+            expectEquals ((int) lastSequence, 2000);
+            expectEquals (numRead + pool.getNumDroppedFrames(), 2000);
+        }
+    }
+};
+
+static CameraFramePoolTests cameraFramePoolTests;
+
+#endif
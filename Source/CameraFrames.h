@@ -0,0 +1,113 @@
+/*
+  ==============================================================================
+
+    CameraFrames.h
+
+  ==============================================================================
+*/
+
+#ifndef CAMERAFRAMES_H_INCLUDED
+#define CAMERAFRAMES_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/**
+    Hands the newest camera frame from the camera's thread to the GL thread
+    through three preallocated pixel buffers.
+
+    The camera thread owns one buffer to write into, the reader owns the one it
+    last read, and the third is passed between them with an atomic exchange, as
+    in LeapUtil::LeapFrameExchange. Writing a frame that replaces one that was
+    never read just drops the older one, so the reader always gets the latest
+    frame and neither side ever waits for the other. The buffers are only
+    reallocated when a frame is bigger than any they've held, so at a steady
+    camera resolution nothing is allocated at all.
+
+    Only one thread may call write(), and only one may call read().
+*/
+class CameraFramePool
+{
+public:
+    /** The buffers are allocated up front to hold frames of this size. */
+    CameraFramePool (int initialWidth = 640, int initialHeight = 480);
+    ~CameraFramePool();
+
+    struct Frame
+    {
+        HeapBlock<PixelARGB> pixels;    // bottom row first, as GL wants them
+        int width, height;
+        uint32 sequenceNumber;
+        size_t numPixelsAllocated;
+    };
+
+    /** Called on the camera thread to copy an image into the pool as the newest frame. */
+    void write (const Image&);
+
+    /** Returns the newest frame if one has arrived since the last call, or nullptr.
+        The frame stays valid until the next call, when its buffer goes back to the pool.
+    */
+    const Frame* read();
+
+    /** The number of frames that were replaced before they could be read. */
+    int getNumDroppedFrames() const noexcept        { return numDropped.get(); }
+
+private:
+    enum { numFrames = 3, indexMask = 3, freshFlag = 4 };
+
+    Frame frames[numFrames];
+    Atomic<int> shared, numDropped;
+    int writeIndex;             // writer only
+    int readIndex;              // reader only
+    uint32 nextSequenceNumber;  // writer only
+
+    static void copyImage (Frame&, const Image&);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CameraFramePool)
+};
+
+//==============================================================================
+/**
+    A texture that's refilled with a new camera frame every time one arrives.
+
+    Frames are copied into one of two pixel buffer objects and the texture is
+    updated from there, so glTexSubImage2D returns straight away and the transfer
+    happens while the GPU gets on with other work. Alternating between the two
+    buffers, and orphaning each one before refilling it, means a new frame never
+    has to wait for the previous one's transfer to finish.
+*/
+class CameraTexture
+{
+public:
+    CameraTexture();
+
+    /** releaseGLResources() must have been called before this is deleted. */
+    ~CameraTexture();
+
+    /** Called on the GL thread to replace the texture's contents. */
+    void upload (OpenGLContext&, const CameraFramePool::Frame&);
+
+    /** Binds the texture, if anything has been uploaded. */
+    void bind() const;
+
+    /** Draws the texture over the whole viewport, and leaves it bound. */
+    void drawFullScreen() const;
+
+    bool isEmpty() const noexcept               { return textureID == 0; }
+    int getWidth() const noexcept               { return width; }
+    int getHeight() const noexcept              { return height; }
+
+    /** Called on the GL thread to delete the texture and its buffers. */
+    void releaseGLResources (OpenGLContext&);
+
+private:
+    enum { numPixelBuffers = 2 };
+
+    GLuint textureID, pixelBuffers[numPixelBuffers];
+    int width, height, nextPixelBuffer;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CameraTexture)
+};
+
+
+#endif  // CAMERAFRAMES_H_INCLUDED
@@ -1,10 +1,17 @@
+// the NI driver only exists on Windows; other builds use SoftwareHapticDevice. This is the
+// same check as HapticsOutput.cpp makes, without bringing in the rest of JUCE, whose int32
+// would clash with NIDAQmx's.
+#include "../JuceLibraryCode/modules/juce_core/system/juce_TargetPlatform.h"
+
+#if JUCE_WINDOWS
+
 #include "DAQMXclass.h"
 
 #define DAQmxErrChk(functionCall) if( DAQmxFailed(this->error=(functionCall)) ) goto Error; else
 
 char errBuff[2048]={'\0'};
 
-DAQMX::DAQMX(char *portName)
+DAQMX::DAQMX(const char *portName)
 {
 	uInt8 dc[8] = {Nsamp/2, Nsamp/2, Nsamp/2, Nsamp/2, Nsamp/2, Nsamp/2, Nsamp/2, Nsamp/2};
 
@@ -25,12 +32,12 @@ DAQMX::DAQMX(char *portName)
 	/*********************************************/
 	// DAQmx Create initial waveform buffer
 	/*********************************************/
-	createPWM(dc);			// updates DAQdata
+	waveform.build(dc);
 
 	/*********************************************/
 	// DAQmx Start Code
 	/*********************************************/
-	DAQmxErrChk (DAQmxWriteDigitalU8(taskHandle,Nsamp,0,10.0,DAQmx_Val_GroupByChannel,DAQdata,NULL,NULL));
+	DAQmxErrChk (DAQmxWriteDigitalU8(taskHandle,Nsamp,0,10.0,DAQmx_Val_GroupByChannel,waveform.getData(),NULL,NULL));
 	DAQmxErrChk (DAQmxStartTask(taskHandle));
 
 	connected = true;
@@ -63,12 +70,17 @@ bool DAQMX::IsConnected()
     return this->connected;
 }
 
-void DAQMX::writePWM(uInt8 dc[8])
+int DAQMX::GetNumChannels()
+{
+	return 8;
+}
+
+void DAQMX::writePWM(const uInt8 *dc)
 {
 	error = 0;
 
-	createPWM(dc);
-	DAQmxErrChk (DAQmxWriteDigitalU8(taskHandle,Nsamp,0,10.0,DAQmx_Val_GroupByChannel,DAQdata,NULL,NULL));
+	waveform.build(dc);
+	DAQmxErrChk (DAQmxWriteDigitalU8(taskHandle,Nsamp,0,10.0,DAQmx_Val_GroupByChannel,waveform.getData(),NULL,NULL));
 
 Error:
 	if( DAQmxFailed(error) ) {
@@ -77,13 +89,4 @@ Error:
 	}
 }
 
-void DAQMX::createPWM(uInt8 dc[8])
-{
-	for(int i=0;i<Nsamp;i++) {
-		DAQdata[i] = 0;
-		for(int j=7;j>=0;j--) {
-			DAQdata[i] <<= 1;
-			DAQdata[i] += (i < dc[j]) ? 1 : 0;
-		}
-	}
-}
\ No newline at end of file
+#endif // JUCE_WINDOWS
\ No newline at end of file
@@ -0,0 +1,167 @@
+// the NI driver only exists on Windows; other builds use SoftwareHapticDevice. This is the
+// same check as HapticsOutput.cpp makes, without bringing in the rest of JUCE, whose int32
+// would clash with NIDAQmx's.
+#include "../JuceLibraryCode/modules/juce_core/system/juce_TargetPlatform.h"
+
+#if JUCE_WINDOWS
+
+#include "DAQMXArray.h"
+
+#define DAQmxErrChk(functionCall) if( DAQmxFailed(this->error=(functionCall)) ) goto Error; else
+
+DAQMXArray::DAQMXArray(const Lines *lines, int numTasks, double clockRate)
+{
+	this->numTasks = 0;
+	this->numChannels = 0;
+	this->lastSamplesWritten = 0;
+	this->error = 0;
+
+	if (numTasks > MaxTasks)
+	{
+		printf("DAQMXArray: only the first %d of %d tasks will be used\n", MaxTasks, numTasks);
+		numTasks = MaxTasks;
+	}
+
+	for (int i = 0; i < numTasks; i++)
+	{
+		Task &task = tasks[this->numTasks++];
+
+		task.taskHandle = 0;
+		task.firstChannel = this->numChannels;
+		task.numLines = (lines[i].numLines < MaxLinesPerTask) ? lines[i].numLines : MaxLinesPerTask;
+		task.connected = false;
+
+		this->numChannels += task.numLines;
+
+		startTask(task, lines[i].name, clockRate);
+	}
+}
+
+DAQMXArray::~DAQMXArray()
+{
+	for (int i = 0; i < numTasks; i++)
+	{
+		Task &task = tasks[i];
+
+		if (task.taskHandle != 0)
+		{
+			/*********************************************/
+			// DAQmx Stop Code
+			/*********************************************/
+			if (task.connected)
+				DAQmxStopTask(task.taskHandle);
+
+			DAQmxClearTask(task.taskHandle);
+			task.connected = false;
+		}
+	}
+}
+
+bool DAQMXArray::IsConnected()
+{
+	for (int i = 0; i < numTasks; i++)
+		if (!tasks[i].connected)
+			return false;
+
+	return numTasks > 0;
+}
+
+int DAQMXArray::GetNumChannels()
+{
+	return numChannels;
+}
+
+int DAQMXArray::GetLastSamplesWritten()
+{
+	return lastSamplesWritten;
+}
+
+bool DAQMXArray::startTask(Task &task, const char *lines, double clockRate)
+{
+	uInt8 dc[MaxLinesPerTask] = {0};
+
+	error = 0;
+
+	// start every line at a duty cycle of 128, like DAQMX
+	for (int j = 0; j < task.numLines; j++)
+		dc[j] = 128;
+
+	task.waveform.build(dc);
+
+	/*********************************************/
+	// DAQmx Configure Code
+	/*********************************************/
+	DAQmxErrChk (DAQmxCreateTask("",&task.taskHandle));
+	DAQmxErrChk (DAQmxCreateDOChan(task.taskHandle,lines,"",DAQmx_Val_ChanForAllLines));
+	DAQmxErrChk (DAQmxCfgSampClkTiming(task.taskHandle,"",clockRate,DAQmx_Val_Rising,DAQmx_Val_ContSamps,Nsamp));
+
+	// the device keeps replaying its buffer, and later writes land at an offset from its
+	// first sample, so that just the part of the period that changed can be replaced
+	DAQmxErrChk (DAQmxSetWriteRegenMode(task.taskHandle,DAQmx_Val_AllowRegen));
+	DAQmxErrChk (DAQmxSetWriteRelativeTo(task.taskHandle,DAQmx_Val_FirstSample));
+	DAQmxErrChk (DAQmxSetWriteOffset(task.taskHandle,0));
+
+	/*********************************************/
+	// DAQmx Start Code
+	/*********************************************/
+	DAQmxErrChk (DAQmxWriteDigitalU32(task.taskHandle,Nsamp,0,10.0,DAQmx_Val_GroupByChannel,task.waveform.getData(),NULL,NULL));
+	DAQmxErrChk (DAQmxStartTask(task.taskHandle));
+
+	task.connected = true;
+
+Error:
+	if( DAQmxFailed(error) ) {
+		reportError();
+		return false;
+	}
+
+	return true;
+}
+
+void DAQMXArray::writePWM(const uInt8 *dc)
+{
+	lastSamplesWritten = 0;
+
+	// build and send each card's update in turn, so that no card waits for another's buffer
+	for (int i = 0; i < numTasks; i++)
+		if (tasks[i].connected)
+			updateTask(tasks[i], dc + tasks[i].firstChannel);
+}
+
+bool DAQMXArray::updateTask(Task &task, const uInt8 *dc)
+{
+	uInt8 padded[MaxLinesPerTask] = {0};
+	int first, last;
+
+	error = 0;
+
+	// The lines past numLines don't exist, so keep them off. Moving a line's duty cycle
+	// only changes the samples between its old and new value, and just that span is sent.
+	memcpy(padded, dc, task.numLines);
+
+	if (!task.waveform.update(padded, first, last))
+		return true;
+
+	DAQmxErrChk (DAQmxSetWriteOffset(task.taskHandle,first));
+	DAQmxErrChk (DAQmxWriteDigitalU32(task.taskHandle,last - first,0,10.0,DAQmx_Val_GroupByChannel,task.waveform.getData() + first,NULL,NULL));
+
+	lastSamplesWritten += last - first;
+
+Error:
+	if( DAQmxFailed(error) ) {
+		reportError();
+		return false;
+	}
+
+	return true;
+}
+
+void DAQMXArray::reportError()
+{
+	char errBuff[2048]={'\0'};
+
+	DAQmxGetExtendedErrorInfo(errBuff,2048);
+	printf("DAQmx Error: %s\n",errBuff);
+}
+
+#endif // JUCE_WINDOWS
@@ -0,0 +1,59 @@
+#ifndef DAQMXARRAY_H_INCLUDED
+#define DAQMXARRAY_H_INCLUDED
+
+#include "DAQMXclass.h"
+#include "PWMWaveform.h"
+
+// PWM output spread over several ports and cards.
+// Each entry in the line list becomes one DAQmx task holding a single channel with up to
+// 32 lines, e.g. "Dev1/port0:3" or "Dev2/port3/line0:7", whose samples are written as
+// uInt32 with one bit per line. Output channels are numbered through the entries in order,
+// so with {"Dev1/port0:3", 32}, {"Dev2/port0:1", 16} channel 40 is Dev2's line 8.
+class DAQMXArray : public HapticOutputDevice
+{
+    public:
+        enum { MaxLinesPerTask = 32, MaxTasks = 16 };
+
+        struct Lines
+        {
+            const char *name;   // physical lines for one device, as passed to DAQmxCreateDOChan
+            int numLines;       // how many lines that string covers
+        };
+
+        // Create and start one task per entry. Every task runs its own sample clock at
+        // clockRate and regenerates its Nsamp long buffer until the next write.
+        DAQMXArray(const Lines *lines, int numTasks, double clockRate = Fclk);
+        // Stop and clear all the tasks
+        ~DAQMXArray();
+        // True if every task was started
+        bool IsConnected();
+        // Total number of lines over all the tasks
+        int GetNumChannels();
+        // [d]uty [c]ycle has GetNumChannels() values between 0 and 255.
+        // Tasks whose duty cycles haven't changed are skipped, and the others only rewrite
+        // the samples that differ from the waveform already in the device's buffer.
+        void writePWM(const uInt8 *dc);
+        // Number of samples written over all tasks by the last writePWM, for profiling
+        int GetLastSamplesWritten();
+
+    private:
+        struct Task
+        {
+            TaskHandle taskHandle;
+            int firstChannel, numLines;
+            bool connected;
+            PWMWaveform<Nsamp, MaxLinesPerTask> waveform;   // as last written to the device
+        };
+
+        Task tasks[MaxTasks];
+        int numTasks, numChannels;
+        int lastSamplesWritten;
+        //Keep track of last error
+        int32 error;
+
+        bool startTask(Task &task, const char *lines, double clockRate);
+        bool updateTask(Task &task, const uInt8 *dc);
+        void reportError();
+};
+
+#endif // DAQMXARRAY_H_INCLUDED
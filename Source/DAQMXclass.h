@@ -7,33 +7,34 @@
 #include <stdint.h>
 #include <NIDAQmx.h>
 
-#define Nsamp	256
-#define Fclk	Nsamp*30000 // must be less than 10Mhz, which is max clock supported by PCIe-6535
+#include "HapticOutputDevice.h"
+#include "PWMWaveform.h"
 
-class DAQMX
+class DAQMX : public HapticOutputDevice
 {
     private:
         //DAQmx task handle
        	TaskHandle taskHandle;
 		//DAQmx u8 waveform
-		uInt8 DAQdata[Nsamp];
+		PWMWaveform<Nsamp, 8> waveform;
         //Connection status
         bool connected;
         //Keep track of last error
         int32 error;
-		void createPWM(uInt8 dc[8]);
 
     public:
         //Initialize Serial communication with the given COM port
-        DAQMX(char *portName);
+        DAQMX(const char *portName);
         //Close the connection
         //NOTA: for some reason you can't connect again before exiting
         //the program and running it again
         ~DAQMX();
         //Check if we are actually connected
         bool IsConnected();
+		//Always 8, one per line of the port
+		int GetNumChannels();
 		// [d]uty [c]ycle has 8 values between 0 and 255
-		void writePWM(uInt8 dc[8]);
+		void writePWM(const uInt8 *dc);
 };
 
 #endif // SERIALCLASS_H_INCLUDED
\ No newline at end of file
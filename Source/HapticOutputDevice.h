@@ -0,0 +1,24 @@
+#ifndef HAPTICOUTPUTDEVICE_H_INCLUDED
+#define HAPTICOUTPUTDEVICE_H_INCLUDED
+
+#include <stdint.h>
+
+#define Nsamp	256
+#define Fclk	Nsamp*30000 // must be less than 10Mhz, which is max clock supported by PCIe-6535
+
+// Something that turns duty cycles into PWM on a set of digital lines.
+// DAQMX and DAQMXArray drive real NI cards; SoftwareHapticDevice stands in for them
+// where there's no hardware or driver, e.g. on Linux and in the unit tests.
+class HapticOutputDevice
+{
+    public:
+        virtual ~HapticOutputDevice() {}
+        // True if the outputs are running
+        virtual bool IsConnected() = 0;
+        // Number of output lines
+        virtual int GetNumChannels() = 0;
+        // [d]uty [c]ycle has GetNumChannels() values between 0 and 255
+        virtual void writePWM(const uint8_t *dc) = 0;
+};
+
+#endif // HAPTICOUTPUTDEVICE_H_INCLUDED
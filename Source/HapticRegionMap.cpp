@@ -0,0 +1,690 @@
+/*
+  ==============================================================================
+
+    HapticRegionMap.cpp
+
+  ==============================================================================
+*/
+
+#include "HapticRegionMap.h"
+
+namespace
+{
+    // The shape tests are done this many at a time: first a branch-free pass that
+    // just fills in a mask, which the compiler can vectorise, then a pass over the
+    // few hits.
+    enum { testBlockSize = 64 };
+
+    // Aim for about this many grid cells per region.
+    const float cellsPerRegion = 2.0f;
+    const int maxCellsPerAxis = 64;
+
+    inline float getAxis (const Leap::Vector& v, int axis) noexcept
+    {
+        return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+    }
+}
+
+//==============================================================================
+void HapticRegionMap::BoxList::clear()
+{
+    minX.clearQuick(); minY.clearQuick(); minZ.clearQuick();
+    maxX.clearQuick(); maxY.clearQuick(); maxZ.clearQuick();
+    region.clearQuick();
+}
+
+void HapticRegionMap::BoxList::add (const Region& r, int regionIndex)
+{
+    minX.add (r.a.x); minY.add (r.a.y); minZ.add (r.a.z);
+    maxX.add (r.b.x); maxY.add (r.b.y); maxZ.add (r.b.z);
+    region.add (regionIndex);
+}
+
+void HapticRegionMap::CapsuleList::clear()
+{
+    startX.clearQuick(); startY.clearQuick(); startZ.clearQuick();
+    dirX.clearQuick(); dirY.clearQuick(); dirZ.clearQuick();
+    invLengthSquared.clearQuick(); radiusSquared.clearQuick();
+    region.clearQuick();
+}
+
+void HapticRegionMap::CapsuleList::add (const Region& r, int regionIndex)
+{
+    const Leap::Vector dir (r.b - r.a);
+    const float lengthSquared = dir.magnitudeSquared();
+
+    startX.add (r.a.x); startY.add (r.a.y); startZ.add (r.a.z);
+    dirX.add (dir.x);   dirY.add (dir.y);   dirZ.add (dir.z);
+
+    // a sphere is a capsule with no length: its closest point is always the start
+    invLengthSquared.add (lengthSquared > 0.0f ? 1.0f / lengthSquared : 0.0f);
+    radiusSquared.add (r.radius * r.radius);
+    region.add (regionIndex);
+}
+
+//==============================================================================
+HapticRegionMap::HapticRegionMap()
+    : needsBuild (false)
+{
+    numCells[0] = numCells[1] = numCells[2] = 0;
+}
+
+HapticRegionMap::~HapticRegionMap()
+{
+}
+
+void HapticRegionMap::clear()
+{
+    regions.clear();
+    ramps.clear();
+    rampRegions.clear();
+    needsBuild = true;
+}
+
+int HapticRegionMap::addRegion (Shape shape, const Leap::Vector& a, const Leap::Vector& b, float radius)
+{
+    Region r;
+    r.shape = shape;
+    r.a = a;
+    r.b = b;
+    r.radius = radius;
+    r.firstRamp = r.numRamps = 0;
+
+    regions.add (r);
+    needsBuild = true;
+    return regions.size() - 1;
+}
+
+int HapticRegionMap::addSphere (const Leap::Vector& centre, float radius)
+{
+    return addRegion (capsuleShape, centre, centre, radius);
+}
+
+int HapticRegionMap::addBox (const Leap::Vector& minCorner, const Leap::Vector& maxCorner)
+{
+    jassert (minCorner.x <= maxCorner.x && minCorner.y <= maxCorner.y && minCorner.z <= maxCorner.z);
+    return addRegion (boxShape, minCorner, maxCorner, 0.0f);
+}
+
+int HapticRegionMap::addCapsule (const Leap::Vector& start, const Leap::Vector& end, float radius)
+{
+    return addRegion (capsuleShape, start, end, radius);
+}
+
+void HapticRegionMap::addRamp (int regionIndex, int channel, Axis axis, float offset, float gain, int subtractFrom)
+{
+    jassert (isPositiveAndBelow (regionIndex, regions.size()));
+
+    ChannelRamp ramp = { channel, axis, offset, gain, subtractFrom };
+    ramps.add (ramp);
+    rampRegions.add (regionIndex);
+    needsBuild = true;
+}
+
+void HapticRegionMap::addFourBarLayout()
+{
+    // Each bar is 1 long and 0.2 thick, centred 0.5 from the origin in the z = 0 plane.
+    // Along the bar, one end's actuator rises from 127 to 255 while the other falls
+    // from 255 to 128, as 383 minus the rising value.
+    const int up    = addBox (Leap::Vector (-0.5f,  0.4f, -0.1f), Leap::Vector ( 0.5f,  0.6f, 0.1f));
+    const int down  = addBox (Leap::Vector (-0.5f, -0.6f, -0.1f), Leap::Vector ( 0.5f, -0.4f, 0.1f));
+    const int right = addBox (Leap::Vector ( 0.4f, -0.5f, -0.1f), Leap::Vector ( 0.6f,  0.5f, 0.1f));
+    const int left  = addBox (Leap::Vector (-0.6f, -0.5f, -0.1f), Leap::Vector (-0.4f,  0.5f, 0.1f));
+
+    // M1 (p3.0) and M2 (p3.2)
+    addRamp (up, 0, xAxis, 191.25f, 127.5f);
+    addRamp (up, 2, xAxis, 191.25f, 127.5f, 383);
+
+    // M3 (p3.3) and M4 (p3.4)
+    addRamp (down, 3, xAxis, 191.25f, 127.5f, 383);
+    addRamp (down, 4, xAxis, 191.25f, 127.5f);
+
+    // M1 and M4
+    addRamp (right, 0, yAxis, 191.25f, 127.5f);
+    addRamp (right, 4, yAxis, 191.25f, 127.5f, 383);
+
+    // M2 and M3
+    addRamp (left, 2, yAxis, 191.25f, 127.5f);
+    addRamp (left, 3, yAxis, 191.25f, 127.5f, 383);
+}
+
+//==============================================================================
+void HapticRegionMap::getBounds (const Region& r, Leap::Vector& low, Leap::Vector& high) const noexcept
+{
+    const Leap::Vector pad (r.radius, r.radius, r.radius);
+
+    low  = Leap::Vector (jmin (r.a.x, r.b.x), jmin (r.a.y, r.b.y), jmin (r.a.z, r.b.z)) - pad;
+    high = Leap::Vector (jmax (r.a.x, r.b.x), jmax (r.a.y, r.b.y), jmax (r.a.z, r.b.z)) + pad;
+}
+
+int HapticRegionMap::getCellIndex (const Leap::Vector& p) const noexcept
+{
+    if (cells.size() == 0)
+        return -1;
+
+    int index = 0;
+
+    for (int axis = 3; --axis >= 0;)
+    {
+        const float cell = (getAxis (p, axis) - getAxis (gridOrigin, axis)) * getAxis (cellScale, axis);
+
+        // outside the grid means outside every region
+        if (! (cell >= 0.0f && cell <= (float) numCells[axis]))
+            return -1;
+
+        index = index * numCells[axis] + jmin ((int) cell, numCells[axis] - 1);
+    }
+
+    return index;
+}
+
+void HapticRegionMap::build()
+{
+    // gather each region's ramps together
+    sortedRamps.clearQuick();
+
+    for (int i = 0; i < regions.size(); ++i)
+    {
+        Region& r = regions.getReference (i);
+        r.firstRamp = sortedRamps.size();
+
+        for (int j = 0; j < ramps.size(); ++j)
+            if (rampRegions.getUnchecked (j) == i)
+                sortedRamps.add (ramps.getReference (j));
+
+        r.numRamps = sortedRamps.size() - r.firstRamp;
+    }
+
+    cells.clearQuick();
+    boxes.clear();
+    capsules.clear();
+    needsBuild = false;
+
+    if (regions.size() == 0)
+    {
+        numCells[0] = numCells[1] = numCells[2] = 0;
+        return;
+    }
+
+    // size the grid to the regions' combined bounds
+    Leap::Vector low, high;
+    getBounds (regions.getReference (0), low, high);
+
+    for (int i = 1; i < regions.size(); ++i)
+    {
+        Leap::Vector l, h;
+        getBounds (regions.getReference (i), l, h);
+
+        low  = Leap::Vector (jmin (low.x, l.x),  jmin (low.y, l.y),  jmin (low.z, l.z));
+        high = Leap::Vector (jmax (high.x, h.x), jmax (high.y, h.y), jmax (high.z, h.z));
+    }
+
+    const float minExtent = 1.0e-4f;
+    const Leap::Vector extent (jmax (minExtent, high.x - low.x),
+                               jmax (minExtent, high.y - low.y),
+                               jmax (minExtent, high.z - low.z));
+
+    // roughly cubic cells, so that flat layouts don't get split along their thin axis
+    const float targetCells = jmax (1.0f, cellsPerRegion * (float) regions.size());
+    const float cellSize = std::pow (extent.x * extent.y * extent.z / targetCells, 1.0f / 3.0f);
+
+    for (int axis = 0; axis < 3; ++axis)
+        numCells[axis] = jlimit (1, maxCellsPerAxis, (int) std::ceil (getAxis (extent, axis) / cellSize));
+
+    gridOrigin = low;
+    cellScale = Leap::Vector (numCells[0] / extent.x, numCells[1] / extent.y, numCells[2] / extent.z);
+
+    // every region goes into each cell its bounding box overlaps
+    const int totalCells = numCells[0] * numCells[1] * numCells[2];
+    Array<Array<int> > cellRegions;
+    cellRegions.resize (totalCells);
+
+    for (int i = 0; i < regions.size(); ++i)
+    {
+        Leap::Vector l, h;
+        getBounds (regions.getReference (i), l, h);
+
+        int first[3], last[3];
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const float origin = getAxis (gridOrigin, axis), scale = getAxis (cellScale, axis);
+            first[axis] = jlimit (0, numCells[axis] - 1, (int) ((getAxis (l, axis) - origin) * scale));
+            last[axis]  = jlimit (0, numCells[axis] - 1, (int) ((getAxis (h, axis) - origin) * scale));
+        }
+
+        for (int z = first[2]; z <= last[2]; ++z)
+            for (int y = first[1]; y <= last[1]; ++y)
+                for (int x = first[0]; x <= last[0]; ++x)
+                    cellRegions.getReference ((z * numCells[1] + y) * numCells[0] + x).add (i);
+    }
+
+    for (int c = 0; c < totalCells; ++c)
+    {
+        const Array<int>& list = cellRegions.getReference (c);
+
+        Cell cell;
+        cell.firstBox = boxes.region.size();
+        cell.firstCapsule = capsules.region.size();
+
+        for (int i = 0; i < list.size(); ++i)
+        {
+            const int regionIndex = list.getUnchecked (i);
+            const Region& r = regions.getReference (regionIndex);
+
+            if (r.shape == boxShape)
+                boxes.add (r, regionIndex);
+            else
+                capsules.add (r, regionIndex);
+        }
+
+        cell.numBoxes = boxes.region.size() - cell.firstBox;
+        cell.numCapsules = capsules.region.size() - cell.firstCapsule;
+        cells.add (cell);
+    }
+}
+
+//==============================================================================
+void HapticRegionMap::applyRamps (int regionIndex, const Leap::Vector& p, uint8* dutyCycles, int numChannels) const noexcept
+{
+    const Region& r = regions.getReference (regionIndex);
+
+    for (int i = 0; i < r.numRamps; ++i)
+    {
+        const ChannelRamp& ramp = sortedRamps.getReference (r.firstRamp + i);
+
+        if (isPositiveAndBelow (ramp.channel, numChannels))
+        {
+            // done in double, where the product and sum are exact, so that the bars give
+            // the same steps as the old hard-coded tests
+            const int ramped = (int) (ramp.offset + ramp.gain * (double) getAxis (p, ramp.axis));
+            const int value = jlimit (0, 255, ramp.subtractFrom != 0 ? ramp.subtractFrom - ramped : ramped);
+            dutyCycles[ramp.channel] = (uint8) jmax ((int) dutyCycles[ramp.channel], value);
+        }
+    }
+}
+
+int HapticRegionMap::process (const Leap::Vector* points, int numPoints,
+                              uint8* dutyCycles, int numChannels,
+                              Array<Touch>* touches) const
+{
+    jassert (! needsBuild); // you need to call build() after changing the regions!
+
+    int numTouches = 0;
+    uint8 hit[testBlockSize];
+
+    for (int pointIndex = 0; pointIndex < numPoints; ++pointIndex)
+    {
+        const Leap::Vector& p = points[pointIndex];
+        const int cellIndex = getCellIndex (p);
+
+        if (cellIndex < 0)
+            continue;
+
+        const Cell& cell = cells.getReference (cellIndex);
+
+        // boxes..
+        const float* const minX = boxes.minX.begin();
+        const float* const minY = boxes.minY.begin();
+        const float* const minZ = boxes.minZ.begin();
+        const float* const maxX = boxes.maxX.begin();
+        const float* const maxY = boxes.maxY.begin();
+        const float* const maxZ = boxes.maxZ.begin();
+
+        for (int start = cell.firstBox, end = cell.firstBox + cell.numBoxes; start < end; start += testBlockSize)
+        {
+            const int num = jmin ((int) testBlockSize, end - start);
+
+            for (int i = 0; i < num; ++i)
+            {
+                const int j = start + i;
+                hit[i] = (uint8) ((p.x >= minX[j]) & (p.x <= maxX[j])
+                                & (p.y >= minY[j]) & (p.y <= maxY[j])
+                                & (p.z >= minZ[j]) & (p.z <= maxZ[j]));
+            }
+
+            for (int i = 0; i < num; ++i)
+            {
+                if (hit[i] != 0)
+                {
+                    const int regionIndex = boxes.region.getUnchecked (start + i);
+                    applyRamps (regionIndex, p, dutyCycles, numChannels);
+
+                    if (touches != nullptr)
+                    {
+                        const Touch t = { regionIndex, pointIndex };
+                        touches->add (t);
+                    }
+
+                    ++numTouches;
+                }
+            }
+        }
+
+        // ..then capsules and spheres
+        const float* const startX = capsules.startX.begin();
+        const float* const startY = capsules.startY.begin();
+        const float* const startZ = capsules.startZ.begin();
+        const float* const dirX = capsules.dirX.begin();
+        const float* const dirY = capsules.dirY.begin();
+        const float* const dirZ = capsules.dirZ.begin();
+        const float* const invLengthSquared = capsules.invLengthSquared.begin();
+        const float* const radiusSquared = capsules.radiusSquared.begin();
+
+        for (int start = cell.firstCapsule, end = cell.firstCapsule + cell.numCapsules; start < end; start += testBlockSize)
+        {
+            const int num = jmin ((int) testBlockSize, end - start);
+
+            for (int i = 0; i < num; ++i)
+            {
+                const int j = start + i;
+                const float dx = p.x - startX[j], dy = p.y - startY[j], dz = p.z - startZ[j];
+
+                // position of the closest point along the segment, from 0 to 1
+                float t = (dx * dirX[j] + dy * dirY[j] + dz * dirZ[j]) * invLengthSquared[j];
+                t = jmin (1.0f, jmax (0.0f, t));
+
+                const float ox = dx - t * dirX[j], oy = dy - t * dirY[j], oz = dz - t * dirZ[j];
+                hit[i] = (uint8) (ox * ox + oy * oy + oz * oz <= radiusSquared[j]);
+            }
+
+            for (int i = 0; i < num; ++i)
+            {
+                if (hit[i] != 0)
+                {
+                    const int regionIndex = capsules.region.getUnchecked (start + i);
+                    applyRamps (regionIndex, p, dutyCycles, numChannels);
+
+                    if (touches != nullptr)
+                    {
+                        const Touch t = { regionIndex, pointIndex };
+                        touches->add (t);
+                    }
+
+                    ++numTouches;
+                }
+            }
+        }
+    }
+
+    return numTouches;
+}
+
+//==============================================================================
+bool HapticRegionMap::contains (const Region& r, const Leap::Vector& p) const noexcept
+{
+    if (r.shape == boxShape)
+        return p.x >= r.a.x && p.x <= r.b.x
+            && p.y >= r.a.y && p.y <= r.b.y
+            && p.z >= r.a.z && p.z <= r.b.z;
+
+    const Leap::Vector dir (r.b - r.a);
+    const float lengthSquared = dir.magnitudeSquared();
+    const float t = lengthSquared > 0.0f ? jlimit (0.0f, 1.0f, (p - r.a).dot (dir) / lengthSquared) : 0.0f;
+
+    return (p - (r.a + dir * t)).magnitudeSquared() <= r.radius * r.radius;
+}
+
+int HapticRegionMap::processLinear (const Leap::Vector* points, int numPoints,
+                                    uint8* dutyCycles, int numChannels,
+                                    Array<Touch>* touches) const
+{
+    jassert (! needsBuild);
+
+    int numTouches = 0;
+
+    for (int pointIndex = 0; pointIndex < numPoints; ++pointIndex)
+    {
+        for (int regionIndex = 0; regionIndex < regions.size(); ++regionIndex)
+        {
+            if (contains (regions.getReference (regionIndex), points[pointIndex]))
+            {
+                applyRamps (regionIndex, points[pointIndex], dutyCycles, numChannels);
+
+                if (touches != nullptr)
+                {
+                    const Touch t = { regionIndex, pointIndex };
+                    touches->add (t);
+                }
+
+                ++numTouches;
+            }
+        }
+    }
+
+    return numTouches;
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class HapticRegionMapTests  : public UnitTest
+{
+public:
+    HapticRegionMapTests() : UnitTest ("HapticRegionMap") {}
+
+    enum { numChannels = 64, numTips = 10 };
+
+    // The four hard-coded bar tests that the demo used before, for comparison
+    static void originalBarTest (const Leap::Vector& p, uint8* dc)
+    {
+        if (p.distanceTo (Leap::Vector (p.x, p.y, 0)) > 0.1)
+            return;
+
+        int val;
+
+        if (p.y >= 0.4 && p.y <= 0.6 && p.x >= -0.5 && p.x <= 0.5)
+        {
+            val = int (255 * (p.x / 2 + 0.75));
+            dc[0] = (uint8) val;
+            dc[2] = (uint8) jmin (255, 383 - val);
+        }
+
+        if (p.y >= -0.6 && p.y <= -0.4 && p.x >= -0.5 && p.x <= 0.5)
+        {
+            val = int (255 * (p.x / 2 + 0.75));
+            dc[3] = (uint8) jmin (255, 383 - val);
+            dc[4] = (uint8) val;
+        }
+
+        if (p.y >= -0.5 && p.y <= 0.5 && p.x >= 0.4 && p.x <= 0.6)
+        {
+            val = int (255 * (p.y / 2 + 0.75));
+            dc[0] = (uint8) val;
+            dc[4] = (uint8) jmin (255, 383 - val);
+        }
+
+        if (p.y >= -0.5 && p.y <= 0.5 && p.x >= -0.6 && p.x <= -0.4)
+        {
+            val = int (255 * (p.y / 2 + 0.75));
+            dc[2] = (uint8) val;
+            dc[3] = (uint8) jmin (255, 383 - val);
+        }
+    }
+
+    static Leap::Vector randomPoint (Random& r, float size)
+    {
+        return Leap::Vector ((r.nextFloat() - 0.5f) * size,
+                             (r.nextFloat() - 0.5f) * size,
+                             (r.nextFloat() - 0.5f) * size);
+    }
+
+    static void addRandomRegions (HapticRegionMap& map, Random& r, int num, float size)
+    {
+        for (int i = 0; i < num; ++i)
+        {
+            const Leap::Vector centre (randomPoint (r, size));
+            const float s = 0.02f + r.nextFloat() * 0.1f;
+            int region;
+
+            switch (i % 3)
+            {
+                case 0:  region = map.addSphere (centre, s); break;
+                case 1:  region = map.addBox (centre - Leap::Vector (s, s * 0.5f, s), centre + Leap::Vector (s, s * 0.5f, s)); break;
+                default: region = map.addCapsule (centre, centre + randomPoint (r, 0.3f), s * 0.5f); break;
+            }
+
+            map.addRamp (region, r.nextInt (numChannels), (HapticRegionMap::Axis) r.nextInt (3), 128.0f, 100.0f);
+            map.addRamp (region, r.nextInt (numChannels), HapticRegionMap::xAxis, 255.0f, 0.0f);
+        }
+
+        map.build();
+    }
+
+    // Fingertips wandering smoothly around the space, standing in for recorded frames
+    static void makeFrames (Random& r, Array<Leap::Vector>& tips, int numFrames, float size)
+    {
+        Leap::Vector pos[numTips], vel[numTips];
+
+        for (int i = 0; i < numTips; ++i)
+            pos[i] = randomPoint (r, size);
+
+        for (int f = 0; f < numFrames; ++f)
+        {
+            for (int i = 0; i < numTips; ++i)
+            {
+                vel[i] = vel[i] * 0.95f + randomPoint (r, 0.004f);
+                pos[i] += vel[i];
+
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    float& c = axis == 0 ? pos[i].x : (axis == 1 ? pos[i].y : pos[i].z);
+
+                    if (std::abs (c) > size * 0.5f)
+                        c = jlimit (-size * 0.5f, size * 0.5f, c);
+                }
+
+                tips.add (pos[i]);
+            }
+        }
+    }
+
+    static int64 sortKey (const HapticRegionMap::Touch& t) noexcept     { return ((int64) t.point << 32) | t.region; }
+
+    static bool sameTouches (Array<HapticRegionMap::Touch> a, Array<HapticRegionMap::Touch> b)
+    {
+        if (a.size() != b.size())
+            return false;
+
+        Array<int64> ka, kb;
+
+        for (int i = 0; i < a.size(); ++i)
+        {
+            ka.add (sortKey (a.getReference (i)));
+            kb.add (sortKey (b.getReference (i)));
+        }
+
+        DefaultElementComparator<int64> comparator;
+        ka.sort (comparator);
+        kb.sort (comparator);
+        return ka == kb;
+    }
+
+    void runTest() override
+    {
+        beginTest ("Four bars match the old hard-coded tests");
+        {
+            HapticRegionMap map;
+            map.addFourBarLayout();
+            map.build();
+
+            Random r (getRandom());
+            int numHits = 0;
+            bool allMatch = true;
+
+            for (int i = 0; i < 20000; ++i)
+            {
+                const Leap::Vector p (r.nextFloat() * 1.4f - 0.7f, r.nextFloat() * 1.4f - 0.7f, r.nextFloat() * 0.3f - 0.15f);
+
+                // skip the corners where two bars overlap: the old code let the last
+                // test win there, whereas the map takes the highest value
+                if (std::abs (p.x) > 0.4f && std::abs (p.y) > 0.4f)
+                    continue;
+
+                uint8 expected[numChannels] = { 0 }, actual[numChannels] = { 0 };
+                originalBarTest (p, expected);
+                numHits += map.process (&p, 1, actual, numChannels);
+
+                allMatch = allMatch && memcmp (expected, actual, sizeof (expected)) == 0;
+            }
+
+            expect (allMatch);
+            expect (numHits > 0);
+        }
+
+        beginTest ("Grid agrees with a linear scan");
+        {
+            Random r (getRandom());
+            const int sizes[] = { 1, 4, 64, 256, 1024 };
+
+            for (int s = 0; s < numElementsInArray (sizes); ++s)
+            {
+                HapticRegionMap map;
+                addRandomRegions (map, r, sizes[s], 2.0f);
+
+                Array<Leap::Vector> tips;
+                makeFrames (r, tips, 200, 2.0f);
+
+                uint8 gridDuty[numChannels] = { 0 }, linearDuty[numChannels] = { 0 };
+                Array<HapticRegionMap::Touch> gridTouches, linearTouches;
+
+                map.process (tips.begin(), tips.size(), gridDuty, numChannels, &gridTouches);
+                map.processLinear (tips.begin(), tips.size(), linearDuty, numChannels, &linearTouches);
+
+                expect (memcmp (gridDuty, linearDuty, sizeof (gridDuty)) == 0, "duty cycles differ with " + String (sizes[s]) + " regions");
+                expect (sameTouches (gridTouches, linearTouches), "touches differ with " + String (sizes[s]) + " regions");
+            }
+        }
+
+        beginTest ("Benchmark");
+        {
+            Random r (getRandom());
+            const int sizes[] = { 4, 64, 256, 1024 };
+            const int numFrames = 5000;
+
+            for (int s = 0; s < numElementsInArray (sizes); ++s)
+            {
+                HapticRegionMap map;
+                addRandomRegions (map, r, sizes[s], 2.0f);
+
+                Array<Leap::Vector> tips;
+                makeFrames (r, tips, numFrames, 2.0f);
+
+                Array<HapticRegionMap::Touch> touches;
+                touches.ensureStorageAllocated (numTips * 8);
+                int gridHits = 0, linearHits = 0;
+
+                const int64 gridStart = Time::getHighResolutionTicks();
+
+                for (int f = 0; f < numFrames; ++f)
+                {
+                    uint8 duty[numChannels] = { 0 };
+                    touches.clearQuick();
+                    gridHits += map.process (tips.begin() + f * numTips, numTips, duty, numChannels, &touches);
+                }
+
+                const int64 linearStart = Time::getHighResolutionTicks();
+
+                for (int f = 0; f < numFrames; ++f)
+                {
+                    uint8 duty[numChannels] = { 0 };
+                    touches.clearQuick();
+                    linearHits += map.processLinear (tips.begin() + f * numTips, numTips, duty, numChannels, &touches);
+                }
+
+                const int64 end = Time::getHighResolutionTicks();
+
+                expectEquals (gridHits, linearHits);
+
+                const double usPerFrame = 1.0e6 / numFrames;
+                logMessage (String (sizes[s]) + " regions, " + String ((int) numTips) + " tips: grid "
+                              + String (Time::highResolutionTicksToSeconds (linearStart - gridStart) * usPerFrame, 2) + " us/frame, linear "
+                              + String (Time::highResolutionTicksToSeconds (end - linearStart) * usPerFrame, 2) + " us/frame");
+            }
+        }
+    }
+};
+
+static HapticRegionMapTests hapticRegionMapTests;
+
+#endif
@@ -0,0 +1,165 @@
+/*
+  ==============================================================================
+
+    HapticRegionMap.h
+
+  ==============================================================================
+*/
+
+#ifndef HAPTICREGIONMAP_H_INCLUDED
+#define HAPTICREGIONMAP_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "LeapUtil.h"
+
+//==============================================================================
+/**
+    A set of touchable regions in scene space, each of which drives some of the
+    haptic output channels when a fingertip is inside it.
+
+    Regions are spheres, axis-aligned boxes or capsules. Each one has any number of
+    ChannelRamps, which set a channel's duty cycle from the fingertip's position
+    along one axis, so that a bar can pan between the two actuators at its ends.
+
+    After adding regions, call build() to sort them into a uniform grid. process()
+    then finds every region touched by a whole frame's fingertips, testing only the
+    regions that share a grid cell with each point, so the cost per fingertip stays
+    flat as the number of regions grows. The map must not be changed while another
+    thread is calling process().
+*/
+class HapticRegionMap
+{
+public:
+    enum Axis { xAxis, yAxis, zAxis };
+
+    /** Sets a channel to the integer part of (offset + gain * position[axis]), or if
+        subtractFrom isn't zero, to subtractFrom minus that, clamped to 0..255 either way.
+    */
+    struct ChannelRamp
+    {
+        int channel;
+        Axis axis;
+        float offset, gain;
+        int subtractFrom;
+    };
+
+    /** One fingertip found inside one region. */
+    struct Touch
+    {
+        int region, point;
+    };
+
+    //==============================================================================
+    HapticRegionMap();
+    ~HapticRegionMap();
+
+    /** Removes all the regions. */
+    void clear();
+
+    /** Each of these returns the index of the new region. */
+    int addSphere (const Leap::Vector& centre, float radius);
+    int addBox (const Leap::Vector& minCorner, const Leap::Vector& maxCorner);
+    int addCapsule (const Leap::Vector& start, const Leap::Vector& end, float radius);
+
+    /** Makes a region drive a channel. A region can drive any number of channels.
+
+        A falling ramp that mirrors a rising one should pass the rising ramp's offset
+        and gain with a subtractFrom value, rather than a negated gain, so that the two
+        round in step with each other.
+    */
+    void addRamp (int regionIndex, int channel, Axis axis, float offset, float gain, int subtractFrom = 0);
+
+    /** Adds the demo's original layout: four bars around the origin, which are
+        regions 0 to 3 (up, down, right and left).
+    */
+    void addFourBarLayout();
+
+    int getNumRegions() const noexcept              { return regions.size(); }
+
+    /** Rebuilds the grid. This must be called after the regions have changed and
+        before the next call to process().
+    */
+    void build();
+
+    //==============================================================================
+    /** Tests a frame's worth of points against the map.
+
+        Every touched region's ramps are applied to dutyCycles, keeping the highest
+        value seen for each channel, so the array should be zeroed by the caller
+        first. Channels at or beyond numChannels are ignored. If touches isn't null,
+        each (region, point) pair found is appended to it.
+
+        @returns the number of touches found
+    */
+    int process (const Leap::Vector* points, int numPoints,
+                 uint8* dutyCycles, int numChannels,
+                 Array<Touch>* touches = nullptr) const;
+
+    /** Gives the same results as process() by testing every region against every
+        point, without the grid. It's here to check and benchmark the grid against.
+    */
+    int processLinear (const Leap::Vector* points, int numPoints,
+                       uint8* dutyCycles, int numChannels,
+                       Array<Touch>* touches = nullptr) const;
+
+private:
+    //==============================================================================
+    enum Shape { boxShape, capsuleShape };
+
+    struct Region
+    {
+        Shape shape;
+        Leap::Vector a, b;      // box: min and max corners, capsule: ends of the segment
+        float radius;
+        int firstRamp, numRamps;
+    };
+
+    struct Cell
+    {
+        int firstBox, numBoxes;
+        int firstCapsule, numCapsules;
+    };
+
+    // The shapes from every cell, packed one cell after another as separate
+    // arrays of each coordinate, so that a cell can be tested in a tight loop.
+    struct BoxList
+    {
+        void clear();
+        void add (const Region&, int regionIndex);
+
+        Array<float> minX, minY, minZ, maxX, maxY, maxZ;
+        Array<int> region;
+    };
+
+    struct CapsuleList
+    {
+        void clear();
+        void add (const Region&, int regionIndex);
+
+        Array<float> startX, startY, startZ, dirX, dirY, dirZ, invLengthSquared, radiusSquared;
+        Array<int> region;
+    };
+
+    Array<Region> regions;
+    Array<ChannelRamp> ramps;
+    Array<int> rampRegions;
+    Array<ChannelRamp> sortedRamps;
+
+    Leap::Vector gridOrigin, cellScale;
+    int numCells[3];
+    Array<Cell> cells;
+    BoxList boxes;
+    CapsuleList capsules;
+    bool needsBuild;
+
+    int addRegion (Shape, const Leap::Vector& a, const Leap::Vector& b, float radius);
+    void getBounds (const Region&, Leap::Vector& low, Leap::Vector& high) const noexcept;
+    bool contains (const Region&, const Leap::Vector&) const noexcept;
+    int getCellIndex (const Leap::Vector&) const noexcept;
+    void applyRamps (int regionIndex, const Leap::Vector&, uint8* dutyCycles, int numChannels) const noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (HapticRegionMap)
+};
+
+
+#endif  // HAPTICREGIONMAP_H_INCLUDED
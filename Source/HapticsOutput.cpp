@@ -0,0 +1,470 @@
+/*
+  ==============================================================================
+
+    HapticsOutput.cpp
+
+  ==============================================================================
+*/
+
+#include "HapticsOutput.h"
+#include "SoftwareHapticDevice.h"
+#include "LatencyTrace.h"
+
+#if JUCE_WINDOWS
+ #include "DAQMXArray.h"
+#endif
+
+static void updateMaximum (Atomic<int64>& maximum, const int64 value) noexcept
+{
+    for (int64 current = maximum.get(); value > current; current = maximum.get())
+        if (maximum.compareAndSetBool (value, current))
+            break;
+}
+
+static double ticksToMs (const int64 ticks) noexcept
+{
+    return Time::highResolutionTicksToSeconds (ticks) * 1000.0;
+}
+
+static HapticOutputDevice* createDevice (const HapticsOutput::LineGroup* groups, int numGroups)
+{
+    // DutyCycles only holds maxChannels values, so any lines beyond that are left out
+    // rather than letting the device read past the end of it
+   #if JUCE_WINDOWS
+    HeapBlock<DAQMXArray::Lines> lines ((size_t) numGroups);
+    int numTasks = 0;
+
+    for (int i = 0, numLines = 0; i < numGroups && numLines < (int) HapticsOutput::maxChannels; ++i)
+    {
+        DAQMXArray::Lines& task = lines[numTasks++];
+        task.name = groups[i].name;
+        task.numLines = jmin (groups[i].numLines, (int) DAQMXArray::MaxLinesPerTask,
+                              (int) HapticsOutput::maxChannels - numLines);
+        numLines += task.numLines;
+    }
+
+    return new DAQMXArray (lines, numTasks);
+   #else
+    int numLines = 0;
+
+    for (int i = 0; i < numGroups; ++i)
+        numLines += groups[i].numLines;
+
+    return new SoftwareHapticDevice (jmin (numLines, (int) HapticsOutput::maxChannels));
+   #endif
+}
+
+//==============================================================================
+HapticsOutput::HapticsOutput (const LineGroup* groups, int numGroups)
+    : Thread ("Haptics Output"),
+      device (createDevice (groups, numGroups)),
+      hasWritten (false)
+{
+    jassert (device->GetNumChannels() <= maxChannels);
+    startThread (10);
+}
+
+HapticsOutput::HapticsOutput (HapticOutputDevice* deviceToUse)
+    : Thread ("Haptics Output"),
+      device (deviceToUse),
+      hasWritten (false)
+{
+    jassert (device != nullptr && device->GetNumChannels() <= maxChannels);
+    startThread (10);
+}
+
+HapticsOutput::~HapticsOutput()
+{
+    stopThread (2000);
+
+    // the thread has gone, so it's safe to talk to the device directly
+    DutyCycles off;
+    device->writePWM (off.dc);
+}
+
+bool HapticsOutput::isConnected() const noexcept
+{
+    return device->IsConnected();
+}
+
+int HapticsOutput::getNumChannels() const noexcept
+{
+    return jmin ((int) maxChannels, device->GetNumChannels());
+}
+
+void HapticsOutput::postDutyCycles (const DutyCycles& dutyCycles, int64 frameId) noexcept
+{
+    Update update;
+    update.dutyCycles = dutyCycles;
+    update.postedTicks = Time::getHighResolutionTicks();
+    update.frameId = frameId;
+
+    ++numPosted;
+    mailbox.Publish (update);
+    notify();
+}
+
+//==============================================================================
+void HapticsOutput::run()
+{
+    Update update;
+    uint32_t numMissed;
+
+    while (! threadShouldExit())
+    {
+        if (mailbox.Read (0, update, numMissed))
+        {
+            numDropped += (int64) numMissed;
+            write (update);
+        }
+        else
+        {
+            wait (-1);
+        }
+    }
+}
+
+void HapticsOutput::write (const Update& update)
+{
+    const int64 startTicks = Time::getHighResolutionTicks();
+    const int64 queueTicks = startTicks - update.postedTicks;
+
+    lastQueueTicks = queueTicks;
+    totalQueueTicks += queueTicks;
+    updateMaximum (maxQueueTicks, queueTicks);
+
+    if (hasWritten && update.dutyCycles == lastWritten)
+    {
+        ++numSkipped;
+        return;
+    }
+
+    LatencyTrace& trace = LatencyTrace::getGlobal();
+    trace.recordAt (LatencyTrace::pwmWriteStarted, update.frameId, startTicks);
+
+    lastWritten = update.dutyCycles;
+    hasWritten = true;
+    device->writePWM (lastWritten.dc);
+
+    const int64 endTicks = Time::getHighResolutionTicks();
+    const int64 writeTicks = endTicks - startTicks;
+    trace.recordAt (LatencyTrace::pwmWritten, update.frameId, endTicks);
+
+    lastWriteTicks = writeTicks;
+    totalWriteTicks += writeTicks;
+    updateMaximum (maxWriteTicks, writeTicks);
+    ++numWritten;
+}
+
+//==============================================================================
+HapticsOutput::Statistics HapticsOutput::getStatistics() const noexcept
+{
+    Statistics s;
+    s.numPosted  = numPosted.get();
+    s.numWritten = numWritten.get();
+    s.numSkipped = numSkipped.get();
+    s.numDropped = numDropped.get();
+
+    const int64 numCollected = s.numWritten + s.numSkipped;
+
+    s.lastWriteTime    = ticksToMs (lastWriteTicks.get());
+    s.averageWriteTime = s.numWritten > 0 ? ticksToMs (totalWriteTicks.get()) / (double) s.numWritten : 0.0;
+    s.maxWriteTime     = ticksToMs (maxWriteTicks.get());
+
+    s.lastQueueAge     = ticksToMs (lastQueueTicks.get());
+    s.averageQueueAge  = numCollected > 0 ? ticksToMs (totalQueueTicks.get()) / (double) numCollected : 0.0;
+    s.maxQueueAge      = ticksToMs (maxQueueTicks.get());
+    return s;
+}
+
+void HapticsOutput::resetStatistics() noexcept
+{
+    numPosted = 0;
+    numWritten = 0;
+    numSkipped = 0;
+    numDropped = 0;
+    lastWriteTicks = 0;
+    totalWriteTicks = 0;
+    maxWriteTicks = 0;
+    lastQueueTicks = 0;
+    totalQueueTicks = 0;
+    maxQueueTicks = 0;
+}
+
+String HapticsOutput::Statistics::toString() const
+{
+    return "Haptics: " + String (numWritten) + " written, "
+             + String (numSkipped) + " unchanged, "
+             + String (numDropped) + " dropped of " + String (numPosted) + " posted\n"
+           "Write ms: last " + String (lastWriteTime, 3) + ", avg " + String (averageWriteTime, 3)
+             + ", max " + String (maxWriteTime, 3) + "\n"
+           "Queue ms: last " + String (lastQueueAge, 3) + ", avg " + String (averageQueueAge, 3)
+             + ", max " + String (maxQueueAge, 3);
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class PWMWaveformTests  : public UnitTest
+{
+public:
+    PWMWaveformTests() : UnitTest ("PWMWaveform") {}
+
+    // The per-sample, per-channel loop that DAQMX::createPWM used to run
+    template <class WaveformType>
+    static void referencePWM (const uint8* dc, typename WaveformType::Sample* data)
+    {
+        for (int i = 0; i < WaveformType::numSamples; ++i)
+        {
+            data[i] = 0;
+
+            for (int j = WaveformType::numChannels - 1; j >= 0; --j)
+            {
+                data[i] <<= 1;
+                data[i] += (i < dc[j]) ? 1 : 0;
+            }
+        }
+    }
+
+    template <class WaveformType>
+    static bool matchesReference (const WaveformType& waveform, const uint8* dc)
+    {
+        typename WaveformType::Sample expected[WaveformType::numSamples];
+        referencePWM<WaveformType> (dc, expected);
+        return memcmp (expected, waveform.getData(), sizeof (expected)) == 0;
+    }
+
+    static void randomise (Random& r, uint8* dc, int numChannels)
+    {
+        for (int j = 0; j < numChannels; ++j)
+            dc[j] = (uint8) r.nextInt (256);
+    }
+
+    template <class WaveformType>
+    void checkAgainstReference (Random& r)
+    {
+        const int numChannels = WaveformType::numChannels;
+        WaveformType built, updated;
+        uint8 dc[numChannels] = { 0 };
+        bool allMatch = true, spansValid = true;
+
+        for (int n = 0; n < 500; ++n)
+        {
+            // change a random subset of the channels, including none at all
+            for (int j = 0; j < numChannels; ++j)
+                if (r.nextInt (4) == 0)
+                    dc[j] = (uint8) r.nextInt (256);
+
+            if (n % 50 == 0)
+                dc[r.nextInt (numChannels)] = (uint8) (r.nextBool() ? 0 : 255);
+
+            typename WaveformType::Sample before[WaveformType::numSamples];
+            memcpy (before, updated.getData(), sizeof (before));
+
+            int first, last;
+            const bool changed = updated.update (dc, first, last);
+            built.build (dc);
+
+            allMatch = allMatch && matchesReference (built, dc) && matchesReference (updated, dc);
+
+            // everything outside the reported span must be untouched
+            for (int i = 0; i < WaveformType::numSamples; ++i)
+                if ((! changed || i < first || i >= last) && before[i] != updated.getData()[i])
+                    spansValid = false;
+        }
+
+        expect (allMatch, String (numChannels) + " channels don't match the reference");
+        expect (spansValid, String (numChannels) + " channels changed samples outside the reported span");
+    }
+
+    template <class WaveformType>
+    void benchmark (Random& r)
+    {
+        const int numChannels = WaveformType::numChannels;
+        const int numUpdates = 20000;
+
+        HeapBlock<uint8> frames ((size_t) (numUpdates * numChannels));
+        randomise (r, frames, numChannels);
+
+        // a hand moving over the actuators only nudges a few channels each frame
+        for (int n = 1; n < numUpdates; ++n)
+        {
+            uint8* dc = frames + n * numChannels;
+            memcpy (dc, dc - numChannels, (size_t) numChannels);
+
+            for (int k = 0; k < 3; ++k)
+            {
+                const int j = r.nextInt (numChannels);
+                dc[j] = (uint8) jlimit (0, 255, dc[j] + r.nextInt (17) - 8);
+            }
+        }
+
+        WaveformType waveform;
+        HeapBlock<typename WaveformType::Sample> data ((size_t) WaveformType::numSamples);
+        int64 checksum = 0, samplesTouched = 0;
+
+        const int64 referenceStart = Time::getHighResolutionTicks();
+
+        for (int n = 0; n < numUpdates; ++n)
+        {
+            referencePWM<WaveformType> (frames + n * numChannels, data);
+            checksum += (int64) data[n % WaveformType::numSamples];
+        }
+
+        const int64 buildStart = Time::getHighResolutionTicks();
+
+        for (int n = 0; n < numUpdates; ++n)
+        {
+            waveform.build (frames + n * numChannels);
+            checksum += (int64) waveform.getData()[n % WaveformType::numSamples];
+        }
+
+        const int64 updateStart = Time::getHighResolutionTicks();
+
+        for (int n = 0; n < numUpdates; ++n)
+        {
+            int first, last;
+
+            if (waveform.update (frames + n * numChannels, first, last))
+                samplesTouched += last - first;
+        }
+
+        const int64 end = Time::getHighResolutionTicks();
+
+        const double usPerUpdate = 1.0e6 / numUpdates;
+        logMessage (String (numChannels) + " channels: reference "
+                      + String (Time::highResolutionTicksToSeconds (buildStart - referenceStart) * usPerUpdate, 3) + " us, build "
+                      + String (Time::highResolutionTicksToSeconds (updateStart - buildStart) * usPerUpdate, 3) + " us, update "
+                      + String (Time::highResolutionTicksToSeconds (end - updateStart) * usPerUpdate, 3) + " us per update, "
+                      + String ((double) samplesTouched / numUpdates, 1) + " of " + String ((int) WaveformType::numSamples)
+                      + " samples sent (checksum " + String (checksum & 0xff) + ")");
+    }
+
+    void runTest()
+    {
+        beginTest ("Matches the reference waveform");
+        {
+            Random r (getRandom());
+            checkAgainstReference<PWMWaveform<256, 8> > (r);
+            checkAgainstReference<PWMWaveform<256, 32> > (r);
+            checkAgainstReference<PWMWaveform<256, 64> > (r);
+            checkAgainstReference<PWMWaveform<100, 8> > (r);
+        }
+
+        beginTest ("Benchmark");
+        {
+            Random r (getRandom());
+            benchmark<PWMWaveform<256, 8> > (r);
+            benchmark<PWMWaveform<256, 32> > (r);
+            benchmark<PWMWaveform<256, 64> > (r);
+        }
+    }
+};
+
+static PWMWaveformTests pwmWaveformTests;
+
+//==============================================================================
+class HapticsOutputTests  : public UnitTest
+{
+public:
+    HapticsOutputTests() : UnitTest ("HapticsOutput") {}
+
+    static double percentile (Array<int64>& ticks, double p)
+    {
+        if (ticks.size() == 0)
+            return 0.0;
+
+        DefaultElementComparator<int64> comparator;
+        ticks.sort (comparator);
+        return ticksToMs (ticks [jmin (ticks.size() - 1, (int) (p * ticks.size()))]);
+    }
+
+    void runTest()
+    {
+        beginTest ("Posted duty cycles reach the device");
+        {
+            enum { numChannels = 16, numUpdates = 300 };
+
+            SoftwareHapticDevice* device = new SoftwareHapticDevice (numChannels, 0.3, 0.2);
+            HapticsOutput output (device);
+            Random r (getRandom());
+
+            Array<int64> postedTicks;
+            HapticsOutput::DutyCycles dutyCycles;
+
+            for (int n = 0; n < numUpdates; ++n)
+            {
+                // the first two channels number the update, so each write can be traced back
+                dutyCycles.dc[0] = (uint8) (n & 0xff);
+                dutyCycles.dc[1] = (uint8) (n >> 8);
+
+                for (int i = 2; i < numChannels; ++i)
+                    dutyCycles.dc[i] = (uint8) r.nextInt (256);
+
+                postedTicks.add (Time::getHighResolutionTicks());
+                output.postDutyCycles (dutyCycles);
+                Thread::sleep (1);
+            }
+
+            HapticsOutput::Statistics stats;
+
+            for (int tries = 0; tries < 200; ++tries)
+            {
+                stats = output.getStatistics();
+
+                if (stats.numWritten + stats.numSkipped + stats.numDropped >= stats.numPosted)
+                    break;
+
+                Thread::sleep (5);
+            }
+
+            const Array<SoftwareHapticDevice::WrittenBuffer> buffers (device->getWrittenBuffers());
+            expectEquals ((int64) buffers.size(), stats.numWritten);
+            expectEquals (stats.numWritten + stats.numSkipped + stats.numDropped, stats.numPosted);
+
+            Array<int64> toReturn, toOutput;
+            int lastUpdate = -1;
+            bool inOrder = true;
+
+            for (int i = 0; i < buffers.size(); ++i)
+            {
+                const SoftwareHapticDevice::WrittenBuffer& b = buffers.getReference (i);
+                const int n = b.dutyCycles[0] | (b.dutyCycles[1] << 8);
+
+                inOrder = inOrder && n > lastUpdate && n < numUpdates;
+                lastUpdate = n;
+
+                if (isPositiveAndBelow (n, (int) numUpdates))
+                {
+                    toReturn.add (b.returnTicks - postedTicks[n]);
+                    toOutput.add (b.outputTicks - postedTicks[n]);
+                }
+            }
+
+            expect (inOrder, "writes arrived out of order");
+            expectEquals (lastUpdate, numUpdates - 1);
+
+            // the device should end up playing exactly the last update
+            SoftwareHapticDevice::Waveform expected;
+            uint8 expectedDC[SoftwareHapticDevice::maxChannels] = { 0 };
+            memcpy (expectedDC, dutyCycles.dc, numChannels);
+            expected.build (expectedDC);
+
+            Array<SoftwareHapticDevice::Waveform::Sample> playing;
+            device->getWaveform (playing);
+            expect (memcmp (playing.begin(), expected.getData(), sizeof (SoftwareHapticDevice::Waveform::Sample) * (size_t) playing.size()) == 0);
+
+            logMessage (stats.toString());
+            logMessage ("Post to driver return ms: p50 " + String (percentile (toReturn, 0.5), 3)
+                          + ", p99 " + String (percentile (toReturn, 0.99), 3)
+                          + ", max " + String (percentile (toReturn, 1.0), 3));
+            logMessage ("Post to waveform on the lines ms: p50 " + String (percentile (toOutput, 0.5), 3)
+                          + ", p99 " + String (percentile (toOutput, 0.99), 3)
+                          + ", max " + String (percentile (toOutput, 1.0), 3));
+        }
+    }
+};
+
+static HapticsOutputTests hapticsOutputTests;
+
+#endif
@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    HapticsOutput.h
+
+  ==============================================================================
+*/
+
+#ifndef HAPTICSOUTPUT_H_INCLUDED
+#define HAPTICSOUTPUT_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "LeapUtil.h"
+#include "HapticOutputDevice.h"
+
+//==============================================================================
+/**
+    Drives a HapticOutputDevice's PWM outputs from a dedicated real-time thread.
+
+    On Windows the outputs are DAQmx lines, which can be spread over several ports
+    and cards (see DAQMXArray); the duty cycles for all of them are posted together
+    and written in one pass. Elsewhere a SoftwareHapticDevice stands in for them.
+
+    The tracking code posts the merged duty cycles for a frame with postDutyCycles(),
+    which never blocks: the output thread picks up the newest value through a
+    LeapUtil::LeapFrameExchange used as a single-slot mailbox, so a slow driver
+    write can't stall rendering and a stalled render can't hold up the actuators.
+    Values that arrive faster than the driver accepts them replace each other, and
+    writes that wouldn't change the waveform are skipped.
+*/
+class HapticsOutput  : private Thread
+{
+public:
+    enum { maxChannels = 64 };
+
+    /** One duty cycle (0 to 255) per output line. Only the first getNumChannels()
+        values are used.
+    */
+    struct DutyCycles
+    {
+        DutyCycles() noexcept                                   { zerostruct (dc); }
+
+        bool operator== (const DutyCycles& other) const noexcept { return memcmp (dc, other.dc, sizeof (dc)) == 0; }
+        bool operator!= (const DutyCycles& other) const noexcept { return ! operator== (other); }
+
+        /** Keeps the larger value of each channel, so that several hands can be
+            combined into a single write.
+        */
+        void mergeWith (const DutyCycles& other) noexcept
+        {
+            for (int i = 0; i < maxChannels; ++i)
+                dc[i] = jmax (dc[i], other.dc[i]);
+        }
+
+        uint8 dc[maxChannels];
+    };
+
+    /** Counters kept by the output thread. Times are in milliseconds. */
+    struct Statistics
+    {
+        int64 numPosted, numWritten, numSkipped, numDropped;
+        double lastWriteTime, averageWriteTime, maxWriteTime;
+        double lastQueueAge, averageQueueAge, maxQueueAge;
+
+        String toString() const;
+    };
+
+    //==============================================================================
+    /** A set of lines on one device, e.g. { "Dev1/port0:3", 32 }. */
+    struct LineGroup
+    {
+        const char* name;
+        int numLines;
+    };
+
+    /** Opens a DAQmx task for each group of lines and starts the output thread.
+        Channels are numbered through the groups in order. Where DAQmx isn't
+        available, a SoftwareHapticDevice with the same number of lines is used.
+    */
+    HapticsOutput (const LineGroup* groups, int numGroups);
+
+    /** Starts the output thread writing to the given device, which will be deleted
+        by this object.
+    */
+    explicit HapticsOutput (HapticOutputDevice* deviceToUse);
+
+    /** Stops the thread and switches all outputs off. */
+    ~HapticsOutput();
+
+    bool isConnected() const noexcept;
+    int getNumChannels() const noexcept;
+
+    /** Hands a new set of duty cycles to the output thread.
+        This is wait-free, so it's safe to call from the render or Leap callbacks,
+        but all calls must come from the same thread. The frame id is used to tag
+        the device write in the LatencyTrace.
+    */
+    void postDutyCycles (const DutyCycles&, int64 frameId = 0) noexcept;
+
+    Statistics getStatistics() const noexcept;
+    void resetStatistics() noexcept;
+
+private:
+    //==============================================================================
+    struct Update
+    {
+        DutyCycles dutyCycles;
+        int64 postedTicks, frameId;
+    };
+
+    ScopedPointer<HapticOutputDevice> device;
+    LeapUtil::LeapFrameExchange<Update> mailbox;
+    DutyCycles lastWritten;
+    bool hasWritten;
+
+    Atomic<int64> numPosted, numWritten, numSkipped, numDropped;
+    Atomic<int64> lastWriteTicks, totalWriteTicks, maxWriteTicks;
+    Atomic<int64> lastQueueTicks, totalQueueTicks, maxQueueTicks;
+
+    void run() override;
+    void write (const Update&);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (HapticsOutput)
+};
+
+
+#endif  // HAPTICSOUTPUT_H_INCLUDED
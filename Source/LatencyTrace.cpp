@@ -0,0 +1,410 @@
+/*
+  ==============================================================================
+
+    LatencyTrace.cpp
+
+  ==============================================================================
+*/
+
+#include "LatencyTrace.h"
+
+static LatencyTrace globalTrace;
+
+static double ticksToMs (const int64 ticks) noexcept
+{
+    return Time::highResolutionTicksToSeconds (ticks) * 1000.0;
+}
+
+struct EventsByFrameComparator
+{
+    static int compareElements (const LatencyTrace::Event& a, const LatencyTrace::Event& b) noexcept
+    {
+        if (a.frameId != b.frameId)  return a.frameId < b.frameId ? -1 : 1;
+        if (a.ticks != b.ticks)      return a.ticks < b.ticks ? -1 : 1;
+        return a.stage - b.stage;
+    }
+};
+
+//==============================================================================
+LatencyTrace::LatencyTrace (int capacity)
+    : mask (nextPowerOfTwo (jmax (16, capacity)) - 1),
+      minCaptureOffset (std::numeric_limits<int64>::max()),
+      enabled (1)
+{
+    slots.calloc ((size_t) mask + 1);
+}
+
+LatencyTrace::~LatencyTrace()
+{
+}
+
+LatencyTrace& LatencyTrace::getGlobal() noexcept
+{
+    return globalTrace;
+}
+
+const char* LatencyTrace::getStageName (const int stage) noexcept
+{
+    static const char* const names[] = { "captured", "arrived", "render started", "hands drawn",
+                                         "haptics processed", "pwm write started", "pwm written" };
+
+    return isPositiveAndBelow (stage, (int) numStages) ? names[stage] : "unknown";
+}
+
+void LatencyTrace::recordAt (const Stage stage, const int64 frameId, const int64 ticks) noexcept
+{
+    if (enabled.get() == 0)
+        return;
+
+    // claim the next slot, and mark it as being written so that a reader can tell
+    // it's torn if the buffer wraps round onto it while it's being copied out
+    const int64 n = (numRecorded += 1);
+    Slot& slot = slots[(int) (n - 1) & mask];
+
+    slot.sequence = -1;
+    slot.event.frameId = frameId;
+    slot.event.ticks = ticks;
+    slot.event.thread = Thread::getCurrentThreadId();
+    slot.event.stage = (int) stage;
+    slot.sequence = n;
+}
+
+int64 LatencyTrace::estimateCaptureTicks (const int64 leapTimestamp, const int64 arrivalTicks) noexcept
+{
+    const int64 leapTicks = (int64) ((double) leapTimestamp * 1.0e-6 * (double) Time::getHighResolutionTicksPerSecond());
+    const int64 offset = arrivalTicks - leapTicks;
+
+    for (int64 current = minCaptureOffset.get(); offset < current; current = minCaptureOffset.get())
+        if (minCaptureOffset.compareAndSetBool (offset, current))
+            break;
+
+    return leapTicks + minCaptureOffset.get();
+}
+
+void LatencyTrace::clear()
+{
+    for (int i = 0; i <= mask; ++i)
+        slots[i].sequence = 0;
+
+    numRecorded = 0;
+    minCaptureOffset = std::numeric_limits<int64>::max();
+}
+
+//==============================================================================
+void LatencyTrace::getEvents (Array<Event>& events) const
+{
+    events.clearQuick();
+
+    const int64 last = numRecorded.get();
+    const int64 first = jmax ((int64) 1, last - mask);
+
+    events.ensureStorageAllocated ((int) (last - first + 1));
+
+    for (int64 n = first; n <= last; ++n)
+    {
+        const Slot& slot = slots[(int) (n - 1) & mask];
+
+        if (slot.sequence.get() != n)
+            continue;
+
+        const Event e (slot.event);
+
+        if (slot.sequence.get() == n)
+            events.add (e);
+    }
+}
+
+LatencyTrace::Percentiles LatencyTrace::getLatency (const Array<Event>& sortedEvents, const Stage from, const Stage to)
+{
+    Array<int64> latencies;
+
+    for (int i = 0; i < sortedEvents.size();)
+    {
+        const int64 frameId = sortedEvents.getReference (i).frameId;
+        int64 fromTicks = 0, toTicks = 0;
+        bool hasFrom = false, hasTo = false;
+
+        // the first time the frame reached each stage counts, since the renderer can draw it more than once
+        for (; i < sortedEvents.size() && sortedEvents.getReference (i).frameId == frameId; ++i)
+        {
+            const Event& e = sortedEvents.getReference (i);
+
+            if (e.stage == from && ! hasFrom)  { fromTicks = e.ticks; hasFrom = true; }
+            if (e.stage == to && ! hasTo)      { toTicks = e.ticks; hasTo = true; }
+        }
+
+        if (hasFrom && hasTo)
+            latencies.add (toTicks - fromTicks);
+    }
+
+    Percentiles p;
+    p.count = latencies.size();
+    p.p50 = p.p99 = p.max = 0.0;
+
+    if (p.count > 0)
+    {
+        DefaultElementComparator<int64> comparator;
+        latencies.sort (comparator);
+
+        p.p50 = ticksToMs (latencies [(p.count - 1) / 2]);
+        p.p99 = ticksToMs (latencies [jmin (p.count - 1, (int) (p.count * 0.99))]);
+        p.max = ticksToMs (latencies.getLast());
+    }
+
+    return p;
+}
+
+LatencyTrace::Percentiles LatencyTrace::getLatency (const Stage from, const Stage to) const
+{
+    Array<Event> events;
+    getEvents (events);
+
+    EventsByFrameComparator comparator;
+    events.sort (comparator);
+
+    return getLatency (events, from, to);
+}
+
+String LatencyTrace::getSummary() const
+{
+    Array<Event> events;
+    getEvents (events);
+
+    EventsByFrameComparator comparator;
+    events.sort (comparator);
+
+    String s;
+    s << "Latency ms (p50 / p99 / max over frames):";
+
+    for (int start = frameCaptured; start <= frameArrived; ++start)
+    {
+        for (int stage = start + 1; stage < numStages; ++stage)
+        {
+            const Percentiles p (getLatency (events, (Stage) start, (Stage) stage));
+
+            if (p.count > 0)
+                s << newLine << getStageName (start) << " -> " << getStageName (stage) << ": "
+                  << String (p.p50, 3) << " / " << String (p.p99, 3) << " / " << String (p.max, 3)
+                  << " (" << p.count << ")";
+        }
+    }
+
+    return s;
+}
+
+//==============================================================================
+bool LatencyTrace::writeChromeTrace (const File& file) const
+{
+    Array<Event> events;
+    getEvents (events);
+
+    file.deleteFile();
+    FileOutputStream out (file);
+
+    if (! out.openedOk())
+        return false;
+
+    int64 startTicks = std::numeric_limits<int64>::max();
+
+    for (int i = 0; i < events.size(); ++i)
+        startTicks = jmin (startTicks, events.getReference (i).ticks);
+
+    const double usPerTick = 1.0e6 / (double) Time::getHighResolutionTicksPerSecond();
+
+    // chrome wants small thread numbers, so give each thread one in order of appearance,
+    // and name it after the first pipeline stage seen on it
+    Array<Thread::ThreadID> threads;
+    StringArray threadNames;
+
+    for (int i = 0; i < events.size(); ++i)
+    {
+        const Event& e = events.getReference (i);
+
+        if (e.stage != frameCaptured && ! threads.contains (e.thread))
+        {
+            threads.add (e.thread);
+            threadNames.add (e.stage == frameArrived ? "Leap"
+                              : e.stage <= handsDrawn ? "OpenGL"
+                              : e.stage == hapticsProcessed ? "Haptics"
+                              : "Haptics Output");
+        }
+    }
+
+    // frameCaptured isn't on any of our threads, so it gets a row of its own
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":["
+        << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Leap capture (estimated)\"}}";
+
+    for (int t = 0; t < threads.size(); ++t)
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << (t + 1)
+            << ",\"args\":{\"name\":\"" << threadNames[t] << "\"}}";
+
+    for (int i = 0; i < events.size(); ++i)
+    {
+        const Event& e = events.getReference (i);
+        const int tid = e.stage == frameCaptured ? 0 : threads.indexOf (e.thread) + 1;
+
+        out << ",\n{\"name\":\"" << getStageName (e.stage) << "\",\"cat\":\"frame\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << tid
+            << ",\"ts\":" << String ((double) (e.ticks - startTicks) * usPerTick, 1)
+            << ",\"args\":{\"frame\":" << String (e.frameId) << "}}";
+    }
+
+    // show the render and device write as spans as well
+    EventsByFrameComparator comparator;
+    events.sort (comparator);
+
+    for (int i = 0; i < events.size(); ++i)
+    {
+        const Event& e = events.getReference (i);
+
+        if (e.stage != renderStarted && e.stage != pwmWriteStarted)
+            continue;
+
+        const int endStage = e.stage == renderStarted ? handsDrawn : pwmWritten;
+
+        for (int j = i + 1; j < events.size() && events.getReference (j).frameId == e.frameId; ++j)
+        {
+            const Event& end = events.getReference (j);
+
+            if (end.stage == endStage && end.thread == e.thread)
+            {
+                out << ",\n{\"name\":\"" << (e.stage == renderStarted ? "draw hands" : "pwm write")
+                    << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (threads.indexOf (e.thread) + 1)
+                    << ",\"ts\":" << String ((double) (e.ticks - startTicks) * usPerTick, 1)
+                    << ",\"dur\":" << String ((double) (end.ticks - e.ticks) * usPerTick, 1)
+                    << ",\"args\":{\"frame\":" << String (e.frameId) << "}}";
+                break;
+            }
+        }
+    }
+
+    out << "\n]}\n";
+    out.flush();
+    return out.getStatus().wasOk();
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class LatencyTraceTests  : public UnitTest
+{
+public:
+    LatencyTraceTests() : UnitTest ("LatencyTrace") {}
+
+    struct Recorder  : public Thread
+    {
+        Recorder (LatencyTrace& t, LatencyTrace::Stage s, int n)
+            : Thread ("LatencyTrace test"), trace (t), stage (s), numFrames (n) {}
+
+        void run() override
+        {
+            for (int i = 1; i <= numFrames; ++i)
+                trace.recordAt (stage, i, (int64) i * 1000 + (int64) stage * 100);
+        }
+
+        LatencyTrace& trace;
+        LatencyTrace::Stage stage;
+        int numFrames;
+    };
+
+    void runTest()
+    {
+        const double msPer100Ticks = ticksToMs (100);
+
+        beginTest ("Percentiles");
+        {
+            LatencyTrace trace (1024);
+
+            // frame i reaches each stage 100 ticks after the last, but frame 100 is slow to draw
+            for (int i = 1; i <= 100; ++i)
+            {
+                trace.recordAt (LatencyTrace::frameArrived, i, i * 10000);
+                trace.recordAt (LatencyTrace::renderStarted, i, i * 10000 + 100);
+                trace.recordAt (LatencyTrace::handsDrawn, i, i * 10000 + (i == 100 ? 5000 : 200));
+                trace.recordAt (LatencyTrace::handsDrawn, i, i * 10000 + 9000);   // drawn again later, which mustn't count
+            }
+
+            const LatencyTrace::Percentiles p (trace.getLatency (LatencyTrace::frameArrived, LatencyTrace::handsDrawn));
+            expectEquals (p.count, 100);
+            expect (std::abs (p.p50 - 2.0 * msPer100Ticks) < 1.0e-9);
+            expect (std::abs (p.max - 50.0 * msPer100Ticks) < 1.0e-9);
+
+            expectEquals (trace.getLatency (LatencyTrace::frameArrived, LatencyTrace::pwmWritten).count, 0);
+        }
+
+        beginTest ("Ring buffer keeps the newest events");
+        {
+            LatencyTrace trace (64);
+
+            for (int i = 1; i <= 1000; ++i)
+                trace.recordAt (LatencyTrace::frameArrived, i, i);
+
+            Array<LatencyTrace::Event> events;
+            trace.getEvents (events);
+
+            expectEquals (events.size(), 64);
+            expectEquals (events.getFirst().frameId, (int64) 937);
+            expectEquals (events.getLast().frameId, (int64) 1000);
+        }
+
+        beginTest ("Concurrent recording");
+        {
+            const int numFrames = 20000;
+            LatencyTrace trace (1 << 17);
+
+            OwnedArray<Recorder> recorders;
+            recorders.add (new Recorder (trace, LatencyTrace::frameArrived, numFrames));
+            recorders.add (new Recorder (trace, LatencyTrace::renderStarted, numFrames));
+            recorders.add (new Recorder (trace, LatencyTrace::hapticsProcessed, numFrames));
+            recorders.add (new Recorder (trace, LatencyTrace::pwmWritten, numFrames));
+
+            for (int i = 0; i < recorders.size(); ++i)
+                recorders.getUnchecked (i)->startThread();
+
+            for (int i = 0; i < recorders.size(); ++i)
+                recorders.getUnchecked (i)->waitForThreadToExit (-1);
+
+            Array<LatencyTrace::Event> events;
+            trace.getEvents (events);
+            expectEquals (events.size(), numFrames * recorders.size());
+
+            const LatencyTrace::Percentiles p (trace.getLatency (LatencyTrace::frameArrived, LatencyTrace::pwmWritten));
+            expectEquals (p.count, numFrames);
+            expect (std::abs (p.max - 5.0 * msPer100Ticks) < 1.0e-9);
+        }
+
+        beginTest ("Capture estimate and Chrome trace");
+        {
+            LatencyTrace trace;
+            const int64 ticksPerMs = Time::getHighResolutionTicksPerSecond() / 1000;
+
+            // the second frame took 3 ms longer to arrive than the first
+            const int64 c1 = trace.estimateCaptureTicks (1000000, 50 * ticksPerMs);
+            const int64 c2 = trace.estimateCaptureTicks (1010000, 63 * ticksPerMs);
+            expect (std::abs (ticksToMs (c1) - 50.0) < 0.01);
+            expect (std::abs (ticksToMs (c2) - 60.0) < 0.01);
+
+            trace.recordAt (LatencyTrace::frameCaptured, 1, Time::getHighResolutionTicks() - ticksPerMs);
+            trace.record (LatencyTrace::frameArrived, 1);
+            trace.record (LatencyTrace::renderStarted, 1);
+            trace.record (LatencyTrace::handsDrawn, 1);
+
+            const File file (File::getSpecialLocation (File::tempDirectory).getNonexistentChildFile ("LatencyTraceTest", ".json"));
+            expect (trace.writeChromeTrace (file));
+
+            const var json (JSON::parse (file));
+            file.deleteFile();
+
+            const Array<var>* traceEvents = json ["traceEvents"].getArray();
+            expect (traceEvents != nullptr);
+
+            if (traceEvents != nullptr)
+                expectEquals (traceEvents->size(), 2 + 4 + 1);   // thread names, stages, the draw span
+
+            logMessage (trace.getSummary());
+        }
+    }
+};
+
+static LatencyTraceTests latencyTraceTests;
+
+#endif
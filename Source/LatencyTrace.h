@@ -0,0 +1,121 @@
+/*
+  ==============================================================================
+
+    LatencyTrace.h
+
+  ==============================================================================
+*/
+
+#ifndef LATENCYTRACE_H_INCLUDED
+#define LATENCYTRACE_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/**
+    Timestamps for each Leap frame as it passes through the demo's pipeline.
+
+    Each thread calls record() as a frame reaches one of the Stages. Events go
+    into a fixed-size ring buffer with one atomic increment and no locks, so the
+    oldest are overwritten if nobody reads them. Afterwards, getLatency() pairs up
+    the events for each frame id and gives percentiles for the time between any
+    two stages, and writeChromeTrace() saves the events in the Chrome trace-event
+    format, for viewing in chrome://tracing.
+
+    The frame's handsDrawn time is when drawing was handed to the driver, so the
+    time to light leaving the display is that plus the swap and scan-out.
+*/
+class LatencyTrace
+{
+public:
+    enum Stage
+    {
+        frameCaptured,      // the Leap timestamp, as an estimate in local ticks (see estimateCaptureTicks)
+        frameArrived,       // onFrame, or a replayed frame being published
+        renderStarted,      // the GL thread picked the frame up
+        handsDrawn,         // the hands have been submitted to GL
+        hapticsProcessed,   // the haptics thread has worked out the frame's duty cycles
+        pwmWriteStarted,    // the output thread is about to write them to the device
+        pwmWritten,         // the device write has returned
+        numStages
+    };
+
+    struct Event
+    {
+        int64 frameId;
+        int64 ticks;
+        Thread::ThreadID thread;
+        int stage;
+    };
+
+    /** Latencies in milliseconds. */
+    struct Percentiles
+    {
+        int count;
+        double p50, p99, max;
+    };
+
+    //==============================================================================
+    /** The capacity is rounded up to a power of two. */
+    explicit LatencyTrace (int capacity = 1 << 16);
+    ~LatencyTrace();
+
+    /** The trace that the demo pipeline records into. */
+    static LatencyTrace& getGlobal() noexcept;
+
+    static const char* getStageName (int stage) noexcept;
+
+    //==============================================================================
+    /** Records a frame reaching a stage now. Safe to call from any thread. */
+    void record (Stage stage, int64 frameId) noexcept       { recordAt (stage, frameId, Time::getHighResolutionTicks()); }
+
+    void recordAt (Stage, int64 frameId, int64 ticks) noexcept;
+
+    /** Converts a Leap::Frame::timestamp() to local ticks.
+
+        The Leap service's clock isn't related to ours, so this keeps the smallest
+        difference seen between a frame's timestamp and its arrival and treats that
+        frame as having arrived instantly. Capture times are therefore relative to
+        the fastest delivery seen since the last clear(), which is a lower bound.
+    */
+    int64 estimateCaptureTicks (int64 leapTimestamp, int64 arrivalTicks) noexcept;
+
+    void setEnabled (bool shouldBeEnabled) noexcept         { enabled = shouldBeEnabled ? 1 : 0; }
+    bool isEnabled() const noexcept                         { return enabled.get() != 0; }
+
+    /** Forgets all the events. This mustn't be called while other threads are recording. */
+    void clear();
+
+    //==============================================================================
+    /** Copies out the events that are still in the buffer, oldest first. */
+    void getEvents (Array<Event>&) const;
+
+    /** The time from one stage to another over every frame that reached both. */
+    Percentiles getLatency (Stage from, Stage to) const;
+
+    /** A table of latencies from frameArrived (and frameCaptured) to each later stage. */
+    String getSummary() const;
+
+    /** Writes the events as Chrome trace-event JSON. */
+    bool writeChromeTrace (const File&) const;
+
+private:
+    //==============================================================================
+    struct Slot
+    {
+        Atomic<int64> sequence;     // 0 if empty, -1 while being written, otherwise the event's number
+        Event event;
+    };
+
+    HeapBlock<Slot> slots;
+    int mask;
+    Atomic<int64> numRecorded, minCaptureOffset;
+    Atomic<int> enabled;
+
+    static Percentiles getLatency (const Array<Event>&, Stage from, Stage to);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LatencyTrace)
+};
+
+
+#endif  // LATENCYTRACE_H_INCLUDED
@@ -0,0 +1,647 @@
+/*
+  ==============================================================================
+
+    LeapFrameLog.cpp
+
+  ==============================================================================
+*/
+
+#include "LeapFrameLog.h"
+
+//==============================================================================
+TrackedFrame::TrackedFrame() noexcept
+{
+    clear();
+}
+
+void TrackedFrame::clear() noexcept
+{
+    id = 0;
+    timestamp = 0;
+    numHands = 0;
+    numPointables = 0;
+}
+
+void TrackedFrame::setFrom (const Leap::Frame& frame)
+{
+    clear();
+    id = frame.id();
+    timestamp = frame.timestamp();
+
+    const Leap::HandList& handList = frame.hands();
+
+    for (int j = 0, m = (int) handList.count(); j < m && numHands < maxHands; ++j)
+    {
+        const Leap::Hand& h = handList[j];
+        Hand& hand = hands[numHands++];
+
+        hand.id             = h.id();
+        hand.firstPointable = numPointables;
+        hand.numPointables  = 0;
+        hand.palmPosition   = h.palmPosition();
+        hand.palmNormal     = h.palmNormal();
+        hand.palmVelocity   = h.palmVelocity();
+        hand.direction      = h.direction();
+
+        const Leap::PointableList& pointableList = h.pointables();
+
+        for (int i = 0, n = (int) pointableList.count(); i < n && numPointables < maxPointables; ++i)
+        {
+            const Leap::Pointable& p = pointableList[i];
+            Pointable& pointable = pointables[numPointables++];
+
+            pointable.id          = p.id();
+            pointable.isTool      = p.isTool();
+            pointable.tipPosition = p.tipPosition();
+            pointable.tipVelocity = p.tipVelocity();
+            pointable.direction   = p.direction();
+            pointable.width       = p.width();
+            pointable.length      = p.length();
+
+            ++hand.numPointables;
+        }
+    }
+}
+
+//==============================================================================
+namespace LeapFrameLog
+{
+    enum
+    {
+        frameHeaderSize = 24,
+        handSize = 56,
+        pointableSize = 52
+    };
+
+    static void writeUInt32 (uint8*& d, uint32 value) noexcept
+    {
+        value = ByteOrder::swapIfBigEndian (value);
+        memcpy (d, &value, 4);
+        d += 4;
+    }
+
+    static void writeUInt64 (uint8*& d, uint64 value) noexcept
+    {
+        value = ByteOrder::swapIfBigEndian (value);
+        memcpy (d, &value, 8);
+        d += 8;
+    }
+
+    static void writeFloat (uint8*& d, float value) noexcept
+    {
+        uint32 bits;
+        memcpy (&bits, &value, 4);
+        writeUInt32 (d, bits);
+    }
+
+    static void writeVector (uint8*& d, const Leap::Vector& v) noexcept
+    {
+        writeFloat (d, v.x);
+        writeFloat (d, v.y);
+        writeFloat (d, v.z);
+    }
+
+    static uint32 readUInt32 (const uint8*& s) noexcept
+    {
+        const uint32 value = ByteOrder::littleEndianInt (s);
+        s += 4;
+        return value;
+    }
+
+    static uint64 readUInt64 (const uint8*& s) noexcept
+    {
+        const uint64 value = ByteOrder::littleEndianInt64 (s);
+        s += 8;
+        return value;
+    }
+
+    static float readFloat (const uint8*& s) noexcept
+    {
+        const uint32 bits = readUInt32 (s);
+        float value;
+        memcpy (&value, &bits, 4);
+        return value;
+    }
+
+    static Leap::Vector readVector (const uint8*& s) noexcept
+    {
+        const float x = readFloat (s);
+        const float y = readFloat (s);
+        const float z = readFloat (s);
+        return Leap::Vector (x, y, z);
+    }
+
+    int getRecordSize (const TrackedFrame& frame) noexcept
+    {
+        return frameHeaderSize + frame.numHands * handSize + frame.numPointables * pointableSize;
+    }
+
+    void writeRecord (const TrackedFrame& frame, uint8* d) noexcept
+    {
+        writeUInt32 (d, (uint32) getRecordSize (frame));
+        writeUInt64 (d, (uint64) frame.id);
+        writeUInt64 (d, (uint64) frame.timestamp);
+        writeUInt32 (d, (uint32) (frame.numHands | (frame.numPointables << 16)));
+
+        for (int j = 0; j < frame.numHands; ++j)
+        {
+            const TrackedFrame::Hand& hand = frame.hands[j];
+
+            writeUInt32 (d, (uint32) hand.id);
+            writeUInt32 (d, (uint32) hand.numPointables);
+            writeVector (d, hand.palmPosition);
+            writeVector (d, hand.palmNormal);
+            writeVector (d, hand.palmVelocity);
+            writeVector (d, hand.direction);
+        }
+
+        // pointables are already grouped by hand, so their order says which hand they're on
+        for (int i = 0; i < frame.numPointables; ++i)
+        {
+            const TrackedFrame::Pointable& pointable = frame.pointables[i];
+
+            writeUInt32 (d, (uint32) pointable.id);
+            writeUInt32 (d, pointable.isTool ? 1u : 0u);
+            writeVector (d, pointable.tipPosition);
+            writeVector (d, pointable.tipVelocity);
+            writeVector (d, pointable.direction);
+            writeFloat (d, pointable.width);
+            writeFloat (d, pointable.length);
+        }
+    }
+
+    bool readRecord (const uint8* s, size_t bytesAvailable, TrackedFrame& frame) noexcept
+    {
+        if (bytesAvailable < (size_t) frameHeaderSize)
+            return false;
+
+        const uint32 recordSize = readUInt32 (s);
+        frame.id = (int64) readUInt64 (s);
+        frame.timestamp = (int64) readUInt64 (s);
+
+        const uint32 counts = readUInt32 (s);
+        const int numHands = (int) (counts & 0xffff);
+        const int numPointables = (int) (counts >> 16);
+
+        if (numHands > TrackedFrame::maxHands || numPointables > TrackedFrame::maxPointables
+             || recordSize != (uint32) (frameHeaderSize + numHands * handSize + numPointables * pointableSize)
+             || recordSize > bytesAvailable)
+            return false;
+
+        frame.numHands = numHands;
+        frame.numPointables = numPointables;
+
+        int firstPointable = 0;
+
+        for (int j = 0; j < numHands; ++j)
+        {
+            TrackedFrame::Hand& hand = frame.hands[j];
+
+            hand.id             = (int32) readUInt32 (s);
+            hand.numPointables  = (int) readUInt32 (s);
+            hand.firstPointable = firstPointable;
+            hand.palmPosition   = readVector (s);
+            hand.palmNormal     = readVector (s);
+            hand.palmVelocity   = readVector (s);
+            hand.direction      = readVector (s);
+
+            firstPointable += hand.numPointables;
+
+            if (hand.numPointables < 0 || firstPointable > numPointables)
+                return false;
+        }
+
+        for (int i = 0; i < numPointables; ++i)
+        {
+            TrackedFrame::Pointable& pointable = frame.pointables[i];
+
+            pointable.id          = (int32) readUInt32 (s);
+            pointable.isTool      = (readUInt32 (s) & 1) != 0;
+            pointable.tipPosition = readVector (s);
+            pointable.tipVelocity = readVector (s);
+            pointable.direction   = readVector (s);
+            pointable.width       = readFloat (s);
+            pointable.length      = readFloat (s);
+        }
+
+        return true;
+    }
+}
+
+//==============================================================================
+LeapFrameRecorder::LeapFrameRecorder (const File& f, int bufferSize)
+    : file (f),
+      recordBuffer ((size_t) (LeapFrameLog::frameHeaderSize
+                                + TrackedFrame::maxHands * LeapFrameLog::handSize
+                                + TrackedFrame::maxPointables * LeapFrameLog::pointableSize))
+{
+    file.deleteFile();
+    stream = file.createOutputStream (bufferSize);
+
+    if (stream != nullptr && stream->openedOk())
+    {
+        stream->writeInt (LeapFrameLog::magic);
+        stream->writeInt (LeapFrameLog::version);
+        stream->writeInt64 (0);
+    }
+    else
+    {
+        stream = nullptr;
+    }
+}
+
+LeapFrameRecorder::~LeapFrameRecorder()
+{
+    stop();
+}
+
+bool LeapFrameRecorder::openedOk() const noexcept
+{
+    return stream != nullptr;
+}
+
+void LeapFrameRecorder::addFrame (const TrackedFrame& frameToAdd)
+{
+    const ScopedLock sl (lock);
+
+    if (stream != nullptr)
+    {
+        LeapFrameLog::writeRecord (frameToAdd, recordBuffer);
+        stream->write (recordBuffer, (size_t) LeapFrameLog::getRecordSize (frameToAdd));
+        ++numFramesWritten;
+    }
+}
+
+void LeapFrameRecorder::stop()
+{
+    const ScopedLock sl (lock);
+
+    if (stream != nullptr)
+    {
+        stream->flush();
+        stream = nullptr;
+    }
+}
+
+void LeapFrameRecorder::onFrame (const Leap::Controller& controller)
+{
+    // the controller only calls this from one thread, so the member frame is safe to fill here
+    frame.setFrom (controller.frame());
+    addFrame (frame);
+}
+
+//==============================================================================
+LeapFrameLogReader::LeapFrameLogReader (const File& f, int64 windowSize_)
+    : file (f),
+      windowSize (jmax ((int64) 65536, windowSize_)),
+      fileSize (f.getSize()),
+      position (0),
+      valid (false)
+{
+    if (const uint8* header = getBytes (0, LeapFrameLog::headerSize))
+        valid = ByteOrder::littleEndianInt (header) == (uint32) LeapFrameLog::magic
+                 && ByteOrder::littleEndianInt (header + 4) == (uint32) LeapFrameLog::version;
+
+    rewind();
+}
+
+LeapFrameLogReader::~LeapFrameLogReader()
+{
+}
+
+void LeapFrameLogReader::rewind() noexcept
+{
+    position = LeapFrameLog::headerSize;
+}
+
+const uint8* LeapFrameLogReader::getBytes (int64 start, int64 numBytes)
+{
+    if (start + numBytes > fileSize)
+        return nullptr;
+
+    Range<int64> mapped (window != nullptr ? window->getRange() : Range<int64>());
+
+    if (start < mapped.getStart() || start + numBytes > mapped.getEnd())
+    {
+        // the window's start gets rounded down to a page boundary, so ask for a little
+        // more than is needed to make sure the whole of this request is covered
+        window = nullptr;
+        window = new MemoryMappedFile (file, Range<int64> (start, start + jmax (numBytes, windowSize) + 65536),
+                                       MemoryMappedFile::readOnly);
+        mapped = window->getRange();
+
+        if (window->getData() == nullptr || start < mapped.getStart() || start + numBytes > mapped.getEnd())
+        {
+            window = nullptr;
+            return nullptr;
+        }
+    }
+
+    return static_cast<const uint8*> (window->getData()) + (start - mapped.getStart());
+}
+
+bool LeapFrameLogReader::readNext (TrackedFrame& frame)
+{
+    if (! valid)
+        return false;
+
+    const uint8* sizeBytes = getBytes (position, 4);
+
+    if (sizeBytes == nullptr)
+        return false;
+
+    const int64 recordSize = (int64) ByteOrder::littleEndianInt (sizeBytes);
+    const uint8* record = getBytes (position, recordSize);
+
+    if (record == nullptr || ! LeapFrameLog::readRecord (record, (size_t) recordSize, frame))
+        return false;
+
+    position += recordSize;
+    return true;
+}
+
+//==============================================================================
+LeapFrameReplayer::LeapFrameReplayer (const File& file, Listener& l)
+    : Thread ("Leap Frame Replay"),
+      reader (file),
+      listener (l),
+      speed (1.0),
+      looping (false)
+{
+}
+
+LeapFrameReplayer::~LeapFrameReplayer()
+{
+    stop();
+}
+
+void LeapFrameReplayer::start (double newSpeed, bool loop)
+{
+    stop();
+
+    speed = newSpeed;
+    looping = loop;
+    numFramesReplayed = 0;
+    startThread (8);
+}
+
+void LeapFrameReplayer::stop()
+{
+    stopThread (2000);
+}
+
+bool LeapFrameReplayer::waitUntil (const int64 ticks)
+{
+    // sleep through most of the wait and spin for the rest, since sleeps are coarse
+    const int64 ticksPerMs = Time::getHighResolutionTicksPerSecond() / 1000;
+
+    for (int64 now = Time::getHighResolutionTicks(); now < ticks; now = Time::getHighResolutionTicks())
+    {
+        if (threadShouldExit())
+            return false;
+
+        if (ticks - now > 2 * ticksPerMs)
+            wait (1);
+        else
+            Thread::yield();
+    }
+
+    return ! threadShouldExit();
+}
+
+void LeapFrameReplayer::run()
+{
+    const double ticksPerMicrosecond = (double) Time::getHighResolutionTicksPerSecond() * 1.0e-6;
+
+    while (! threadShouldExit())
+    {
+        reader.rewind();
+
+        int64 startTicks = 0, firstTimestamp = 0;
+        bool isFirst = true;
+
+        while (reader.readNext (frame))
+        {
+            if (isFirst)
+            {
+                startTicks = Time::getHighResolutionTicks();
+                firstTimestamp = frame.timestamp;
+                isFirst = false;
+            }
+            else if (speed > 0)
+            {
+                const double elapsed = (double) (frame.timestamp - firstTimestamp) / speed;
+
+                if (! waitUntil (startTicks + (int64) (elapsed * ticksPerMicrosecond)))
+                    return;
+            }
+            else if (threadShouldExit())
+            {
+                return;
+            }
+
+            listener.frameReplayed (frame);
+            ++numFramesReplayed;
+        }
+
+        if (! looping || isFirst)
+            break;
+    }
+
+    if (! threadShouldExit())
+        listener.replayFinished();
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class LeapFrameLogTests  : public UnitTest
+{
+public:
+    LeapFrameLogTests() : UnitTest ("LeapFrameLog") {}
+
+    static Leap::Vector randomVector (Random& r)
+    {
+        return Leap::Vector (r.nextFloat() * 400.0f - 200.0f, r.nextFloat() * 400.0f, r.nextFloat() * 400.0f - 200.0f);
+    }
+
+    static void makeFrame (Random& r, int64 index, TrackedFrame& frame)
+    {
+        frame.clear();
+        frame.id = 1000 + index;
+        frame.timestamp = 5000000 + index * 8333;   // 120 fps
+        frame.numHands = r.nextInt (TrackedFrame::maxHands + 1);
+
+        for (int j = 0; j < frame.numHands; ++j)
+        {
+            TrackedFrame::Hand& hand = frame.hands[j];
+            hand.id = r.nextInt (100);
+            hand.firstPointable = frame.numPointables;
+            hand.numPointables = r.nextInt (6);
+            hand.palmPosition = randomVector (r);
+            hand.palmNormal = randomVector (r).normalized();
+            hand.palmVelocity = randomVector (r);
+            hand.direction = randomVector (r).normalized();
+
+            for (int i = 0; i < hand.numPointables; ++i)
+            {
+                TrackedFrame::Pointable& p = frame.pointables[frame.numPointables++];
+                p.id = r.nextInt (1000);
+                p.isTool = r.nextBool();
+                p.tipPosition = randomVector (r);
+                p.tipVelocity = randomVector (r);
+                p.direction = randomVector (r).normalized();
+                p.width = r.nextFloat() * 20.0f;
+                p.length = r.nextFloat() * 80.0f;
+            }
+        }
+    }
+
+    static bool framesMatch (const TrackedFrame& a, const TrackedFrame& b)
+    {
+        if (a.id != b.id || a.timestamp != b.timestamp || a.numHands != b.numHands || a.numPointables != b.numPointables)
+            return false;
+
+        for (int j = 0; j < a.numHands; ++j)
+        {
+            const TrackedFrame::Hand& ha = a.hands[j];
+            const TrackedFrame::Hand& hb = b.hands[j];
+
+            if (ha.id != hb.id || ha.firstPointable != hb.firstPointable || ha.numPointables != hb.numPointables
+                 || ha.palmPosition != hb.palmPosition || ha.palmNormal != hb.palmNormal
+                 || ha.palmVelocity != hb.palmVelocity || ha.direction != hb.direction)
+                return false;
+        }
+
+        for (int i = 0; i < a.numPointables; ++i)
+        {
+            const TrackedFrame::Pointable& pa = a.pointables[i];
+            const TrackedFrame::Pointable& pb = b.pointables[i];
+
+            if (pa.id != pb.id || pa.isTool != pb.isTool || pa.tipPosition != pb.tipPosition
+                 || pa.tipVelocity != pb.tipVelocity || pa.direction != pb.direction
+                 || pa.width != pb.width || pa.length != pb.length)
+                return false;
+        }
+
+        return true;
+    }
+
+    struct CountingListener  : public LeapFrameReplayer::Listener
+    {
+        CountingListener() : lastId (0), inOrder (true), finished (false) {}
+
+        void frameReplayed (const TrackedFrame& frame) override
+        {
+            inOrder = inOrder && frame.id > lastId;
+            lastId = frame.id;
+            ++count;
+        }
+
+        void replayFinished() override      { finished = true; event.signal(); }
+
+        Atomic<int> count;
+        int64 lastId;
+        bool inOrder, finished;
+        WaitableEvent event;
+    };
+
+    void runTest()
+    {
+        const File file (File::getSpecialLocation (File::tempDirectory).getNonexistentChildFile ("LeapFrameLogTest", ".leapframes"));
+        const int numFrames = 3000;
+        Random r (getRandom());
+        const int64 seed = r.nextInt64();
+
+        beginTest ("Round trip");
+        {
+            {
+                LeapFrameRecorder recorder (file);
+                expect (recorder.openedOk());
+
+                Random frameRandom (seed);
+                TrackedFrame frame;
+
+                for (int n = 0; n < numFrames; ++n)
+                {
+                    makeFrame (frameRandom, n, frame);
+                    recorder.addFrame (frame);
+                }
+
+                expectEquals (recorder.getNumFramesWritten(), (int64) numFrames);
+            }
+
+            // a small window, so that the reader has to move it many times
+            LeapFrameLogReader reader (file, 65536);
+            expect (reader.isValid());
+
+            Random frameRandom (seed);
+            TrackedFrame expected, actual;
+            int numRead = 0;
+            bool allMatch = true;
+
+            while (reader.readNext (actual))
+            {
+                makeFrame (frameRandom, numRead++, expected);
+                allMatch = allMatch && framesMatch (expected, actual);
+            }
+
+            expectEquals (numRead, numFrames);
+            expect (allMatch);
+            expectEquals (reader.getPosition(), reader.getTotalSize());
+
+            reader.rewind();
+            expect (reader.readNext (actual) && actual.id == 1000);
+        }
+
+        beginTest ("Rejects other files");
+        {
+            const File other (file.getSiblingFile ("LeapFrameLogTestOther.leapframes"));
+            other.replaceWithText ("not a frame log");
+
+            TrackedFrame frame;
+            LeapFrameLogReader reader (other);
+            expect (! reader.isValid());
+            expect (! reader.readNext (frame));
+            other.deleteFile();
+        }
+
+        beginTest ("Replay");
+        {
+            // the whole log covers 25 seconds, so at 100x it should take about a quarter of one
+            {
+                CountingListener listener;
+                LeapFrameReplayer replayer (file, listener);
+                expect (replayer.isValid());
+
+                const int64 startTicks = Time::getHighResolutionTicks();
+                replayer.start (100.0, false);
+                expect (listener.event.wait (5000));
+                const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+
+                expectEquals (listener.count.get(), numFrames);
+                expect (listener.inOrder && listener.finished);
+                expect (seconds > 0.2 && seconds < 1.0, "100x replay took " + String (seconds, 3) + " s");
+            }
+
+            {
+                CountingListener listener;
+                LeapFrameReplayer replayer (file, listener);
+
+                const int64 startTicks = Time::getHighResolutionTicks();
+                replayer.start (0.0, false);
+                expect (listener.event.wait (5000));
+                const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+
+                expectEquals (listener.count.get(), numFrames);
+                logMessage ("Max speed replay: " + String (roundToInt (numFrames / jmax (1.0e-6, seconds))) + " frames/s");
+            }
+        }
+
+        file.deleteFile();
+    }
+};
+
+static LeapFrameLogTests leapFrameLogTests;
+
+#endif
@@ -0,0 +1,223 @@
+/*
+  ==============================================================================
+
+    LeapFrameLog.h
+
+  ==============================================================================
+*/
+
+#ifndef LEAPFRAMELOG_H_INCLUDED
+#define LEAPFRAMELOG_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "LeapUtil.h"
+
+//==============================================================================
+/**
+    The parts of a Leap::Frame that the demo uses, copied into a fixed-size block.
+
+    Unlike a Leap::Frame, one of these can be built from a recording, so the
+    rendering and haptics code takes TrackedFrames whether they come live from
+    the controller or from a LeapFrameReplayer. Copying one never allocates.
+
+    Each hand's pointables are stored together, starting at firstPointable.
+    Pointables that don't belong to a hand, and any past the limits below, are
+    left out.
+*/
+struct TrackedFrame
+{
+    enum { maxHands = 4, maxPointables = 20 };
+
+    struct Hand
+    {
+        int32 id;
+        int firstPointable, numPointables;
+        Leap::Vector palmPosition, palmNormal, palmVelocity, direction;
+    };
+
+    struct Pointable
+    {
+        int32 id;
+        bool isTool;
+        Leap::Vector tipPosition, tipVelocity, direction;
+        float width, length;
+    };
+
+    TrackedFrame() noexcept;
+
+    /** Removes all the hands. */
+    void clear() noexcept;
+
+    /** Copies a frame from the controller. */
+    void setFrom (const Leap::Frame&);
+
+    const Pointable& getPointable (const Hand& hand, int index) const noexcept  { return pointables [hand.firstPointable + index]; }
+
+    int64 id;
+    int64 timestamp;        // microseconds, as given by Leap::Frame::timestamp()
+    int numHands, numPointables;
+    Hand hands[maxHands];
+    Pointable pointables[maxPointables];
+};
+
+//==============================================================================
+/**
+    The binary frame log written by LeapFrameRecorder and read by LeapFrameLogReader.
+
+    A log is a 16 byte header followed by one record per frame. Everything is
+    little-endian. Each record holds its own size, the frame's id and timestamp,
+    then its hands and their pointables, so a typical two-hand frame takes
+    around 700 bytes.
+*/
+namespace LeapFrameLog
+{
+    enum
+    {
+        magic = 0x4c46504c,     // "LPFL"
+        version = 1,
+        headerSize = 16
+    };
+
+    /** Returns the size of the record that a frame will be written as. */
+    int getRecordSize (const TrackedFrame&) noexcept;
+
+    /** Writes a frame's record into dest, which must have getRecordSize() bytes. */
+    void writeRecord (const TrackedFrame&, uint8* dest) noexcept;
+
+    /** Reads a record back. Returns false if it's truncated or malformed. */
+    bool readRecord (const uint8* source, size_t bytesAvailable, TrackedFrame&) noexcept;
+}
+
+//==============================================================================
+/**
+    Appends every frame it's given to a frame log.
+
+    Add it to a Leap::Controller as a listener and it'll record each new frame
+    as the controller delivers it; frames can also be passed straight to
+    addFrame(). Records go through a large write buffer, so the callback only
+    copies the frame. The file is complete once the recorder has been deleted
+    or stop() has been called.
+*/
+class LeapFrameRecorder  : public Leap::Listener
+{
+public:
+    /** Replaces the file with a new, empty log. */
+    explicit LeapFrameRecorder (const File& file, int bufferSize = 1 << 18);
+    ~LeapFrameRecorder();
+
+    /** False if the file couldn't be opened. */
+    bool openedOk() const noexcept;
+
+    void addFrame (const TrackedFrame&);
+
+    /** Flushes and closes the file. Any later frames are ignored. */
+    void stop();
+
+    int64 getNumFramesWritten() const noexcept      { return numFramesWritten.get(); }
+
+    const File& getFile() const noexcept            { return file; }
+
+    void onFrame (const Leap::Controller&) override;
+
+private:
+    const File file;
+    CriticalSection lock;
+    ScopedPointer<FileOutputStream> stream;
+    HeapBlock<uint8> recordBuffer;
+    TrackedFrame frame;
+    Atomic<int64> numFramesWritten;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LeapFrameRecorder)
+};
+
+//==============================================================================
+/**
+    Reads the frames from a log in order.
+
+    Rather than loading the log, it maps a window of the file at a time with a
+    MemoryMappedFile and moves the window along as it goes, so a recording of
+    any length can be read with a fixed amount of address space.
+*/
+class LeapFrameLogReader
+{
+public:
+    explicit LeapFrameLogReader (const File& file, int64 windowSize = 1 << 24);
+    ~LeapFrameLogReader();
+
+    /** False if the file is missing or isn't a frame log. */
+    bool isValid() const noexcept                   { return valid; }
+
+    /** Reads the next frame. Returns false at the end of the log, or if the
+        rest of it is unreadable.
+    */
+    bool readNext (TrackedFrame&);
+
+    /** Goes back to the first frame. */
+    void rewind() noexcept;
+
+    int64 getPosition() const noexcept              { return position; }
+    int64 getTotalSize() const noexcept             { return fileSize; }
+
+private:
+    const File file;
+    const int64 windowSize;
+    int64 fileSize, position;
+    bool valid;
+    ScopedPointer<MemoryMappedFile> window;
+
+    const uint8* getBytes (int64 start, int64 numBytes);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LeapFrameLogReader)
+};
+
+//==============================================================================
+/**
+    Plays a frame log back from its own thread.
+
+    Frames are handed to the Listener at their recorded timing scaled by a speed
+    factor, so 1.0 reproduces the original capture, 4.0 plays it four times as
+    fast, and 0 delivers them as fast as the listener takes them.
+*/
+class LeapFrameReplayer  : private Thread
+{
+public:
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+
+        /** Called on the replay thread for each frame. */
+        virtual void frameReplayed (const TrackedFrame&) = 0;
+
+        /** Called on the replay thread when the log runs out and isn't looping. */
+        virtual void replayFinished() {}
+    };
+
+    LeapFrameReplayer (const File& file, Listener&);
+    ~LeapFrameReplayer();
+
+    bool isValid() const noexcept                   { return reader.isValid(); }
+
+    /** Starts from the beginning of the log. */
+    void start (double speed, bool loop);
+    void stop();
+
+    bool isReplaying() const                        { return isThreadRunning(); }
+    int64 getNumFramesReplayed() const noexcept     { return numFramesReplayed.get(); }
+
+private:
+    LeapFrameLogReader reader;
+    Listener& listener;
+    double speed;
+    bool looping;
+    TrackedFrame frame;
+    Atomic<int64> numFramesReplayed;
+
+    void run() override;
+    bool waitUntil (int64 ticks);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LeapFrameReplayer)
+};
+
+
+#endif  // LEAPFRAMELOG_H_INCLUDED
@@ -93,4 +93,1100 @@ void Camera::OnMouseMoveOrbit( const Vector& vMousePos )
   m_vLastMousePos = vMousePos;
 }
 
+///
+/// MotionPredictor methods
+///
+
+// frames further apart than this, in seconds, are treated as a new start rather than filtered across
+static const float kfMaxFrameGap = 0.25f;
+
+// initial uncertainty of a new point's velocity (units/s) and acceleration (units/s^2)
+static const float kfInitialVelocityVariance     = 1.0e6f;
+static const float kfInitialAccelerationVariance = 1.0e8f;
+
+MotionPredictor::MotionPredictor( FilterType eFilterType )
+  : m_eFilterType(eFilterType),
+    m_fPredictionTime(0.0f)
+{
+  // defaults suit fingertips in millimetres, tracked at 100Hz or more
+  SetOneEuroParameters( 1.0f, 0.05f, 5.0f );
+  SetKalmanParameters( 1.0e7f, 0.5f );
+  Reset();
+}
+
+void MotionPredictor::SetFilterType( FilterType eFilterType )
+{
+  m_eFilterType = eFilterType;
+  Reset();
+}
+
+void MotionPredictor::SetOneEuroParameters( float fMinCutoff, float fBeta, float fDerivativeCutoff )
+{
+  m_fMinCutoff        = fMinCutoff;
+  m_fBeta             = fBeta;
+  m_fDerivativeCutoff = fDerivativeCutoff;
+}
+
+void MotionPredictor::SetKalmanParameters( float fJerkNoise, float fMeasurementNoise )
+{
+  m_fJerkNoise           = fJerkNoise;
+  m_fMeasurementVariance = fMeasurementNoise * fMeasurementNoise;
+}
+
+void MotionPredictor::Reset()
+{
+  m_iNumTracked     = 0;
+  m_iTimestamp      = 0;
+  m_iLastTimestamp  = 0;
+  m_bHasLastFrame   = false;
+}
+
+void MotionPredictor::BeginFrame( int64_t iTimestamp )
+{
+  m_iTimestamp = iTimestamp;
+}
+
+int MotionPredictor::findSlot( int32_t iId ) const
+{
+  for ( int i = 0; i < m_iNumTracked; i++ )
+  {
+    if ( m_aiIds[i] == iId )
+    {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+void MotionPredictor::initSlot( int iSlot )
+{
+  for ( int iAxis = 0; iAxis < 3; iAxis++ )
+  {
+    m_afPosition[iAxis][iSlot]      = m_afMeasured[iAxis][iSlot];
+    m_afLastMeasured[iAxis][iSlot]  = m_afMeasured[iAxis][iSlot];
+    m_afPredicted[iAxis][iSlot]     = m_afMeasured[iAxis][iSlot];
+    m_afVelocity[iAxis][iSlot]      = 0.0f;
+    m_afAcceleration[iAxis][iSlot]  = 0.0f;
+  }
+
+  m_afCovariance[0][iSlot] = m_fMeasurementVariance;
+  m_afCovariance[1][iSlot] = 0.0f;
+  m_afCovariance[2][iSlot] = 0.0f;
+  m_afCovariance[3][iSlot] = kfInitialVelocityVariance;
+  m_afCovariance[4][iSlot] = 0.0f;
+  m_afCovariance[5][iSlot] = kfInitialAccelerationVariance;
+}
+
+bool MotionPredictor::AddMeasurement( int32_t iId, const Leap::Vector& vPosition )
+{
+  int iSlot = findSlot( iId );
+  const bool bIsNew = iSlot < 0;
+
+  if ( bIsNew )
+  {
+    if ( m_iNumTracked >= kMaxTracked )
+    {
+      return false;
+    }
+
+    iSlot = m_iNumTracked++;
+    m_aiIds[iSlot] = iId;
+  }
+
+  m_afMeasured[0][iSlot] = vPosition.x;
+  m_afMeasured[1][iSlot] = vPosition.y;
+  m_afMeasured[2][iSlot] = vPosition.z;
+  m_abMeasured[iSlot]    = 1;
+
+  if ( bIsNew )
+  {
+    initSlot( iSlot );
+  }
+
+  return true;
+}
+
+void MotionPredictor::removeUnmeasured()
+{
+  // swap the last slot into each gap so that the arrays stay packed
+  for ( int i = m_iNumTracked; --i >= 0; )
+  {
+    if ( m_abMeasured[i] )
+    {
+      continue;
+    }
+
+    const int iLast = --m_iNumTracked;
+
+    m_aiIds[i]      = m_aiIds[iLast];
+    m_abMeasured[i] = m_abMeasured[iLast];
+
+    for ( int iAxis = 0; iAxis < 3; iAxis++ )
+    {
+      m_afMeasured[iAxis][i]      = m_afMeasured[iAxis][iLast];
+      m_afLastMeasured[iAxis][i]  = m_afLastMeasured[iAxis][iLast];
+      m_afPosition[iAxis][i]      = m_afPosition[iAxis][iLast];
+      m_afVelocity[iAxis][i]      = m_afVelocity[iAxis][iLast];
+      m_afAcceleration[iAxis][i]  = m_afAcceleration[iAxis][iLast];
+      m_afPredicted[iAxis][i]     = m_afPredicted[iAxis][iLast];
+    }
+
+    for ( int iTerm = 0; iTerm < kNumCovarianceTerms; iTerm++ )
+    {
+      m_afCovariance[iTerm][i] = m_afCovariance[iTerm][iLast];
+    }
+  }
+}
+
+void MotionPredictor::EndFrame()
+{
+  removeUnmeasured();
+
+  const float fDeltaTime = static_cast<float>(m_iTimestamp - m_iLastTimestamp) * 1.0e-6f;
+
+  // start again after a gap, or if time goes backwards when a recording restarts
+  if ( ! m_bHasLastFrame || fDeltaTime < 0.0f || fDeltaTime > kfMaxFrameGap )
+  {
+    for ( int i = 0; i < m_iNumTracked; i++ )
+    {
+      initSlot( i );
+    }
+  }
+  else if ( fDeltaTime > 0.0f )
+  {
+    if ( m_eFilterType == kFilter_Kalman )
+    {
+      updateKalman( fDeltaTime );
+    }
+    else
+    {
+      updateOneEuro( fDeltaTime );
+    }
+  }
+
+  for ( int i = 0; i < m_iNumTracked; m_abMeasured[i++] = 0 );
+
+  m_iLastTimestamp = m_iTimestamp;
+  m_bHasLastFrame  = true;
+}
+
+void MotionPredictor::updateOneEuro( float fDeltaTime )
+{
+  const int   iNum        = m_iNumTracked;
+  const float fLead       = m_fPredictionTime;
+  const float fRate       = 1.0f / fDeltaTime;
+  const float fTwoPiDT    = kf2Pi * fDeltaTime;
+  const float fDerivAlpha = fTwoPiDT * m_fDerivativeCutoff / (fTwoPiDT * m_fDerivativeCutoff + 1.0f);
+
+  // smooth the velocity between the last two measurements
+  for ( int iAxis = 0; iAxis < 3; iAxis++ )
+  {
+    const float*  pfMeasured      = m_afMeasured[iAxis];
+    float*        pfLastMeasured  = m_afLastMeasured[iAxis];
+    float*        pfVelocity      = m_afVelocity[iAxis];
+
+    for ( int i = 0; i < iNum; i++ )
+    {
+      const float fRawVelocity = (pfMeasured[i] - pfLastMeasured[i]) * fRate;
+      pfVelocity[i]     += fDerivAlpha * (fRawVelocity - pfVelocity[i]);
+      pfLastMeasured[i]  = pfMeasured[i];
+    }
+  }
+
+  // the faster a point moves, the higher its cutoff, so the less it lags
+  float* pfAlpha = m_afGain[0];
+
+  for ( int i = 0; i < iNum; i++ )
+  {
+    const float fSpeed  = sqrtf(  m_afVelocity[0][i] * m_afVelocity[0][i]
+                                + m_afVelocity[1][i] * m_afVelocity[1][i]
+                                + m_afVelocity[2][i] * m_afVelocity[2][i] );
+    const float fR      = fTwoPiDT * (m_fMinCutoff + m_fBeta * fSpeed);
+    pfAlpha[i]          = fR / (fR + 1.0f);
+  }
+
+  for ( int iAxis = 0; iAxis < 3; iAxis++ )
+  {
+    const float*  pfMeasured  = m_afMeasured[iAxis];
+    const float*  pfVelocity  = m_afVelocity[iAxis];
+    float*        pfPosition  = m_afPosition[iAxis];
+    float*        pfPredicted = m_afPredicted[iAxis];
+
+    for ( int i = 0; i < iNum; i++ )
+    {
+      pfPosition[i]  += pfAlpha[i] * (pfMeasured[i] - pfPosition[i]);
+      pfPredicted[i]  = pfPosition[i] + pfVelocity[i] * fLead;
+    }
+  }
+}
+
+void MotionPredictor::updateKalman( float fDeltaTime )
+{
+  const int   iNum  = m_iNumTracked;
+  const float fDT   = fDeltaTime;
+  const float fHalfDT2 = 0.5f * fDT * fDT;
+  const float fLead = m_fPredictionTime;
+  const float fHalfLead2 = 0.5f * fLead * fLead;
+  const float fR    = m_fMeasurementVariance;
+
+  // process noise of a white-noise jerk model
+  const float fQ    = m_fJerkNoise;
+  const float fDT2  = fDT * fDT;
+  const float fDT3  = fDT2 * fDT;
+  const float fQ00  = fQ * fDT3 * fDT2 / 20.0f;
+  const float fQ01  = fQ * fDT2 * fDT2 / 8.0f;
+  const float fQ02  = fQ * fDT3 / 6.0f;
+  const float fQ11  = fQ * fDT3 / 3.0f;
+  const float fQ12  = fQ * fDT2 / 2.0f;
+  const float fQ22  = fQ * fDT;
+
+  float* pfP00 = m_afCovariance[0];
+  float* pfP01 = m_afCovariance[1];
+  float* pfP02 = m_afCovariance[2];
+  float* pfP11 = m_afCovariance[3];
+  float* pfP12 = m_afCovariance[4];
+  float* pfP22 = m_afCovariance[5];
+
+  // every axis is measured together with the same noise, so they share a covariance and gains
+  for ( int i = 0; i < iNum; i++ )
+  {
+    // P = F P F' + Q, where F = [1 dt dt^2/2; 0 1 dt; 0 0 1]
+    const float fA00 = pfP00[i] + fDT * pfP01[i] + fHalfDT2 * pfP02[i];
+    const float fA01 = pfP01[i] + fDT * pfP11[i] + fHalfDT2 * pfP12[i];
+    const float fA02 = pfP02[i] + fDT * pfP12[i] + fHalfDT2 * pfP22[i];
+    const float fA11 = pfP11[i] + fDT * pfP12[i];
+    const float fA12 = pfP12[i] + fDT * pfP22[i];
+
+    const float fN00 = fA00 + fDT * fA01 + fHalfDT2 * fA02 + fQ00;
+    const float fN01 = fA01 + fDT * fA02 + fQ01;
+    const float fN02 = fA02 + fQ02;
+    const float fN11 = fA11 + fDT * fA12 + fQ11;
+    const float fN12 = fA12 + fQ12;
+    const float fN22 = pfP22[i] + fQ22;
+
+    // only position is measured, so the gain is P's first column over its innovation variance
+    const float fInvS = 1.0f / (fN00 + fR);
+    const float fK0   = fN00 * fInvS;
+    const float fK1   = fN01 * fInvS;
+    const float fK2   = fN02 * fInvS;
+
+    pfP00[i] = fN00 - fK0 * fN00;
+    pfP01[i] = fN01 - fK0 * fN01;
+    pfP02[i] = fN02 - fK0 * fN02;
+    pfP11[i] = fN11 - fK1 * fN01;
+    pfP12[i] = fN12 - fK1 * fN02;
+    pfP22[i] = fN22 - fK2 * fN02;
+
+    m_afGain[0][i] = fK0;
+    m_afGain[1][i] = fK1;
+    m_afGain[2][i] = fK2;
+  }
+
+  for ( int iAxis = 0; iAxis < 3; iAxis++ )
+  {
+    const float*  pfMeasured      = m_afMeasured[iAxis];
+    float*        pfPosition      = m_afPosition[iAxis];
+    float*        pfVelocity      = m_afVelocity[iAxis];
+    float*        pfAcceleration  = m_afAcceleration[iAxis];
+    float*        pfPredicted     = m_afPredicted[iAxis];
+
+    for ( int i = 0; i < iNum; i++ )
+    {
+      const float fPosition   = pfPosition[i] + fDT * pfVelocity[i] + fHalfDT2 * pfAcceleration[i];
+      const float fVelocity   = pfVelocity[i] + fDT * pfAcceleration[i];
+      const float fInnovation = pfMeasured[i] - fPosition;
+
+      pfPosition[i]     = fPosition + m_afGain[0][i] * fInnovation;
+      pfVelocity[i]     = fVelocity + m_afGain[1][i] * fInnovation;
+      pfAcceleration[i] += m_afGain[2][i] * fInnovation;
+      pfPredicted[i]    = pfPosition[i] + fLead * pfVelocity[i] + fHalfLead2 * pfAcceleration[i];
+    }
+  }
+}
+
+bool MotionPredictor::GetFiltered( int32_t iId, Vector& vPosition ) const
+{
+  const int iSlot = findSlot( iId );
+
+  if ( iSlot < 0 )
+  {
+    return false;
+  }
+
+  vPosition = Vector( m_afPosition[0][iSlot], m_afPosition[1][iSlot], m_afPosition[2][iSlot] );
+  return true;
+}
+
+bool MotionPredictor::GetVelocity( int32_t iId, Vector& vVelocity ) const
+{
+  const int iSlot = findSlot( iId );
+
+  if ( iSlot < 0 )
+  {
+    return false;
+  }
+
+  vVelocity = Vector( m_afVelocity[0][iSlot], m_afVelocity[1][iSlot], m_afVelocity[2][iSlot] );
+  return true;
+}
+
+bool MotionPredictor::GetPredicted( int32_t iId, Vector& vPosition ) const
+{
+  const int iSlot = findSlot( iId );
+
+  if ( iSlot < 0 )
+  {
+    return false;
+  }
+
+  vPosition = Vector( m_afPredicted[0][iSlot], m_afPredicted[1][iSlot], m_afPredicted[2][iSlot] );
+  return true;
+}
+
+bool MotionPredictor::GetPredicted( int32_t iId, float fSecondsAhead, Vector& vPosition ) const
+{
+  const int iSlot = findSlot( iId );
+
+  if ( iSlot < 0 )
+  {
+    return false;
+  }
+
+  // the One-Euro filter's acceleration is always zero, so this is a straight line for it
+  const float fHalfT2 = 0.5f * fSecondsAhead * fSecondsAhead;
+  float       afResult[3];
+
+  for ( int iAxis = 0; iAxis < 3; iAxis++ )
+  {
+    afResult[iAxis] = m_afPosition[iAxis][iSlot]
+                    + fSecondsAhead * m_afVelocity[iAxis][iSlot]
+                    + fHalfT2 * m_afAcceleration[iAxis][iSlot];
+  }
+
+  vPosition = Vector( afResult[0], afResult[1], afResult[2] );
+  return true;
+}
+
+}
+
+//==============================================================================
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class LeapFrameExchangeTests  : public juce::UnitTest
+{
+public:
+    LeapFrameExchangeTests() : UnitTest ("LeapFrameExchange") {}
+
+    // stands in for a frame's worth of tracking data, big enough for the copies to matter
+    struct Payload
+    {
+        void fill (uint32 n) noexcept   { sequence = n; for (int i = 0; i < numElementsInArray (data); ++i) data[i] = (float) n; }
+        bool isIntact() const noexcept  { for (int i = 0; i < numElementsInArray (data); ++i) if (data[i] != (float) sequence) return false; return true; }
+
+        uint32 sequence;
+        float data[511];
+    };
+
+    // the straightforward alternative: one shared copy behind a lock
+    struct LockedExchange
+    {
+        LockedExchange() : fresh (false), published (0), lastRead (0) {}
+
+        void Publish (const Payload& p)
+        {
+            const ScopedLock sl (lock);
+            value = p;
+            fresh = true;
+            ++published;
+        }
+
+        bool Read (int, Payload& result, uint32_t& numSkipped)
+        {
+            const ScopedLock sl (lock);
+
+            if (! fresh)
+                return false;
+
+            result = value;
+            fresh = false;
+            numSkipped = published - lastRead - 1;
+            lastRead = published;
+            return true;
+        }
+
+        CriticalSection lock;
+        Payload value;
+        bool fresh;
+        uint32_t published, lastRead;
+    };
+
+    template <class ExchangeType>
+    struct Producer  : public Thread
+    {
+        Producer (ExchangeType& e, double rateHz, int total)
+            : Thread ("exchange producer"), exchange (e), numToPublish (total),
+              interval ((int64) (Time::getHighResolutionTicksPerSecond() / rateHz)),
+              totalTicks (0), maxTicks (0)
+        {
+        }
+
+        void run() override
+        {
+            Payload p;
+            int64 next = Time::getHighResolutionTicks();
+
+            for (int i = 1; i <= numToPublish && ! threadShouldExit(); ++i)
+            {
+                for (int64 now = Time::getHighResolutionTicks(); now < next; now = Time::getHighResolutionTicks())
+                {
+                    const int msLeft = (int) (Time::highResolutionTicksToSeconds (next - now) * 1000.0);
+
+                    if (msLeft > 1)
+                        Thread::sleep (msLeft - 1);
+                    else
+                        Thread::yield();
+                }
+
+                next += interval;
+                p.fill ((uint32) i);
+
+                const int64 start = Time::getHighResolutionTicks();
+                exchange.Publish (p);
+                const int64 elapsed = Time::getHighResolutionTicks() - start;
+
+                totalTicks += elapsed;
+                maxTicks = jmax (maxTicks, elapsed);
+            }
+        }
+
+        ExchangeType& exchange;
+        const int numToPublish;
+        const int64 interval;
+        int64 totalTicks, maxTicks;
+    };
+
+    template <class ExchangeType>
+    void runHandoff (const String& name, double rateHz, int numFrames)
+    {
+        ExchangeType exchange;
+        Producer<ExchangeType> producer (exchange, rateHz, numFrames);
+
+        Payload p;
+        uint32_t numSkipped = 0, lastSequence = 0, totalSkipped = 0, numRead = 0;
+        int64 readTicks = 0, maxReadTicks = 0;
+        bool intact = true, ordered = true;
+
+        producer.startThread();
+
+        while (lastSequence < (uint32_t) numFrames)
+        {
+            const int64 start = Time::getHighResolutionTicks();
+            const bool gotOne = exchange.Read (0, p, numSkipped);
+            const int64 elapsed = Time::getHighResolutionTicks() - start;
+
+            if (gotOne)
+            {
+                readTicks += elapsed;
+                maxReadTicks = jmax (maxReadTicks, elapsed);
+                intact = intact && p.isIntact();
+                ordered = ordered && p.sequence == lastSequence + numSkipped + 1;
+                lastSequence = p.sequence;
+                totalSkipped += numSkipped;
+                ++numRead;
+            }
+            else
+            {
+                Thread::yield();
+            }
+        }
+
+        producer.stopThread (5000);
+
+        expect (intact, "torn frame");
+        expect (ordered, "sequence numbers don't match skip counts");
+        expectEquals ((int) (numRead + totalSkipped), numFrames);
+
+        const double usPerTick = 1.0e6 / (double) Time::getHighResolutionTicksPerSecond();
+
+        logMessage (name + " @ " + String (rateHz, 0) + " Hz: publish avg "
+                     + String (usPerTick * producer.totalTicks / numFrames, 2) + " us, max "
+                     + String (usPerTick * producer.maxTicks, 2) + " us; read avg "
+                     + String (usPerTick * readTicks / jmax (1u, numRead), 2) + " us, max "
+                     + String (usPerTick * maxReadTicks, 2) + " us; "
+                     + String (totalSkipped) + " skipped");
+    }
+
+    void runTest() override
+    {
+        beginTest ("Newest value and skip counts");
+
+        LeapUtil::LeapFrameExchange<int, 2> exchange;
+        int value = 0;
+        uint32_t numSkipped = 0;
+
+        expect (! exchange.Read (0, value, numSkipped));
+
+        for (int i = 1; i <= 5; ++i)
+            exchange.Publish (i);
+
+        expect (exchange.Read (0, value, numSkipped));
+        expectEquals (value, 5);
+        expectEquals ((int) numSkipped, 4);
+        expect (! exchange.Read (0, value, numSkipped));
+
+        exchange.Publish (6);
+        expect (exchange.Read (0, value, numSkipped));
+        expectEquals (value, 6);
+        expectEquals ((int) numSkipped, 0);
+
+        expect (exchange.Read (1, value, numSkipped));
+        expectEquals (value, 6);
+        expectEquals ((int) numSkipped, 5);
+        expectEquals ((int) exchange.GetLastReadSequence (1), 6);
+
+        beginTest ("Triple buffer vs CriticalSection handoff");
+
+        const double rates[] = { 240.0, 1000.0 };
+
+        for (int i = 0; i < numElementsInArray (rates); ++i)
+        {
+            const int numFrames = (int) (rates[i] / 4);
+
+            runHandoff<LeapUtil::LeapFrameExchange<Payload> > ("LeapFrameExchange", rates[i], numFrames);
+            runHandoff<LockedExchange> ("CriticalSection", rates[i], numFrames);
+        }
+    }
+};
+
+static LeapFrameExchangeTests leapFrameExchangeTests;
+
+#endif
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class MotionPredictorTests  : public juce::UnitTest
+{
+public:
+    MotionPredictorTests() : UnitTest ("MotionPredictor") {}
+
+    static Leap::Vector circlePosition (double seconds) noexcept
+    {
+        // a fingertip circling 80mm across, once a second
+        const double angle = 2.0 * double_Pi * seconds;
+        return Leap::Vector ((float) (40.0 * std::cos (angle)), (float) (200.0 + 40.0 * std::sin (angle)), 0.0f);
+    }
+
+    /** Returns the RMS error of the predictions, and the error of just using the latest measurement. */
+    void runCircle (LeapUtil::MotionPredictor& predictor, float latency, float noise, double& predictedError, double& rawError)
+    {
+        Random r (0x1eaf);
+        const double frameInterval = 1.0 / 115.0;
+        double predictedSum = 0, rawSum = 0;
+        int numErrors = 0;
+
+        predictor.SetPredictionTime (latency);
+
+        for (int frame = 0; frame < 600; ++frame)
+        {
+            const double t = frame * frameInterval;
+            const Leap::Vector measured (circlePosition (t) + Leap::Vector (noise * (r.nextFloat() - 0.5f),
+                                                                            noise * (r.nextFloat() - 0.5f),
+                                                                            noise * (r.nextFloat() - 0.5f)));
+            predictor.BeginFrame ((int64_t) (t * 1.0e6));
+            predictor.AddMeasurement (7, measured);
+            predictor.EndFrame();
+
+            // give the filters a second to settle
+            if (frame >= 115)
+            {
+                const Leap::Vector actual (circlePosition (t + latency));
+                Leap::Vector predicted;
+                predictor.GetPredicted (7, predicted);
+
+                predictedSum += (predicted - actual).magnitudeSquared();
+                rawSum += (measured - actual).magnitudeSquared();
+                ++numErrors;
+            }
+        }
+
+        predictedError = std::sqrt (predictedSum / numErrors);
+        rawError = std::sqrt (rawSum / numErrors);
+    }
+
+    void runTest() override
+    {
+        beginTest ("Points are tracked by id");
+        {
+            LeapUtil::MotionPredictor predictor;
+            Leap::Vector v;
+
+            predictor.BeginFrame (1000);
+            predictor.AddMeasurement (5, Leap::Vector (1, 2, 3));
+            predictor.AddMeasurement (9, Leap::Vector (4, 5, 6));
+            predictor.EndFrame();
+
+            expectEquals (predictor.GetNumTracked(), 2);
+            expect (predictor.GetFiltered (9, v) && v == Leap::Vector (4, 5, 6));
+            expect (predictor.GetPredicted (5, v) && v == Leap::Vector (1, 2, 3));
+
+            // a point that isn't measured in a frame is forgotten
+            predictor.BeginFrame (10000);
+            predictor.AddMeasurement (9, Leap::Vector (4, 5, 6));
+            predictor.EndFrame();
+
+            expectEquals (predictor.GetNumTracked(), 1);
+            expect (! predictor.GetFiltered (5, v));
+            expect (predictor.GetFiltered (9, v) && v == Leap::Vector (4, 5, 6));
+
+            for (int i = 0; i < LeapUtil::MotionPredictor::kMaxTracked; ++i)
+                predictor.AddMeasurement (100 + i, Leap::Vector());
+
+            expect (! predictor.AddMeasurement (1, Leap::Vector()));
+        }
+
+        beginTest ("Still points settle");
+        {
+            for (int type = LeapUtil::MotionPredictor::kFilter_OneEuro; type <= LeapUtil::MotionPredictor::kFilter_Kalman; ++type)
+            {
+                LeapUtil::MotionPredictor predictor ((LeapUtil::MotionPredictor::FilterType) type);
+                Random r (0x57111);
+                const Leap::Vector target (10, 150, -20);
+                double filteredSum = 0, rawSum = 0;
+
+                for (int frame = 0; frame < 500; ++frame)
+                {
+                    const Leap::Vector noise (r.nextFloat() - 0.5f, r.nextFloat() - 0.5f, r.nextFloat() - 0.5f);
+                    predictor.BeginFrame (frame * 8333);
+                    predictor.AddMeasurement (1, target + noise);
+                    predictor.EndFrame();
+
+                    Leap::Vector filtered;
+                    predictor.GetFiltered (1, filtered);
+
+                    if (frame >= 100)
+                    {
+                        filteredSum += (filtered - target).magnitudeSquared();
+                        rawSum += noise.magnitudeSquared();
+                    }
+                }
+
+                expect (filteredSum < rawSum * 0.5, "filter type " + String (type));
+            }
+        }
+
+        beginTest ("Prediction makes up for latency");
+        {
+            const char* const names[] = { "One-Euro", "Kalman" };
+
+            for (int type = LeapUtil::MotionPredictor::kFilter_OneEuro; type <= LeapUtil::MotionPredictor::kFilter_Kalman; ++type)
+            {
+                LeapUtil::MotionPredictor predictor ((LeapUtil::MotionPredictor::FilterType) type);
+                double predictedError, rawError;
+                runCircle (predictor, 0.04f, 1.0f, predictedError, rawError);
+
+                expect (predictedError < rawError * 0.5, names[type]);
+                logMessage (String (names[type]) + " 40ms ahead: RMS error " + String (predictedError, 2)
+                             + " mm, against " + String (rawError, 2) + " mm for the latest measurement");
+            }
+        }
+
+        beginTest ("Update speed");
+        {
+            for (int type = LeapUtil::MotionPredictor::kFilter_OneEuro; type <= LeapUtil::MotionPredictor::kFilter_Kalman; ++type)
+            {
+                LeapUtil::MotionPredictor predictor ((LeapUtil::MotionPredictor::FilterType) type);
+                predictor.SetPredictionTime (0.03f);
+
+                const int numPoints = 40, numFrames = 20000;
+                const int64 start = Time::getHighResolutionTicks();
+
+                for (int frame = 0; frame < numFrames; ++frame)
+                {
+                    predictor.BeginFrame ((int64_t) frame * 8333);
+
+                    for (int i = 0; i < numPoints; ++i)
+                        predictor.AddMeasurement (i, Leap::Vector ((float) i, (float) frame * 0.1f, 0.0f));
+
+                    predictor.EndFrame();
+                }
+
+                const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+                expectEquals (predictor.GetNumTracked(), numPoints);
+
+                logMessage (String (type == LeapUtil::MotionPredictor::kFilter_Kalman ? "Kalman" : "One-Euro")
+                             + ": " + String (seconds * 1.0e6 / numFrames, 2) + " us per frame of "
+                             + String (numPoints) + " points");
+            }
+        }
+    }
+};
+
+static MotionPredictorTests motionPredictorTests;
+
+#endif
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class RollingStatisticsTests  : public juce::UnitTest
+{
+public:
+    RollingStatisticsTests() : UnitTest ("RollingStatistics") {}
+
+    void expectNear (double value, double expected, double tolerance)
+    {
+        expect (std::abs (value - expected) <= tolerance,
+                "expected " + String (expected) + " +/- " + String (tolerance) + ", got " + String (value));
+    }
+
+    /** Feeds random samples in and checks every statistic against one worked out from scratch. */
+    template <class StatsType>
+    void compareWithBruteForce (StatsType& stats, int numSamplesToAdd, int64 seed)
+    {
+        const int numChannels = StatsType::kNumChannels;
+        const int historyLength = StatsType::kHistoryLength;
+        const double binWidth = 100.0 / StatsType::kNumBins;
+        Random r (seed);
+        Array<double> values[numChannels];
+
+        stats.SetPercentileRange (-50.0f, 50.0f);
+
+        for (int i = 0; i < numSamplesToAdd; ++i)
+        {
+            float sample[numChannels];
+
+            for (int c = 0; c < numChannels; ++c)
+            {
+                // each channel gets a different spread, and the odd one drifts
+                sample[c] = (r.nextFloat() - 0.5f) * 10.0f * (c + 1) + ((c & 1) != 0 ? 0.01f * (i % 500) : 0.0f);
+                values[c].add (sample[c]);
+
+                if (values[c].size() > historyLength)
+                    values[c].remove (0);
+            }
+
+            stats.AddSample (sample);
+
+            if (i % 37 != 0 && i != numSamplesToAdd - 1)
+                continue;
+
+            expectEquals ((int) stats.GetNumSamples(), values[0].size());
+
+            for (int c = 0; c < numChannels; ++c)
+            {
+                const int n = values[c].size();
+                double mean = 0, variance = 0;
+
+                for (int j = 0; j < n; ++j)
+                    mean += values[c][j];
+
+                mean /= n;
+
+                for (int j = 0; j < n; ++j)
+                    variance += (values[c][j] - mean) * (values[c][j] - mean);
+
+                variance /= n;
+
+                expectNear ((double) stats.GetMean (c), mean, 1.0e-3);
+                expectNear ((double) stats.GetVariance (c), variance, 1.0e-2 * (1.0 + variance * 1.0e-2));
+
+                Array<double> sorted (values[c]);
+                DefaultElementComparator<double> comparator;
+                sorted.sort (comparator);
+
+                expectEquals ((double) stats.GetMin (c), sorted.getFirst());
+                expectEquals ((double) stats.GetMax (c), sorted.getLast());
+                expectEquals ((double) stats.GetSample (0, c), values[c].getFirst());
+                expectEquals ((double) stats.GetLatest (c), values[c].getLast());
+
+                for (int percent = 0; percent <= 100; percent += 10)
+                {
+                    // when the rank falls between two samples, anything between them is right
+                    const double rank = percent * 0.01 * n;
+                    const double lower = sorted[jlimit (0, n - 1, (int) std::ceil (rank) - 1)];
+                    const double upper = sorted[jlimit (0, n - 1, (int) rank)];
+                    const double percentile = stats.GetPercentile ((float) percent, c);
+
+                    expect (percentile >= lower - binWidth && percentile <= upper + binWidth,
+                            String (percent) + "th percentile " + String (percentile) + " isn't near " + String (lower) + " to " + String (upper));
+                }
+            }
+        }
+    }
+
+    void runTest() override
+    {
+        beginTest ("Matches brute force");
+        {
+            // a history that isn't a power of two, so the storage is longer than the window
+            ScopedPointer<LeapUtil::RollingStatistics<float, 100, 3> > stats (new LeapUtil::RollingStatistics<float, 100, 3>());
+            compareWithBruteForce (*stats, 2000, 0x5ea7);
+
+            // and one where the window fills the storage exactly
+            ScopedPointer<LeapUtil::RollingStatistics<float, 64, 2, 128> > stats2 (new LeapUtil::RollingStatistics<float, 64, 2, 128>());
+            compareWithBruteForce (*stats2, 2000, 0x64);
+
+            stats2->Reset();
+            expectEquals ((int) stats2->GetNumSamples(), 0);
+            compareWithBruteForce (*stats2, 50, 0x2);
+        }
+
+        beginTest ("Extremes of monotonic runs");
+        {
+            LeapUtil::RollingStatistics<int, 10> stats (0, 100);
+
+            for (int i = 0; i < 50; ++i)
+            {
+                stats.AddSample (i);
+                expectEquals (stats.GetMin(), jmax (0, i - 9));
+                expectEquals (stats.GetMax(), i);
+            }
+
+            // the window now holds 40 to 49, followed by 49, 48, 47...
+            for (int i = 1; i <= 30; ++i)
+            {
+                stats.AddSample (50 - i);
+                expectEquals (stats.GetMin(), jmin (40 + i, 50 - i));
+                expectEquals (stats.GetMax(), i <= 10 ? 49 : 59 - i);
+            }
+        }
+
+        beginTest ("RollingAverage");
+        {
+            LeapUtil::RollingAverage<4> average;
+
+            expectEquals (average.AddSample (4.0f), 4.0f);
+            expectEquals (average.AddSample (2.0f), 3.0f);
+            expectEquals (average[0], 0.0f);
+            expectEquals (average[2], 4.0f);
+            expectEquals (average[3], 2.0f);
+
+            average.AddSample (6.0f);
+            average.AddSample (8.0f);
+            expectEquals (average.AddSample (10.0f), 6.5f);
+            expectEquals (average.GetSum(), 26.0f);
+            expectEquals (average[0], 2.0f);
+            expectEquals (average[3], 10.0f);
+        }
+
+        beginTest ("Performance");
+        {
+            enum { numChannels = 32, numSamples = 200000 };
+            ScopedPointer<LeapUtil::RollingStatistics<float, 256, numChannels> > stats (new LeapUtil::RollingStatistics<float, 256, numChannels>());
+            HeapBlock<float> samples ((size_t) numChannels * 1024);
+            Random r (0x9e7f);
+
+            for (int i = 0; i < numChannels * 1024; ++i)
+                samples[i] = r.nextFloat();
+
+            const double startTime = Time::getMillisecondCounterHiRes();
+
+            for (int i = 0; i < numSamples; ++i)
+                stats->AddSample (samples + (i & 1023) * numChannels);
+
+            const double elapsed = Time::getMillisecondCounterHiRes() - startTime;
+
+            logMessage (String (numSamples) + " samples of " + String ((int) numChannels) + " channels in "
+                         + String (elapsed, 1) + "ms, " + String (elapsed * 1.0e6 / numSamples, 0) + "ns per sample");
+
+            expect (stats->GetMean (0) > 0.4f && stats->GetMean (0) < 0.6f);
+        }
+    }
+};
+
+static RollingStatisticsTests rollingStatisticsTests;
+
+#endif
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+namespace SmartPointerTestHelpers
+{
+    static Atomic<int> numLiveObjects;
+
+    struct Counted
+    {
+        Counted (int v) noexcept : value (v)   { ++numLiveObjects; }
+        ~Counted() noexcept                     { --numLiveObjects; }
+
+        int value;
+    };
+
+    typedef LeapUtil::SmartPointer<Counted> CountedPointer;
+    typedef LeapUtil::SmartPointer<Counted, LeapUtil::SmartInstanceDestructor<Counted>, 4> SmallPoolPointer;
+
+    /** Copies and releases a handful of shared pointers, and creates and releases its own. */
+    class Worker  : public Thread
+    {
+    public:
+        Worker (const CountedPointer* shared, int numShared, int numIterations, int seed)
+            : Thread ("SmartPointer worker"), sharedPointers (shared), numSharedPointers (numShared),
+              iterations (numIterations), random (seed), numErrors (0)
+        {
+        }
+
+        void run() override
+        {
+            CountedPointer held[8];
+
+            for (int i = 0; i < iterations; ++i)
+            {
+                const CountedPointer& shared = sharedPointers[random.nextInt (numSharedPointers)];
+                held[i & 7] = shared;
+
+                if (held[i & 7]->value != shared->value)
+                    ++numErrors;
+
+                // every so often a new object, which goes through the hash table and free list
+                if ((i & 15) == 0)
+                {
+                    CountedPointer own (new Counted (i));
+                    CountedPointer copy (own);
+
+                    if (copy.GetRefCount() != 2 || copy->value != i)
+                        ++numErrors;
+                }
+            }
+        }
+
+        const CountedPointer* sharedPointers;
+        const int numSharedPointers, iterations;
+        Random random;
+        int numErrors;
+    };
 }
+
+class SmartPointerTests  : public juce::UnitTest
+{
+public:
+    SmartPointerTests() : UnitTest ("SmartPointer") {}
+
+    /** Returns the number of reference operations per second. */
+    double runThreads (int numThreads, int iterationsPerThread)
+    {
+        using namespace SmartPointerTestHelpers;
+
+        CountedPointer shared[4];
+
+        for (int i = 0; i < numElementsInArray (shared); ++i)
+            shared[i] = CountedPointer (new Counted (i));
+
+        OwnedArray<Worker> workers;
+
+        for (int i = 0; i < numThreads; ++i)
+            workers.add (new Worker (shared, numElementsInArray (shared), iterationsPerThread, i + 1));
+
+        const double startTime = Time::getMillisecondCounterHiRes();
+
+        for (int i = 0; i < numThreads; ++i)
+            workers[i]->startThread();
+
+        for (int i = 0; i < numThreads; ++i)
+        {
+            workers[i]->waitForThreadToExit (-1);
+            expectEquals (workers[i]->numErrors, 0);
+        }
+
+        const double elapsed = Time::getMillisecondCounterHiRes() - startTime;
+
+        for (int i = 0; i < numElementsInArray (shared); ++i)
+            expectEquals ((int) shared[i].GetRefCount(), 1);
+
+        return numThreads * (double) iterationsPerThread * 1000.0 / jmax (elapsed, 0.001);
+    }
+
+    void runTest() override
+    {
+        using namespace SmartPointerTestHelpers;
+
+        beginTest ("Reference counting");
+        {
+            {
+                Counted* raw = new Counted (7);
+                CountedPointer a (raw);
+                expectEquals ((int) a.GetRefCount(), 1);
+                expect (CountedPointer::IsManaged (raw));
+
+                {
+                    // a second smart pointer made from the same raw pointer shares the count
+                    CountedPointer b (raw);
+                    CountedPointer c (b);
+                    expect (a == b && b == c);
+                    expectEquals ((int) a.GetRefCount(), 3);
+                }
+
+                expectEquals ((int) a.GetRefCount(), 1);
+                expectEquals (numLiveObjects.get(), 1);
+
+                a = CountedPointer::Null();
+                expect (! a);
+                expectEquals (numLiveObjects.get(), 0);
+                expect (! CountedPointer::IsManaged (raw));
+            }
+
+            expectEquals ((int) CountedPointer::GetNumManagedPointers(), 0);
+            expect (! CountedPointer (nullptr));
+        }
+
+        beginTest ("Pool grows");
+        {
+            const int numPointers = 100;
+            HeapBlock<SmallPoolPointer> pointers;
+            pointers.allocate (numPointers, true);
+
+            for (int i = 0; i < numPointers; ++i)
+            {
+                new (pointers + i) SmallPoolPointer (new Counted (i));
+                expect (pointers[i] && pointers[i]->value == i);
+            }
+
+            expectEquals ((int) SmallPoolPointer::GetNumManagedPointers(), numPointers);
+            expect ((int) SmallPoolPointer::GetManagedPointerCapacity() >= numPointers);
+            expectEquals (numLiveObjects.get(), numPointers);
+
+            for (int i = 0; i < numPointers; ++i)
+                expect (SmallPoolPointer::IsManaged (pointers[i].GetPointer()));
+
+            // free every other one, then refill, so entries are recycled from the free list
+            const int capacity = (int) SmallPoolPointer::GetManagedPointerCapacity();
+
+            for (int i = 0; i < numPointers; i += 2)
+                pointers[i].Release();
+
+            for (int i = 0; i < numPointers; i += 2)
+                pointers[i] = SmallPoolPointer (new Counted (-i));
+
+            expectEquals ((int) SmallPoolPointer::GetManagedPointerCapacity(), capacity);
+
+            for (int i = 0; i < numPointers; ++i)
+                pointers[i].~SmallPoolPointer();
+
+            expectEquals ((int) SmallPoolPointer::GetNumManagedPointers(), 0);
+            expectEquals (numLiveObjects.get(), 0);
+        }
+
+        beginTest ("Shared between threads");
+        {
+            runThreads (8, 20000);
+            expectEquals ((int) CountedPointer::GetNumManagedPointers(), 0);
+            expectEquals (numLiveObjects.get(), 0);
+        }
+
+        beginTest ("Contention benchmark");
+        {
+            for (int numThreads = 4; numThreads <= 16; numThreads *= 2)
+                logMessage (String (numThreads) + " threads: "
+                             + String (runThreads (numThreads, 200000) / 1.0e6, 2) + " million copies per second");
+
+            expectEquals (numLiveObjects.get(), 0);
+        }
+    }
+};
+
+static SmartPointerTests smartPointerTests;
+
+#endif
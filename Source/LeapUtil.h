@@ -10,6 +10,7 @@
 #define __LeapUtil_h__
 
 #include "Leap.h"
+#include "../JuceLibraryCode/JuceHeader.h"
 
 // Define integer types for Visual Studio 2005
 #if defined(_MSC_VER) && (_MSC_VER < 1600)
@@ -211,54 +212,554 @@ inline const char* BoolToStr( uint32_t bVal )
   return bVal ? "On" : "Off";
 }
 
-template<int _HistoryLength=256>
-class RollingAverage
+/// the smallest power of two that is at least N, at compile time.
+template<uint32_t N, uint32_t P=1, bool _Done=(P >= N)>
+struct NextPowerOfTwo
+{
+  enum { value = NextPowerOfTwo<N, P * 2>::value };
+};
+
+template<uint32_t N, uint32_t P>
+struct NextPowerOfTwo<N, P, true>
+{
+  enum { value = P };
+};
+
+/// statistics over the last _HistoryLength samples of one or more channels, all of which
+/// get a new sample at the same time.
+/// keeps the mean and variance (a sliding Welford update, recomputed exactly once per trip
+/// around the history so rounding errors can't build up), the minimum and maximum (monotonic
+/// queues of sample numbers) and approximate percentiles (a histogram over a range given by
+/// SetPercentileRange(), interpolated within each bin).  every one of these costs a constant
+/// amount per sample however long the history is.
+/// values are stored sample by sample, with each sample's channels next to each other and the
+/// per-channel sums in their own arrays, so the mean and variance updates are loops over
+/// contiguous values that the compiler can vectorise across channels.  the history is a power
+/// of two long so that indices wrap with a mask rather than a modulo.
+template<typename T, int _HistoryLength=256, int _NumChannels=1, int _NumBins=64>
+class RollingStatistics
 {
 public:
   enum
   {
-    kHistoryLength = _HistoryLength
+    kHistoryLength  = _HistoryLength,
+    kNumChannels    = _NumChannels,
+    kNumBins        = _NumBins,
+    kCapacity       = NextPowerOfTwo<_HistoryLength>::value,
+    kIndexMask      = kCapacity - 1
   };
 
 public:
-  RollingAverage() { Reset(); }
+  RollingStatistics( T minValue = T(0), T maxValue = T(1) )
+  {
+    for ( int c = 0; c < kNumChannels; c++ )
+    {
+      setRange( c, minValue, maxValue );
+    }
+
+    Reset();
+  }
 
   void Reset()
   {
-    m_uiCurIndex  = 0;
-    m_fNumSamples = 0.0f;
-    m_fSum        = 0.0f;
-    m_fAverage    = 0.0f;
-    for ( int i = 0; i < kHistoryLength; m_afSamples[i++] = 0.0f );
+    m_uiNumAdded = 0;
+
+    for ( int c = 0; c < kNumChannels; c++ )
+    {
+      m_aMean[c]              = T(0);
+      m_aM2[c]                = T(0);
+      m_auiMinHead[c]         = m_auiMinTail[c] = 0;
+      m_auiMaxHead[c]         = m_auiMaxTail[c] = 0;
+
+      for ( int b = 0; b < kNumBins; m_auiBins[c][b++] = 0 );
+    }
+  }
+
+  /// sets the range that a channel's histogram covers. values outside it are counted in
+  /// the first or last bin, so percentiles that land there are only as good as the range.
+  void SetPercentileRange( int iChannel, T minValue, T maxValue )
+  {
+    setRange( iChannel, minValue, maxValue );
+
+    // rebuild the histogram from the samples still in the window
+    for ( int b = 0; b < kNumBins; m_auiBins[iChannel][b++] = 0 );
+
+    for ( uint32_t i = 0; i < GetNumSamples(); i++ )
+    {
+      m_auiBins[iChannel][getBin( iChannel, GetSample( i, iChannel ) )]++;
+    }
+  }
+
+  void SetPercentileRange( T minValue, T maxValue )
+  {
+    for ( int c = 0; c < kNumChannels; c++ )
+    {
+      SetPercentileRange( c, minValue, maxValue );
+    }
+  }
+
+  /// adds one sample to every channel, from an array of kNumChannels values.
+  void AddSample( const T* pSamples )
+  {
+    const uint32_t  uiSequence  = m_uiNumAdded;
+    const bool      bIsFull     = uiSequence >= static_cast<uint32_t>(kHistoryLength);
+    const uint32_t  uiExpired   = uiSequence - kHistoryLength;   // only meaningful when full
+    T*              pSlot       = m_aHistory[uiSequence & kIndexMask];
+    const T*        pOldest     = m_aHistory[uiExpired & kIndexMask];
+
+    if ( bIsFull )
+    {
+      // slide the window: the oldest sample's contribution is swapped for the new one's
+      const T invN = T(1) / T(kHistoryLength);
+
+      for ( int c = 0; c < kNumChannels; c++ )
+      {
+        const T oldMean = m_aMean[c];
+        const T newMean = oldMean + (pSamples[c] - pOldest[c]) * invN;
+
+        m_aM2[c]   += (pSamples[c] - pOldest[c]) * (pSamples[c] - newMean + pOldest[c] - oldMean);
+        m_aMean[c]  = newMean;
+      }
+
+      for ( int c = 0; c < kNumChannels; c++ )
+      {
+        m_auiBins[c][getBin( c, pOldest[c] )]--;
+      }
+    }
+    else
+    {
+      const T invN = T(1) / T(uiSequence + 1);
+
+      for ( int c = 0; c < kNumChannels; c++ )
+      {
+        const T delta = pSamples[c] - m_aMean[c];
+
+        m_aMean[c]  += delta * invN;
+        m_aM2[c]    += delta * (pSamples[c] - m_aMean[c]);
+      }
+    }
+
+    // the oldest sample's slot is only reused after it's been taken out of everything above
+    // (when the capacity is longer than the history, it's already gone)
+    for ( int c = 0; c < kNumChannels; c++ )
+    {
+      expireExtremes( c, uiSequence );
+    }
+
+    for ( int c = 0; c < kNumChannels; c++ )
+    {
+      pSlot[c] = pSamples[c];
+      m_auiBins[c][getBin( c, pSamples[c] )]++;
+    }
+
+    for ( int c = 0; c < kNumChannels; c++ )
+    {
+      pushExtremes( c, uiSequence );
+    }
+
+    ++m_uiNumAdded;
+
+    // once per trip around the history, replace the running sums with exact ones
+    if ( bIsFull && (m_uiNumAdded & kIndexMask) == 0 )
+    {
+      recompute();
+    }
+  }
+
+  /// adds a sample to a single-channel history.
+  void AddSample( T sample )
+  {
+    jassert( kNumChannels == 1 );
+    AddSample( &sample );
+  }
+
+  uint32_t  GetNumSamples() const { return Min( m_uiNumAdded, static_cast<uint32_t>(kHistoryLength) ); }
+  bool      IsFull() const        { return m_uiNumAdded >= static_cast<uint32_t>(kHistoryLength); }
+
+  T         GetMean( int iChannel=0 ) const     { return m_aMean[iChannel]; }
+
+  /// the population variance of the samples in the window.
+  T         GetVariance( int iChannel=0 ) const
+  {
+    const uint32_t uiNumSamples = GetNumSamples();
+    return uiNumSamples > 0 ? Max( m_aM2[iChannel] / T(uiNumSamples), T(0) ) : T(0);
+  }
+
+  T         GetStandardDeviation( int iChannel=0 ) const { return static_cast<T>(sqrt( static_cast<double>(GetVariance( iChannel )) )); }
+
+  /// these return zero when there are no samples.
+  T         GetMin( int iChannel=0 ) const  { return m_auiMinHead[iChannel] != m_auiMinTail[iChannel] ? getValue( iChannel, m_auiMinQueue[iChannel][m_auiMinHead[iChannel] & kIndexMask] ) : T(0); }
+  T         GetMax( int iChannel=0 ) const  { return m_auiMaxHead[iChannel] != m_auiMaxTail[iChannel] ? getValue( iChannel, m_auiMaxQueue[iChannel][m_auiMaxHead[iChannel] & kIndexMask] ) : T(0); }
+
+  /// an approximate percentile, from 0 to 100, interpolated within the histogram's bins
+  /// and kept within the window's minimum and maximum.
+  T GetPercentile( float fPercent, int iChannel=0 ) const
+  {
+    const uint32_t uiNumSamples = GetNumSamples();
+
+    if ( uiNumSamples == 0 )
+    {
+      return T(0);
+    }
+
+    const float fTarget     = Clamp( fPercent, 0.0f, 100.0f ) * 0.01f * static_cast<float>(uiNumSamples);
+    uint32_t    uiBelow     = 0;
+    int         iBin        = 0;
+
+    for ( ; iBin < kNumBins - 1 && static_cast<float>(uiBelow + m_auiBins[iChannel][iBin]) < fTarget; iBin++ )
+    {
+      uiBelow += m_auiBins[iChannel][iBin];
+    }
+
+    const uint32_t  uiInBin   = m_auiBins[iChannel][iBin];
+    const float     fFraction = uiInBin > 0 ? (fTarget - static_cast<float>(uiBelow)) / static_cast<float>(uiInBin) : 0.5f;
+    const double    dValue    = static_cast<double>(m_aRangeMin[iChannel])
+                                  + (iBin + Clamp( fFraction, 0.0f, 1.0f )) / static_cast<double>(m_aBinScale[iChannel]);
+
+    return Clamp( static_cast<T>(dValue), GetMin( iChannel ), GetMax( iChannel ) );
+  }
+
+  /// index 0 is the oldest sample in the window, index GetNumSamples() - 1 is the newest.
+  T         GetSample( uint32_t uiIdx, int iChannel=0 ) const
+  {
+    return m_aHistory[(m_uiNumAdded - GetNumSamples() + uiIdx) & kIndexMask][iChannel];
+  }
+
+  T         GetLatest( int iChannel=0 ) const { return m_uiNumAdded > 0 ? m_aHistory[(m_uiNumAdded - 1) & kIndexMask][iChannel] : T(0); }
+
+private:
+  void setRange( int iChannel, T minValue, T maxValue )
+  {
+    jassert( maxValue > minValue );
+
+    m_aRangeMin[iChannel] = minValue;
+    m_aBinScale[iChannel] = static_cast<float>(kNumBins) / static_cast<float>(maxValue - minValue);
+  }
+
+  int getBin( int iChannel, T value ) const
+  {
+    const float fBin = static_cast<float>(value - m_aRangeMin[iChannel]) * m_aBinScale[iChannel];
+    return fBin <= 0.0f ? 0 : Min( static_cast<int>(fBin), kNumBins - 1 );
   }
 
+  T getValue( int iChannel, uint32_t uiSequence ) const { return m_aHistory[uiSequence & kIndexMask][iChannel]; }
+
+  void expireExtremes( int c, uint32_t uiSequence )
+  {
+    // the queues hold sample numbers, so anything older than the window is at the front
+    const uint32_t uiOldestKept = uiSequence - kHistoryLength + 1;
+
+    if ( uiSequence < static_cast<uint32_t>(kHistoryLength) )
+    {
+      return;
+    }
+
+    if ( m_auiMinHead[c] != m_auiMinTail[c] && m_auiMinQueue[c][m_auiMinHead[c] & kIndexMask] < uiOldestKept )
+    {
+      m_auiMinHead[c]++;
+    }
+
+    if ( m_auiMaxHead[c] != m_auiMaxTail[c] && m_auiMaxQueue[c][m_auiMaxHead[c] & kIndexMask] < uiOldestKept )
+    {
+      m_auiMaxHead[c]++;
+    }
+  }
+
+  void pushExtremes( int c, uint32_t uiSequence )
+  {
+    const T value = getValue( c, uiSequence );
+
+    // each queue keeps only the samples that could still become the window's extreme
+    while ( m_auiMinHead[c] != m_auiMinTail[c] && getValue( c, m_auiMinQueue[c][(m_auiMinTail[c] - 1) & kIndexMask] ) >= value )
+    {
+      m_auiMinTail[c]--;
+    }
+
+    m_auiMinQueue[c][m_auiMinTail[c]++ & kIndexMask] = uiSequence;
+
+    while ( m_auiMaxHead[c] != m_auiMaxTail[c] && getValue( c, m_auiMaxQueue[c][(m_auiMaxTail[c] - 1) & kIndexMask] ) <= value )
+    {
+      m_auiMaxTail[c]--;
+    }
+
+    m_auiMaxQueue[c][m_auiMaxTail[c]++ & kIndexMask] = uiSequence;
+  }
+
+  void recompute()
+  {
+    const T invN = T(1) / T(kHistoryLength);
+
+    for ( int c = 0; c < kNumChannels; c++ )
+    {
+      m_aMean[c]  = T(0);
+      m_aM2[c]    = T(0);
+    }
+
+    for ( int i = 0; i < kHistoryLength; i++ )
+    {
+      const T* pSample = m_aHistory[(m_uiNumAdded - kHistoryLength + i) & kIndexMask];
+
+      for ( int c = 0; c < kNumChannels; c++ )
+      {
+        m_aMean[c] += pSample[c];
+      }
+    }
+
+    for ( int c = 0; c < kNumChannels; c++ )
+    {
+      m_aMean[c] *= invN;
+    }
+
+    for ( int i = 0; i < kHistoryLength; i++ )
+    {
+      const T* pSample = m_aHistory[(m_uiNumAdded - kHistoryLength + i) & kIndexMask];
+
+      for ( int c = 0; c < kNumChannels; c++ )
+      {
+        m_aM2[c] += (pSample[c] - m_aMean[c]) * (pSample[c] - m_aMean[c]);
+      }
+    }
+  }
+
+  uint32_t  m_uiNumAdded;
+  T         m_aHistory[kCapacity][kNumChannels];
+  T         m_aMean[kNumChannels];
+  T         m_aM2[kNumChannels];
+  T         m_aRangeMin[kNumChannels];
+  float     m_aBinScale[kNumChannels];
+  uint32_t  m_auiBins[kNumChannels][kNumBins];
+  uint32_t  m_auiMinQueue[kNumChannels][kCapacity];
+  uint32_t  m_auiMaxQueue[kNumChannels][kCapacity];
+  uint32_t  m_auiMinHead[kNumChannels], m_auiMinTail[kNumChannels];
+  uint32_t  m_auiMaxHead[kNumChannels], m_auiMaxTail[kNumChannels];
+};
+
+/// the mean of the last _HistoryLength values of a single float.
+template<int _HistoryLength=256>
+class RollingAverage : public RollingStatistics<float, _HistoryLength>
+{
+public:
+  typedef RollingStatistics<float, _HistoryLength> Statistics;
+
+public:
   float AddSample( float fSample )
   {
-    m_fNumSamples =   Min( (m_fNumSamples + 1.0f), static_cast<float>(kHistoryLength) );
-    m_fSum        -=  m_afSamples[m_uiCurIndex];
-    m_fSum        +=  fSample;
-    m_fAverage    =   m_fSum * (1.0f/m_fNumSamples);
+    Statistics::AddSample( &fSample );
+    return GetAverage();
+  }
 
-    m_afSamples[m_uiCurIndex] = fSample;
+  float     GetAverage() const  { return Statistics::GetMean(); }
+  float     GetSum() const      { return Statistics::GetMean() * static_cast<float>(Statistics::GetNumSamples()); }
 
-    m_uiCurIndex = static_cast<uint32_t>((m_uiCurIndex + 1) % kHistoryLength);
+  /// index 0 is the oldest sample, index kHistoryLength - 1 is the newest.
+  /// slots that haven't been filled yet read as zero.
+  float     operator[]( uint32_t uiIdx ) const
+  {
+    const uint32_t uiNumEmpty = Statistics::kHistoryLength - Statistics::GetNumSamples();
+    return uiIdx < uiNumEmpty ? 0.0f : Statistics::GetSample( uiIdx - uiNumEmpty );
+  }
+};
 
-    return m_fAverage;
+/// filters fingertip positions and extrapolates them forward in time, to make up for the
+/// latency between a frame being captured and its effect being seen or felt.
+/// points are keyed by pointable id.  their filter state is stored as a structure of arrays,
+/// so each frame's update is a few branch-free loops over contiguous floats that the
+/// compiler can vectorise, however many points are being tracked.
+/// each frame is given as BeginFrame(), an AddMeasurement() per point, then EndFrame().
+/// not thread-safe: each consuming thread should have its own predictor.
+class MotionPredictor
+{
+public:
+  enum FilterType
+  {
+    /// adaptive low-pass filter (Casiez et al., "1 Euro Filter", CHI 2012) that smooths
+    /// heavily when a point is slow and lightly when it's fast, extrapolated at its
+    /// filtered velocity.
+    kFilter_OneEuro,
+    /// constant-acceleration Kalman filter on each axis, extrapolated along a parabola.
+    kFilter_Kalman
+  };
+
+  enum
+  {
+    kMaxTracked = 64
+  };
+
+public:
+  MotionPredictor( FilterType eFilterType = kFilter_OneEuro );
+
+  /// changing the filter type forgets every point.
+  void        SetFilterType( FilterType eFilterType );
+  FilterType  GetFilterType() const { return m_eFilterType; }
+
+  /// minimum cutoff frequency in Hz, how much the cutoff rises per unit/s of speed,
+  /// and the cutoff in Hz used to smooth the velocity.
+  void        SetOneEuroParameters( float fMinCutoff, float fBeta, float fDerivativeCutoff );
+
+  /// spectral density of the random jerk that drives the motion model, in units^2/s^5,
+  /// and the standard deviation of the measurement noise, in units.
+  void        SetKalmanParameters( float fJerkNoise, float fMeasurementNoise );
+
+  /// how far past each frame's timestamp GetPredicted() extrapolates, usually the
+  /// measured latency from capture to display or actuation.
+  void        SetPredictionTime( float fSeconds )   { m_fPredictionTime = Max( fSeconds, 0.0f ); }
+  float       GetPredictionTime() const             { return m_fPredictionTime; }
+
+  /// forgets every point.
+  void        Reset();
+
+  /// starts a frame. timestamps are in microseconds, as Leap::Frame::timestamp() gives them.
+  void        BeginFrame( int64_t iTimestamp );
+
+  /// adds a point's measured position to the current frame.
+  /// returns false if kMaxTracked points are already being tracked.
+  bool        AddMeasurement( int32_t iId, const Leap::Vector& vPosition );
+
+  /// filters every point measured since BeginFrame(), and forgets those that weren't.
+  void        EndFrame();
+
+  int         GetNumTracked() const { return m_iNumTracked; }
+
+  /// results for the last frame. each returns false if the point isn't being tracked.
+  bool        GetFiltered( int32_t iId, Leap::Vector& vPosition ) const;
+  bool        GetVelocity( int32_t iId, Leap::Vector& vVelocity ) const;
+  bool        GetPredicted( int32_t iId, Leap::Vector& vPosition ) const;
+
+  /// extrapolates to any time after the last frame, rather than the prediction time.
+  bool        GetPredicted( int32_t iId, float fSecondsAhead, Leap::Vector& vPosition ) const;
+
+private:
+  int         findSlot( int32_t iId ) const;
+  void        initSlot( int iSlot );
+  void        removeUnmeasured();
+  void        updateOneEuro( float fDeltaTime );
+  void        updateKalman( float fDeltaTime );
+
+  enum { kNumCovarianceTerms = 6 };   // p00 p01 p02 p11 p12 p22, shared by all three axes
+
+  FilterType  m_eFilterType;
+  float       m_fMinCutoff;
+  float       m_fBeta;
+  float       m_fDerivativeCutoff;
+  float       m_fJerkNoise;
+  float       m_fMeasurementVariance;
+  float       m_fPredictionTime;
+  int64_t     m_iTimestamp;
+  int64_t     m_iLastTimestamp;
+  bool        m_bHasLastFrame;
+  int         m_iNumTracked;
+
+  int32_t     m_aiIds[kMaxTracked];
+  uint8_t     m_abMeasured[kMaxTracked];
+  float       m_afMeasured[3][kMaxTracked];
+  float       m_afLastMeasured[3][kMaxTracked];          // One-Euro only
+  float       m_afPosition[3][kMaxTracked];
+  float       m_afVelocity[3][kMaxTracked];
+  float       m_afAcceleration[3][kMaxTracked];           // Kalman only
+  float       m_afPredicted[3][kMaxTracked];
+  float       m_afCovariance[kNumCovarianceTerms][kMaxTracked];  // Kalman only
+  float       m_afGain[3][kMaxTracked];                   // scratch space for the update
+};
+
+/// wait-free handoff of the newest value of T (usually a Leap::Frame) from one producer
+/// thread to one or more consumer threads.
+/// each consumer has its own triple buffer: the producer and the consumer each own one slot
+/// and trade the third with a single atomic exchange, so Publish() never blocks and Read()
+/// always gets the most recent complete value.  every published value carries a sequence
+/// number, which lets a consumer tell how many values were replaced before it could read them.
+/// only one thread may call Publish(), and each consumer index must only be read from one thread.
+template<typename T, int _NumConsumers=1>
+class LeapFrameExchange
+{
+public:
+  enum
+  {
+    kNumConsumers = _NumConsumers
+  };
+
+public:
+  LeapFrameExchange() : m_uiSequence(0) {}
+
+  /// producer side. copies the value into a free slot for each consumer.
+  void Publish( const T& value )
+  {
+    ++m_uiSequence;
+
+    for ( int i = 0; i < kNumConsumers; i++ )
+    {
+      m_aChannels[i].Publish( value, m_uiSequence );
+    }
   }
 
-  float     GetAverage()    const { return m_fAverage; }
-  float     GetSum()        const { return m_fSum; }
-  uint32_t  GetNumSamples() const { return static_cast<uint32_t>(m_fNumSamples); }
+  /// consumer side. returns false if nothing has been published since the last call.
+  /// otherwise result receives the newest value and uiNumSkipped the number of values
+  /// this consumer never saw.
+  bool Read( int iConsumer, T& result, uint32_t& uiNumSkipped )
+  {
+    return m_aChannels[iConsumer].Read( result, uiNumSkipped );
+  }
 
-  /// index 0 is the oldest sample, index kHistorySize - 1 is the newest.
-  float     operator[](uint32_t uiIdx) const { return m_afSamples[(m_uiCurIndex + uiIdx) % kHistoryLength]; }
+  bool Read( int iConsumer, T& result )
+  {
+    uint32_t uiNumSkipped;
+    return Read( iConsumer, result, uiNumSkipped );
+  }
+
+  /// sequence number of the value last returned by Read() for this consumer, 0 if none yet.
+  uint32_t GetLastReadSequence( int iConsumer ) const { return m_aChannels[iConsumer].m_uiLastSequence; }
 
 private:
-  uint32_t      m_uiCurIndex;
-  float         m_fNumSamples;
-  float         m_fSum;
-  float         m_fAverage;
-  float         m_afSamples[kHistoryLength];
+  struct Channel
+  {
+    enum { kIndexMask = 3, kFreshFlag = 4 };
+
+    Channel()
+      : m_iShared(1),
+        m_iWriteIndex(0),
+        m_iReadIndex(2),
+        m_uiLastSequence(0)
+    {
+      for ( int i = 0; i < 3; m_auiSequence[i++] = 0 );
+    }
+
+    void Publish( const T& value, uint32_t uiSequence )
+    {
+      m_aValues[m_iWriteIndex]      = value;
+      m_auiSequence[m_iWriteIndex]  = uiSequence;
+
+      // hand the filled slot over and take back whichever one was shared
+      m_iWriteIndex = m_iShared.exchange( m_iWriteIndex | kFreshFlag ) & kIndexMask;
+    }
+
+    bool Read( T& result, uint32_t& uiNumSkipped )
+    {
+      if ( (m_iShared.get() & kFreshFlag) == 0 )
+      {
+        uiNumSkipped = 0;
+        return false;
+      }
+
+      m_iReadIndex = m_iShared.exchange( m_iReadIndex ) & kIndexMask;
+
+      const uint32_t uiSequence = m_auiSequence[m_iReadIndex];
+
+      uiNumSkipped      = uiSequence - m_uiLastSequence - 1;
+      m_uiLastSequence  = uiSequence;
+      result            = m_aValues[m_iReadIndex];
+
+      return true;
+    }
+
+    T                   m_aValues[3];
+    uint32_t            m_auiSequence[3];
+    juce::Atomic<int>   m_iShared;
+    int                 m_iWriteIndex;      // producer only
+    int                 m_iReadIndex;       // consumer only
+    uint32_t            m_uiLastSequence;   // consumer only
+  };
+
+  Channel   m_aChannels[kNumConsumers];
+  uint32_t  m_uiSequence;                   // producer only
 };
 
 /// a graphics system agnostic camera that provides a point of view and a view matrix
@@ -618,15 +1119,17 @@ public:
 /// OR .Release() is called explicitly.
 /// when the reference count reaches zero the Destructor::Destroy static method
 /// is invoked on the raw pointer.
-/// note: this smart pointer class is not thread-safe.
-/// making it thread safe would have required adding a cross-platform
-/// mutex class.  the use cases in the sample code do not require it.
+/// note: reference counts are atomic, so different smart pointers that share a raw pointer
+/// can be copied and released on different threads (e.g. the Leap, GL and message threads).
+/// as with any smart pointer, a single SmartPointer instance must not be assigned on one thread
+/// while it is being read on another.
 template< typename T,
           class Destructor = SmartInstanceDestructor<T>,
           unsigned int ManagedPointerPoolSize = 512 >
 class SmartPointer
 {
 public:
+  /// the number of entries the pool starts with, and adds each time it runs out.
   enum { kManagedPointerPoolSize = ManagedPointerPoolSize };
 
   typedef T ManagedType;
@@ -635,132 +1138,276 @@ private:
   // a managed pointer is a pointer of the desired type plus a reference count.
   struct ManagedPointerEntry
   {
-    ManagedType*  m_pPointer;
-    uint32_t      m_uiRefCount;
+    ManagedType*          m_pPointer;
+    // while the entry is in the free list this holds the index + 1 of the next free entry
+    juce::Atomic<int32_t> m_iRefCount;
+    // next entry in the same hash bucket
+    ManagedPointerEntry*  m_pNextInBucket;
+    // the entry's position in the pool, counting from 1
+    uint32_t              m_uiNumber;
   };
 
   // this private, embedded class manages a pool of smart pointers for the given type.
   // there are separate pools for each created type of smart pointer.
-  // the pool is managed using a simple O(1) fixed size free list allocator
+  // raw pointers are found through a hash table with a lock per bucket, so only smart pointers
+  // being created from (or finally releasing) raw pointers that hash to the same bucket
+  // ever wait for each other.  entries come from a lock-free free list that grows a block
+  // of kManagedPointerPoolSize entries at a time.
   struct ManagedPointerPool
   {
-    enum { kPoolSize = kManagedPointerPoolSize, kDeadPointer = 0xdeadbea7 };
+    enum
+    {
+      kBlockSize    = kManagedPointerPoolSize,
+      kMaxBlocks    = 256,
+      kNumBuckets   = NextPowerOfTwo<kManagedPointerPoolSize>::value
+    };
 
     ManagedPointerPool()
-      : m_uiNextFree(0),
-        m_uiNumAllocated(0)
+      : m_iNumBlocks(0)
     {
-      for ( uint32_t i = 0; i < static_cast<uint32_t>(kPoolSize); i++ )
+      for ( int i = 0; i < kMaxBlocks; i++ )
+      {
+        m_apBlocks[i] = NULL;
+      }
+
+      for ( int i = 0; i < kNumBuckets; i++ )
       {
-        m_aEntryPool[i].m_pPointer    = reinterpret_cast<ManagedType*>(kDeadPointer);
-        m_aEntryPool[i].m_uiRefCount  = i + 1;
+        m_apBuckets[i] = NULL;
+      }
+    }
+
+    ~ManagedPointerPool()
+    {
+      // smart pointers held by other statics may still be released after this, in which case
+      // the blocks are left for the OS to reclaim.
+      if ( m_iNumAllocated.get() == 0 )
+      {
+        for ( int i = 0; i < kMaxBlocks; i++ )
+        {
+          delete[] m_apBlocks[i];
+        }
       }
     }
 
     // allocate a managed pointer entry for a raw pointer
     ManagedPointerEntry* allocEntry( ManagedType* pPointer )
     {
-      ManagedPointerEntry* pEntry = NULL;
+      if ( !pPointer )
+      {
+        return NULL;
+      }
 
-      // this incurs a linear search penalty each time
-      // we create a new smart pointer from a raw pointer
-      // but adds significant safety - it prevents
-      // assigning the same raw pointer to two different
-      // member entries - this would result in double
-      // deletion when the 2nd one hit its end of life.
-      pEntry = findEntry( pPointer );
+      const uint32_t uiBucket = getBucket( pPointer );
+      const juce::SpinLock::ScopedLockType bucketLock( m_aBucketLocks[uiBucket] );
 
-      if ( pEntry )
+      // looking the raw pointer up first prevents assigning the same raw pointer to two
+      // different entries - this would result in double deletion when the 2nd one hit
+      // its end of life.
+      for ( ManagedPointerEntry* pEntry = m_apBuckets[uiBucket]; pEntry; pEntry = pEntry->m_pNextInBucket )
       {
-        // we found an existing managed pointer entry, just increase the reference count
-        pEntry->m_uiRefCount++;
+        // an entry whose count has already hit zero is about to be destroyed, so it can't be revived
+        if ( pEntry->m_pPointer == pPointer && tryAddReference( pEntry ) )
+        {
+          return pEntry;
+        }
       }
-      else if ( (m_uiNextFree < kPoolSize) && pPointer )
-      {
-        // grab the next free entry from the head of the free list
-        pEntry = m_aEntryPool + m_uiNextFree;
 
-        // the head of the list now becomes the next free entry in the chain
-        // (m_uiRefCount is serving double-duty as next index member for entries that are still in the pool)
-        m_uiNextFree = pEntry->m_uiRefCount;
+      ManagedPointerEntry* pEntry = popFreeEntry();
 
+      if ( pEntry )
+      {
         // initialize the entry with the pointer and a reference count of 1.
-        pEntry->m_pPointer = pPointer;
-        pEntry->m_uiRefCount = 1;
+        pEntry->m_pPointer      = pPointer;
+        pEntry->m_iRefCount     = 1;
+        pEntry->m_pNextInBucket = m_apBuckets[uiBucket];
+        m_apBuckets[uiBucket]   = pEntry;
 
         // book keeping.
-        m_uiNumAllocated++;
+        ++m_iNumAllocated;
       }
 
       return pEntry;
     }
 
-    // return an entry to the pool
+    // remove an entry whose reference count has reached zero from the lookup table and return it to the pool
     void freeEntry( ManagedPointerEntry* pEntry )
     {
-      // calculate the entry index as an offset from the start of the pool
-      const uint32_t entryIndex = static_cast<uint32_t>(pEntry - m_aEntryPool);
+      {
+        const uint32_t uiBucket = getBucket( pEntry->m_pPointer );
+        const juce::SpinLock::ScopedLockType bucketLock( m_aBucketLocks[uiBucket] );
+
+        for ( ManagedPointerEntry** ppLink = m_apBuckets + uiBucket; *ppLink; ppLink = &(*ppLink)->m_pNextInBucket )
+        {
+          if ( *ppLink == pEntry )
+          {
+            *ppLink = pEntry->m_pNextInBucket;
+            break;
+          }
+        }
+      }
 
-      // if this is a valid allocated entry (from this pool, and not already freed)
-      if (  (entryIndex < kPoolSize)  &&
-            (m_uiNumAllocated != 0)   &&
-            (pEntry->m_pPointer != reinterpret_cast<ManagedType*>(kDeadPointer)) )
+      pEntry->m_pPointer = NULL;
+      pushFreeEntries( pEntry, pEntry );
+
+      // book keeping.
+      --m_iNumAllocated;
+    }
+
+    // returns true if a live entry refers to the raw pointer.
+    bool isManaged( const ManagedType* pPointer )
+    {
+      if ( !pPointer )
       {
-        // clear the entry
-        pEntry->m_pPointer = NULL;
+        return false;
+      }
 
-        // push it to the head of the free list
-        pEntry->m_uiRefCount = m_uiNextFree;
-        m_uiNextFree = entryIndex;
+      const uint32_t uiBucket = getBucket( pPointer );
+      const juce::SpinLock::ScopedLockType bucketLock( m_aBucketLocks[uiBucket] );
 
-        // book keeping.
-        m_uiNumAllocated--;
+      for ( const ManagedPointerEntry* pEntry = m_apBuckets[uiBucket]; pEntry; pEntry = pEntry->m_pNextInBucket )
+      {
+        if ( pEntry->m_pPointer == pPointer && pEntry->m_iRefCount.get() > 0 )
+        {
+          return true;
+        }
       }
+
+      return false;
+    }
+
+    // number of allocated managed pointer entries
+    uint32_t getNumAllocated() const { return static_cast<uint32_t>(m_iNumAllocated.get()); }
+
+    // number of entries the pool has grown to
+    uint32_t getCapacity() const { return static_cast<uint32_t>(m_iNumBlocks.get()) * kBlockSize; }
+
+  private:
+    static bool tryAddReference( ManagedPointerEntry* pEntry )
+    {
+      for ( ;; )
+      {
+        const int32_t iRefCount = pEntry->m_iRefCount.get();
+
+        if ( iRefCount <= 0 )
+        {
+          return false;
+        }
+
+        if ( pEntry->m_iRefCount.compareAndSetBool( iRefCount + 1, iRefCount ) )
+        {
+          return true;
+        }
+      }
+    }
+
+    // multiplicative hash of the pointer's address, ignoring the low bits that alignment leaves clear
+    static uint32_t getBucket( const ManagedType* pPointer )
+    {
+      const uint64_t ullAddress = static_cast<uint64_t>(reinterpret_cast<juce::pointer_sized_uint>(pPointer)) >> 3;
+      return static_cast<uint32_t>((ullAddress * 0x9e3779b97f4a7c15ULL) >> 32) & (kNumBuckets - 1);
+    }
+
+    // entries are numbered from 1 so that 0 can mean "none"
+    ManagedPointerEntry* getEntry( uint32_t uiNumber ) const
+    {
+      return m_apBlocks[(uiNumber - 1) / kBlockSize] + (uiNumber - 1) % kBlockSize;
     }
 
-    // look for the managed pointer entry associated with a raw pointer. returns NULL
-    // if pPointer is NULL, dead or not found.
-    ManagedPointerEntry* findEntry( const ManagedType* pPointer )
+    // the free list's head packs the first entry's number into the low 32 bits and a count of
+    // changes into the high 32 bits, so that a head that was popped and pushed back by other
+    // threads between our read and our compare-and-swap can't be mistaken for an unchanged one.
+    ManagedPointerEntry* popFreeEntry()
     {
-      // don't bother if the pointer is NULL or marked as our dead value
-      if ( pPointer && (pPointer != reinterpret_cast<ManagedType*>(kDeadPointer)) )
+      for ( ;; )
       {
-        // linear search. stop after testing as many live entries as are allocated instead of always
-        // searching the entire pool.
-        for ( uint32_t i = 0, j = 0; j < m_uiNumAllocated && i < static_cast<uint32_t>(kPoolSize); i++ )
+        const int64_t  iHead     = m_iFreeHead.get();
+        const uint32_t uiFirst   = static_cast<uint32_t>(iHead);
+
+        if ( uiFirst == 0 )
         {
-          // if the entry is live (allocated)
-          if ( m_aEntryPool[i].m_pPointer != reinterpret_cast<ManagedType*>(kDeadPointer) )
+          const juce::SpinLock::ScopedLockType growLock( m_growLock );
+
+          // another thread may have grown the pool, or freed an entry, while we waited
+          if ( static_cast<uint32_t>(m_iFreeHead.get()) != 0 )
           {
-            // a match? return it.
-            if ( m_aEntryPool[i].m_pPointer == pPointer )
-            {
-              return m_aEntryPool + i;
-            }
-
-            // not, increment the count of live entries encountered.
-            j++;
+            continue;
           }
+
+          return grow();
+        }
+
+        const uint32_t uiNext = static_cast<uint32_t>(getEntry( uiFirst )->m_iRefCount.get());
+
+        if ( m_iFreeHead.compareAndSetBool( makeHead( iHead, uiNext ), iHead ) )
+        {
+          return getEntry( uiFirst );
         }
       }
+    }
 
-      return NULL;
+    // pushes a chain of entries, already linked from pFirst to pLast
+    void pushFreeEntries( ManagedPointerEntry* pFirst, ManagedPointerEntry* pLast )
+    {
+      const uint32_t uiFirst = pFirst->m_uiNumber;
+
+      for ( ;; )
+      {
+        const int64_t iHead = m_iFreeHead.get();
+        pLast->m_iRefCount = static_cast<int32_t>(static_cast<uint32_t>(iHead));
+
+        if ( m_iFreeHead.compareAndSetBool( makeHead( iHead, uiFirst ), iHead ) )
+        {
+          return;
+        }
+      }
     }
 
-    // number of allocated managed pointer entries
-    uint32_t getNumAllocated() const { return m_uiNumAllocated; }
+    static int64_t makeHead( int64_t iOldHead, uint32_t uiFirst )
+    {
+      return static_cast<int64_t>( ((static_cast<uint64_t>(iOldHead) >> 32) + 1) << 32 | uiFirst );
+    }
+
+    // adds a block of entries and returns the first of them, or NULL if the pool is full.
+    // must be called with m_growLock held.
+    ManagedPointerEntry* grow()
+    {
+      const int iBlock = m_iNumBlocks.get();
+
+      if ( iBlock == kMaxBlocks )
+      {
+        return NULL;
+      }
 
-    // number of available managed pointer entries.
-    uint32_t getNumFree() const { return static_cast<uint32_t>(kPoolSize) - m_uiNumAllocated; }
+      ManagedPointerEntry* pBlock = new ManagedPointerEntry[kBlockSize];
+      const uint32_t uiFirstNumber = static_cast<uint32_t>(iBlock * kBlockSize + 1);
 
-    // actual entry pool
-    ManagedPointerEntry m_aEntryPool[kPoolSize];
+      for ( uint32_t i = 0; i < static_cast<uint32_t>(kBlockSize); i++ )
+      {
+        pBlock[i].m_pPointer      = NULL;
+        pBlock[i].m_pNextInBucket = NULL;
+        pBlock[i].m_uiNumber      = uiFirstNumber + i;
+        pBlock[i].m_iRefCount     = static_cast<int32_t>(uiFirstNumber + i + 1);
+      }
 
-    // head of the free list
-    uint32_t            m_uiNextFree;
+      // the block is published before any of its entries can be reached through the free list
+      m_apBlocks[iBlock] = pBlock;
+      m_iNumBlocks = iBlock + 1;
 
-    // number of entries that have been allocated from the free list
-    uint32_t            m_uiNumAllocated;
+      if ( kBlockSize > 1 )
+      {
+        pushFreeEntries( pBlock + 1, pBlock + kBlockSize - 1 );
+      }
+
+      return pBlock;
+    }
+
+    ManagedPointerEntry*  m_apBlocks[kMaxBlocks];
+    ManagedPointerEntry*  m_apBuckets[kNumBuckets];
+    juce::SpinLock        m_aBucketLocks[kNumBuckets];
+    juce::SpinLock        m_growLock;
+    juce::Atomic<int64_t> m_iFreeHead;
+    juce::Atomic<int32_t> m_iNumBlocks;
+    juce::Atomic<int32_t> m_iNumAllocated;
   };
 
   // static instance of the managed pointer pool
@@ -775,7 +1422,7 @@ private:
   {
     if ( m_pManagedPointer )
     {
-      m_pManagedPointer->m_uiRefCount++;
+      ++m_pManagedPointer->m_iRefCount;
     }
   }
 
@@ -786,18 +1433,14 @@ private:
   {
     if ( m_pManagedPointer )
     {
-      if ( m_pManagedPointer->m_uiRefCount )
-      {
-        m_pManagedPointer->m_uiRefCount--;
-      }
+      ManagedPointerEntry* const pEntry = m_pManagedPointer;
+      m_pManagedPointer = NULL;
 
-      if ( !m_pManagedPointer->m_uiRefCount )
+      if ( --pEntry->m_iRefCount == 0 )
       {
-        Destructor::Destroy(m_pManagedPointer->m_pPointer);
-        s_pool().freeEntry(m_pManagedPointer);
+        Destructor::Destroy( pEntry->m_pPointer );
+        s_pool().freeEntry( pEntry );
       }
-
-      m_pManagedPointer = NULL;
     }
   }
 
@@ -850,7 +1493,7 @@ public:
   ManagedType* GetPointer() const { return m_pManagedPointer ? m_pManagedPointer->m_pPointer : NULL; }
 
   /// how many references are there to this managed pointer?
-  uint32_t GetRefCount() const { return m_pManagedPointer ? m_pManagedPointer->m_uiRefCount : 0u; }
+  uint32_t GetRefCount() const { return m_pManagedPointer ? static_cast<uint32_t>(m_pManagedPointer->m_iRefCount.get()) : 0u; }
 
   /// operators for easy implicit assignment to raw pointer type or direct use of the object pointer
   operator ManagedType*() const { return GetPointer(); }
@@ -888,13 +1531,15 @@ public:
   /// returns true if the given raw pointer is managed by a smart pointer somewhere, false if not.
   static bool IsManaged( const ManagedType* pPointer )
   {
-    return s_pool().findEntry( pPointer ) != NULL;
+    return s_pool().isManaged( pPointer );
   }
 
   /// returns the number of raw pointers of this type under management.
-  /// use SmartPointer::kManagedPointerPoolSize to get the total number of pointers of this type that can be managed.
   static uint32_t GetNumManagedPointers() { return s_pool().getNumAllocated(); }
 
+  /// returns the number of pointers of this type that can be managed before the pool next grows.
+  static uint32_t GetManagedPointerCapacity() { return s_pool().getCapacity(); }
+
 private:
   ManagedPointerEntry* m_pManagedPointer;
 };
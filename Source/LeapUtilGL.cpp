@@ -68,6 +68,12 @@ void drawGrid( ePlane plane, unsigned int horizSubdivs, unsigned int vertSubdivs
 
     glDisable(GL_LIGHTING);
 
+    if ( MeshCache* pCache = MeshCache::GetForCurrentContext() )
+    {
+      pCache->DrawGrid( plane, horizSubdivs, vertSubdivs );
+      return;
+    }
+
     glBegin( GL_LINES );
 
     switch ( plane )
@@ -120,6 +126,15 @@ void drawGrid( ePlane plane, unsigned int horizSubdivs, unsigned int vertSubdivs
 
 void drawSphere( eStyle style )
 {
+  if ( style == kStyle_Solid )
+  {
+    if ( MeshCache* pCache = MeshCache::GetForCurrentContext() )
+    {
+      pCache->Draw( kMesh_Sphere );
+      return;
+    }
+  }
+
   switch ( style )
   {
    case kStyle_Outline:
@@ -236,6 +251,15 @@ void drawQuad( eStyle style, ePlane plane )
 
 void drawBox( eStyle style )
 {
+  if ( style == kStyle_Solid )
+  {
+    if ( MeshCache* pCache = MeshCache::GetForCurrentContext() )
+    {
+      pCache->Draw( kMesh_Box );
+      return;
+    }
+  }
+
   static const float s_afCorners[8][3] = {
                                             // near face - ccw facing origin from face.
                                             {-0.5f, -0.5f,  0.5f},
@@ -401,6 +425,15 @@ void drawCylinder( eStyle style, eAxis axis )
     break;
   }
 
+  if ( style == kStyle_Solid )
+  {
+    if ( MeshCache* pCache = MeshCache::GetForCurrentContext() )
+    {
+      pCache->Draw( kMesh_Cylinder );
+      return;
+    }
+  }
+
   // draw end caps
   if ( style != kStyle_Outline )
   {
@@ -458,6 +491,16 @@ void drawCylinder( eStyle style, eAxis axis, GLfloat radius, GLfloat length, con
     break;
   }
 
+  if ( style == kStyle_Solid )
+  {
+    if ( MeshCache* pCache = MeshCache::GetForCurrentContext() )
+    {
+      glScalef( radius*2.0f, radius*2.0f, length );
+      pCache->Draw( kMesh_Cylinder );
+      return;
+    }
+  }
+
   // draw end caps
   if ( style != kStyle_Outline )
   {
@@ -514,9 +557,16 @@ void drawDisk( eStyle style, ePlane plane )
     break;
   }
 
-  gluDisk(s_quadric, 0, 0.5f, 32, 1);
-  glRotatef( 180.0f, 0, 1, 0 );
-  gluDisk(s_quadric, 0, 0.5f, 32, 1);
+  if ( MeshCache* pCache = MeshCache::GetForCurrentContext() )
+  {
+    pCache->Draw( style == kStyle_Solid ? kMesh_Disk : kMesh_Circle );
+  }
+  else
+  {
+    gluDisk(s_quadric, 0, 0.5f, 32, 1);
+    glRotatef( 180.0f, 0, 1, 0 );
+    gluDisk(s_quadric, 0, 0.5f, 32, 1);
+  }
 
   switch ( style )
   {
@@ -557,9 +607,17 @@ void drawDisk( eStyle style, ePlane plane, GLfloat radius )
     break;
   }
 
-  gluDisk(s_quadric, 0, radius, 32, 1);
-  glRotatef( 180.0f, 0, 1, 0 );
-  gluDisk(s_quadric, 0, radius, 32, 1);
+  if ( MeshCache* pCache = MeshCache::GetForCurrentContext() )
+  {
+    glScalef( radius*2.0f, radius*2.0f, 1.0f );
+    pCache->Draw( style == kStyle_Solid ? kMesh_Disk : kMesh_Circle );
+  }
+  else
+  {
+    gluDisk(s_quadric, 0, radius, 32, 1);
+    glRotatef( 180.0f, 0, 1, 0 );
+    gluDisk(s_quadric, 0, radius, 32, 1);
+  }
 
   switch ( style )
   {
@@ -585,7 +643,16 @@ void drawDisk(Leap::Vector vCenter, Leap::Vector vNormal)
 	glTranslatef( vCenter.x, vCenter.y, vCenter.z );
 	Vector orth = vNormal.cross(Vector::zAxis());
 	glRotatef(-vNormal.angleTo(Vector::zAxis())/3.1416f*180.0f, orth.x, orth.y, orth.z);
-	gluDisk(s_quadric, 0, 0.1f, 32, 1);
+
+	if ( MeshCache* pCache = MeshCache::GetForCurrentContext() )
+	{
+		glScalef( 0.2f, 0.2f, 0.2f );
+		pCache->Draw( kMesh_Circle );
+	}
+	else
+	{
+		gluDisk(s_quadric, 0, 0.1f, 32, 1);
+	}
 
 	glPopAttrib();
 }
@@ -665,4 +732,597 @@ void CameraGL::SetupGLView() const
   glMultMatrixf( GetView().toArray4x4() );
 }
 
+//MeshCache methods
+
+static const char* const s_szMeshCacheName = "LeapUtilGL::MeshCache";
+
+/// number of slices (and sphere stacks) used for each eDetail level.
+static const int s_aiDetailSlices[kNumDetails] = { 8, 16, 32 };
+
+#if defined(WIN32)
+  #define LEAPUTILGL_APIENTRY __stdcall
+#else
+  #define LEAPUTILGL_APIENTRY
+#endif
+
+typedef void (LEAPUTILGL_APIENTRY *DrawElementsInstancedFunc)( GLenum, GLsizei, GLenum, const GLvoid*, GLsizei );
+typedef void (LEAPUTILGL_APIENTRY *VertexAttribDivisorFunc)( GLuint, GLuint );
+
+MeshCache* MeshCache::GetForCurrentContext()
+{
+  juce::OpenGLContext* pContext = juce::OpenGLContext::getCurrentContext();
+
+  if ( !pContext )
+  {
+    return NULL;
+  }
+
+  MeshCache* pCache = static_cast<MeshCache*>( pContext->getAssociatedObject( s_szMeshCacheName ) );
+
+  if ( !pCache )
+  {
+    pCache = new MeshCache( *pContext );
+    pContext->setAssociatedObject( s_szMeshCacheName, pCache );
+  }
+
+  return pCache;
+}
+
+void MeshCache::ReleaseForCurrentContext()
+{
+  if ( juce::OpenGLContext* pContext = juce::OpenGLContext::getCurrentContext() )
+  {
+    if ( MeshCache* pCache = static_cast<MeshCache*>( pContext->getAssociatedObject( s_szMeshCacheName ) ) )
+    {
+      pCache->ReleaseGLResources();
+      pContext->setAssociatedObject( s_szMeshCacheName, NULL );
+    }
+  }
+}
+
+MeshCache::MeshCache( juce::OpenGLContext& context )
+  : m_context( context ),
+    m_iTransformAttrib( -1 ),
+    m_iColorAttrib( -1 ),
+    m_uiInstanceBuffer( 0 ),
+    m_iInstanceBufferSize( 0 ),
+    m_iInstanceDataSize( 0 ),
+    m_pfnDrawElementsInstanced( NULL ),
+    m_pfnVertexAttribDivisor( NULL ),
+    m_bInstancingChecked( false ),
+    m_iNumDrawCalls( 0 )
+{
+}
+
+MeshCache::~MeshCache()
+{
+  // the context may already have gone when it discards its associated objects,
+  // in which case the buffers have been destroyed along with it.
+  if ( juce::OpenGLHelpers::isContextActive() )
+  {
+    ReleaseGLResources();
+  }
+}
+
+void MeshCache::ReleaseGLResources()
+{
+  for ( int i = 0; i < kNumMeshes; i++ )
+  {
+    for ( int j = 0; j < kNumDetails; j++ )
+    {
+      Mesh& mesh = m_aMeshes[i][j];
+
+      if ( mesh.m_uiVertexBuffer )
+      {
+        m_context.extensions.glDeleteBuffers( 1, &mesh.m_uiVertexBuffer );
+        m_context.extensions.glDeleteBuffers( 1, &mesh.m_uiIndexBuffer );
+      }
+
+      mesh = Mesh();
+    }
+  }
+
+  for ( int i = 0; i < m_grids.size(); i++ )
+  {
+    m_context.extensions.glDeleteBuffers( 1, &m_grids[i]->m_uiVertexBuffer );
+    m_context.extensions.glDeleteBuffers( 1, &m_grids[i]->m_uiIndexBuffer );
+  }
+
+  m_grids.clear();
+
+  if ( m_uiInstanceBuffer )
+  {
+    m_context.extensions.glDeleteBuffers( 1, &m_uiInstanceBuffer );
+    m_uiInstanceBuffer = 0;
+    m_iInstanceBufferSize = 0;
+  }
+
+  m_pInstanceShader = nullptr;
+  m_bInstancingChecked = false;
+}
+
+void MeshCache::Upload( Mesh& mesh, const Array<Vertex>& vertices, const Array<GLushort>& indices, GLenum primitive )
+{
+  // indices are 16 bit
+  jassert( vertices.size() <= 0x10000 );
+
+  m_context.extensions.glGenBuffers( 1, &mesh.m_uiVertexBuffer );
+  m_context.extensions.glBindBuffer( GL_ARRAY_BUFFER, mesh.m_uiVertexBuffer );
+  m_context.extensions.glBufferData( GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(Vertex) * vertices.size()),
+                                     vertices.begin(), GL_STATIC_DRAW );
+
+  m_context.extensions.glGenBuffers( 1, &mesh.m_uiIndexBuffer );
+  m_context.extensions.glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mesh.m_uiIndexBuffer );
+  m_context.extensions.glBufferData( GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(GLushort) * indices.size()),
+                                     indices.begin(), GL_STATIC_DRAW );
+
+  m_context.extensions.glBindBuffer( GL_ARRAY_BUFFER, 0 );
+  m_context.extensions.glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+
+  mesh.m_iNumIndices  = static_cast<GLsizei>(indices.size());
+  mesh.m_ePrimitive   = primitive;
+}
+
+static void addVertex( Array<MeshCache::Vertex>& vertices, float x, float y, float z, float nx, float ny, float nz )
+{
+  MeshCache::Vertex vertex;
+  vertex.m_afPosition[0] = x;
+  vertex.m_afPosition[1] = y;
+  vertex.m_afPosition[2] = z;
+  vertex.m_afNormal[0] = nx;
+  vertex.m_afNormal[1] = ny;
+  vertex.m_afNormal[2] = nz;
+  vertices.add( vertex );
+}
+
+static void addTriangle( Array<GLushort>& indices, int a, int b, int c )
+{
+  indices.add( static_cast<GLushort>(a) );
+  indices.add( static_cast<GLushort>(b) );
+  indices.add( static_cast<GLushort>(c) );
+}
+
+/// adds a triangle fan disk of the given radius at height z facing along +z or -z.
+static void addDiskFan( Array<MeshCache::Vertex>& vertices, Array<GLushort>& indices, int iSlices, float fRadius, float z, float fFacing )
+{
+  const int iCenter = vertices.size();
+
+  addVertex( vertices, 0, 0, z, 0, 0, fFacing );
+
+  for ( int i = 0; i <= iSlices; i++ )
+  {
+    const float fAngle = kf2Pi * static_cast<float>(i) / static_cast<float>(iSlices);
+    addVertex( vertices, fRadius * cosf(fAngle), fRadius * sinf(fAngle), z, 0, 0, fFacing );
+  }
+
+  for ( int i = 0; i < iSlices; i++ )
+  {
+    if ( fFacing > 0 )
+    {
+      addTriangle( indices, iCenter, iCenter + 1 + i, iCenter + 2 + i );
+    }
+    else
+    {
+      addTriangle( indices, iCenter, iCenter + 2 + i, iCenter + 1 + i );
+    }
+  }
+}
+
+const MeshCache::Mesh& MeshCache::GetMesh( eMesh meshType, eDetail detail )
+{
+  // boxes have no curved surfaces, so every detail level shares one mesh.
+  if ( meshType == kMesh_Box )
+  {
+    detail = kDetail_High;
+  }
+
+  Mesh& mesh = m_aMeshes[meshType][detail];
+
+  if ( mesh.m_uiVertexBuffer )
+  {
+    return mesh;
+  }
+
+  const int iSlices = s_aiDetailSlices[detail];
+
+  Array<Vertex>   vertices;
+  Array<GLushort> indices;
+  GLenum          primitive = GL_TRIANGLES;
+
+  switch ( meshType )
+  {
+    case kMesh_Sphere:
+    {
+      const int iStacks = iSlices;
+
+      for ( int i = 0; i <= iStacks; i++ )
+      {
+        const float fPhi    = kfPi * static_cast<float>(i) / static_cast<float>(iStacks);
+        const float fSinPhi = sinf(fPhi);
+        const float fCosPhi = cosf(fPhi);
+
+        for ( int j = 0; j <= iSlices; j++ )
+        {
+          const float fTheta  = kf2Pi * static_cast<float>(j) / static_cast<float>(iSlices);
+          const float x       = fSinPhi * cosf(fTheta);
+          const float y       = fSinPhi * sinf(fTheta);
+
+          addVertex( vertices, x, y, fCosPhi, x, y, fCosPhi );
+        }
+      }
+
+      for ( int i = 0; i < iStacks; i++ )
+      {
+        for ( int j = 0; j < iSlices; j++ )
+        {
+          const int a = i * (iSlices + 1) + j;
+          const int b = a + iSlices + 1;
+
+          addTriangle( indices, a, b, a + 1 );
+          addTriangle( indices, a + 1, b, b + 1 );
+        }
+      }
+      break;
+    }
+
+    case kMesh_Cylinder:
+    {
+      for ( int i = 0; i <= iSlices; i++ )
+      {
+        const float fAngle  = kf2Pi * static_cast<float>(i) / static_cast<float>(iSlices);
+        const float nx      = cosf(fAngle);
+        const float ny      = sinf(fAngle);
+
+        addVertex( vertices, 0.5f * nx, 0.5f * ny, -0.5f, nx, ny, 0 );
+        addVertex( vertices, 0.5f * nx, 0.5f * ny,  0.5f, nx, ny, 0 );
+      }
+
+      for ( int i = 0; i < iSlices; i++ )
+      {
+        addTriangle( indices, i*2, i*2 + 2, i*2 + 1 );
+        addTriangle( indices, i*2 + 1, i*2 + 2, i*2 + 3 );
+      }
+
+      addDiskFan( vertices, indices, iSlices, 0.5f,  0.5f,  1.0f );
+      addDiskFan( vertices, indices, iSlices, 0.5f, -0.5f, -1.0f );
+      break;
+    }
+
+    case kMesh_Disk:
+      addDiskFan( vertices, indices, iSlices, 0.5f, 0,  1.0f );
+      addDiskFan( vertices, indices, iSlices, 0.5f, 0, -1.0f );
+      break;
+
+    case kMesh_Circle:
+      primitive = GL_LINE_LOOP;
+
+      for ( int i = 0; i < iSlices; i++ )
+      {
+        const float fAngle = kf2Pi * static_cast<float>(i) / static_cast<float>(iSlices);
+        addVertex( vertices, 0.5f * cosf(fAngle), 0.5f * sinf(fAngle), 0, 0, 0, 1 );
+        indices.add( static_cast<GLushort>(i) );
+      }
+      break;
+
+    case kMesh_Box:
+    {
+      static const float s_afNormals[6][3] = { {0, 0, 1}, {0, 0, -1}, {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0} };
+
+      for ( int iFace = 0; iFace < 6; iFace++ )
+      {
+        const Vector vNormal( s_afNormals[iFace][0], s_afNormals[iFace][1], s_afNormals[iFace][2] );
+        const Vector vSide  = fabsf(vNormal.y) > 0.5f ? Vector::xAxis() : Vector::yAxis();
+        const Vector vUp    = vNormal.cross( vSide );
+        const int    iBase  = vertices.size();
+
+        for ( int iCorner = 0; iCorner < 4; iCorner++ )
+        {
+          const float fSide   = (iCorner == 1 || iCorner == 2) ? 0.5f : -0.5f;
+          const float fUp     = (iCorner >= 2) ? 0.5f : -0.5f;
+          const Vector vPos   = vNormal * 0.5f + vSide * fSide + vUp * fUp;
+
+          addVertex( vertices, vPos.x, vPos.y, vPos.z, vNormal.x, vNormal.y, vNormal.z );
+        }
+
+        addTriangle( indices, iBase, iBase + 1, iBase + 2 );
+        addTriangle( indices, iBase + 2, iBase + 3, iBase );
+      }
+      break;
+    }
+
+    default:
+      jassertfalse;
+      break;
+  }
+
+  Upload( mesh, vertices, indices, primitive );
+
+  return mesh;
+}
+
+void MeshCache::Bind( const Mesh& mesh )
+{
+  m_context.extensions.glBindBuffer( GL_ARRAY_BUFFER, mesh.m_uiVertexBuffer );
+  m_context.extensions.glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mesh.m_uiIndexBuffer );
+
+  glEnableClientState( GL_VERTEX_ARRAY );
+  glEnableClientState( GL_NORMAL_ARRAY );
+  glVertexPointer( 3, GL_FLOAT, sizeof(Vertex), reinterpret_cast<const GLvoid*>(offsetof(Vertex, m_afPosition)) );
+  glNormalPointer( GL_FLOAT, sizeof(Vertex), reinterpret_cast<const GLvoid*>(offsetof(Vertex, m_afNormal)) );
+}
+
+void MeshCache::Unbind()
+{
+  glDisableClientState( GL_NORMAL_ARRAY );
+  glDisableClientState( GL_VERTEX_ARRAY );
+
+  m_context.extensions.glBindBuffer( GL_ARRAY_BUFFER, 0 );
+  m_context.extensions.glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+}
+
+void MeshCache::Draw( eMesh meshType, eDetail detail )
+{
+  const Mesh& mesh = GetMesh( meshType, detail );
+
+  Bind( mesh );
+  glDrawElements( mesh.m_ePrimitive, mesh.m_iNumIndices, GL_UNSIGNED_SHORT, 0 );
+  ++m_iNumDrawCalls;
+  Unbind();
+}
+
+void MeshCache::DrawGrid( ePlane plane, unsigned int horizSubdivs, unsigned int vertSubdivs )
+{
+  GridMesh* pGrid = NULL;
+
+  for ( int i = 0; i < m_grids.size() && !pGrid; i++ )
+  {
+    GridMesh* pCandidate = m_grids.getUnchecked(i);
+
+    if ( pCandidate->m_plane == plane && pCandidate->m_uiHorizSubdivs == horizSubdivs && pCandidate->m_uiVertSubdivs == vertSubdivs )
+    {
+      pGrid = pCandidate;
+    }
+  }
+
+  if ( !pGrid )
+  {
+    // same stepping as the immediate mode drawGrid(), so the lines land in exactly the same places.
+    const float fHalfGridSize   = 0.5f;
+    const float fHGridStep      = (fHalfGridSize + fHalfGridSize)/static_cast<float>(Max(horizSubdivs, 1u));
+    const float fVGridStep      = (fHalfGridSize + fHalfGridSize)/static_cast<float>(Max(vertSubdivs, 1u));
+    const float fHEndStep       = fHalfGridSize + fHGridStep;
+    const float fVEndStep       = fHalfGridSize + fVGridStep;
+
+    Array<Vertex>   vertices;
+    Array<GLushort> indices;
+
+    for ( float h = -fHalfGridSize; h < fHEndStep; h += fHGridStep )
+    {
+      for ( int iEnd = 0; iEnd < 2; iEnd++ )
+      {
+        const float v = iEnd ? fHalfGridSize : -fHalfGridSize;
+
+        switch ( plane )
+        {
+          case kPlane_XY: addVertex( vertices, h, v, 0, 0, 0, 1 ); break;
+          case kPlane_YZ: addVertex( vertices, 0, h, v, 1, 0, 0 ); break;
+          case kPlane_ZX: addVertex( vertices, v, 0, h, 0, 1, 0 ); break;
+        }
+
+        indices.add( static_cast<GLushort>(indices.size()) );
+      }
+    }
+
+    for ( float v = -fHalfGridSize; v < fVEndStep; v += fVGridStep )
+    {
+      for ( int iEnd = 0; iEnd < 2; iEnd++ )
+      {
+        const float h = iEnd ? fHalfGridSize : -fHalfGridSize;
+
+        switch ( plane )
+        {
+          case kPlane_XY: addVertex( vertices, h, v, 0, 0, 0, 1 ); break;
+          case kPlane_YZ: addVertex( vertices, 0, h, v, 1, 0, 0 ); break;
+          case kPlane_ZX: addVertex( vertices, v, 0, h, 0, 1, 0 ); break;
+        }
+
+        indices.add( static_cast<GLushort>(indices.size()) );
+      }
+    }
+
+    pGrid = m_grids.add( new GridMesh() );
+    pGrid->m_plane          = plane;
+    pGrid->m_uiHorizSubdivs = horizSubdivs;
+    pGrid->m_uiVertSubdivs  = vertSubdivs;
+
+    Upload( *pGrid, vertices, indices, GL_LINES );
+  }
+
+  GLAttribScope lightingScope( GL_LIGHTING_BIT );
+
+  glDisable(GL_LIGHTING);
+
+  Bind( *pGrid );
+  glDrawElements( pGrid->m_ePrimitive, pGrid->m_iNumIndices, GL_UNSIGNED_SHORT, 0 );
+  ++m_iNumDrawCalls;
+  Unbind();
+}
+
+bool MeshCache::InitInstancing()
+{
+#if JUCE_USE_OPENGL_SHADERS
+  // mat4 vertex attributes need GLSL 1.20
+  if ( juce::OpenGLShaderProgram::getLanguageVersion() < 1.199 )
+  {
+    return false;
+  }
+
+  m_pfnDrawElementsInstanced  = juce::OpenGLHelpers::getExtensionFunction( "glDrawElementsInstanced" );
+  m_pfnVertexAttribDivisor    = juce::OpenGLHelpers::getExtensionFunction( "glVertexAttribDivisor" );
+
+  if ( !m_pfnDrawElementsInstanced )
+  {
+    m_pfnDrawElementsInstanced = juce::OpenGLHelpers::getExtensionFunction( "glDrawElementsInstancedARB" );
+  }
+
+  if ( !m_pfnVertexAttribDivisor )
+  {
+    m_pfnVertexAttribDivisor = juce::OpenGLHelpers::getExtensionFunction( "glVertexAttribDivisorARB" );
+  }
+
+  if ( !m_pfnDrawElementsInstanced || !m_pfnVertexAttribDivisor )
+  {
+    return false;
+  }
+
+  juce::ScopedPointer<juce::OpenGLShaderProgram> pShader( new juce::OpenGLShaderProgram( m_context ) );
+
+  if ( !pShader->addVertexShader( "#version 120\n"
+                                  "attribute mat4 instanceTransform;\n"
+                                  "attribute vec4 instanceColor;\n"
+                                  "varying vec4 color;\n"
+                                  "void main()\n"
+                                  "{\n"
+                                  "    color = instanceColor;\n"
+                                  "    gl_Position = gl_ModelViewProjectionMatrix * (instanceTransform * gl_Vertex);\n"
+                                  "}\n" )
+       || !pShader->addFragmentShader( "#version 120\n"
+                                       "varying vec4 color;\n"
+                                       "void main()\n"
+                                       "{\n"
+                                       "    gl_FragColor = color;\n"
+                                       "}\n" )
+       || !pShader->link() )
+  {
+    DBG( "LeapUtilGL::MeshCache: instancing shader failed: " + pShader->getLastError() );
+    return false;
+  }
+
+  m_iTransformAttrib  = m_context.extensions.glGetAttribLocation( pShader->programID, "instanceTransform" );
+  m_iColorAttrib      = m_context.extensions.glGetAttribLocation( pShader->programID, "instanceColor" );
+
+  if ( m_iTransformAttrib < 0 || m_iColorAttrib < 0 )
+  {
+    return false;
+  }
+
+  m_context.extensions.glGenBuffers( 1, &m_uiInstanceBuffer );
+  m_pInstanceShader = pShader;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void MeshCache::DrawInstanced( eMesh meshType, eDetail detail, const Leap::Matrix* pTransforms, const Colour* pColors, int iNumInstances )
+{
+  if ( iNumInstances <= 0 )
+  {
+    return;
+  }
+
+  const Mesh& mesh = GetMesh( meshType, detail );
+
+  if ( !m_bInstancingChecked )
+  {
+    m_bInstancingChecked = true;
+    InitInstancing();
+  }
+
+  if ( !m_pInstanceShader )
+  {
+    // no instancing - still one buffer bind for the whole batch, but a draw call per instance.
+    GLAttribScope attribScope( GL_CURRENT_BIT | GL_LIGHTING_BIT );
+
+    glDisable(GL_LIGHTING);
+
+    Bind( mesh );
+
+    for ( int i = 0; i < iNumInstances; i++ )
+    {
+      GLMatrixScope matrixScope;
+
+      glMultMatrixf( pTransforms[i].toArray4x4() );
+      glColor4f( pColors[i].getFloatRed(), pColors[i].getFloatGreen(), pColors[i].getFloatBlue(), pColors[i].getFloatAlpha() );
+      glDrawElements( mesh.m_ePrimitive, mesh.m_iNumIndices, GL_UNSIGNED_SHORT, 0 );
+      ++m_iNumDrawCalls;
+    }
+
+    Unbind();
+    return;
+  }
+
+#if JUCE_USE_OPENGL_SHADERS
+  if ( m_iInstanceDataSize < iNumInstances )
+  {
+    m_instanceData.malloc( static_cast<size_t>(iNumInstances) );
+    m_iInstanceDataSize = iNumInstances;
+  }
+
+  for ( int i = 0; i < iNumInstances; i++ )
+  {
+    Instance& instance = m_instanceData[i];
+    const Leap::FloatArray transform = pTransforms[i].toArray4x4();
+
+    memcpy( instance.m_afTransform, transform.m_array, sizeof(instance.m_afTransform) );
+    instance.m_afColor[0] = pColors[i].getFloatRed();
+    instance.m_afColor[1] = pColors[i].getFloatGreen();
+    instance.m_afColor[2] = pColors[i].getFloatBlue();
+    instance.m_afColor[3] = pColors[i].getFloatAlpha();
+  }
+
+  const GLsizeiptr iNumBytes = static_cast<GLsizeiptr>(sizeof(Instance) * static_cast<size_t>(iNumInstances));
+  const VertexAttribDivisorFunc pfnVertexAttribDivisor = reinterpret_cast<VertexAttribDivisorFunc>(m_pfnVertexAttribDivisor);
+
+  m_context.extensions.glBindBuffer( GL_ARRAY_BUFFER, m_uiInstanceBuffer );
+
+  if ( iNumBytes > m_iInstanceBufferSize )
+  {
+    m_context.extensions.glBufferData( GL_ARRAY_BUFFER, iNumBytes, m_instanceData.getData(), GL_STREAM_DRAW );
+    m_iInstanceBufferSize = iNumBytes;
+  }
+  else
+  {
+    // orphan the previous contents so the driver doesn't stall on a draw that's still using them
+    m_context.extensions.glBufferData( GL_ARRAY_BUFFER, m_iInstanceBufferSize, NULL, GL_STREAM_DRAW );
+    m_context.extensions.glBufferSubData( GL_ARRAY_BUFFER, 0, iNumBytes, m_instanceData.getData() );
+  }
+
+  // a mat4 attribute takes four consecutive locations, one per column
+  for ( int iColumn = 0; iColumn < 4; iColumn++ )
+  {
+    const GLuint uiAttrib = static_cast<GLuint>(m_iTransformAttrib + iColumn);
+
+    m_context.extensions.glEnableVertexAttribArray( uiAttrib );
+    m_context.extensions.glVertexAttribPointer( uiAttrib, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                                                reinterpret_cast<const GLvoid*>(offsetof(Instance, m_afTransform) + sizeof(GLfloat) * 4 * iColumn) );
+    pfnVertexAttribDivisor( uiAttrib, 1 );
+  }
+
+  m_context.extensions.glEnableVertexAttribArray( static_cast<GLuint>(m_iColorAttrib) );
+  m_context.extensions.glVertexAttribPointer( static_cast<GLuint>(m_iColorAttrib), 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                                              reinterpret_cast<const GLvoid*>(offsetof(Instance, m_afColor)) );
+  pfnVertexAttribDivisor( static_cast<GLuint>(m_iColorAttrib), 1 );
+
+  Bind( mesh );
+  m_pInstanceShader->use();
+
+  reinterpret_cast<DrawElementsInstancedFunc>(m_pfnDrawElementsInstanced)( mesh.m_ePrimitive, mesh.m_iNumIndices, GL_UNSIGNED_SHORT, 0, iNumInstances );
+  ++m_iNumDrawCalls;
+
+  m_context.extensions.glUseProgram( 0 );
+
+  for ( int iColumn = 0; iColumn < 4; iColumn++ )
+  {
+    pfnVertexAttribDivisor( static_cast<GLuint>(m_iTransformAttrib + iColumn), 0 );
+    m_context.extensions.glDisableVertexAttribArray( static_cast<GLuint>(m_iTransformAttrib + iColumn) );
+  }
+
+  pfnVertexAttribDivisor( static_cast<GLuint>(m_iColorAttrib), 0 );
+  m_context.extensions.glDisableVertexAttribArray( static_cast<GLuint>(m_iColorAttrib) );
+
+  Unbind();
+#endif
+}
+
 }
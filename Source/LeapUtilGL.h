@@ -124,6 +124,113 @@ public:
   void SetupGLView() const;
 };
 
+/// tessellation levels for the curved meshes held by MeshCache.
+enum eDetail { kDetail_Low, kDetail_Medium, kDetail_High, kNumDetails };
+
+/// primitives held by MeshCache. they match the unit sized objects drawn by the functions above:
+/// sphere has radius 1, cylinder is radius 0.5 and length 1 along the z axis with end caps,
+/// disk is a double sided radius 0.5 disk in the xy plane, circle is its outline as a line loop
+/// and box is a unit cube.
+enum eMesh { kMesh_Sphere, kMesh_Cylinder, kMesh_Disk, kMesh_Circle, kMesh_Box, kNumMeshes };
+
+/// builds each primitive once per OpenGLContext as a pair of static vertex and index buffers
+/// so that repeated drawing only has to bind buffers and issue a single glDrawElements().
+/// DrawInstanced() draws many copies of one mesh with their own transform and color in one
+/// draw call when the driver supports glDrawElementsInstanced() and glVertexAttribDivisor(),
+/// falling back to one glDrawElements() per instance (still without any glBegin/glEnd) when not.
+///
+/// the cache is stored as an associated object of the current OpenGLContext, so it must only
+/// be used from the GL rendering callbacks.  call ReleaseForCurrentContext() from
+/// openGLContextClosing() so the buffers are deleted while the context is still current.
+class MeshCache : public juce::ReferenceCountedObject
+{
+public:
+  /// returns the cache for the active OpenGLContext, creating it on first use.
+  /// returns NULL when no juce OpenGLContext is active on this thread.
+  static MeshCache* GetForCurrentContext();
+
+  /// deletes the GL objects of the current context's cache and detaches it from the context.
+  static void ReleaseForCurrentContext();
+
+  ~MeshCache();
+
+  /// draws one mesh with the current modelview matrix and color.
+  void Draw( eMesh mesh, eDetail detail = kDetail_High );
+
+  /// draws iNumInstances copies of a mesh.  each instance is transformed by pTransforms[i] on top
+  /// of the current modelview matrix and drawn unlit in pColors[i].
+  void DrawInstanced( eMesh mesh, eDetail detail, const Leap::Matrix* pTransforms, const Colour* pColors, int iNumInstances );
+
+  /// draws the same unlit line grid as drawGrid(), cached by plane and subdivision counts.
+  void DrawGrid( ePlane plane, unsigned int horizSubdivs, unsigned int vertSubdivs );
+
+  /// true once DrawInstanced() has found working instancing support.
+  bool IsInstancingSupported() const { return m_pInstanceShader != nullptr; }
+
+  /// number of glDrawElements/glDrawElementsInstanced calls issued since the last reset.
+  int GetNumDrawCalls() const { return m_iNumDrawCalls; }
+  void ResetDrawCallCount() { m_iNumDrawCalls = 0; }
+
+  /// layout of the cached vertex buffers.
+  struct Vertex
+  {
+    GLfloat m_afPosition[3];
+    GLfloat m_afNormal[3];
+  };
+
+private:
+  struct Instance
+  {
+    GLfloat m_afTransform[16];
+    GLfloat m_afColor[4];
+  };
+
+  struct Mesh
+  {
+    Mesh() : m_uiVertexBuffer(0), m_uiIndexBuffer(0), m_iNumIndices(0), m_ePrimitive(GL_TRIANGLES) {}
+
+    GLuint  m_uiVertexBuffer;
+    GLuint  m_uiIndexBuffer;
+    GLsizei m_iNumIndices;
+    GLenum  m_ePrimitive;
+  };
+
+  struct GridMesh : public Mesh
+  {
+    ePlane        m_plane;
+    unsigned int  m_uiHorizSubdivs;
+    unsigned int  m_uiVertSubdivs;
+  };
+
+  explicit MeshCache( juce::OpenGLContext& context );
+
+  const Mesh& GetMesh( eMesh mesh, eDetail detail );
+  void Upload( Mesh& mesh, const juce::Array<Vertex>& vertices, const juce::Array<GLushort>& indices, GLenum primitive );
+  void Bind( const Mesh& mesh );
+  void Unbind();
+  void ReleaseGLResources();
+  bool InitInstancing();
+
+  juce::OpenGLContext&                      m_context;
+  Mesh                                      m_aMeshes[kNumMeshes][kNumDetails];
+  juce::OwnedArray<GridMesh>                m_grids;
+
+  juce::ScopedPointer<juce::OpenGLShaderProgram> m_pInstanceShader;
+  GLint                                     m_iTransformAttrib;
+  GLint                                     m_iColorAttrib;
+  GLuint                                    m_uiInstanceBuffer;
+  GLsizeiptr                                m_iInstanceBufferSize;
+  juce::HeapBlock<Instance>                 m_instanceData;
+  int                                       m_iInstanceDataSize;
+  void*                                     m_pfnDrawElementsInstanced;
+  void*                                     m_pfnVertexAttribDivisor;
+  bool                                      m_bInstancingChecked;
+
+  int                                       m_iNumDrawCalls;
+
+  JUCE_DECLARE_NON_COPYABLE (MeshCache)
+};
+
 }
 
 #endif // __LeapUtilGL_h__
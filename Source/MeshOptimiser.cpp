@@ -0,0 +1,467 @@
+/*
+  ==============================================================================
+
+    MeshOptimiser.cpp
+
+  ==============================================================================
+*/
+
+#include "MeshOptimiser.h"
+
+namespace MeshOptimiser
+{
+
+//==============================================================================
+String Statistics::toString() const
+{
+    return String (numTriangles) + " triangles, " + String (numVertices) + " vertices: ACMR "
+             + String (getACMR(), 3) + ", ATVR " + String (getATVR(), 3) + " with a "
+             + String (cacheSize) + " entry cache";
+}
+
+Statistics analyse (const uint32* indices, int numIndices, int numVertices, int cacheSize)
+{
+    jassert (cacheSize > 0);
+
+    Statistics stats;
+    stats.numTriangles = numIndices / 3;
+    stats.numVertices = 0;
+    stats.cacheSize = cacheSize;
+    stats.numCacheMisses = 0;
+
+    // Each vertex records the miss count when it entered the cache. With a FIFO, it's
+    // still there as long as no more than cacheSize misses have happened since.
+    HeapBlock<int> entryTime ((size_t) jmax (1, numVertices));
+
+    for (int i = 0; i < numVertices; ++i)
+        entryTime[i] = -1;
+
+    for (int i = 0; i < stats.numTriangles * 3; ++i)
+    {
+        const uint32 v = indices[i];
+        jassert (v < (uint32) numVertices);
+
+        if (entryTime[v] < 0)
+            ++stats.numVertices;
+        else if (stats.numCacheMisses - entryTime[v] <= cacheSize)
+            continue;
+
+        entryTime[v] = stats.numCacheMisses++;
+    }
+
+    return stats;
+}
+
+String getReport (const Statistics& before, const Statistics& after)
+{
+    return "ACMR " + String (before.getACMR(), 3) + " -> " + String (after.getACMR(), 3)
+             + ", ATVR " + String (before.getATVR(), 3) + " -> " + String (after.getATVR(), 3)
+             + " (" + String (after.numTriangles) + " triangles, " + String (after.cacheSize) + " entry FIFO)";
+}
+
+//==============================================================================
+namespace ForsythScores
+{
+    enum { maxCacheSize = 32, maxValence = 32 };
+
+    // The constants from the paper
+    static const float cacheDecayPower   = 1.5f;
+    static const float lastTriangleScore = 0.75f;
+    static const float valenceBoostScale = 2.0f;
+    static const float valenceBoostPower = 0.5f;
+
+    struct Tables
+    {
+        Tables()
+        {
+            for (int i = 0; i < maxCacheSize; ++i)
+            {
+                // the three vertices of the last triangle all get the same score, so that
+                // which one came first doesn't matter
+                if (i < 3)
+                    cachePosition[i] = lastTriangleScore;
+                else
+                    cachePosition[i] = std::pow (1.0f - (i - 3) / (float) (maxCacheSize - 3), cacheDecayPower);
+            }
+
+            valence[0] = 0.0f;
+
+            for (int i = 1; i <= maxValence; ++i)
+                valence[i] = valenceBoostScale * std::pow ((float) i, -valenceBoostPower);
+        }
+
+        float getScore (int position, int numActiveTriangles) const noexcept
+        {
+            if (numActiveTriangles == 0)
+                return -1.0f;
+
+            return (position >= 0 ? cachePosition[position] : 0.0f)
+                     + (numActiveTriangles <= maxValence ? valence[numActiveTriangles]
+                                                         : valenceBoostScale * std::pow ((float) numActiveTriangles, -valenceBoostPower));
+        }
+
+        float cachePosition[maxCacheSize];
+        float valence[maxValence + 1];
+    };
+
+    struct VertexData
+    {
+        int cachePosition, numActiveTriangles, firstTriangle;
+        float score;
+    };
+}
+
+void optimiseVertexCache (uint32* indices, const int numIndices, const int numVertices)
+{
+    using namespace ForsythScores;
+
+    const int numTriangles = numIndices / 3;
+
+    if (numTriangles < 2 || numVertices <= 0)
+        return;
+
+    const Tables tables;
+
+    HeapBlock<VertexData> vertices ((size_t) numVertices);
+    HeapBlock<int> adjacency ((size_t) numTriangles * 3);
+    HeapBlock<float> triangleScores ((size_t) numTriangles);
+    HeapBlock<bool> triangleAdded ((size_t) numTriangles, true);
+
+    // list each vertex's triangles together in the adjacency array
+    for (int i = 0; i < numVertices; ++i)
+    {
+        vertices[i].cachePosition = -1;
+        vertices[i].numActiveTriangles = 0;
+    }
+
+    for (int i = 0; i < numTriangles * 3; ++i)
+    {
+        jassert (indices[i] < (uint32) numVertices);
+        ++vertices[indices[i]].numActiveTriangles;
+    }
+
+    for (int i = 0, offset = 0; i < numVertices; ++i)
+    {
+        VertexData& v = vertices[i];
+        v.firstTriangle = offset;
+        offset += v.numActiveTriangles;
+        v.score = tables.getScore (-1, v.numActiveTriangles);
+        v.numActiveTriangles = 0;
+    }
+
+    for (int t = 0; t < numTriangles; ++t)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            VertexData& v = vertices[indices[t * 3 + j]];
+            adjacency[v.firstTriangle + v.numActiveTriangles++] = t;
+        }
+    }
+
+    int bestTriangle = -1;
+    float bestScore = -1.0f;
+
+    for (int t = 0; t < numTriangles; ++t)
+    {
+        triangleScores[t] = vertices[indices[t * 3]].score + vertices[indices[t * 3 + 1]].score + vertices[indices[t * 3 + 2]].score;
+
+        if (triangleScores[t] > bestScore)
+        {
+            bestScore = triangleScores[t];
+            bestTriangle = t;
+        }
+    }
+
+    HeapBlock<uint32> output ((size_t) numTriangles * 3);
+    int cache[maxCacheSize + 3], newCache[maxCacheSize + 3];
+    int cacheSize = 0, nextUnaddedTriangle = 0;
+
+    for (int n = 0; n < numTriangles; ++n)
+    {
+        if (bestTriangle < 0)
+        {
+            // nothing in the cache has any triangles left, so start again somewhere new
+            while (triangleAdded[nextUnaddedTriangle])
+                ++nextUnaddedTriangle;
+
+            bestTriangle = nextUnaddedTriangle;
+        }
+
+        const uint32* const corners = indices + bestTriangle * 3;
+        output[n * 3]     = corners[0];
+        output[n * 3 + 1] = corners[1];
+        output[n * 3 + 2] = corners[2];
+        triangleAdded[bestTriangle] = true;
+
+        // take the triangle off its vertices' lists, and put them at the front of the cache
+        int newCacheSize = 0;
+
+        for (int j = 0; j < 3; ++j)
+        {
+            const int vertexIndex = (int) corners[j];
+            VertexData& v = vertices[vertexIndex];
+            int* const triangles = adjacency + v.firstTriangle;
+
+            for (int k = 0; k < v.numActiveTriangles; ++k)
+            {
+                if (triangles[k] == bestTriangle)
+                {
+                    triangles[k] = triangles[--v.numActiveTriangles];
+                    break;
+                }
+            }
+
+            if (v.cachePosition != -2)
+            {
+                v.cachePosition = -2;   // marks it as already in the new cache
+                newCache[newCacheSize++] = vertexIndex;
+            }
+        }
+
+        for (int i = 0; i < cacheSize; ++i)
+            if (vertices[cache[i]].cachePosition != -2)
+                newCache[newCacheSize++] = cache[i];
+
+        // rescore everything that was or is in the cache, and find the best triangle among them
+        bestTriangle = -1;
+        bestScore = -1.0f;
+
+        for (int i = 0; i < newCacheSize; ++i)
+        {
+            VertexData& v = vertices[newCache[i]];
+            v.cachePosition = i < maxCacheSize ? i : -1;
+
+            const float newScore = tables.getScore (v.cachePosition, v.numActiveTriangles);
+            const float delta = newScore - v.score;
+            v.score = newScore;
+
+            const int* const triangles = adjacency + v.firstTriangle;
+
+            for (int k = 0; k < v.numActiveTriangles; ++k)
+            {
+                const int t = triangles[k];
+                triangleScores[t] += delta;
+
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        cacheSize = jmin ((int) maxCacheSize, newCacheSize);
+        memcpy (cache, newCache, (size_t) cacheSize * sizeof (int));
+    }
+
+    memcpy (indices, output, (size_t) numTriangles * 3 * sizeof (uint32));
+}
+
+int optimiseVertexFetch (uint32* indices, int numIndices, void* vertexData, int numVertices, int vertexSize)
+{
+    HeapBlock<int> remap ((size_t) jmax (1, numVertices));
+
+    for (int i = 0; i < numVertices; ++i)
+        remap[i] = -1;
+
+    const uint8* const source = static_cast<const uint8*> (vertexData);
+    HeapBlock<uint8> reordered ((size_t) numVertices * (size_t) vertexSize);
+    int numUsed = 0;
+
+    for (int i = 0; i < numIndices; ++i)
+    {
+        const uint32 v = indices[i];
+        jassert (v < (uint32) numVertices);
+
+        if (remap[v] < 0)
+        {
+            memcpy (reordered + (size_t) numUsed * (size_t) vertexSize, source + (size_t) v * (size_t) vertexSize, (size_t) vertexSize);
+            remap[v] = numUsed++;
+        }
+
+        indices[i] = (uint32) remap[v];
+    }
+
+    memcpy (vertexData, reordered, (size_t) numUsed * (size_t) vertexSize);
+    return numUsed;
+}
+
+//==============================================================================
+void compactIndices (const uint32* source, uint16* dest, int numIndices) noexcept
+{
+    for (int i = 0; i < numIndices; ++i)
+    {
+        jassert (source[i] <= 0xffff);
+        dest[i] = (uint16) source[i];
+    }
+}
+
+int8 packSigned (float value) noexcept
+{
+    return (int8) roundToInt (jlimit (-1.0f, 1.0f, value) * 127.0f);
+}
+
+uint8 packUnsigned8 (float value) noexcept
+{
+    return (uint8) roundToInt (jlimit (0.0f, 1.0f, value) * 255.0f);
+}
+
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+using namespace MeshOptimiser;
+
+class MeshOptimiserTests  : public UnitTest
+{
+public:
+    MeshOptimiserTests() : UnitTest ("MeshOptimiser") {}
+
+    /** A grid of quads, with the triangles shuffled as an exporter might leave them. */
+    static void createGrid (int size, Array<uint32>& indices, Random& r, bool shuffle)
+    {
+        indices.clearQuick();
+
+        for (int y = 0; y < size; ++y)
+        {
+            for (int x = 0; x < size; ++x)
+            {
+                const uint32 a = (uint32) (y * (size + 1) + x), b = a + 1, c = a + (uint32) size + 1, d = c + 1;
+                indices.add (a); indices.add (b); indices.add (d);
+                indices.add (a); indices.add (d); indices.add (c);
+            }
+        }
+
+        if (shuffle)
+        {
+            for (int t = indices.size() / 3; --t > 0;)
+            {
+                const int other = r.nextInt (t + 1);
+
+                for (int j = 0; j < 3; ++j)
+                    indices.swap (t * 3 + j, other * 3 + j);
+            }
+        }
+    }
+
+    /** Each triangle as a sorted-rotation key, so the sets can be compared. */
+    static void getTriangleKeys (const uint32* indices, int numIndices, const uint32* vertexIds, Array<int64>& keys)
+    {
+        keys.clearQuick();
+
+        for (int i = 0; i < numIndices; i += 3)
+        {
+            uint32 v[3] = { vertexIds[indices[i]], vertexIds[indices[i + 1]], vertexIds[indices[i + 2]] };
+
+            // rotate the smallest to the front, which keeps the winding
+            while (v[0] > v[1] || v[0] > v[2])
+            {
+                const uint32 first = v[0];
+                v[0] = v[1]; v[1] = v[2]; v[2] = first;
+            }
+
+            keys.add ((int64) v[0] << 42 | (int64) v[1] << 21 | (int64) v[2]);
+        }
+
+        DefaultElementComparator<int64> comparator;
+        keys.sort (comparator);
+    }
+
+    void runTest()
+    {
+        beginTest ("Reordering keeps every triangle");
+        {
+            Random r (getRandom());
+            Array<uint32> indices;
+            createGrid (40, indices, r, true);
+
+            const int numVertices = 41 * 41;
+            HeapBlock<uint32> vertexIds ((size_t) numVertices);
+
+            for (int i = 0; i < numVertices; ++i)
+                vertexIds[i] = (uint32) i;
+
+            Array<int64> before, after;
+            getTriangleKeys (indices.begin(), indices.size(), vertexIds, before);
+
+            optimiseVertexCache (indices.begin(), indices.size(), numVertices);
+            const int numUsed = optimiseVertexFetch (indices.begin(), indices.size(), vertexIds, numVertices, sizeof (uint32));
+
+            expectEquals (numUsed, numVertices);
+            getTriangleKeys (indices.begin(), indices.size(), vertexIds, after);
+            expect (before == after);
+
+            // vertices are now in the order they're first used
+            uint32 highest = 0;
+            bool inOrder = true;
+
+            for (int i = 0; i < indices.size(); ++i)
+            {
+                inOrder = inOrder && indices[i] <= highest + 1;
+                highest = jmax (highest, indices[i]);
+            }
+
+            expect (inOrder);
+        }
+
+        beginTest ("Cache statistics");
+        {
+            // a strip of triangles that reuse two vertices each
+            const uint32 strip[] = { 0, 1, 2,  1, 3, 2,  2, 3, 4,  3, 5, 4 };
+            const Statistics stats (analyse (strip, numElementsInArray (strip), 6, 16));
+            expectEquals (stats.numCacheMisses, 6);
+            expectEquals (stats.getACMR(), 1.5);
+            expectEquals (stats.getATVR(), 1.0);
+
+            // with a 3 entry cache, vertices 0 and 2 have been pushed out by the time the last triangle needs them
+            const uint32 fan[] = { 0, 1, 2,  0, 3, 4,  0, 5, 2 };
+            expectEquals (analyse (fan, numElementsInArray (fan), 6, 3).numCacheMisses, 8);
+        }
+
+        beginTest ("Reordering reduces cache misses");
+        {
+            Random r (getRandom());
+            Array<uint32> indices;
+            createGrid (200, indices, r, true);
+            const int numVertices = 201 * 201;
+
+            const Statistics shuffled (analyse (indices.begin(), indices.size(), numVertices));
+            createGrid (200, indices, r, false);
+            const Statistics rowByRow (analyse (indices.begin(), indices.size(), numVertices));
+
+            createGrid (200, indices, r, true);
+            const int64 start = Time::getHighResolutionTicks();
+            optimiseVertexCache (indices.begin(), indices.size(), numVertices);
+            const double ms = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start) * 1000.0;
+            const Statistics optimised (analyse (indices.begin(), indices.size(), numVertices));
+
+            expect (optimised.getACMR() < rowByRow.getACMR());
+            expect (optimised.getACMR() < 0.8);
+
+            logMessage ("Shuffled: " + getReport (shuffled, optimised) + ", in " + String (ms, 1) + " ms");
+            logMessage ("Row by row: " + getReport (rowByRow, optimised));
+        }
+
+        beginTest ("Packing");
+        {
+            expectEquals ((int) packSigned (1.0f), 127);
+            expectEquals ((int) packSigned (-2.0f), -127);
+            expectEquals ((int) packSigned (0.0f), 0);
+            expectEquals ((int) packUnsigned8 (0.5f), 128);
+            expect (canUse16BitIndices (65536));
+            expect (! canUse16BitIndices (65537));
+
+            const uint32 source[] = { 0, 65535, 12 };
+            uint16 dest[3];
+            compactIndices (source, dest, 3);
+            expectEquals ((int) dest[1], 65535);
+            expectEquals ((int) dest[2], 12);
+            expectEquals ((int) sizeof (PackedVertex), 28);
+        }
+    }
+};
+
+static MeshOptimiserTests meshOptimiserTests;
+
+#endif
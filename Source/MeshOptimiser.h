@@ -0,0 +1,90 @@
+/*
+  ==============================================================================
+
+    MeshOptimiser.h
+
+  ==============================================================================
+*/
+
+#ifndef MESHOPTIMISER_H_INCLUDED
+#define MESHOPTIMISER_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/**
+    Reorders indexed triangle lists so they draw with fewer vertex shader runs
+    and less memory traffic, and packs vertices into smaller formats.
+
+    A typical pass over a mesh is optimiseVertexCache(), then optimiseVertexFetch(),
+    then compactIndices() if the vertex count allows. Triangles are only
+    reordered, never changed, and each keeps its winding.
+*/
+namespace MeshOptimiser
+{
+    /** How well an index list uses a FIFO post-transform vertex cache. */
+    struct Statistics
+    {
+        int numTriangles, numVertices, cacheSize;
+        int numCacheMisses;
+
+        /** Average cache misses per triangle (ACMR). 0.5 is ideal for a large grid, 3 is the worst. */
+        double getACMR() const noexcept     { return numTriangles > 0 ? numCacheMisses / (double) numTriangles : 0.0; }
+
+        /** Average transforms per vertex (ATVR). 1 is ideal. */
+        double getATVR() const noexcept     { return numVertices > 0 ? numCacheMisses / (double) numVertices : 0.0; }
+
+        String toString() const;
+    };
+
+    /** Simulates a FIFO cache of the given size over the indices. */
+    Statistics analyse (const uint32* indices, int numIndices, int numVertices, int cacheSize = 16);
+
+    /** A line comparing two sets of statistics. */
+    String getReport (const Statistics& before, const Statistics& after);
+
+    //==============================================================================
+    /** Reorders the triangles in place to make good use of a vertex cache, using
+        Tom Forsyth's "Linear-Speed Vertex Cache Optimisation". This doesn't assume
+        any particular cache size, and runs in roughly linear time.
+    */
+    void optimiseVertexCache (uint32* indices, int numIndices, int numVertices);
+
+    /** Reorders the vertices into the order the indices first use them, so that
+        they're fetched from memory roughly sequentially, and updates the indices
+        to match. Any unused vertices are dropped.
+
+        Returns the new number of vertices.
+    */
+    int optimiseVertexFetch (uint32* indices, int numIndices, void* vertices, int numVertices, int vertexSize);
+
+    //==============================================================================
+    /** True if every index will fit into 16 bits. */
+    inline bool canUse16BitIndices (int numVertices) noexcept      { return numVertices <= 0x10000; }
+
+    void compactIndices (const uint32* source, uint16* dest, int numIndices) noexcept;
+
+    //==============================================================================
+    /** A 28 byte vertex, a little over half the size of four floats for each attribute.
+
+        Normals are signed bytes and colours are unsigned bytes, both read by GL as
+        normalised values. Texture coordinates stay as floats, because meshes such
+        as the teapot go outside 0..1 and rely on the texture wrapping.
+    */
+    struct PackedVertex
+    {
+        float position[3];
+        int8 normal[4];         // the fourth is padding
+        uint8 colour[4];
+        float texCoord[2];
+    };
+
+    /** Packs a component in the range -1..1 into a signed byte. */
+    int8 packSigned (float value) noexcept;
+
+    /** Packs a component in the range 0..1 into an unsigned byte. */
+    uint8 packUnsigned8 (float value) noexcept;
+}
+
+
+#endif  // MESHOPTIMISER_H_INCLUDED
@@ -23,9 +23,16 @@
   ==============================================================================
 */
 
-#include "DAQMXclass.h"
 #include "JuceDemoHeader.h"
+#include "HapticsOutput.h"
+#include "HapticRegionMap.h"
+#include "LeapFrameLog.h"
+#include "LatencyTrace.h"
 #include "WavefrontObjParser.h"
+#include "CachedMesh.h"
+#include "AssetStreamer.h"
+#include "MeshOptimiser.h"
+#include "CameraFrames.h"
 #include "Leap.h"
 #include "LeapUtil.h"
 #include "LeapUtilGL.h"
@@ -86,6 +93,36 @@ struct OpenGLDemoClasses
             }
         }
 
+        /** The same attributes for vertices in the MeshOptimiser::PackedVertex layout. */
+        void enablePacked (OpenGLContext& openGLContext)
+        {
+            typedef MeshOptimiser::PackedVertex PackedVertex;
+
+            if (position != nullptr)
+            {
+                openGLContext.extensions.glVertexAttribPointer (position->attributeID, 3, GL_FLOAT, GL_FALSE, sizeof (PackedVertex), 0);
+                openGLContext.extensions.glEnableVertexAttribArray (position->attributeID);
+            }
+
+            if (normal != nullptr)
+            {
+                openGLContext.extensions.glVertexAttribPointer (normal->attributeID, 3, GL_BYTE, GL_TRUE, sizeof (PackedVertex), (GLvoid*) offsetof (PackedVertex, normal));
+                openGLContext.extensions.glEnableVertexAttribArray (normal->attributeID);
+            }
+
+            if (sourceColour != nullptr)
+            {
+                openGLContext.extensions.glVertexAttribPointer (sourceColour->attributeID, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof (PackedVertex), (GLvoid*) offsetof (PackedVertex, colour));
+                openGLContext.extensions.glEnableVertexAttribArray (sourceColour->attributeID);
+            }
+
+            if (texureCoordIn != nullptr)
+            {
+                openGLContext.extensions.glVertexAttribPointer (texureCoordIn->attributeID, 2, GL_FLOAT, GL_FALSE, sizeof (PackedVertex), (GLvoid*) offsetof (PackedVertex, texCoord));
+                openGLContext.extensions.glEnableVertexAttribArray (texureCoordIn->attributeID);
+            }
+        }
+
         void disable (OpenGLContext& openGLContext)
         {
             if (position != nullptr)       openGLContext.extensions.glDisableVertexAttribArray (position->attributeID);
@@ -136,111 +173,348 @@ struct OpenGLDemoClasses
     };
 
     //==============================================================================
-    /** This loads a 3D model from an OBJ file and converts it into some vertex buffers
-        that we can draw.
+    /** This draws a 3D model that's loaded from an OBJ file by an AssetStreamer.
+
+        The converted vertices are kept in a CachedMesh, so after the first run the
+        buffers are filled straight from the memory-mapped cache file. Nothing is
+        drawn until the mesh has finished uploading.
+
+        The cached mesh is run through MeshOptimiser when it's built, so its
+        vertices are packed into 28 bytes and its indices are usually 16 bits.
     */
     struct Shape
     {
-        Shape (OpenGLContext& openGLContext)
-        {
-            if (shapeFile.load (BinaryData::teapot_obj).wasOk())
-                for (int i = 0; i < shapeFile.shapes.size(); ++i)
-                    vertexBuffers.add (new VertexBuffer (openGLContext, *shapeFile.shapes.getUnchecked(i)));
+        Shape (StreamedMesh* m) : mesh (m) {}
 
+        /** Creates the teapot, which needs adding to a streamer to load it. */
+        static StreamedMesh* createTeapot()
+        {
+            return new StreamedMesh (BinaryData::teapot_obj, (size_t) BinaryData::teapot_objSize, "teapot", new ShapeVertexBuilder());
         }
 
         void draw (OpenGLContext& openGLContext, Attributes& attributes)
         {
-            for (int i = 0; i < vertexBuffers.size(); ++i)
+            if (mesh == nullptr || ! mesh->isReady())
+                return;
+
+            for (int i = 0; i < mesh->getNumParts(); ++i)
             {
-                VertexBuffer& vertexBuffer = *vertexBuffers.getUnchecked (i);
-                vertexBuffer.bind();
+                mesh->bind (openGLContext, i);
 
-                attributes.enable (openGLContext);
-                glDrawElements (GL_TRIANGLES, vertexBuffer.numIndices, GL_UNSIGNED_INT, 0);
+                attributes.enablePacked (openGLContext);
+                glDrawElements (GL_TRIANGLES, mesh->getNumIndices (i), mesh->getIndexType (i), 0);
                 attributes.disable (openGLContext);
             }
         }
 
     private:
-        struct VertexBuffer
+        // Packs a mesh into the PackedVertex layout. Bump the format id whenever
+        // this changes, so that any cached meshes get rebuilt.
+        struct ShapeVertexBuilder  : public CachedMesh::VertexBuilder
         {
-            VertexBuffer (OpenGLContext& context, WavefrontObjFile::Shape& shape) : openGLContext (context)
+            uint32 getFormatId() const override     { return 3; }
+            int getVertexSize() const override      { return (int) sizeof (MeshOptimiser::PackedVertex); }
+            bool shouldOptimise() const override    { return true; }
+
+            void buildVertices (const WavefrontObjFile::Mesh& m, void* dest) override
             {
-                numIndices = shape.mesh.indices.size();
+                createVertexListFromMesh (m, static_cast<MeshOptimiser::PackedVertex*> (dest), Colours::green);
+            }
+        };
 
-                openGLContext.extensions.glGenBuffers (1, &vertexBuffer);
-                openGLContext.extensions.glBindBuffer (GL_ARRAY_BUFFER, vertexBuffer);
+        StreamedMesh::Ptr mesh;
+
+        static void createVertexListFromMesh (const WavefrontObjFile::Mesh& mesh, MeshOptimiser::PackedVertex* list, Colour colour)
+        {
+            const float scale = 0.2f;
+            WavefrontObjFile::TextureCoord defaultTexCoord = { 0.5f, 0.5f };
+            WavefrontObjFile::Vertex defaultNormal = { 0.5f, 0.5f, 0.5f };
+
+            for (int i = 0; i < mesh.vertices.size(); ++i)
+            {
+                const WavefrontObjFile::Vertex& v = mesh.vertices.getReference (i);
+
+                const WavefrontObjFile::Vertex& n
+                        = i < mesh.normals.size() ? mesh.normals.getReference (i) : defaultNormal;
+
+                const WavefrontObjFile::TextureCoord& tc
+                        = i < mesh.textureCoords.size() ? mesh.textureCoords.getReference (i) : defaultTexCoord;
+
+                using namespace MeshOptimiser;
+
+                PackedVertex vert =
+                {
+                    { scale * v.x, scale * v.y, scale * v.z, },
+                    { packSigned (scale * n.x), packSigned (scale * n.y), packSigned (scale * n.z), 0 },
+                    { colour.getRed(), colour.getGreen(), colour.getBlue(), colour.getAlpha() },
+                    { tc.x, tc.y }
+                };
 
-                Array<Vertex> vertices;
-                createVertexListFromMesh (shape.mesh, vertices, Colours::green);
+                list[i] = vert;
+            }
+        }
+    };
 
-                openGLContext.extensions.glBufferData (GL_ARRAY_BUFFER, vertices.size() * sizeof (Vertex),
-                                                       vertices.getRawDataPointer(), GL_STATIC_DRAW);
+    //==============================================================================
+    /** Draws the tracked hands - bone lines, palm outlines and fingertip spheres - from
+        a single dynamic vertex buffer.
+
+        Everything for a frame is collected on the CPU with the add methods, then draw()
+        orphans and refills one vertex and one index buffer and submits all the triangles
+        with one glDrawElements and all the lines with one glDrawArrays, however many
+        hands and fingers there are. It uses the same Vertex layout, Attributes and
+        Uniforms as the shader demo, with its own flat-colour program.
+    */
+    struct HandBatchRenderer
+    {
+        HandBatchRenderer (OpenGLContext& context)
+            : openGLContext (context), vertexBuffer (0), indexBuffer (0),
+              vertexBufferSize (0), indexBufferSize (0), numDrawCalls (0)
+        {
+            ScopedPointer<OpenGLShaderProgram> newShader (new OpenGLShaderProgram (openGLContext));
+
+            if (newShader->addVertexShader ("attribute vec4 position;\n"
+                                            "attribute vec4 sourceColour;\n"
+                                            "\n"
+                                            "uniform mat4 projectionMatrix;\n"
+                                            "uniform mat4 viewMatrix;\n"
+                                            "\n"
+                                            "varying vec4 destinationColour;\n"
+                                            "\n"
+                                            "void main (void)\n"
+                                            "{\n"
+                                            "    destinationColour = sourceColour;\n"
+                                            "    gl_Position = projectionMatrix * viewMatrix * position;\n"
+                                            "}\n")
+                  && newShader->addFragmentShader (
+                                           #if JUCE_OPENGL_ES
+                                            "varying lowp vec4 destinationColour;\n"
+                                           #else
+                                            "varying vec4 destinationColour;\n"
+                                           #endif
+                                            "\n"
+                                            "void main (void)\n"
+                                            "{\n"
+                                            "    gl_FragColor = destinationColour;\n"
+                                            "}\n")
+                  && newShader->link())
+            {
+                shader     = newShader;
+                attributes = new Attributes (openGLContext, *shader);
+                uniforms   = new Uniforms (openGLContext, *shader);
 
+                openGLContext.extensions.glGenBuffers (1, &vertexBuffer);
                 openGLContext.extensions.glGenBuffers (1, &indexBuffer);
-                openGLContext.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-                openGLContext.extensions.glBufferData (GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof (juce::uint32),
-                                                       shape.mesh.indices.getRawDataPointer(), GL_STATIC_DRAW);
             }
+            else
+            {
+                DBG ("HandBatchRenderer: " + newShader->getLastError());
+            }
+
+            createSphereTemplate (12, 8);
+        }
 
-            ~VertexBuffer()
+        ~HandBatchRenderer()
+        {
+            if (vertexBuffer != 0)
             {
                 openGLContext.extensions.glDeleteBuffers (1, &vertexBuffer);
                 openGLContext.extensions.glDeleteBuffers (1, &indexBuffer);
             }
+        }
+
+        /** False if the shader couldn't be built, in which case draw() does nothing. */
+        bool isValid() const noexcept       { return shader != nullptr; }
 
-            void bind()
+        /** Draw calls issued by the last draw() - never more than two. */
+        int getNumDrawCalls() const noexcept    { return numDrawCalls; }
+
+        void clear()
+        {
+            triangleVertices.clearQuick();
+            triangleIndices.clearQuick();
+            lineVertices.clearQuick();
+        }
+
+        void addLine (const Leap::Vector& start, const Leap::Vector& end, Colour colour)
+        {
+            lineVertices.add (makeVertex (start, Leap::Vector::zAxis(), colour));
+            lineVertices.add (makeVertex (end, Leap::Vector::zAxis(), colour));
+        }
+
+        /** Adds the outline of a circle lying in the plane whose normal is given. */
+        void addCircle (const Leap::Vector& centre, const Leap::Vector& normal, float radius, Colour colour)
+        {
+            const int numSegments = 32;
+
+            const Leap::Vector n (normal.normalized());
+            const Leap::Vector u ((std::abs (n.x) < 0.9f ? Leap::Vector::xAxis() : Leap::Vector::yAxis()).cross (n).normalized());
+            const Leap::Vector v (n.cross (u));
+
+            Leap::Vector previous (centre + u * radius);
+
+            for (int i = 1; i <= numSegments; ++i)
             {
-                openGLContext.extensions.glBindBuffer (GL_ARRAY_BUFFER, vertexBuffer);
-                openGLContext.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+                const float angle = LeapUtil::kf2Pi * i / (float) numSegments;
+                const Leap::Vector next (centre + (u * std::cos (angle) + v * std::sin (angle)) * radius);
+
+                addLine (previous, next, colour);
+                previous = next;
             }
+        }
 
-            GLuint vertexBuffer, indexBuffer;
-            int numIndices;
-            OpenGLContext& openGLContext;
+        void addSphere (const Leap::Vector& centre, float radius, Colour colour)
+        {
+            const int baseIndex = triangleVertices.size();
 
-            JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VertexBuffer)
-        };
+            for (int i = 0; i < spherePoints.size(); ++i)
+            {
+                const Leap::Vector& p = spherePoints.getReference (i);
+                triangleVertices.add (makeVertex (centre + p * radius, p, colour));
+            }
 
-        WavefrontObjFile shapeFile;
-        OwnedArray<VertexBuffer> vertexBuffers;
+            for (int i = 0; i < sphereIndices.size(); ++i)
+                triangleIndices.add ((juce::uint32) (baseIndex + sphereIndices.getUnchecked (i)));
+        }
 
-        static void createVertexListFromMesh (const WavefrontObjFile::Mesh& mesh, Array<Vertex>& list, Colour colour)
+        /** Uploads everything added since the last clear() and draws it using the current
+            fixed-function projection and modelview matrices.
+        */
+        void draw()
         {
-            const float scale = 0.2f;
-            WavefrontObjFile::TextureCoord defaultTexCoord = { 0.5f, 0.5f };
-            WavefrontObjFile::Vertex defaultNormal = { 0.5f, 0.5f, 0.5f };
+            numDrawCalls = 0;
 
-            for (int i = 0; i < mesh.vertices.size(); ++i)
+            if (shader == nullptr || (triangleVertices.size() == 0 && lineVertices.size() == 0))
+                return;
+
+            const int numTriangleVertices = triangleVertices.size();
+            const GLsizeiptr triangleBytes = (GLsizeiptr) (numTriangleVertices * sizeof (Vertex));
+            const GLsizeiptr lineBytes     = (GLsizeiptr) (lineVertices.size() * sizeof (Vertex));
+            const GLsizeiptr indexBytes    = (GLsizeiptr) (triangleIndices.size() * sizeof (juce::uint32));
+
+            // Orphan last frame's storage rather than overwrite it, so the driver can hand
+            // us a fresh block instead of waiting for the GPU to finish with the old one.
+            openGLContext.extensions.glBindBuffer (GL_ARRAY_BUFFER, vertexBuffer);
+            vertexBufferSize = jmax (vertexBufferSize, triangleBytes + lineBytes);
+            openGLContext.extensions.glBufferData (GL_ARRAY_BUFFER, vertexBufferSize, nullptr, GL_STREAM_DRAW);
+            openGLContext.extensions.glBufferSubData (GL_ARRAY_BUFFER, 0, triangleBytes, triangleVertices.getRawDataPointer());
+            openGLContext.extensions.glBufferSubData (GL_ARRAY_BUFFER, triangleBytes, lineBytes, lineVertices.getRawDataPointer());
+
+            openGLContext.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+            indexBufferSize = jmax (indexBufferSize, indexBytes);
+            openGLContext.extensions.glBufferData (GL_ELEMENT_ARRAY_BUFFER, indexBufferSize, nullptr, GL_STREAM_DRAW);
+            openGLContext.extensions.glBufferSubData (GL_ELEMENT_ARRAY_BUFFER, 0, indexBytes, triangleIndices.getRawDataPointer());
+
+            shader->use();
+
+            GLfloat matrix[16];
+
+            if (uniforms->projectionMatrix != nullptr)
             {
-                const WavefrontObjFile::Vertex& v = mesh.vertices.getReference (i);
+                glGetFloatv (GL_PROJECTION_MATRIX, matrix);
+                uniforms->projectionMatrix->setMatrix4 (matrix, 1, false);
+            }
 
-                const WavefrontObjFile::Vertex& n
-                        = i < mesh.normals.size() ? mesh.normals.getReference (i) : defaultNormal;
+            if (uniforms->viewMatrix != nullptr)
+            {
+                glGetFloatv (GL_MODELVIEW_MATRIX, matrix);
+                uniforms->viewMatrix->setMatrix4 (matrix, 1, false);
+            }
 
-                const WavefrontObjFile::TextureCoord& tc
-                        = i < mesh.textureCoords.size() ? mesh.textureCoords.getReference (i) : defaultTexCoord;
+            attributes->enable (openGLContext);
+
+            if (triangleIndices.size() > 0)
+            {
+                glDrawElements (GL_TRIANGLES, triangleIndices.size(), GL_UNSIGNED_INT, 0);
+                ++numDrawCalls;
+            }
+
+            if (lineVertices.size() > 0)
+            {
+                glDrawArrays (GL_LINES, numTriangleVertices, lineVertices.size());
+                ++numDrawCalls;
+            }
+
+            attributes->disable (openGLContext);
+            openGLContext.extensions.glUseProgram (0);
+
+            openGLContext.extensions.glBindBuffer (GL_ARRAY_BUFFER, 0);
+            openGLContext.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+        }
+
+    private:
+        OpenGLContext& openGLContext;
+        ScopedPointer<OpenGLShaderProgram> shader;
+        ScopedPointer<Attributes> attributes;
+        ScopedPointer<Uniforms> uniforms;
+
+        GLuint vertexBuffer, indexBuffer;
+        GLsizeiptr vertexBufferSize, indexBufferSize;
+        int numDrawCalls;
+
+        Array<Vertex> triangleVertices, lineVertices;
+        Array<juce::uint32> triangleIndices;
 
-                Vertex vert =
+        Array<Leap::Vector> spherePoints;   // unit sphere, so each point is also its normal
+        Array<int> sphereIndices;
+
+        static Vertex makeVertex (const Leap::Vector& p, const Leap::Vector& n, Colour colour) noexcept
+        {
+            Vertex v =
+            {
+                { p.x, p.y, p.z },
+                { n.x, n.y, n.z },
+                { colour.getFloatRed(), colour.getFloatGreen(), colour.getFloatBlue(), colour.getFloatAlpha() },
+                { 0.5f, 0.5f }
+            };
+
+            return v;
+        }
+
+        void createSphereTemplate (const int numSlices, const int numStacks)
+        {
+            for (int i = 0; i <= numStacks; ++i)
+            {
+                const float phi = LeapUtil::kfPi * i / (float) numStacks;
+
+                for (int j = 0; j <= numSlices; ++j)
                 {
-                    { scale * v.x, scale * v.y, scale * v.z, },
-                    { scale * n.x, scale * n.y, scale * n.z, },
-                    { colour.getFloatRed(), colour.getFloatGreen(), colour.getFloatBlue(), colour.getFloatAlpha() },
-                    { tc.x, tc.y }
-                };
+                    const float theta = LeapUtil::kf2Pi * j / (float) numSlices;
+                    spherePoints.add (Leap::Vector (std::sin (phi) * std::cos (theta),
+                                                    std::sin (phi) * std::sin (theta),
+                                                    std::cos (phi)));
+                }
+            }
+
+            for (int i = 0; i < numStacks; ++i)
+            {
+                for (int j = 0; j < numSlices; ++j)
+                {
+                    const int a = i * (numSlices + 1) + j;
+                    const int b = a + numSlices + 1;
 
-                list.add (vert);
+                    sphereIndices.add (a);      sphereIndices.add (b);      sphereIndices.add (a + 1);
+                    sphereIndices.add (a + 1);  sphereIndices.add (b);      sphereIndices.add (b + 1);
+                }
             }
         }
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (HandBatchRenderer)
     };
 
     //==============================================================================
-    // These classes are used to load textures from the various sources that the demo uses..
+    // These classes are used to load textures from the various sources that the demo uses.
+    // The images are decoded and uploaded through the AssetStreamer, so choosing one
+    // never stalls the GL thread.
     struct DemoTexture
     {
         virtual ~DemoTexture() {}
-        virtual bool applyTo (OpenGLTexture&) = 0;
+
+        /** Returns the texture, adding it to the streamer the first time. */
+        virtual StreamedTexture* getTexture (AssetStreamer&) = 0;
+
+        /** Called on the GL thread before each frame that uses the texture. */
+        virtual void update() {}
 
         String name;
     };
@@ -251,8 +525,21 @@ struct OpenGLDemoClasses
 
         Image image;
         BouncingNumber x, y;
+        StreamedTexture::Ptr texture;
 
-        bool applyTo (OpenGLTexture& texture) override
+        StreamedTexture* getTexture (AssetStreamer& streamer) override
+        {
+            if (texture == nullptr)
+            {
+                texture = new StreamedTexture();
+                update();
+                streamer.add (texture);
+            }
+
+            return texture;
+        }
+
+        void update() override
         {
             const int size = 128;
 
@@ -274,54 +561,51 @@ struct OpenGLDemoClasses
                 g.drawFittedText (String (Time::getCurrentTime().getMilliseconds()), image.getBounds(), Justification::centred, 1);
             }
 
-            texture.loadImage (image);
-            return true;
+            if (texture != nullptr)
+                texture->setImage (image);
         }
     };
 
     struct BuiltInTexture   : public DemoTexture
     {
-        BuiltInTexture (const char* nm, const void* imageData, int imageSize)
-            : image (resizeImageToPowerOfTwo (ImageFileFormat::loadFrom (imageData, imageSize)))
+        BuiltInTexture (const char* nm, const void* data, int size)
+            : imageData (data), imageSize (size)
         {
             name = nm;
         }
 
-        Image image;
+        const void* imageData;
+        int imageSize;
+        StreamedTexture::Ptr texture;
 
-        bool applyTo (OpenGLTexture& texture) override
+        StreamedTexture* getTexture (AssetStreamer& streamer) override
         {
-            texture.loadImage (image);
-            return false;
+            if (texture == nullptr)
+                streamer.add (texture = new StreamedTexture (imageData, (size_t) imageSize));
+
+            return texture;
         }
     };
 
     struct TextureFromFile   : public DemoTexture
     {
-        TextureFromFile (const File& file)
+        TextureFromFile (const File& f) : file (f)
         {
             name = file.getFileName();
-            image = resizeImageToPowerOfTwo (ImageFileFormat::loadFrom (file));
         }
 
-        Image image;
+        File file;
+        StreamedTexture::Ptr texture;
 
-        bool applyTo (OpenGLTexture& texture) override
+        StreamedTexture* getTexture (AssetStreamer& streamer) override
         {
-            texture.loadImage (image);
-            return false;
+            if (texture == nullptr)
+                streamer.add (texture = new StreamedTexture (file));
+
+            return texture;
         }
     };
 
-    static Image resizeImageToPowerOfTwo (Image image)
-    {
-        if (! (isPowerOfTwo (image.getWidth()) && isPowerOfTwo (image.getHeight())))
-            return image.rescaled (jmin (1024, nextPowerOfTwo (image.getWidth())),
-                                   jmin (1024, nextPowerOfTwo (image.getHeight())));
-
-        return image;
-    }
-
     class OpenGLDemo;
 
     //==============================================================================
@@ -342,7 +626,12 @@ struct OpenGLDemoClasses
               vertexEditorComp (vertexDocument, nullptr),
               fragmentEditorComp (fragmentDocument, nullptr),
               tabbedComp (TabbedButtonBar::TabsAtLeft),
-              showBackgroundToggle ("Draw 2D graphics in background")
+              showBackgroundToggle ("Draw 2D graphics in background"),
+              compareRenderersToggle ("Compare hand renderers"),
+              recordToggle ("Record Leap frames"),
+              predictToggle ("Predict fingertips"),
+              replayButton ("Replay frames..."),
+              traceButton ("Save latency trace")
         {
             addAndMakeVisible (statusLabel);
             statusLabel.setJustificationType (Justification::topLeft);
@@ -369,6 +658,31 @@ struct OpenGLDemoClasses
             addAndMakeVisible (showBackgroundToggle);
             showBackgroundToggle.addListener (this);
 
+            addAndMakeVisible (compareRenderersToggle);
+            compareRenderersToggle.addListener (this);
+
+            addAndMakeVisible (recordToggle);
+            recordToggle.addListener (this);
+
+            addAndMakeVisible (replayButton);
+            replayButton.addListener (this);
+
+            addAndMakeVisible (traceButton);
+            traceButton.addListener (this);
+
+            addAndMakeVisible (predictToggle);
+            predictToggle.addListener (this);
+
+            addAndMakeVisible (replaySpeedBox);
+            replaySpeedBox.addItem ("Original speed", 1);
+            replaySpeedBox.addItem ("4x speed", 2);
+            replaySpeedBox.addItem ("Maximum speed", 3);
+
+            addAndMakeVisible (timingLabel);
+            timingLabel.setJustificationType (Justification::topLeft);
+            timingLabel.setColour (Label::textColourId, Colours::black);
+            timingLabel.setFont (Font (14.0f));
+
             Colour editorBackground (Colours::white.withAlpha (0.6f));
 
             addAndMakeVisible (tabbedComp);
@@ -412,6 +726,8 @@ struct OpenGLDemoClasses
         void initialise()
         {
             showBackgroundToggle.setToggleState (false, sendNotification);
+            compareRenderersToggle.setToggleState (false, sendNotification);
+            replaySpeedBox.setSelectedId (1);
             textureBox.setSelectedItemIndex (0);
             presetBox.setSelectedItemIndex (0);
             speedSlider.setValue (0.01);
@@ -422,14 +738,23 @@ struct OpenGLDemoClasses
         {
             juce::Rectangle<int> area (getLocalBounds().reduced (4));
 
-            juce::Rectangle<int> top (area.removeFromTop (75));
+            juce::Rectangle<int> top (area.removeFromTop (125));
 
             juce::Rectangle<int> sliders (top.removeFromRight (area.getWidth() / 2));
+            juce::Rectangle<int> replayRow (sliders.removeFromBottom (25));
+            replayButton.setBounds (replayRow.removeFromLeft (replayRow.getWidth() / 2).reduced (0, 1));
+            replaySpeedBox.setBounds (replayRow.reduced (4, 1));
+            recordToggle.setBounds (sliders.removeFromBottom (25));
             showBackgroundToggle.setBounds (sliders.removeFromBottom (25));
             speedSlider.setBounds (sliders.removeFromBottom (25));
             //sizeSlider.setBounds (sliders.removeFromBottom (25));
+            compareRenderersToggle.setBounds (sliders.removeFromBottom (25));
 
             top.removeFromRight (70);
+            juce::Rectangle<int> traceRow (top.removeFromBottom (25));
+            traceButton.setBounds (traceRow.removeFromLeft (160).reduced (0, 1));
+            predictToggle.setBounds (traceRow.reduced (8, 0));
+            timingLabel.setBounds (top.removeFromBottom (25));
             statusLabel.setBounds (top);
 
             juce::Rectangle<int> shaderArea (area.removeFromBottom (area.getHeight() / 8));
@@ -517,7 +842,13 @@ struct OpenGLDemoClasses
            #endif
         }
 
-        Label statusLabel;
+        /** Shows whether a replay is running. */
+        void setReplaying (bool isReplaying)
+        {
+            replayButton.setButtonText (isReplaying ? "Stop replay" : "Replay frames...");
+        }
+
+        Label statusLabel, timingLabel;
 
     private:
         void sliderValueChanged (Slider*) override
@@ -526,9 +857,39 @@ struct OpenGLDemoClasses
             demo.rotationSpeed = (float) speedSlider.getValue();
         }
 
-        void buttonClicked (Button*)
+        void buttonClicked (Button* button)
         {
+            if (button == &recordToggle)
+                demo.setRecording (recordToggle.getToggleState());
+            else if (button == &replayButton)
+                chooseReplay();
+            else if (button == &traceButton)
+                statusLabel.setText (demo.saveLatencyTrace(), dontSendNotification);
+            else if (button == &predictToggle)
+                statusLabel.setText (demo.setPredictingFingertips (predictToggle.getToggleState()), dontSendNotification);
+
             demo.doBackgroundDrawing = showBackgroundToggle.getToggleState();
+            demo.compareHandRenderers = compareRenderersToggle.getToggleState();
+        }
+
+        void chooseReplay()
+        {
+            if (demo.isReplaying())
+            {
+                demo.stopReplay();
+                return;
+            }
+
+           #if JUCE_MODAL_LOOPS_PERMITTED
+            FileChooser fc ("Choose a recording to replay...",
+                            File::getSpecialLocation (File::userDocumentsDirectory), "*.leapframes");
+
+            if (fc.browseForFileToOpen())
+            {
+                const double speeds[] = { 1.0, 4.0, 0.0 };
+                demo.startReplay (fc.getResult(), speeds [jlimit (0, 2, replaySpeedBox.getSelectedId() - 1)]);
+            }
+           #endif
         }
 
         enum { shaderLinkDelay = 500 };
@@ -567,10 +928,11 @@ struct OpenGLDemoClasses
         CodeEditorComponent vertexEditorComp, fragmentEditorComp;
         TabbedComponent tabbedComp;
 
-        ComboBox presetBox, textureBox;
+        ComboBox presetBox, textureBox, replaySpeedBox;
         Label presetLabel, textureLabel;
 
-        ToggleButton showBackgroundToggle;
+        ToggleButton showBackgroundToggle, compareRenderersToggle, recordToggle, predictToggle;
+        TextButton replayButton, traceButton;
 
         OwnedArray<DemoTexture> textures;
 
@@ -584,12 +946,15 @@ struct OpenGLDemoClasses
     */
     class OpenGLDemo  : public Component,
                         private OpenGLRenderer,
+                        private HighResolutionTimer,
+                        private AsyncUpdater,
+                        private LeapFrameReplayer::Listener,
 						Leap::Listener,
 						CameraDevice::Listener
     {
     public:
         OpenGLDemo()
-            : doBackgroundDrawing (false),
+            : doBackgroundDrawing (false), compareHandRenderers (false),
               scale (0.5f), rotationSpeed (0.0f), rotation (0.0f),
               textureToUse (nullptr)
         {
@@ -604,6 +969,9 @@ struct OpenGLDemoClasses
 
             controlsOverlay->initialise();
 
+            // start loading the teapot straight away, so it's ready by the time it's needed
+            assetStreamer.add (teapot = Shape::createTeapot());
+
 			OpenGLDemoClasses::getController().addListener( *this );
 			initColors();
 			resetCamera();
@@ -611,7 +979,14 @@ struct OpenGLDemoClasses
 			m_fFrameScale = 0.005f;
 			m_mtxFrameTransform.origin = Leap::Vector( 0.0f, -1.0f, 0.125f );
 			m_fPointableRadius = 0.025f;
-			SP = new DAQMX("Dev1/port3/line0:7");
+			m_iNumComparedFrames = 0;
+			m_isReplaying = 0;
+			m_predictFingertips = 0;
+			m_hapticRegions.addFourBarLayout();
+			m_hapticRegions.build();
+			const HapticsOutput::LineGroup hapticLines[] = { { "Dev1/port3/line0:7", 8 } };
+			haptics = new HapticsOutput (hapticLines, numElementsInArray (hapticLines));
+			HighResolutionTimer::startTimer (2);
 			StringArray camDevList = CameraDevice::getAvailableDevices();
 			camDevPtr = CameraDevice::openDevice(0);
 			if ( camDevPtr != nullptr)
@@ -623,12 +998,14 @@ struct OpenGLDemoClasses
         ~OpenGLDemo()
         {
 			OpenGLDemoClasses::getController().removeListener( *this );
-
-			unsigned char tmp[8] = {0,0,0,0,0,0,0,0};
-			SP->writePWM(tmp);
-			delete SP;
+			setRecording( false );
+			stopReplay();
+			HighResolutionTimer::stopTimer();
 
             openGLContext.detach();
+            cancelPendingUpdate();
+
+			haptics = nullptr;
 			
 			OpenGLDemoClasses::getController().removeListener( *this );
 			
@@ -654,7 +1031,11 @@ struct OpenGLDemoClasses
             shader = nullptr;
             attributes = nullptr;
             uniforms = nullptr;
-            texture.release();
+            currentTexture = nullptr;
+            handRenderer = nullptr;
+            assetStreamer.releaseGLResources (openGLContext);
+            m_cameraTexture.releaseGLResources (openGLContext);
+            LeapUtilGL::MeshCache::ReleaseForCurrentContext();
         }
 
         // This is a virtual method in OpenGLRenderer, and is called when it's time
@@ -666,13 +1047,29 @@ struct OpenGLDemoClasses
             const float desktopScale = (float) openGLContext.getRenderingScale();
             OpenGLHelpers::clear (Colours::lightblue);
 
-            if (textureToUse != nullptr)
-                if (! textureToUse->applyTo (texture))
-                    textureToUse = nullptr;
+            // Upload whatever has finished loading, up to the streamer's budget for a frame
+            assetStreamer.processUploads (openGLContext);
+
+            if (DemoTexture* t = textureToUse)
+            {
+                t->update();
+
+                // keep drawing with the old texture until the new one is all there
+                StreamedTexture* newTexture = t->getTexture (assetStreamer);
+
+                if (newTexture->isReady())
+                    currentTexture = newTexture;
+            }
 
             // First draw our background graphics to demonstrate the OpenGLGraphicsContext class
             if (doBackgroundDrawing)
+            {
+                // camera frames are only uploaded when they're going to be drawn
+                if (const CameraFramePool::Frame* frame = m_cameraFrames.read())
+                    m_cameraTexture.upload (openGLContext, *frame);
+
                 drawBackground2DStuff (desktopScale);
+            }
 
             // Having used the juce 2D renderer, it will have messed-up a whole load of GL state, so
             // we need to initialise some important settings before doing our normal GL 3D drawing..
@@ -686,9 +1083,22 @@ struct OpenGLDemoClasses
 			LeapUtilGL::GLMatrixScope sceneMatrixScope;
 			setupScene();
 
-			// Draw the Leap frame
-			Leap::Frame frame = m_lastFrame;
-			drawLeapFrame(frame);
+			// Draw the newest Leap frame, or the previous one again if nothing new has arrived
+			const bool isNewFrame = m_frameExchange.Read( kRenderConsumer, m_lastFrame );
+
+			if (isNewFrame)
+			{
+				LatencyTrace::getGlobal().record( LatencyTrace::renderStarted, m_lastFrame.id );
+				updatePredictor( m_renderPredictor, m_lastFrame, m_renderLeadMicros.get() );
+			}
+
+			if (handRenderer == nullptr)
+				handRenderer = new HandBatchRenderer (openGLContext);
+
+			drawHands( m_lastFrame );
+
+			if (isNewFrame)
+				LatencyTrace::getGlobal().record( LatencyTrace::handsDrawn, m_lastFrame.id );
 
 			/*
 			updateShader();   // Check whether we need to compile a new shader
@@ -698,7 +1108,8 @@ struct OpenGLDemoClasses
 
             glViewport (0, 0, roundToInt (desktopScale * getWidth()), roundToInt (desktopScale * getHeight()));
 
-            texture.bind();
+            if (currentTexture != nullptr)
+                currentTexture->bind();
 
             glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
             glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -828,48 +1239,250 @@ struct OpenGLDemoClasses
 
 		void onFrame(const Leap::Controller& controller) override
 		{
-			Leap::Frame frame = controller.frame();
-			m_lastFrame = frame;
+			// live frames are ignored while a recording is being replayed in their place
+			if (m_isReplaying.get() != 0)
+				return;
+
+			const int64 arrivalTicks = Time::getHighResolutionTicks();
+			m_liveFrame.setFrom( controller.frame() );
+
+			LatencyTrace& trace = LatencyTrace::getGlobal();
+			trace.recordAt( LatencyTrace::frameCaptured, m_liveFrame.id, trace.estimateCaptureTicks( m_liveFrame.timestamp, arrivalTicks ) );
+			trace.recordAt( LatencyTrace::frameArrived, m_liveFrame.id, arrivalTicks );
+
+			m_frameExchange.Publish( m_liveFrame );
+			openGLContext.triggerRepaint();
+		}
+
+		void frameReplayed( const TrackedFrame& frame ) override
+		{
+			LatencyTrace::getGlobal().record( LatencyTrace::frameArrived, frame.id );
+			m_frameExchange.Publish( frame );
 			openGLContext.triggerRepaint();
 		}
 
+		void replayFinished() override
+		{
+			m_isReplaying = 0;
+			triggerAsyncUpdate();
+		}
+
+		/// records the controller's frames to a new file in the user's documents folder
+		void setRecording( bool shouldRecord )
+		{
+			if (m_recorder != nullptr)
+			{
+				OpenGLDemoClasses::getController().removeListener( *m_recorder );
+				m_recorder = nullptr;
+			}
+
+			if (shouldRecord)
+			{
+				const File file( File::getSpecialLocation( File::userDocumentsDirectory )
+									.getNonexistentChildFile( "LeapFrames " + Time::getCurrentTime().formatted( "%Y-%m-%d %H-%M-%S" ), ".leapframes" ) );
+
+				m_recorder = new LeapFrameRecorder( file );
+
+				if (m_recorder->openedOk())
+					OpenGLDemoClasses::getController().addListener( *m_recorder );
+				else
+					m_recorder = nullptr;
+			}
+		}
+
+		/// feeds a recording through the same path as live frames. speed is a multiple of
+		/// the recorded rate, or 0 to replay as fast as possible.
+		void startReplay( const File& file, double speed )
+		{
+			stopReplay();
+
+			m_replayer = new LeapFrameReplayer( file, *this );
+
+			if (m_replayer->isValid())
+			{
+				m_isReplaying = 1;
+				m_replayer->start( speed, false );
+			}
+			else
+			{
+				m_replayer = nullptr;
+			}
+
+			controlsOverlay->setReplaying( isReplaying() );
+		}
+
+		void stopReplay()
+		{
+			if (m_replayer != nullptr)
+				m_replayer->stop();
+
+			m_replayer = nullptr;
+			m_isReplaying = 0;
+
+			if (controlsOverlay != nullptr)
+				controlsOverlay->setReplaying( false );
+		}
+
+		bool isReplaying() const
+		{
+			return m_isReplaying.get() != 0;
+		}
+
+		/// writes the latency trace so far as Chrome trace JSON to the user's documents folder
+		/// and returns a summary of it
+		String saveLatencyTrace()
+		{
+			const LatencyTrace& trace = LatencyTrace::getGlobal();
+			const File file( File::getSpecialLocation( File::userDocumentsDirectory )
+								.getNonexistentChildFile( "Latency trace " + Time::getCurrentTime().formatted( "%Y-%m-%d %H-%M-%S" ), ".json" ) );
+
+			String summary( trace.getSummary() );
+
+			if (! trace.writeChromeTrace( file ))
+				summary << newLine << "Couldn't write " << file.getFullPathName();
+
+			return summary;
+		}
+
+		/// turns fingertip prediction on or off. when it's turned on, the drawn fingertips are
+		/// extrapolated by the median latency traced so far from a frame's capture to its hands
+		/// being drawn, and the haptic ones by the latency to the output being written.
+		String setPredictingFingertips( bool shouldPredict )
+		{
+			if (! shouldPredict)
+			{
+				m_predictFingertips = 0;
+				return "Fingertip prediction off";
+			}
+
+			const LatencyTrace& trace = LatencyTrace::getGlobal();
+			m_renderLeadMicros  = getMedianLatencyMicros( trace, LatencyTrace::handsDrawn );
+			m_hapticsLeadMicros = getMedianLatencyMicros( trace, LatencyTrace::pwmWritten );
+			m_predictFingertips = 1;
+
+			return "Predicting fingertips " + String( m_renderLeadMicros.get() / 1000.0, 1 ) + " ms ahead for drawing, "
+					+ String( m_hapticsLeadMicros.get() / 1000.0, 1 ) + " ms for haptics";
+		}
+
+		/// replayed frames have no capture time, so their latency is measured from their arrival
+		static int getMedianLatencyMicros( const LatencyTrace& trace, LatencyTrace::Stage stage )
+		{
+			LatencyTrace::Percentiles latency = trace.getLatency( LatencyTrace::frameCaptured, stage );
+
+			if (latency.count == 0)
+				latency = trace.getLatency( LatencyTrace::frameArrived, stage );
+
+			return roundToInt( latency.p50 * 1000.0 );
+		}
+
+		/// every frame goes through the predictors, so they've settled whenever prediction is turned on
+		static void updatePredictor( LeapUtil::MotionPredictor& predictor, const TrackedFrame& frame, int leadMicros )
+		{
+			predictor.SetPredictionTime( leadMicros * 1.0e-6f );
+			predictor.BeginFrame( frame.timestamp );
+
+			for (int i = 0; i < frame.numPointables; i++)
+				predictor.AddMeasurement( frame.pointables[i].id, frame.pointables[i].tipPosition );
+
+			predictor.EndFrame();
+		}
+
+		Leap::Vector getTipPosition( const LeapUtil::MotionPredictor& predictor, const TrackedFrame::Pointable& pointable ) const
+		{
+			Leap::Vector vPredicted;
+
+			if (m_predictFingertips.get() != 0 && predictor.GetPredicted( pointable.id, vPredicted ))
+				return vPredicted;
+
+			return pointable.tipPosition;
+		}
+
+		// runs on the camera's thread, and only copies the frame into the pool's free buffer
 		void imageReceived(const Image &image) override
 		{
-			m_lastImage = image;
+			m_cameraFrames.write( image );
 			openGLContext.triggerRepaint();
 		}
 
-		void drawLeapFrame( Leap::Frame frame )
+		// runs on its own thread so that haptics follow the tracking rate, not the frame rate
+		void hiResTimerCallback() override
+		{
+			if ( m_frameExchange.Read( kHapticsConsumer, m_hapticsFrame ) )
+				updateHaptics( m_hapticsFrame );
+		}
+
+		void updateHaptics( const TrackedFrame& frame )
+		{
+			m_fingertips.clearQuick();
+			updatePredictor( m_hapticsPredictor, frame, m_hapticsLeadMicros.get() );
+
+			for (int i = 0; i < frame.numPointables; i++)
+				m_fingertips.add( m_mtxFrameTransform.transformPoint( getTipPosition( m_hapticsPredictor, frame.pointables[i] ) * m_fFrameScale ) );
+
+			// all hands are merged into a single write per frame: duty cycles ch1, skip, ch2, ch3, ch4, ...
+			HapticsOutput::DutyCycles frameDutyCycles;
+			m_fingertipTouches.clearQuick();
+
+			m_hapticRegions.process( m_fingertips.begin(), m_fingertips.size(),
+									 frameDutyCycles.dc, haptics->getNumChannels(), &m_fingertipTouches );
+
+			int touchedRegions = 0;
+
+			// only the first 32 regions fit in the mask; custom layouts can have more, but only 0-3 are drawn
+			for (int i = 0; i < m_fingertipTouches.size(); ++i)
+			{
+				const int region = m_fingertipTouches.getReference (i).region;
+
+				if (isPositiveAndBelow (region, 32))
+					touchedRegions |= (int) (1u << region);
+			}
+
+			m_touchedRegions = touchedRegions;
+			LatencyTrace::getGlobal().record( LatencyTrace::hapticsProcessed, frame.id );
+
+			// hand the new DC to the DAQmx output thread
+			if (frame.numHands > 0)
+				haptics->postDutyCycles( frameDutyCycles, frame.id );
+		}
+
+		void drawLeapFrame( const TrackedFrame& frame )
 		{
 			LeapUtilGL::GLAttribScope colorScope( GL_CURRENT_BIT | GL_LINE_BIT );
 			glLineWidth( 3.0f );
 
+			LeapUtilGL::MeshCache* meshCache = LeapUtilGL::MeshCache::GetForCurrentContext();
+			jassert( meshCache != nullptr );
+
 			const float fScale = m_fPointableRadius;			
-			const Leap::HandList& hands = frame.hands();
-			Colour leftClr(Colours::white), rightClr(Colours::white), 
-				upClr(Colours::white), downClr(Colours::white);
 
-			for (size_t j = 0, m = hands.count(); j < m; j++)
+			m_palmTransforms.clearQuick();
+			m_palmColors.clearQuick();
+			m_tipTransforms.clearQuick();
+			m_tipColors.clearQuick();
+
+			glColor3f( 1, 0, 0 );
+
+			for (int j = 0; j < frame.numHands; j++)
 			{
-				const Leap::Hand& hand = hands[j];
-				Leap::Vector palmPos = m_mtxFrameTransform.transformPoint( hand.palmPosition() * m_fFrameScale );
-				Leap::Vector palmNor = m_mtxFrameTransform.transformDirection( hand.palmNormal() );
+				const TrackedFrame::Hand& hand = frame.hands[j];
+				Leap::Vector palmPos = m_mtxFrameTransform.transformPoint( hand.palmPosition * m_fFrameScale );
+				Leap::Vector palmNor = m_mtxFrameTransform.transformDirection( hand.palmNormal );
 
-				LeapUtilGL::drawDisk( palmPos, palmNor );
+				// palm outline: a radius 0.1 circle turned to face along the palm normal
+				Leap::Vector rotAxis = Leap::Vector::zAxis().cross( palmNor );
+				Leap::Matrix palmMtx;
 
-				const Leap::PointableList& pointables = hand.pointables();
+				if ( rotAxis.magnitudeSquared() > 1e-8f )
+					palmMtx.setRotation( rotAxis.normalized(), Leap::Vector::zAxis().angleTo( palmNor ) );
 
-				// create variable for duty cycles: ch1, skip, ch2, ch3, ch4, ...
-				unsigned char dc[8] = {0,0,0,0,0,0,0,0};
-				float val = 0;
+				m_palmTransforms.add( Leap::Matrix( palmMtx.xBasis * 0.2f, palmMtx.yBasis * 0.2f, palmMtx.zBasis * 0.2f, palmPos ) );
+				m_palmColors.add( Colours::red );
 
-				for ( size_t i = 0, n = pointables.count(); i < n; i++ )
+				for ( int i = 0; i < hand.numPointables; i++ )
 				{
-					const Leap::Pointable&  pointable   = pointables[i];
-					Leap::Vector            vStartPos   = m_mtxFrameTransform.transformPoint( pointable.tipPosition() * m_fFrameScale );
-					Leap::Vector            vEndPos     = m_mtxFrameTransform.transformDirection( pointable.direction() ) * -0.125f;
-
-					glColor3f( 1, 0, 0 );
+					const TrackedFrame::Pointable& pointable = frame.getPointable( hand, i );
+					Leap::Vector            vStartPos   = m_mtxFrameTransform.transformPoint( getTipPosition( m_renderPredictor, pointable ) * m_fFrameScale );
+					Leap::Vector            vEndPos     = m_mtxFrameTransform.transformDirection( pointable.direction ) * -0.125f;
 
 					{
 						LeapUtilGL::GLMatrixScope matrixScope;
@@ -884,89 +1497,185 @@ struct OpenGLDemoClasses
 						glVertex3fv( (palmPos-vStartPos).toFloatPointer() );
 
 						glEnd();
+					}
 
-						glScalef( fScale, fScale, fScale );
+					m_tipTransforms.add( Leap::Matrix( Leap::Vector( fScale, 0, 0 ), Leap::Vector( 0, fScale, 0 ), Leap::Vector( 0, 0, fScale ), vStartPos ) );
+					m_tipColors.add( Colours::red );
+				}
+			}
 
-						LeapUtilGL::drawSphere( LeapUtilGL::kStyle_Solid );
-					}
+			meshCache->DrawInstanced( LeapUtilGL::kMesh_Circle, LeapUtilGL::kDetail_High, m_palmTransforms.begin(), m_palmColors.begin(), m_palmTransforms.size() );
 
-					// Check for intersection with the cylinders
-					if (vStartPos.distanceTo(Leap::Vector(vStartPos.x, vStartPos.y, 0)) <= 0.1)
-					{
-						if (vStartPos.y>=0.4 && vStartPos.y<=0.6 && vStartPos.x>=-0.5 && vStartPos.x<=0.5)
-						{
-							upClr = Colours::red;
-							// determine value
-							val = int(255*(vStartPos.x/2+0.75));
-							// vibrate M1 (p3.0) and M2 (p3.2)
-							dc[0] = val;
-							dc[2] = 383-val;
-						}
-						if (vStartPos.y>=-0.6 && vStartPos.y<=-0.4 && vStartPos.x>=-0.5 && vStartPos.x<=0.5)
-						{
-							downClr = Colours::red;
-							// determine value
-							val = int(255*(vStartPos.x/2+0.75));
-							// vibrate M3 (p3.3) and M4 (p3.4)
-							dc[3] = 383-val;
-							dc[4] = val;
-						}
-						if (vStartPos.y>=-0.5 && vStartPos.y<=0.5 && vStartPos.x>=0.4 && vStartPos.x<=0.6)
-						{
-							rightClr = Colours::red;
-							// determine value
-							val = int(255*(vStartPos.y/2+0.75));
-							// vibrate M1 and M4
-							dc[0] = val;
-							dc[4] = 383-val;
-						}
-						if (vStartPos.y>=-0.5 && vStartPos.y<=0.5 && vStartPos.x>=-0.6 && vStartPos.x<=-0.4)
-						{
-							leftClr = Colours::red;
-							// determine value
-							val = int(255*(vStartPos.y/2+0.75));
-							// vibrate M2 and M3
-							dc[2] = val;
-							dc[3] = 383-val;
-						}
-					}
+			// fingertips are only a few pixels across, so a coarser sphere is indistinguishable
+			meshCache->DrawInstanced( LeapUtilGL::kMesh_Sphere, LeapUtilGL::kDetail_Medium, m_tipTransforms.begin(), m_tipColors.begin(), m_tipTransforms.size() );
+
+			drawRegionsOfInterest();
+		}
+
+		/// same picture as drawLeapFrame(), but every hand goes through the HandBatchRenderer
+		/// in two draw calls, plus one for the regions of interest.
+		void drawLeapFrameBatched( const TrackedFrame& frame )
+		{
+			LeapUtilGL::GLAttribScope lineScope( GL_LINE_BIT );
+			glLineWidth( 3.0f );
+
+			const Colour handClr( Colours::red );
+
+			handRenderer->clear();
+
+			for (int j = 0; j < frame.numHands; j++)
+			{
+				const TrackedFrame::Hand& hand = frame.hands[j];
+				Leap::Vector palmPos = m_mtxFrameTransform.transformPoint( hand.palmPosition * m_fFrameScale );
+				Leap::Vector palmNor = m_mtxFrameTransform.transformDirection( hand.palmNormal );
+
+				handRenderer->addCircle( palmPos, palmNor, 0.1f, handClr );
+
+				for ( int i = 0; i < hand.numPointables; i++ )
+				{
+					const TrackedFrame::Pointable& pointable = frame.getPointable( hand, i );
+					Leap::Vector            vStartPos   = m_mtxFrameTransform.transformPoint( getTipPosition( m_renderPredictor, pointable ) * m_fFrameScale );
+					Leap::Vector            vKnuckle    = vStartPos + m_mtxFrameTransform.transformDirection( pointable.direction ) * -0.125f;
+
+					handRenderer->addLine( vStartPos, vKnuckle, handClr );
+					handRenderer->addLine( vKnuckle, palmPos, handClr );
+					handRenderer->addSphere( vStartPos, m_fPointableRadius, handClr );
 				}
-				// write new DC to DAQmx
-				SP->writePWM(dc);
+			}
+
+			handRenderer->draw();
+
+			drawRegionsOfInterest();
+		}
+
+		/// draws the hands with the batched renderer, or - while comparing - alternates
+		/// between both renderers every frame and reports their average cost.
+		void drawHands( const TrackedFrame& frame )
+		{
+			if (! compareHandRenderers)
+			{
+				if (handRenderer->isValid())
+					drawLeapFrameBatched( frame );
+				else
+					drawLeapFrame( frame );
+
+				return;
+			}
+
+			const int path = (handRenderer->isValid() && (m_iNumComparedFrames & 1) != 0) ? kBatchedHands : kImmediateHands;
+
+			// drain the pipeline either side, so that each sample covers the driver and GPU
+			// work of just this path rather than whatever happened to be queued before it
+			glFinish();
+			const int64 startTicks = Time::getHighResolutionTicks();
+
+			if (path == kBatchedHands)
+				drawLeapFrameBatched( frame );
+			else
+				drawLeapFrame( frame );
 
+			glFinish();
+			const double ms = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks) * 1000.0;
+
+			m_handDrawTimes[path].AddSample( (float) ms );
+
+			if ((++m_iNumComparedFrames % 60) == 0)
+			{
+				const float immediateMs = m_handDrawTimes[kImmediateHands].GetAverage();
+				const float batchedMs   = m_handDrawTimes[kBatchedHands].GetAverage();
+
+				const ScopedLock sl (m_timingLock);
+				m_timingText = "Hands: immediate " + String (immediateMs, 3) + " ms, batched " + String (batchedMs, 3) + " ms";
+
+				if (batchedMs > 0.0f)
+					m_timingText << " (" << String (immediateMs / batchedMs, 2) << "x)";
+
+				triggerAsyncUpdate();
 			}
+		}
+
+		void handleAsyncUpdate() override
+		{
+			String text;
 
-			// Draw the region of interest
 			{
-				LeapUtilGL::GLMatrixScope roiMatrixScope;
-
-				glTranslatef(0.5, 0, 0);
-				drawCylinder(LeapUtilGL::kStyle_Solid, LeapUtilGL::kAxis_Y, 0.1f, 1.0f, rightClr);
-				glTranslatef(-1, 0, 0);
-				drawCylinder(LeapUtilGL::kStyle_Solid, LeapUtilGL::kAxis_Y, 0.1f, 1.0f, leftClr);
-				glTranslatef(0.5, 0.5, 0);
-				drawCylinder(LeapUtilGL::kStyle_Solid, LeapUtilGL::kAxis_X, 0.1f, 1.0f, upClr);
-				glTranslatef(0, -1, 0);
-				drawCylinder(LeapUtilGL::kStyle_Solid, LeapUtilGL::kAxis_X, 0.1f, 1.0f, downClr);
+				const ScopedLock sl (m_timingLock);
+				text = m_timingText;
 			}
+
+			controlsOverlay->timingLabel.setText (text, dontSendNotification);
+			controlsOverlay->setReplaying (isReplaying());
+		}
+
+		void drawRegionsOfInterest()
+		{
+			LeapUtilGL::MeshCache* meshCache = LeapUtilGL::MeshCache::GetForCurrentContext();
+
+			// Draw the region of interest, highlighting whatever the haptics thread last saw touched.
+			// The bars are radius 0.1, length 1 cylinders: the left and right ones run along y, up and down along x.
+			// Like the hands they're drawn unlit, which is how the old solid cylinders came out too, as nothing
+			// in the demo turns GL_LIGHTING on.
+			const int touchedRegions = m_touchedRegions.get();
+
+			const Leap::Matrix roiTransforms[] =
+			{
+				Leap::Matrix( Leap::Vector( 0.2f, 0, 0 ), Leap::Vector( 0, 0, 0.2f ), Leap::Vector( 0, -1, 0 ), Leap::Vector(  0.5f, 0, 0 ) ),
+				Leap::Matrix( Leap::Vector( 0.2f, 0, 0 ), Leap::Vector( 0, 0, 0.2f ), Leap::Vector( 0, -1, 0 ), Leap::Vector( -0.5f, 0, 0 ) ),
+				Leap::Matrix( Leap::Vector( 0, 0, -0.2f ), Leap::Vector( 0, 0.2f, 0 ), Leap::Vector( 1, 0, 0 ), Leap::Vector( 0,  0.5f, 0 ) ),
+				Leap::Matrix( Leap::Vector( 0, 0, -0.2f ), Leap::Vector( 0, 0.2f, 0 ), Leap::Vector( 1, 0, 0 ), Leap::Vector( 0, -0.5f, 0 ) )
+			};
+
+			const Colour roiColors[] =
+			{
+				(touchedRegions & kRegion_Right) != 0 ? Colours::red : Colours::white,
+				(touchedRegions & kRegion_Left)  != 0 ? Colours::red : Colours::white,
+				(touchedRegions & kRegion_Up)    != 0 ? Colours::red : Colours::white,
+				(touchedRegions & kRegion_Down)  != 0 ? Colours::red : Colours::white
+			};
+
+			meshCache->DrawInstanced( LeapUtilGL::kMesh_Cylinder, LeapUtilGL::kDetail_High, roiTransforms, roiColors, numElementsInArray (roiTransforms) );
 		}
 
 		Draggable3DOrientation draggableOrientation;
-        bool doBackgroundDrawing;
+        bool doBackgroundDrawing, compareHandRenderers;
         float scale, rotationSpeed;
         BouncingNumber bouncingNumber;
 		LeapUtilGL::CameraGL        camera;
 
     private:
-		Leap::Frame                 m_lastFrame;
+		enum  { kRenderConsumer, kHapticsConsumer, kNumFrameConsumers };
+		enum  { kImmediateHands, kBatchedHands, kNumHandRenderers };
+		enum  { kRegion_Up = 1, kRegion_Down = 2, kRegion_Right = 4, kRegion_Left = 8 };	// bits for regions 0-3 of HapticRegionMap::addFourBarLayout()
+
+		LeapUtil::LeapFrameExchange<TrackedFrame, kNumFrameConsumers> m_frameExchange;
+		TrackedFrame                m_liveFrame;	// Leap thread only
+		TrackedFrame                m_lastFrame;	// only touched by the GL thread
+		TrackedFrame                m_hapticsFrame;	// haptics thread only
+		ScopedPointer<LeapFrameRecorder> m_recorder;
+		ScopedPointer<LeapFrameReplayer> m_replayer;
+		Atomic<int>                 m_isReplaying;
+		Atomic<int>                 m_touchedRegions;
+		HapticRegionMap             m_hapticRegions;	// built once, then only read by the haptics thread
+		Array<Leap::Vector>         m_fingertips;		// haptics thread only
+		LeapUtil::MotionPredictor   m_renderPredictor;	// GL thread only
+		LeapUtil::MotionPredictor   m_hapticsPredictor;	// haptics thread only
+		Atomic<int>                 m_predictFingertips, m_renderLeadMicros, m_hapticsLeadMicros;
+		Array<HapticRegionMap::Touch> m_fingertipTouches;
+		Array<Leap::Matrix>         m_palmTransforms, m_tipTransforms;	// per-frame instance data, GL thread only
+		Array<Colour>               m_palmColors, m_tipColors;
+		LeapUtil::RollingAverage<120> m_handDrawTimes[kNumHandRenderers];	// GL thread only
+		uint32_t                    m_iNumComparedFrames;
+		CriticalSection             m_timingLock;
+		String                      m_timingText;
 		enum  { kNumColors = 256 };
 		Leap::Vector				m_avColors[kNumColors];
 		float                       m_fPointableRadius;
 		Leap::Matrix                m_mtxFrameTransform;
 		float                       m_fFrameScale;
-		DAQMX*						SP;
+		ScopedPointer<HapticsOutput>	haptics;
 		CameraDevice*				camDevPtr;
-		Image						m_lastImage;
+		CameraFramePool				m_cameraFrames;
+		CameraTexture				m_cameraTexture;	// GL thread only
 
         OpenGLContext openGLContext;
 
@@ -976,10 +1685,13 @@ struct OpenGLDemoClasses
 
         ScopedPointer<OpenGLShaderProgram> shader;
         ScopedPointer<Shape> shape;
+        ScopedPointer<HandBatchRenderer> handRenderer;
         ScopedPointer<Attributes> attributes;
         ScopedPointer<Uniforms> uniforms;
 
-        OpenGLTexture texture;
+        AssetStreamer assetStreamer;
+        StreamedMesh::Ptr teapot;
+        StreamedTexture::Ptr currentTexture;
         DemoTexture* textureToUse;
 
         String newVertexShader, newFragmentShader;
@@ -1011,7 +1723,7 @@ struct OpenGLDemoClasses
                     shader = newShader;
                     shader->use();
 
-                    shape      = new Shape (openGLContext);
+                    shape      = new Shape (teapot);
                     attributes = new Attributes (openGLContext, *shader);
                     uniforms   = new Uniforms (openGLContext, *shader);
 
@@ -1036,6 +1748,9 @@ struct OpenGLDemoClasses
 
 		void drawBackground2DStuff (float desktopScale)
         {
+            glViewport (0, 0, roundToInt (desktopScale * getWidth()), roundToInt (desktopScale * getHeight()));
+            m_cameraTexture.drawFullScreen();
+
             // Create an OpenGLGraphicsContext that will draw into this GL window..
             ScopedPointer<LowLevelGraphicsContext> glRenderer (createOpenGLGraphicsContext (openGLContext,
                                                                                             roundToInt (desktopScale * getWidth()),
@@ -1048,9 +1763,6 @@ struct OpenGLDemoClasses
 				
                 //g.addTransform (AffineTransform::scale (desktopScale*getWidth()/bg.getWidth(), 
 				//	desktopScale*getHeight()/bg.getHeight()));
-				g.addTransform (AffineTransform::scale (desktopScale*getWidth()/m_lastImage.getWidth(), 
-					desktopScale*getHeight()/m_lastImage.getHeight()));
-				g.drawImageAt( m_lastImage, 0, 0 );
 				
 				/*
                 for (int i = 0; i < numElementsInArray (stars); ++i)
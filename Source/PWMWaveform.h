@@ -0,0 +1,106 @@
+#ifndef PWMWAVEFORM_H_INCLUDED
+#define PWMWAVEFORM_H_INCLUDED
+
+#include <string.h>
+#include <stdint.h>
+
+// The smallest sample word that has a bit for every channel
+template <bool fitsInByte, bool fitsInWord> struct PWMSampleType			{ typedef uint64_t Type; };
+template <bool fitsInWord> struct PWMSampleType<true, fitsInWord>			{ typedef uint8_t Type; };
+template <> struct PWMSampleType<false, true>								{ typedef uint32_t Type; };
+
+// A bit-packed PWM waveform of NumSamples samples for NumChannels digital lines.
+// Sample i has bit j set while i < dc[j], so a duty cycle of 0 is always off and
+// one of NumSamples or more is always on.
+//
+// Rather than testing every channel at every sample, build() sorts the channels by
+// the sample at which they switch off and sweeps the period once, clearing their bits
+// as it passes, which costs O(NumSamples + NumChannels) with no branches. update()
+// goes further and only touches the samples between each changed channel's old and
+// new duty cycle, reporting the span that a regenerating device needs to be sent.
+template <int NumSamples, int NumChannels>
+class PWMWaveform
+{
+	public:
+		typedef typename PWMSampleType<(NumChannels <= 8), (NumChannels <= 32)>::Type Sample;
+
+		enum { numSamples = NumSamples, numChannels = NumChannels };
+
+		// Starts with every channel off
+		PWMWaveform()
+		{
+			memset(data, 0, sizeof(data));
+			memset(lastDC, 0, sizeof(lastDC));
+		}
+
+		// Rebuilds the whole period from NumChannels duty cycles
+		void build(const uint8_t *dc)
+		{
+			Sample offAt[NumSamples + 1];
+			Sample word = 0;
+
+			memset(offAt, 0, sizeof(offAt));
+
+			for (int j = 0; j < NumChannels; j++)
+			{
+				const Sample bit = ((Sample) 1) << j;
+				const int end = (dc[j] < NumSamples) ? dc[j] : NumSamples;
+
+				word |= bit;
+				offAt[end] |= bit;
+				lastDC[j] = dc[j];
+			}
+
+			for (int i = 0; i < NumSamples; i++)
+			{
+				word &= ~offAt[i];
+				data[i] = word;
+			}
+		}
+
+		// Brings the waveform up to date with NumChannels new duty cycles, patching only
+		// the samples that change. Returns false if nothing changed; otherwise the changed
+		// samples are [first, last).
+		bool update(const uint8_t *dc, int &first, int &last)
+		{
+			first = NumSamples;
+			last = 0;
+
+			for (int j = 0; j < NumChannels; j++)
+			{
+				const int from = (lastDC[j] < NumSamples) ? lastDC[j] : NumSamples;
+				const int to = (dc[j] < NumSamples) ? dc[j] : NumSamples;
+
+				lastDC[j] = dc[j];
+
+				if (from == to)
+					continue;
+
+				const Sample bit = ((Sample) 1) << j;
+
+				if (to > from)
+				{
+					for (int i = from; i < to; i++) data[i] |= bit;
+					if (from < first) first = from;
+					if (to > last) last = to;
+				}
+				else
+				{
+					for (int i = to; i < from; i++) data[i] &= ~bit;
+					if (to < first) first = to;
+					if (from > last) last = from;
+				}
+			}
+
+			return first < last;
+		}
+
+		const Sample *getData() const			{ return data; }
+		const uint8_t *getDutyCycles() const	{ return lastDC; }
+
+	private:
+		Sample data[NumSamples];
+		uint8_t lastDC[NumChannels];
+};
+
+#endif // PWMWAVEFORM_H_INCLUDED
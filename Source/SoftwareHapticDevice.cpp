@@ -0,0 +1,134 @@
+/*
+  ==============================================================================
+
+    SoftwareHapticDevice.cpp
+
+  ==============================================================================
+*/
+
+#include "SoftwareHapticDevice.h"
+
+static int64 msToTicks (const double ms) noexcept
+{
+    return (int64) (ms * 0.001 * (double) Time::getHighResolutionTicksPerSecond());
+}
+
+//==============================================================================
+SoftwareHapticDevice::SoftwareHapticDevice (int numChannels_, double writeLatencyMs, double latencyJitterMs,
+                                            double clockRate, int maxBuffersToRecord_)
+    : numChannels (jlimit (0, (int) maxChannels, numChannels_)),
+      maxBuffersToRecord (maxBuffersToRecord_),
+      latencyTicks (msToTicks (writeLatencyMs)),
+      jitterTicks (msToTicks (latencyJitterMs)),
+      ticksPerSample ((double) Time::getHighResolutionTicksPerSecond() / clockRate),
+      clockStartTicks (Time::getHighResolutionTicks())
+{
+    jassert (numChannels_ <= maxChannels);
+
+    // start every line at a duty cycle of 128, like DAQMXArray
+    uint8 dc[maxChannels] = { 0 };
+
+    for (int i = 0; i < numChannels; ++i)
+        dc[i] = 128;
+
+    waveform.build (dc);
+}
+
+SoftwareHapticDevice::~SoftwareHapticDevice()
+{
+}
+
+void SoftwareHapticDevice::writePWM (const uint8_t* dc)
+{
+    WrittenBuffer buffer;
+    buffer.callTicks = Time::getHighResolutionTicks();
+
+    // the lines past numChannels don't exist, so they stay off
+    zerostruct (buffer.dutyCycles);
+    memcpy (buffer.dutyCycles, dc, (size_t) numChannels);
+
+    int first, last;
+
+    {
+        const ScopedLock sl (lock);
+
+        if (! waveform.update (buffer.dutyCycles, first, last))
+            first = last = 0;
+    }
+
+    buffer.firstSample = first;
+    buffer.numSamples = last - first;
+
+    waitUntil (buffer.callTicks + latencyTicks + (jitterTicks > 0 ? (int64) (random.nextDouble() * (double) jitterTicks) : 0));
+
+    buffer.returnTicks = Time::getHighResolutionTicks();
+    buffer.outputTicks = getNextTimeAtSample (buffer.returnTicks, first);
+
+    ++numWrites;
+
+    const ScopedLock sl (lock);
+
+    if (writtenBuffers.size() < maxBuffersToRecord)
+    {
+        buffer.samplesIndex = writtenSamples.size();
+        writtenSamples.addArray (waveform.getData() + first, buffer.numSamples);
+        writtenBuffers.add (buffer);
+    }
+}
+
+//==============================================================================
+Array<SoftwareHapticDevice::WrittenBuffer> SoftwareHapticDevice::getWrittenBuffers() const
+{
+    const ScopedLock sl (lock);
+    return writtenBuffers;
+}
+
+void SoftwareHapticDevice::getWrittenSamples (const WrittenBuffer& buffer, Array<Waveform::Sample>& samples) const
+{
+    const ScopedLock sl (lock);
+    samples.clearQuick();
+    samples.addArray (static_cast<const Waveform::Sample*> (writtenSamples.begin()) + buffer.samplesIndex, buffer.numSamples);
+}
+
+void SoftwareHapticDevice::getWaveform (Array<Waveform::Sample>& samples) const
+{
+    const ScopedLock sl (lock);
+    samples.clearQuick();
+    samples.addArray (waveform.getData(), (int) Waveform::numSamples);
+}
+
+void SoftwareHapticDevice::clearWrittenBuffers()
+{
+    const ScopedLock sl (lock);
+    writtenBuffers.clear();
+    writtenSamples.clear();
+}
+
+//==============================================================================
+void SoftwareHapticDevice::waitUntil (const int64 ticks) const noexcept
+{
+    // sleep through most of the wait and spin for the rest, since sleeps are coarse
+    const int64 ticksPerMs = Time::getHighResolutionTicksPerSecond() / 1000;
+
+    for (int64 now = Time::getHighResolutionTicks(); now < ticks; now = Time::getHighResolutionTicks())
+    {
+        if (ticks - now > 2 * ticksPerMs)
+            Thread::sleep (1);
+        else
+            Thread::yield();
+    }
+}
+
+int64 SoftwareHapticDevice::getNextTimeAtSample (const int64 ticks, const int sample) const noexcept
+{
+    // the buffer is regenerated continuously, so find where playback is within the period
+    const double samplesSinceStart = (double) (ticks - clockStartTicks) / ticksPerSample;
+    const double position = std::fmod (samplesSinceStart, (double) Nsamp);
+
+    double wait = sample - position;
+
+    if (wait < 0)
+        wait += Nsamp;
+
+    return ticks + (int64) (wait * ticksPerSample);
+}
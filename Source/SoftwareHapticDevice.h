@@ -0,0 +1,99 @@
+/*
+  ==============================================================================
+
+    SoftwareHapticDevice.h
+
+  ==============================================================================
+*/
+
+#ifndef SOFTWAREHAPTICDEVICE_H_INCLUDED
+#define SOFTWAREHAPTICDEVICE_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "HapticOutputDevice.h"
+#include "PWMWaveform.h"
+
+//==============================================================================
+/**
+    A HapticOutputDevice with no hardware behind it.
+
+    It behaves like a DAQMXArray task: the waveform is regenerated continuously
+    from a free-running sample clock, and each write patches only the samples
+    that changed. Every write is recorded along with when it was made, when the
+    simulated driver call returned and when its new samples would first have
+    reached the lines, so the whole haptics path can be run and timed without
+    a card or the NI driver.
+
+    Driver latency is simulated by holding writePWM() for a fixed time plus a
+    random amount of jitter.
+*/
+class SoftwareHapticDevice  : public HapticOutputDevice
+{
+public:
+    enum { maxChannels = 64 };
+
+    typedef PWMWaveform<Nsamp, maxChannels> Waveform;
+
+    /** One call to writePWM(). Times are in high-resolution ticks. */
+    struct WrittenBuffer
+    {
+        int64 callTicks;        // when writePWM() was called
+        int64 returnTicks;      // when the simulated driver call returned
+        int64 outputTicks;      // when the playback position next reaches the first changed sample
+        int firstSample, numSamples;
+        int samplesIndex;       // where the written samples start in the recorded sample list
+        uint8 dutyCycles[maxChannels];
+    };
+
+    //==============================================================================
+    SoftwareHapticDevice (int numChannels,
+                          double writeLatencyMs = 0.0,
+                          double latencyJitterMs = 0.0,
+                          double clockRate = Fclk,
+                          int maxBuffersToRecord = 100000);
+
+    ~SoftwareHapticDevice();
+
+    bool IsConnected() override                     { return true; }
+    int GetNumChannels() override                   { return numChannels; }
+    void writePWM (const uint8_t* dc) override;
+
+    //==============================================================================
+    /** Returns a copy of everything recorded so far. */
+    Array<WrittenBuffer> getWrittenBuffers() const;
+
+    /** Copies the samples that were sent by one of the recorded writes. */
+    void getWrittenSamples (const WrittenBuffer&, Array<Waveform::Sample>& samples) const;
+
+    /** Copies the whole waveform that the lines are currently playing. */
+    void getWaveform (Array<Waveform::Sample>& samples) const;
+
+    /** Forgets the recorded writes, though not the waveform itself. */
+    void clearWrittenBuffers();
+
+    /** Counts every write, including any made after the recording filled up. */
+    int64 getNumWrites() const noexcept             { return numWrites.get(); }
+
+private:
+    //==============================================================================
+    const int numChannels, maxBuffersToRecord;
+    const int64 latencyTicks, jitterTicks;
+    const double ticksPerSample;
+    const int64 clockStartTicks;
+
+    Waveform waveform;
+    Random random;
+    Atomic<int64> numWrites;
+
+    CriticalSection lock;
+    Array<WrittenBuffer> writtenBuffers;
+    Array<Waveform::Sample> writtenSamples;
+
+    void waitUntil (int64 ticks) const noexcept;
+    int64 getNextTimeAtSample (int64 ticks, int sample) const noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SoftwareHapticDevice)
+};
+
+
+#endif  // SOFTWAREHAPTICDEVICE_H_INCLUDED
@@ -0,0 +1,1094 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library - "Jules' Utility Class Extensions"
+   Copyright 2004-12 by Raw Material Software Ltd.
+
+  ------------------------------------------------------------------------------
+
+   JUCE can be redistributed and/or modified under the terms of the GNU General
+   Public License (Version 2), as published by the Free Software Foundation.
+   A copy of the license is included in the JUCE distribution, or can be found
+   online at www.gnu.org/licenses.
+
+   JUCE is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+   A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  ------------------------------------------------------------------------------
+
+   To release a closed-source product which uses JUCE, commercial licenses are
+   available: visit www.rawmaterialsoftware.com/juce for more information.
+
+  ==============================================================================
+*/
+
+#include "WavefrontObjParser.h"
+
+namespace ObjParsing
+{
+    // Inputs below this size are parsed on the calling thread, and larger ones are cut
+    // into chunks of at least this size.
+    enum { minChunkSize = 1 << 20 };
+
+    static inline bool isSpace (const char c) noexcept      { return c == ' ' || c == '\t' || c == '\r'; }
+    static inline bool isDigit (const char c) noexcept      { return (unsigned int) (c - '0') < 10u; }
+
+    static inline const char* skipSpace (const char* p, const char* end) noexcept
+    {
+        while (p < end && isSpace (*p))
+            ++p;
+
+        return p;
+    }
+
+    static inline const char* findLineEnd (const char* p, const char* end) noexcept
+    {
+        const char* const newLine = static_cast<const char*> (memchr (p, '\n', (size_t) (end - p)));
+        return newLine != nullptr ? newLine : end;
+    }
+
+    static inline bool matchToken (const char*& p, const char* end, const char* token, const int len) noexcept
+    {
+        if (end - p >= len && memcmp (p, token, (size_t) len) == 0 && (p + len == end || isSpace (p[len])))
+        {
+            p = skipSpace (p + len, end);
+            return true;
+        }
+
+        return false;
+    }
+
+    // Numbers in OBJ files are short decimals, so accumulate up to 19 significant digits as an
+    // integer and scale by an exact power of ten, which is correctly rounded for all but
+    // extreme exponents. Anything else, like "nan", goes to the general-purpose parser.
+    static float parseFloatSlowly (const char*& p, const char* end)
+    {
+        char buffer[64];
+        int len = 0;
+
+        while (p + len < end && len < (int) sizeof (buffer) - 1 && ! isSpace (p[len]) && p[len] != '\n')
+        {
+            buffer[len] = p[len];
+            ++len;
+        }
+
+        buffer[len] = 0;
+        CharPointer_ASCII t (buffer);
+        const float value = (float) CharacterFunctions::readDoubleValue (t);
+        p += len;
+        return value;
+    }
+
+    static float parseFloat (const char*& p, const char* end)
+    {
+        static const double powersOfTen[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                              1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+        p = skipSpace (p, end);
+        const char* const start = p;
+
+        bool isNegative = false;
+
+        if (p < end && (*p == '-' || *p == '+'))
+            isNegative = (*p++ == '-');
+
+        uint64 mantissa = 0;
+        int exponent = 0, numSignificant = 0;
+        bool hasDigits = false;
+
+        for (; p < end && isDigit (*p); ++p)
+        {
+            hasDigits = true;
+
+            if (numSignificant < 19)
+            {
+                mantissa = mantissa * 10 + (uint64) (*p - '0');
+                numSignificant += (mantissa != 0) ? 1 : 0;
+            }
+            else
+            {
+                ++exponent;
+            }
+        }
+
+        if (p < end && *p == '.')
+        {
+            for (++p; p < end && isDigit (*p); ++p)
+            {
+                hasDigits = true;
+
+                if (numSignificant < 19)
+                {
+                    mantissa = mantissa * 10 + (uint64) (*p - '0');
+                    numSignificant += (mantissa != 0) ? 1 : 0;
+                    --exponent;
+                }
+            }
+        }
+
+        if (! hasDigits)
+        {
+            p = start;
+            return parseFloatSlowly (p, end);
+        }
+
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            const char* e = p + 1;
+            bool isNegativeExponent = false;
+
+            if (e < end && (*e == '-' || *e == '+'))
+                isNegativeExponent = (*e++ == '-');
+
+            if (e < end && isDigit (*e))
+            {
+                int explicitExponent = 0;
+
+                for (; e < end && isDigit (*e); ++e)
+                    explicitExponent = jmin (9999, explicitExponent * 10 + (*e - '0'));
+
+                exponent += isNegativeExponent ? -explicitExponent : explicitExponent;
+                p = e;
+            }
+        }
+
+        double value = (double) mantissa;
+
+        if (exponent < 0)
+            value = exponent >= -22 ? value / powersOfTen[-exponent] : value * std::pow (10.0, (double) exponent);
+        else if (exponent > 0)
+            value = exponent <= 22 ? value * powersOfTen[exponent] : value * std::pow (10.0, (double) exponent);
+
+        return (float) (isNegative ? -value : value);
+    }
+
+    static inline bool parseInt (const char*& p, const char* end, int& result) noexcept
+    {
+        bool isNegative = false;
+
+        if (p < end && (*p == '-' || *p == '+'))
+            isNegative = (*p++ == '-');
+
+        if (p >= end || ! isDigit (*p))
+            return false;
+
+        int value = 0;
+
+        for (; p < end && isDigit (*p); ++p)
+            value = value * 10 + (*p - '0');
+
+        result = isNegative ? -value : value;
+        return true;
+    }
+
+    static inline WavefrontObjFile::Vertex parseVertex (const char* p, const char* end)
+    {
+        WavefrontObjFile::Vertex v;
+        v.x = parseFloat (p, end);
+        v.y = parseFloat (p, end);
+        v.z = parseFloat (p, end);
+        return v;
+    }
+
+    static inline WavefrontObjFile::TextureCoord parseTextureCoord (const char* p, const char* end)
+    {
+        WavefrontObjFile::TextureCoord tc;
+        tc.x = parseFloat (p, end);
+        tc.y = parseFloat (p, end);
+        return tc;
+    }
+
+    static String getArgument (const char* p, const char* end)
+    {
+        return String (CharPointer_UTF8 (p), CharPointer_UTF8 (end)).trim();
+    }
+
+    //==============================================================================
+    /** A face corner as written in the file. Negative (relative) indices are
+        stored relative to the start of the chunk they were read in, with a flag
+        so that the chunk's offset can be added once it's known.
+    */
+    struct RawTriple
+    {
+        enum { relativeVertex = 1, relativeTexture = 2, relativeNormal = 4 };
+
+        int vertexIndex, textureIndex, normalIndex, relativeFlags;
+    };
+
+    /** Maps each distinct (vertex, texture, normal) triple to its index in the
+        output mesh, using open addressing with linear probing.
+    */
+    class TripleMap
+    {
+    public:
+        explicit TripleMap (int expectedSize)
+            : numUsed (0)
+        {
+            allocate (nextPowerOfTwo (jmax (16, expectedSize * 2)));
+        }
+
+        /** Returns the triple's index, or adds it with newIndex and returns that. */
+        WavefrontObjFile::Index getOrAdd (int v, int t, int n, WavefrontObjFile::Index newIndex, bool& wasAdded)
+        {
+            if (numUsed * 2 >= mask)
+                grow();
+
+            for (int i = (int) hash (v, t, n) & mask;; i = (i + 1) & mask)
+            {
+                Entry& e = entries[i];
+
+                if (e.vertexIndex == emptySlot)
+                {
+                    e.vertexIndex = v;
+                    e.textureIndex = t;
+                    e.normalIndex = n;
+                    e.index = newIndex;
+                    ++numUsed;
+                    wasAdded = true;
+                    return newIndex;
+                }
+
+                if (e.vertexIndex == v && e.textureIndex == t && e.normalIndex == n)
+                {
+                    wasAdded = false;
+                    return e.index;
+                }
+            }
+        }
+
+    private:
+        enum { emptySlot = (int) 0x80000000 };
+
+        struct Entry
+        {
+            int vertexIndex, textureIndex, normalIndex;
+            WavefrontObjFile::Index index;
+        };
+
+        HeapBlock<Entry> entries;
+        int mask, numUsed;
+
+        static inline uint32 hash (int v, int t, int n) noexcept
+        {
+            uint32 h = (uint32) v * 0x9e3779b1u;
+            h ^= (uint32) t * 0x85ebca77u + (h << 6) + (h >> 2);
+            h ^= (uint32) n * 0xc2b2ae3du + (h << 6) + (h >> 2);
+            return h ^ (h >> 15);
+        }
+
+        void allocate (int size)
+        {
+            entries.malloc ((size_t) size);
+            mask = size - 1;
+            numUsed = 0;
+
+            for (int i = 0; i < size; ++i)
+                entries[i].vertexIndex = emptySlot;
+        }
+
+        void grow()
+        {
+            HeapBlock<Entry> oldEntries;
+            oldEntries.swapWith (entries);
+            const int oldSize = mask + 1;
+
+            allocate (oldSize * 2);
+
+            for (int i = 0; i < oldSize; ++i)
+            {
+                const Entry& old = oldEntries[i];
+
+                if (old.vertexIndex != emptySlot)
+                {
+                    int j = (int) hash (old.vertexIndex, old.textureIndex, old.normalIndex) & mask;
+
+                    while (entries[j].vertexIndex != emptySlot)
+                        j = (j + 1) & mask;
+
+                    entries[j] = old;
+                    ++numUsed;
+                }
+            }
+        }
+
+        JUCE_DECLARE_NON_COPYABLE (TripleMap)
+    };
+}
+
+//==============================================================================
+namespace ObjParsing
+{
+    /** A run of whole lines of the file, and everything that was read from them. */
+    struct Chunk
+    {
+        typedef WavefrontObjFile::Vertex Vertex;
+        typedef WavefrontObjFile::TextureCoord TextureCoord;
+
+        Chunk (const char* s, const char* e) noexcept
+            : start (s), end (e), vertexBase (0), textureBase (0), normalBase (0) {}
+
+        /** Something other than geometry, which applies from the given triangle onwards. */
+        struct Statement
+        {
+            enum Type { group, useMaterial, materialLibrary };
+
+            Type type;
+            int triangle;
+            String argument;
+        };
+
+        const char* start;
+        const char* end;
+
+        Array<Vertex> vertices, normals;
+        Array<TextureCoord> textureCoords;
+        Array<RawTriple> triangleCorners;     // three per triangle
+        Array<Statement> statements;
+
+        // how many of each element came before this chunk
+        int vertexBase, textureBase, normalBase;
+
+        int getNumTriangles() const noexcept    { return triangleCorners.size() / 3; }
+
+        void parse()
+        {
+            Array<RawTriple> face;
+
+            for (const char* line = start; line < end;)
+            {
+                const char* const lineEnd = findLineEnd (line, end);
+                const char* p = skipSpace (line, lineEnd);
+                line = lineEnd + 1;
+
+                if (p >= lineEnd)
+                    continue;
+
+                switch (*p)
+                {
+                    case 'v':
+                        if (matchToken (p, lineEnd, "v", 1))        { vertices.add (parseVertex (p, lineEnd)); continue; }
+                        if (matchToken (p, lineEnd, "vn", 2))       { normals.add (parseVertex (p, lineEnd)); continue; }
+                        if (matchToken (p, lineEnd, "vt", 2))       { textureCoords.add (parseTextureCoord (p, lineEnd)); continue; }
+                        break;
+
+                    case 'f':
+                        if (matchToken (p, lineEnd, "f", 1))        { parseFace (p, lineEnd, face); continue; }
+                        break;
+
+                    case 'g':
+                    case 'o':
+                        if (matchToken (p, lineEnd, "g", 1) || matchToken (p, lineEnd, "o", 1))
+                        {
+                            addStatement (Statement::group, StringArray::fromTokens (getArgument (p, lineEnd), " \t", "")[0]);
+                            continue;
+                        }
+                        break;
+
+                    case 'u':
+                        if (matchToken (p, lineEnd, "usemtl", 6))   { addStatement (Statement::useMaterial, getArgument (p, lineEnd)); continue; }
+                        break;
+
+                    case 'm':
+                        if (matchToken (p, lineEnd, "mtllib", 6))   { addStatement (Statement::materialLibrary, getArgument (p, lineEnd)); continue; }
+                        break;
+
+                    default:
+                        break;
+                }
+            }
+        }
+
+    private:
+        void addStatement (Statement::Type type, const String& argument)
+        {
+            Statement s;
+            s.type = type;
+            s.triangle = getNumTriangles();
+            s.argument = argument;
+            statements.add (s);
+        }
+
+        // v, v/vt, v//vn or v/vt/vn, where each index counts from 1 or, if negative,
+        // back from the most recent element of its kind
+        static int resolveIndex (int index, int numSoFar, int& relativeFlags, int flag) noexcept
+        {
+            if (index > 0)
+                return index - 1;
+
+            if (index < 0)
+            {
+                relativeFlags |= flag;
+                return numSoFar + index;
+            }
+
+            return -1;
+        }
+
+        void parseFace (const char* p, const char* lineEnd, Array<RawTriple>& face)
+        {
+            face.clearQuick();
+
+            while (p < lineEnd)
+            {
+                RawTriple corner;
+                corner.textureIndex = corner.normalIndex = -1;
+                corner.relativeFlags = 0;
+
+                int index = 0;
+
+                if (! parseInt (p, lineEnd, index))
+                    break;
+
+                corner.vertexIndex = resolveIndex (index, vertices.size(), corner.relativeFlags, RawTriple::relativeVertex);
+
+                if (p < lineEnd && *p == '/')
+                {
+                    ++p;
+
+                    if (parseInt (p, lineEnd, index))
+                        corner.textureIndex = resolveIndex (index, textureCoords.size(), corner.relativeFlags, RawTriple::relativeTexture);
+
+                    if (p < lineEnd && *p == '/')
+                    {
+                        ++p;
+
+                        if (parseInt (p, lineEnd, index))
+                            corner.normalIndex = resolveIndex (index, normals.size(), corner.relativeFlags, RawTriple::relativeNormal);
+                    }
+                }
+
+                // skip anything else in the token
+                while (p < lineEnd && ! isSpace (*p))
+                    ++p;
+
+                p = skipSpace (p, lineEnd);
+                face.add (corner);
+            }
+
+            // polygons are split into a fan around their first corner
+            for (int i = 2; i < face.size(); ++i)
+            {
+                triangleCorners.add (face.getReference (0));
+                triangleCorners.add (face.getReference (i - 1));
+                triangleCorners.add (face.getReference (i));
+            }
+        }
+    };
+
+    /** A range of triangles from one chunk that belongs to a face group. */
+    struct Segment
+    {
+        const Chunk* chunk;
+        int firstTriangle, endTriangle;
+    };
+
+    //==============================================================================
+    static void buildShapeMesh (WavefrontObjFile::Mesh& newMesh, const WavefrontObjFile::Mesh& srcMesh,
+                                const Array<Segment>& segments)
+    {
+        int numTriangles = 0;
+
+        for (int i = 0; i < segments.size(); ++i)
+            numTriangles += segments.getReference (i).endTriangle - segments.getReference (i).firstTriangle;
+
+        TripleMap indexMap (jmin (numTriangles * 3, srcMesh.vertices.size() + 16));
+        newMesh.indices.ensureStorageAllocated (numTriangles * 3);
+
+        for (int s = 0; s < segments.size(); ++s)
+        {
+            const Segment& segment = segments.getReference (s);
+            const RawTriple* corner = segment.chunk->triangleCorners.begin() + segment.firstTriangle * 3;
+            const RawTriple* const end = segment.chunk->triangleCorners.begin() + segment.endTriangle * 3;
+
+            for (; corner < end; ++corner)
+            {
+                const int v = corner->vertexIndex  + ((corner->relativeFlags & RawTriple::relativeVertex)  ? segment.chunk->vertexBase  : 0);
+                const int t = corner->textureIndex + ((corner->relativeFlags & RawTriple::relativeTexture) ? segment.chunk->textureBase : 0);
+                const int n = corner->normalIndex  + ((corner->relativeFlags & RawTriple::relativeNormal)  ? segment.chunk->normalBase  : 0);
+
+                bool wasAdded;
+                const WavefrontObjFile::Index index = indexMap.getOrAdd (v, t, n, (WavefrontObjFile::Index) newMesh.vertices.size(), wasAdded);
+
+                if (wasAdded)
+                {
+                    if (isPositiveAndBelow (v, srcMesh.vertices.size()))
+                        newMesh.vertices.add (srcMesh.vertices.getReference (v));
+
+                    if (isPositiveAndBelow (n, srcMesh.normals.size()))
+                        newMesh.normals.add (srcMesh.normals.getReference (n));
+
+                    if (isPositiveAndBelow (t, srcMesh.textureCoords.size()))
+                        newMesh.textureCoords.add (srcMesh.textureCoords.getReference (t));
+                }
+
+                newMesh.indices.add (index);
+            }
+        }
+    }
+
+    struct ChunkJob  : public ThreadPoolJob
+    {
+        ChunkJob (Chunk& c) : ThreadPoolJob ("OBJ chunk"), chunk (c) {}
+
+        JobStatus runJob() override
+        {
+            chunk.parse();
+            return jobHasFinished;
+        }
+
+        Chunk& chunk;
+    };
+
+    struct ShapeJob  : public ThreadPoolJob
+    {
+        ShapeJob (WavefrontObjFile::Shape& s, const WavefrontObjFile::Mesh& src, const Array<Segment>& segs)
+            : ThreadPoolJob ("OBJ shape"), shape (s), srcMesh (src), segments (segs) {}
+
+        JobStatus runJob() override
+        {
+            buildShapeMesh (shape.mesh, srcMesh, segments);
+            return jobHasFinished;
+        }
+
+        WavefrontObjFile::Shape& shape;
+        const WavefrontObjFile::Mesh& srcMesh;
+        const Array<Segment> segments;
+    };
+
+    /** Runs the jobs on the pool, or on this thread if there isn't one, and waits for them. */
+    static void runJobs (OwnedArray<ThreadPoolJob>& jobs, ThreadPool* pool)
+    {
+        for (int i = 0; i < jobs.size(); ++i)
+        {
+            if (pool != nullptr)
+                pool->addJob (jobs.getUnchecked (i), false);
+            else
+                jobs.getUnchecked (i)->runJob();
+        }
+
+        if (pool != nullptr)
+            for (int i = 0; i < jobs.size(); ++i)
+                pool->waitForJobToFinish (jobs.getUnchecked (i), -1);
+
+        jobs.clear();
+    }
+}
+
+//==============================================================================
+Result WavefrontObjFile::load (const String& objFileContent, ThreadPool* pool)
+{
+    return load (objFileContent.toRawUTF8(), objFileContent.getNumBytesAsUTF8(), pool);
+}
+
+Result WavefrontObjFile::load (const File& file, ThreadPool* pool)
+{
+    sourceFile = file;
+
+    MemoryMappedFile mappedFile (file, MemoryMappedFile::readOnly);
+
+    if (mappedFile.getData() != nullptr)
+        return parseObjData (static_cast<const char*> (mappedFile.getData()), mappedFile.getSize(), pool);
+
+    if (! file.existsAsFile())
+        return Result::fail ("Cannot open file: " + file.getFullPathName());
+
+    // an empty file can't be mapped, and some filesystems don't support it
+    MemoryBlock data;
+
+    if (! file.loadFileAsData (data))
+        return Result::fail ("Cannot read file: " + file.getFullPathName());
+
+    return parseObjData (static_cast<const char*> (data.getData()), data.getSize(), pool);
+}
+
+Result WavefrontObjFile::load (const void* objFileData, size_t numBytes, ThreadPool* pool)
+{
+    return parseObjData (static_cast<const char*> (objFileData), numBytes, pool);
+}
+
+Result WavefrontObjFile::parseObjData (const char* data, size_t numBytes, ThreadPool* pool)
+{
+    using namespace ObjParsing;
+
+    shapes.clear();
+
+    ScopedPointer<ThreadPool> localPool;
+
+    if (numBytes < (size_t) minChunkSize * 2)
+    {
+        pool = nullptr;
+    }
+    else if (pool == nullptr)
+    {
+        localPool = new ThreadPool (SystemStats::getNumCpus());
+        pool = localPool;
+    }
+
+    // cut the data into a few chunks per thread, each ending at a line break
+    const int numThreads = SystemStats::getNumCpus();
+    const size_t chunkSize = jmax ((size_t) minChunkSize, numBytes / (size_t) (numThreads * 4) + 1);
+    const char* const end = data + numBytes;
+
+    OwnedArray<Chunk> chunks;
+
+    for (const char* chunkStart = data; chunkStart < end;)
+    {
+        const char* chunkEnd = pool == nullptr || (size_t) (end - chunkStart) <= chunkSize
+                                   ? end : findLineEnd (chunkStart + chunkSize, end);
+
+        if (chunkEnd < end)
+            ++chunkEnd;
+
+        chunks.add (new Chunk (chunkStart, chunkEnd));
+        chunkStart = chunkEnd;
+    }
+
+    OwnedArray<ThreadPoolJob> jobs;
+
+    for (int i = 0; i < chunks.size(); ++i)
+        jobs.add (new ChunkJob (*chunks.getUnchecked (i)));
+
+    runJobs (jobs, pool);
+
+    // gather all the vertices, and work out where each chunk's relative indices start from
+    Mesh mesh;
+    int numVertices = 0, numTextureCoords = 0, numNormals = 0;
+
+    for (int i = 0; i < chunks.size(); ++i)
+    {
+        Chunk& chunk = *chunks.getUnchecked (i);
+        chunk.vertexBase  = numVertices;
+        chunk.textureBase = numTextureCoords;
+        chunk.normalBase  = numNormals;
+
+        numVertices      += chunk.vertices.size();
+        numTextureCoords += chunk.textureCoords.size();
+        numNormals       += chunk.normals.size();
+    }
+
+    mesh.vertices.ensureStorageAllocated (numVertices);
+    mesh.textureCoords.ensureStorageAllocated (numTextureCoords);
+    mesh.normals.ensureStorageAllocated (numNormals);
+
+    for (int i = 0; i < chunks.size(); ++i)
+    {
+        Chunk& chunk = *chunks.getUnchecked (i);
+        mesh.vertices.addArray (static_cast<const Vertex*> (chunk.vertices.begin()), chunk.vertices.size());
+        mesh.textureCoords.addArray (static_cast<const TextureCoord*> (chunk.textureCoords.begin()), chunk.textureCoords.size());
+        mesh.normals.addArray (static_cast<const Vertex*> (chunk.normals.begin()), chunk.normals.size());
+
+        chunk.vertices.clear();
+        chunk.textureCoords.clear();
+        chunk.normals.clear();
+    }
+
+    // Split the faces into groups at each "g" or "o", as a single-threaded parse would
+    // have, and build each group's mesh as a separate job.
+    Array<Material> knownMaterials;
+    Material lastMaterial;
+    String lastName;
+    Array<Segment> faceGroup;
+    int numTrianglesInGroup = 0;
+
+    struct GroupEnder
+    {
+        static void flush (OwnedArray<Shape>& shapes, OwnedArray<ThreadPoolJob>& jobs, const Mesh& mesh,
+                           Array<Segment>& faceGroup, int& numTriangles, const Material& material, const String& name)
+        {
+            if (numTriangles > 0)
+            {
+                Shape* shape = shapes.add (new Shape());
+                shape->name = name;
+                shape->material = material;
+                jobs.add (new ShapeJob (*shape, mesh, faceGroup));
+            }
+
+            faceGroup.clearQuick();
+            numTriangles = 0;
+        }
+    };
+
+    for (int i = 0; i < chunks.size(); ++i)
+    {
+        const Chunk& chunk = *chunks.getUnchecked (i);
+        int firstTriangle = 0;
+
+        for (int s = 0; s <= chunk.statements.size(); ++s)
+        {
+            const Chunk::Statement* statement = s < chunk.statements.size() ? &chunk.statements.getReference (s) : nullptr;
+            const int endTriangle = statement != nullptr ? statement->triangle : chunk.getNumTriangles();
+
+            if (endTriangle > firstTriangle)
+            {
+                const Segment segment = { &chunk, firstTriangle, endTriangle };
+                faceGroup.add (segment);
+                numTrianglesInGroup += endTriangle - firstTriangle;
+                firstTriangle = endTriangle;
+            }
+
+            if (statement == nullptr)
+                break;
+
+            switch (statement->type)
+            {
+                case Chunk::Statement::group:
+                    GroupEnder::flush (shapes, jobs, mesh, faceGroup, numTrianglesInGroup, lastMaterial, lastName);
+                    lastName = statement->argument;
+                    break;
+
+                case Chunk::Statement::useMaterial:
+                    for (int m = knownMaterials.size(); --m >= 0;)
+                    {
+                        if (knownMaterials.getReference (m).name == statement->argument)
+                        {
+                            lastMaterial = knownMaterials.getReference (m);
+                            break;
+                        }
+                    }
+                    break;
+
+                case Chunk::Statement::materialLibrary:
+                    parseMaterial (knownMaterials, statement->argument);
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    GroupEnder::flush (shapes, jobs, mesh, faceGroup, numTrianglesInGroup, lastMaterial, lastName);
+    runJobs (jobs, pool);
+
+    return Result::ok();
+}
+
+//==============================================================================
+Result WavefrontObjFile::parseMaterial (Array<Material>& materials, const String& filename)
+{
+    using namespace ObjParsing;
+
+    // text that was parsed from memory has nowhere to look for its material libraries
+    if (sourceFile == File::nonexistent)
+        return Result::fail ("Cannot open material library without a source file: " + filename);
+
+    File f (sourceFile.getSiblingFile (filename));
+
+    if (! f.exists())
+        return Result::fail ("Cannot open file: " + filename);
+
+    StringArray lines;
+    lines.addLines (f.loadFileAsString());
+
+    materials.clear();
+    Material material;
+
+    for (int i = 0; i < lines.size(); ++i)
+    {
+        const String line (lines[i].trim());
+        const char* l = line.toRawUTF8();
+        const char* const end = l + line.getNumBytesAsUTF8();
+
+        if (matchToken (l, end, "newmtl", 6))   { materials.add (material); material.name = getArgument (l, end); continue; }
+
+        if (matchToken (l, end, "Ka", 2))       { material.ambient         = parseVertex (l, end); continue; }
+        if (matchToken (l, end, "Kd", 2))       { material.diffuse         = parseVertex (l, end); continue; }
+        if (matchToken (l, end, "Ks", 2))       { material.specular        = parseVertex (l, end); continue; }
+        if (matchToken (l, end, "Kt", 2))       { material.transmittance   = parseVertex (l, end); continue; }
+        if (matchToken (l, end, "Ke", 2))       { material.emission        = parseVertex (l, end); continue; }
+        if (matchToken (l, end, "Ni", 2))       { material.refractiveIndex = parseFloat (l, end);  continue; }
+        if (matchToken (l, end, "Ns", 2))       { material.shininess       = parseFloat (l, end);  continue; }
+
+        if (matchToken (l, end, "map_Ka", 6))   { material.ambientTextureName  = getArgument (l, end); continue; }
+        if (matchToken (l, end, "map_Kd", 6))   { material.diffuseTextureName  = getArgument (l, end); continue; }
+        if (matchToken (l, end, "map_Ks", 6))   { material.specularTextureName = getArgument (l, end); continue; }
+        if (matchToken (l, end, "map_Ns", 6))   { material.normalTextureName   = getArgument (l, end); continue; }
+
+        StringArray tokens;
+        tokens.addTokens (line, " \t", "");
+
+        if (tokens.size() >= 2)
+            material.parameters.set (tokens[0].trim(), tokens[1].trim());
+    }
+
+    materials.add (material);
+    return Result::ok();
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+#include <map>
+
+class WavefrontObjFileTests  : public UnitTest
+{
+public:
+    WavefrontObjFileTests() : UnitTest ("WavefrontObjFile") {}
+
+    //==============================================================================
+    /** A parser written the way this one used to be, reading a String line by line
+        with the general-purpose number parser and a std::map, to benchmark against.
+    */
+    struct LegacyParser
+    {
+        struct TripleIndex
+        {
+            int vertexIndex, textureIndex, normalIndex;
+
+            bool operator< (const TripleIndex& other) const noexcept
+            {
+                if (vertexIndex != other.vertexIndex)    return vertexIndex < other.vertexIndex;
+                if (textureIndex != other.textureIndex)  return textureIndex < other.textureIndex;
+                return normalIndex < other.normalIndex;
+            }
+        };
+
+        Array<WavefrontObjFile::Vertex> vertices, normals, outputVertices;
+        Array<int> outputIndices;
+
+        static float parseFloat (String::CharPointerType& t)
+        {
+            t = t.findEndOfWhitespace();
+            return (float) CharacterFunctions::readDoubleValue (t);
+        }
+
+        static WavefrontObjFile::Vertex parseVertex (String::CharPointerType t)
+        {
+            WavefrontObjFile::Vertex v;
+            v.x = parseFloat (t);
+            v.y = parseFloat (t);
+            v.z = parseFloat (t);
+            return v;
+        }
+
+        void parse (const String& objFile)
+        {
+            const StringArray lines (StringArray::fromLines (objFile));
+            std::map<TripleIndex, int> indexMap;
+
+            for (int i = 0; i < lines.size(); ++i)
+            {
+                const String::CharPointerType l (lines[i].getCharPointer().findEndOfWhitespace());
+
+                if (l.compareUpTo (CharPointer_ASCII ("v "), 2) == 0)
+                {
+                    vertices.add (parseVertex (l + 1));
+                }
+                else if (l.compareUpTo (CharPointer_ASCII ("vn "), 3) == 0)
+                {
+                    normals.add (parseVertex (l + 2));
+                }
+                else if (l.compareUpTo (CharPointer_ASCII ("g "), 2) == 0)
+                {
+                    indexMap.clear();
+                }
+                else if (l.compareUpTo (CharPointer_ASCII ("f "), 2) == 0)
+                {
+                    const StringArray corners (StringArray::fromTokens (String (l + 2), " \t", ""));
+                    Array<int> face;
+
+                    for (int c = 0; c < corners.size(); ++c)
+                    {
+                        const StringArray parts (StringArray::fromTokens (corners[c], "/", ""));
+                        const TripleIndex t = { parts[0].getIntValue() - 1, parts[1].getIntValue() - 1, parts[2].getIntValue() - 1 };
+                        const std::map<TripleIndex, int>::const_iterator existing (indexMap.find (t));
+
+                        if (existing != indexMap.end())
+                        {
+                            face.add (existing->second);
+                        }
+                        else
+                        {
+                            indexMap[t] = outputVertices.size();
+                            face.add (outputVertices.size());
+                            outputVertices.add (vertices[t.vertexIndex]);
+                        }
+                    }
+
+                    for (int c = 2; c < face.size(); ++c)
+                    {
+                        outputIndices.add (face[0]);
+                        outputIndices.add (face[c - 1]);
+                        outputIndices.add (face[c]);
+                    }
+                }
+            }
+        }
+    };
+
+    //==============================================================================
+    static String createGrid (int size)
+    {
+        MemoryOutputStream s ((size_t) size * (size_t) size * 100);
+        s << "mtllib missing.mtl\n";
+
+        for (int y = 0; y <= size; ++y)
+            for (int x = 0; x <= size; ++x)
+                s << "v " << (x * 0.0137f - 1.5f) << ' ' << (y * -0.0291f) << " " << String ((x * y) % 1000 * 1.0e-3, 4) << "\n"
+                  << "vt " << (x / (float) size) << ' ' << (y / (float) size) << "\n"
+                  << "vn 0 " << ((x & 1) ? "1" : "-1") << " 0\n";
+
+        for (int y = 0; y < size; ++y)
+        {
+            if (y % 64 == 0)
+                s << "g strip" << (y / 64) << "\n";
+
+            for (int x = 0; x < size; ++x)
+            {
+                const int a = y * (size + 1) + x + 1, b = a + 1, c = a + size + 1, d = c + 1;
+                s << "f " << a << '/' << a << '/' << a << ' ' << b << '/' << b << '/' << b << ' '
+                  << d << '/' << d << '/' << d << ' ' << c << '/' << c << '/' << c << "\n";
+            }
+        }
+
+        return s.toString();
+    }
+
+    static bool meshesMatch (const WavefrontObjFile& a, const WavefrontObjFile& b)
+    {
+        if (a.shapes.size() != b.shapes.size())
+            return false;
+
+        for (int i = 0; i < a.shapes.size(); ++i)
+        {
+            const WavefrontObjFile::Mesh& m1 = a.shapes.getUnchecked (i)->mesh;
+            const WavefrontObjFile::Mesh& m2 = b.shapes.getUnchecked (i)->mesh;
+
+            if (a.shapes.getUnchecked (i)->name != b.shapes.getUnchecked (i)->name
+                 || m1.indices != m2.indices
+                 || m1.vertices.size() != m2.vertices.size()
+                 || m1.normals.size() != m2.normals.size()
+                 || m1.textureCoords.size() != m2.textureCoords.size()
+                 || memcmp (m1.vertices.begin(), m2.vertices.begin(), sizeof (WavefrontObjFile::Vertex) * (size_t) m1.vertices.size()) != 0
+                 || memcmp (m1.normals.begin(), m2.normals.begin(), sizeof (WavefrontObjFile::Vertex) * (size_t) m1.normals.size()) != 0)
+                return false;
+        }
+
+        return true;
+    }
+
+    static double msSince (int64 start)
+    {
+        return Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start) * 1000.0;
+    }
+
+    void runTest()
+    {
+        beginTest ("Parsing");
+        {
+            WavefrontObjFile obj;
+            expect (obj.load (String ("# a comment\r\n"
+                                      "v 0 0 0\r\n"
+                                      "v 1.5 0 0\r\n"
+                                      "v 1 1e1 -2.25E-1\r\n"
+                                      "v 0 1 0\r\n"
+                                      "vn 0 0 1\r\n"
+                                      "vn 0 1 0\r\n"
+                                      "o first\r\n"
+                                      "f 1//1 2//1 3//1 4//1\r\n"
+                                      "g second extra\r\n"
+                                      "\tf -4//-2 -3//-1 -2//-2\r\n"
+                                      "f 1//2 2//2 3//2\r\n"
+                                      "g empty\r\n"))
+                     .wasOk());
+
+            expectEquals (obj.shapes.size(), 2);
+
+            const WavefrontObjFile::Shape& first = *obj.shapes[0];
+            expectEquals (first.name, String ("first"));
+            expectEquals (first.mesh.indices.size(), 6);
+            expectEquals (first.mesh.vertices.size(), 4);
+            expectEquals ((int) first.mesh.indices[3], 0);
+            expectEquals ((int) first.mesh.indices[5], 3);
+            expectEquals (first.mesh.vertices[2].y, 10.0f);
+            expectEquals (first.mesh.vertices[2].z, -0.225f);
+            expectEquals (first.mesh.vertices[1].x, 1.5f);
+
+            // the same positions with different normals must be different vertices
+            const WavefrontObjFile::Shape& second = *obj.shapes[1];
+            expectEquals (second.name, String ("second"));
+            expectEquals (second.mesh.indices.size(), 6);
+            expectEquals (second.mesh.vertices.size(), 5);
+            expectEquals (second.mesh.normals.size(), 5);
+            expectEquals (second.mesh.normals[1].y, 1.0f);
+            expectEquals (second.mesh.normals[3].y, 1.0f);
+            expectEquals (second.mesh.normals[0].z, 1.0f);
+        }
+
+        beginTest ("Numbers");
+        {
+            const char* const values[] = { "0", "-0.5", "3.14159265", "1e-3", "-7.25e+2", "123456789012345678901234",
+                                           "0.000000000000000000000000000001", "1.17549435e-38", "+42", ".5" };
+
+            for (int i = 0; i < numElementsInArray (values); ++i)
+            {
+                const String line (String ("v ") + values[i] + " 0 0\n");
+                WavefrontObjFile obj;
+                obj.load (line + "f 1 1 1\n");
+                expectEquals (obj.shapes[0]->mesh.vertices[0].x, String (values[i]).getFloatValue());
+            }
+        }
+
+        const String grid (createGrid (700));
+
+        beginTest ("Parallel parsing matches serial parsing");
+        {
+            ThreadPool singleThread (1), pool (SystemStats::getNumCpus());
+            WavefrontObjFile serial, parallel;
+
+            expect (serial.load (grid, &singleThread).wasOk());
+            expect (parallel.load (grid.toRawUTF8(), grid.getNumBytesAsUTF8(), &pool).wasOk());
+
+            expectEquals (serial.shapes.size(), 11);
+            expect (meshesMatch (serial, parallel));
+        }
+
+        beginTest ("Benchmark");
+        {
+            const File file (File::createTempFile (".obj"));
+            file.replaceWithText (grid);
+
+            ThreadPool singleThread (1), pool (SystemStats::getNumCpus());
+            const double megabytes = file.getSize() / (1024.0 * 1024.0);
+
+            int64 start = Time::getHighResolutionTicks();
+            LegacyParser legacy;
+            legacy.parse (file.loadFileAsString());
+            const double legacyMs = msSince (start);
+
+            start = Time::getHighResolutionTicks();
+            WavefrontObjFile serial;
+            serial.load (file, &singleThread);
+            const double serialMs = msSince (start);
+
+            start = Time::getHighResolutionTicks();
+            WavefrontObjFile parallel;
+            parallel.load (file, &pool);
+            const double parallelMs = msSince (start);
+
+            int numVertices = 0, numIndices = 0;
+
+            for (int i = 0; i < parallel.shapes.size(); ++i)
+            {
+                numVertices += parallel.shapes.getUnchecked (i)->mesh.vertices.size();
+                numIndices += parallel.shapes.getUnchecked (i)->mesh.indices.size();
+            }
+
+            expectEquals (numIndices, legacy.outputIndices.size());
+            expectEquals (numVertices, legacy.outputVertices.size());
+
+            logMessage (String (megabytes, 1) + " MB, " + String (numIndices / 3) + " triangles: legacy "
+                          + String (legacyMs, 1) + " ms (" + String (megabytes * 1000.0 / legacyMs, 1) + " MB/s), one thread "
+                          + String (serialMs, 1) + " ms (" + String (megabytes * 1000.0 / serialMs, 1) + " MB/s), "
+                          + String (SystemStats::getNumCpus()) + " threads " + String (parallelMs, 1) + " ms ("
+                          + String (megabytes * 1000.0 / parallelMs, 1) + " MB/s)");
+
+            file.deleteFile();
+        }
+    }
+};
+
+static WavefrontObjFileTests wavefrontObjFileTests;
+
+#endif